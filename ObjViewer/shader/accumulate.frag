@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec2 texCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D scene;
+uniform float weight; // 1 / samples so far, blended as the source alpha
+
+void main()
+{
+    FragColor = vec4(texture(scene, texCoord).rgb, weight);
+}
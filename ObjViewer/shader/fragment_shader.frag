@@ -7,9 +7,29 @@ out vec4 FragColor;
 uniform sampler2D texture_container;
 uniform sampler2D texture_awesomeface;
 
+uniform sampler2DArray texture_atlas;
+uniform int atlas_layer;  // -1 when the draw uses texture_container
+uniform vec4 atlas_rect;  // uv offset and scale of the texture in its layer
+
+vec4 diffuse()
+{
+    // the gradients come from the unwrapped coordinates, fract() would make
+    // them jump where the texture repeats and pick the smallest level there
+    vec2 dx = dFdx(texCoord) * atlas_rect.zw;
+    vec2 dy = dFdy(texCoord) * atlas_rect.zw;
+
+    if (atlas_layer < 0)
+    {
+        return texture(texture_container, texCoord);
+    }
+
+    vec2 uv = atlas_rect.xy + fract(texCoord) * atlas_rect.zw;
+    return textureGrad(texture_atlas, vec3(uv, float(atlas_layer)), dx, dy);
+}
+
 void main()
 {
-    FragColor = mix(texture(texture_container, texCoord),
+    FragColor = mix(diffuse(),
 					texture(texture_awesomeface, texCoord),
 					0.2);
 }
@@ -0,0 +1,59 @@
+#version 330 core
+
+in vec2 texCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D vt_atlas;        // pages with their border, no mips
+uniform sampler2D vt_indirection;  // per page and level: slot x, slot y, level in the slot
+uniform sampler2D texture_awesomeface;
+
+uniform vec2 vt_size;       // level 0, in texels
+uniform vec2 vt_atlas_size;
+uniform float vt_max_level;
+uniform float vt_lod_bias;
+
+const float PAGE_SIZE = 128.0;
+const float PAGE_BORDER = 4.0;
+const float PAGE_STRIDE = PAGE_SIZE + 2.0 * PAGE_BORDER;
+
+vec2 level_size(float level)
+{
+    return max(floor(vt_size / exp2(level)), vec2(1.0));
+}
+
+vec2 page_of(vec2 uv, float level)
+{
+    vec2 size = level_size(level);
+    return min(floor(uv * size / PAGE_SIZE), ceil(size / PAGE_SIZE) - 1.0);
+}
+
+vec4 sample_virtual_texture(vec2 coord)
+{
+    vec2 texel = coord * vt_size;
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + vt_lod_bias;
+    float level = clamp(floor(lod), 0.0, vt_max_level);
+
+    vec2 uv = fract(coord);
+    vec2 page = page_of(uv, level);
+
+    // the page itself, or its finest ancestor in the atlas while it loads
+    vec3 entry = floor(texelFetch(vt_indirection, ivec2(page), int(level)).rgb * 255.0 + 0.5);
+    float resident_level = entry.b;
+
+    vec2 resident_page = min(floor(page / exp2(resident_level - level)), page_of(vec2(1.0), resident_level));
+    vec2 local_texel = uv * level_size(resident_level) - resident_page * PAGE_SIZE;
+    local_texel = clamp(local_texel, vec2(0.5 - PAGE_BORDER), vec2(PAGE_SIZE + PAGE_BORDER - 0.5));
+
+    vec2 atlas_texel = entry.rg * PAGE_STRIDE + PAGE_BORDER + local_texel;
+    return textureLod(vt_atlas, atlas_texel / vt_atlas_size, 0.0);
+}
+
+void main()
+{
+    FragColor = mix(sample_virtual_texture(texCoord),
+					texture(texture_awesomeface, texCoord),
+					0.2);
+}
@@ -0,0 +1,11 @@
+#version 330 core
+
+out vec2 texCoord;
+
+// one triangle over the whole screen, no vertex buffer
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    texCoord = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
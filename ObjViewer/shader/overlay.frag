@@ -0,0 +1,14 @@
+#version 330 core
+
+in vec2 texCoord;
+in vec2 shadeAlpha;
+
+out vec4 FragColor;
+
+uniform sampler2D font;
+
+void main()
+{
+    float ink = texture(font, texCoord).r;
+    FragColor = vec4(vec3(shadeAlpha.x), ink * shadeAlpha.y);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+layout (location=0) in vec4 aPosTexCoord; // pixels from the top left, font texels
+layout (location=1) in vec2 aShadeAlpha;
+
+out vec2 texCoord;
+out vec2 shadeAlpha;
+
+uniform vec2 screen_size;
+uniform vec2 font_size;
+
+void main()
+{
+    vec2 ndc = aPosTexCoord.xy / screen_size * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+    texCoord = aPosTexCoord.zw / font_size;
+    shadeAlpha = aShadeAlpha;
+}
@@ -2,6 +2,8 @@
 
 layout (location=0) in vec3 aPos;
 layout (location=1) in vec2 aTexCoord;
+layout (location=2) in vec3 aNormal;
+layout (location=3) in vec4 aTangent;
 
 out vec2 texCoord;
 
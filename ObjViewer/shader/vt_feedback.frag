@@ -0,0 +1,26 @@
+#version 330 core
+
+in vec2 texCoord;
+
+out vec4 FragColor;
+
+uniform vec2 vt_size;       // level 0, in texels
+uniform float vt_max_level;
+uniform float vt_lod_bias;  // the feedback target is smaller than the screen
+
+const float PAGE_SIZE = 128.0;
+
+// page and level the fragment samples, read back by process_feedback
+void main()
+{
+    vec2 texel = texCoord * vt_size;
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + vt_lod_bias;
+    float level = clamp(floor(lod), 0.0, vt_max_level);
+
+    vec2 level_size = max(floor(vt_size / exp2(level)), vec2(1.0));
+    vec2 page = min(floor(fract(texCoord) * level_size / PAGE_SIZE), ceil(level_size / PAGE_SIZE) - 1.0);
+
+    FragColor = vec4(page, level, 255.0) / 255.0;
+}
@@ -0,0 +1,172 @@
+#include <glad\glad.h>
+
+#include "accum.h"
+#include "log.h"
+#include "stats.h"
+
+AccumulationOptions default_accumulation_options()
+{
+    AccumulationOptions options;
+    options.max_samples = 16;
+    return options;
+}
+
+local void
+destroy_targets(AccumulationBuffer *accum)
+{
+    if (accum->accum_fbo) glDeleteFramebuffers(1, &accum->accum_fbo);
+    if (accum->accum_color) glDeleteTextures(1, &accum->accum_color);
+
+    accum->accum_fbo = 0;
+    accum->accum_color = 0;
+    accum->width = 0;
+    accum->height = 0;
+    accum->sample_count = 0;
+}
+
+local s32
+init_targets(AccumulationBuffer *accum, u32 width, u32 height)
+{
+    destroy_targets(accum);
+
+    accum->width = width > 0 ? width : 1;
+    accum->height = height > 0 ? height : 1;
+
+    glGenTextures(1, &accum->accum_color);
+    glBindTexture(GL_TEXTURE_2D, accum->accum_color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, accum->width, accum->height, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenFramebuffers(1, &accum->accum_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, accum->accum_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accum->accum_color, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        LOG_W("Accumulation target is incomplete (0x%x)", status);
+        destroy_targets(accum);
+        return -1;
+    }
+
+    return 0;
+}
+
+s32 init(AccumulationBuffer *accum, u32 width, u32 height, const AccumulationOptions &options)
+{
+    *accum = {};
+    accum->options = options;
+
+    if (init(&accum->shader, "shader\\fullscreen.vert", "shader\\accumulate.frag") != 0) return -1;
+    use(&accum->shader);
+    set_int(&accum->shader, "scene", 0);
+
+    glGenVertexArrays(1, &accum->vao);
+
+    return init_targets(accum, width, height);
+}
+
+void destroy(AccumulationBuffer *accum)
+{
+    destroy_targets(accum);
+    if (accum->vao) glDeleteVertexArrays(1, &accum->vao);
+    accum->vao = 0;
+    destroy(&accum->shader);
+}
+
+void reset(AccumulationBuffer *accum)
+{
+    accum->sample_count = 0;
+}
+
+bool refining(const AccumulationBuffer *accum)
+{
+    return accum->accum_fbo && accum->sample_count < accum->options.max_samples;
+}
+
+local float
+halton(u32 index, u32 base)
+{
+    float result = 0.0f;
+    float f = 1.0f;
+    while (index > 0)
+    {
+        f /= base;
+        result += f * (index % base);
+        index /= base;
+    }
+    return result;
+}
+
+glm::mat4 jitter_projection(const AccumulationBuffer *accum, const glm::mat4 &projection)
+{
+    // the first sample sits on the pixel center so it matches the frame
+    // drawn while the view was moving
+    if (accum->sample_count == 0 || accum->width == 0) return projection;
+
+    // Halton from 1, index 0 is the origin for both bases
+    float jitter_x = halton(accum->sample_count, 2) - 0.5f;
+    float jitter_y = halton(accum->sample_count, 3) - 0.5f;
+
+    // pixels to clip space offsets; the third column is multiplied by view z
+    // and the divide by w = -z turns it into a constant shift in NDC
+    glm::mat4 jittered = projection;
+    jittered[2][0] += 2.0f * jitter_x / accum->width;
+    jittered[2][1] += 2.0f * jitter_y / accum->height;
+    return jittered;
+}
+
+void accumulate(AccumulationBuffer *accum, const RenderTarget *scene)
+{
+    if (accum->width != scene->width || accum->height != scene->height)
+    {
+        init_targets(accum, scene->width, scene->height);
+    }
+
+    if (!accum->accum_fbo)
+    {
+        present(scene);
+        return;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, accum->accum_fbo);
+    glViewport(0, 0, accum->width, accum->height);
+
+    GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+    GLboolean cull_face = glIsEnabled(GL_CULL_FACE);
+    GLint polygon_mode[2];
+    glGetIntegerv(GL_POLYGON_MODE, polygon_mode);
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    // the first sample replaces whatever was there with weight 1
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    use(&accum->shader);
+    set_float(&accum->shader, "weight", 1.0f / (accum->sample_count + 1));
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, scene->color);
+    glBindVertexArray(accum->vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    count_draw(3);
+    glBindVertexArray(0);
+
+    glDisable(GL_BLEND);
+    if (depth_test) glEnable(GL_DEPTH_TEST);
+    if (cull_face) glEnable(GL_CULL_FACE);
+    glPolygonMode(GL_FRONT_AND_BACK, polygon_mode[0]);
+
+    ++accum->sample_count;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, accum->accum_fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, accum->width, accum->height, 0, 0, accum->width, accum->height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "types.h"
+#include "shader.h"
+#include "target.h"
+
+// Progressive anti-aliasing while the view stands still.
+//
+// Each idle frame renders the scene once more into its render target with
+// the projection moved by a sub pixel Halton offset, and blends that into a
+// float buffer as a running average: the new sample gets weight 1/n as its
+// alpha, so the buffer always holds the mean of n samples and is shown as
+// is. Any change to the view throws the samples away.
+
+struct AccumulationOptions
+{
+    u32 max_samples; // refinement stops here and the viewer goes idle
+};
+
+AccumulationOptions default_accumulation_options();
+
+struct AccumulationBuffer
+{
+    AccumulationOptions options;
+
+    u32 width;
+    u32 height;
+
+    u32 accum_fbo;   // running average, RGBA16F
+    u32 accum_color;
+
+    u32 vao;         // empty, the full screen triangle comes from gl_VertexID
+    Shader shader;
+
+    u32 sample_count;
+};
+
+s32 init(AccumulationBuffer *accum, u32 width, u32 height, const AccumulationOptions &options);
+
+void destroy(AccumulationBuffer *accum);
+
+// the next frame starts over
+void reset(AccumulationBuffer *accum);
+
+bool refining(const AccumulationBuffer *accum);
+
+// projection for the next sample, offset by less than a pixel
+glm::mat4 jitter_projection(const AccumulationBuffer *accum, const glm::mat4 &projection);
+
+// averages in the scene drawn with the jittered projection and copies the
+// result to the default framebuffer, in place of present()
+void accumulate(AccumulationBuffer *accum, const RenderTarget *scene);
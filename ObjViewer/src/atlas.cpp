@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+#include <glad\glad.h>
+
+#include "atlas.h"
+#include "image.h"
+#include "texbake.h"
+#include "profile.h"
+#include "stats.h"
+#include "log.h"
+
+void init(SkylinePacker *packer, u32 width, u32 height)
+{
+    packer->width = width;
+    packer->height = height;
+    packer->skyline.clear();
+    packer->skyline.push_back(SkylineSegment{0, 0, width});
+}
+
+// lowest y a rectangle of this width can sit at starting on segment index
+local bool
+fit(const SkylinePacker *packer, u32 index, u32 width, u32 height, u32 *y)
+{
+    u32 x = packer->skyline[index].x;
+    if (x + width > packer->width) return false;
+
+    u32 top = 0;
+    s64 remaining = width;
+    for (u32 i = index; remaining > 0; ++i)
+    {
+        const SkylineSegment &segment = packer->skyline[i];
+        top = glm::max(top, segment.y);
+        if (top + height > packer->height) return false;
+        remaining -= segment.width;
+    }
+
+    *y = top;
+    return true;
+}
+
+bool pack(SkylinePacker *packer, u32 width, u32 height, u32 *x, u32 *y)
+{
+    u32 best_index = 0xFFFFFFFF;
+    u32 best_y = 0xFFFFFFFF;
+    u32 best_width = 0xFFFFFFFF;
+
+    // lowest first, then the narrowest segment to waste less next to it
+    for (u32 i = 0; i < (u32)packer->skyline.size(); ++i)
+    {
+        u32 top;
+        if (!fit(packer, i, width, height, &top)) continue;
+
+        if (top < best_y || (top == best_y && packer->skyline[i].width < best_width))
+        {
+            best_index = i;
+            best_y = top;
+            best_width = packer->skyline[i].width;
+        }
+    }
+
+    if (best_index == 0xFFFFFFFF) return false;
+
+    SkylineSegment placed = SkylineSegment{packer->skyline[best_index].x, best_y + height, width};
+    std::vector<SkylineSegment> &skyline = packer->skyline;
+    skyline.insert(skyline.begin() + best_index, placed);
+
+    // the segments under the new one shrink or go away
+    u32 right = placed.x + placed.width;
+    for (u32 i = best_index + 1; i < (u32)skyline.size();)
+    {
+        SkylineSegment &segment = skyline[i];
+        if (segment.x >= right) break;
+
+        u32 covered = right - segment.x;
+        if (segment.width <= covered)
+        {
+            skyline.erase(skyline.begin() + i);
+            continue;
+        }
+
+        segment.x += covered;
+        segment.width -= covered;
+        break;
+    }
+
+    for (u32 i = 0; i + 1 < (u32)skyline.size();)
+    {
+        if (skyline[i].y == skyline[i + 1].y)
+        {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    *x = placed.x;
+    *y = best_y;
+    return true;
+}
+
+TextureAtlasOptions default_texture_atlas_options()
+{
+    TextureAtlasOptions options;
+    options.layer_size = 2048;
+    options.max_texture_size = 512;
+    options.padding = 16;
+    return options;
+}
+
+struct AtlasImage
+{
+    u32 entry;
+    u8 *pixels;
+    u32 width;
+    u32 height;
+
+    u32 layer;
+    u32 x; // of the padded box
+    u32 y;
+};
+
+local inline u32
+align_up(u32 value, u32 alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// the whole padded box, texels outside the image wrap around like GL_REPEAT
+local void
+copy_padded(const AtlasImage *image, u32 padding, u32 box_width, u32 box_height, u8 *layer, u32 layer_size)
+{
+    for (u32 y = 0; y < box_height; ++y)
+    {
+        u32 source_y = (y + image->height - padding % image->height) % image->height;
+        const u8 *row = image->pixels + (u64)source_y * image->width * 4;
+        u8 *out = layer + ((u64)(image->y + y) * layer_size + image->x) * 4;
+
+        for (u32 x = 0; x < box_width; ++x)
+        {
+            u32 source_x = (x + image->width - padding % image->width) % image->width;
+            memcpy(out + x * 4, row + source_x * 4, 4);
+        }
+    }
+}
+
+s32 init(TextureAtlas *atlas, const std::vector<std::string> &filenames, const TextureAtlasOptions &options)
+{
+    PROFILE_SCOPE("texture atlas");
+
+    atlas->ID = 0;
+    atlas->layer_count = 0;
+    atlas->level_count = 0;
+    atlas->packed = 0;
+    atlas->size = 0;
+    atlas->entries.assign(filenames.size(), TextureAtlasEntry{TEXTURE_ATLAS_NO_LAYER, glm::vec4(0.0f)});
+
+    u32 padding = options.padding;
+    u32 alignment = glm::max(padding, 1u); // no padding, no alignment
+    u32 max_size = glm::min(options.max_texture_size, options.layer_size - 2 * padding);
+
+    // materials often share a texture, it is packed once
+    std::unordered_map<std::string, u32> first_use;
+    std::vector<u32> same_as(filenames.size(), TEXTURE_ATLAS_NO_LAYER);
+
+    std::vector<AtlasImage> images;
+    for (u32 i = 0; i < (u32)filenames.size(); ++i)
+    {
+        if (filenames[i].empty()) continue;
+
+        auto known = first_use.find(filenames[i]);
+        if (known != first_use.end())
+        {
+            same_as[i] = known->second;
+            continue;
+        }
+        first_use[filenames[i]] = i;
+
+        u32 width, height, n_channels;
+        if (!image_info(filenames[i].c_str(), &width, &height, &n_channels)) continue;
+        if (width > max_size || height > max_size) continue;
+
+        Image image;
+        if (load_image(&image, filenames[i].c_str(), 4) != 0)
+        {
+            LOG_W("Cannot load '%s': %s", filenames[i].c_str(), image_failure_reason());
+            continue;
+        }
+
+        images.push_back(AtlasImage{i, image.pixels, image.width, image.height, 0, 0, 0});
+    }
+
+    if (images.empty()) return 0;
+
+    // tall ones first keep the skyline flat
+    std::sort(images.begin(), images.end(), [](const AtlasImage &a, const AtlasImage &b) {
+        if (a.height != b.height) return a.height > b.height;
+        return a.width > b.width;
+    });
+
+    std::vector<SkylinePacker> layers;
+    for (AtlasImage &image : images)
+    {
+        u32 box_width = align_up(image.width + 2 * padding, alignment);
+        u32 box_height = align_up(image.height + 2 * padding, alignment);
+
+        bool placed = false;
+        for (u32 layer = 0; layer < (u32)layers.size() && !placed; ++layer)
+        {
+            placed = pack(&layers[layer], box_width, box_height, &image.x, &image.y);
+            image.layer = layer;
+        }
+
+        if (!placed)
+        {
+            layers.emplace_back();
+            init(&layers.back(), options.layer_size, options.layer_size);
+            pack(&layers.back(), box_width, box_height, &image.x, &image.y);
+            image.layer = (u32)layers.size() - 1;
+        }
+    }
+
+    u32 layer_size = options.layer_size;
+    std::vector<std::vector<u8>> layer_pixels(layers.size(), std::vector<u8>((u64)layer_size * layer_size * 4, 0));
+
+    for (const AtlasImage &image : images)
+    {
+        u32 box_width = align_up(image.width + 2 * padding, alignment);
+        u32 box_height = align_up(image.height + 2 * padding, alignment);
+        copy_padded(&image, padding, box_width, box_height, layer_pixels[image.layer].data(), layer_size);
+        free(image.pixels);
+
+        TextureAtlasEntry *entry = &atlas->entries[image.entry];
+        entry->layer = image.layer;
+        entry->rect = glm::vec4((float)(image.x + padding) / layer_size, (float)(image.y + padding) / layer_size,
+                                (float)image.width / layer_size, (float)image.height / layer_size);
+    }
+
+    for (u32 i = 0; i < (u32)filenames.size(); ++i)
+    {
+        if (same_as[i] != TEXTURE_ATLAS_NO_LAYER) atlas->entries[i] = atlas->entries[same_as[i]];
+    }
+
+    // a level texel must stay inside the padding of its rectangle
+    u32 level_count = 1;
+    while ((1u << level_count) <= padding) ++level_count;
+
+    atlas->layer_count = (u32)layers.size();
+    atlas->level_count = level_count;
+    atlas->packed = (u32)images.size();
+
+    glGenTextures(1, &atlas->ID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, atlas->ID);
+
+    for (u32 level = 0; level < level_count; ++level)
+    {
+        u32 size = glm::max(layer_size >> level, 1u);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, size, size, atlas->layer_count, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        atlas->size += (u64)size * size * 4 * atlas->layer_count;
+    }
+
+    std::vector<TextureLevel> levels;
+    for (u32 layer = 0; layer < atlas->layer_count; ++layer)
+    {
+        build_mip_chain(layer_pixels[layer].data(), layer_size, layer_size, true, &levels);
+        layer_pixels[layer].clear();
+        layer_pixels[layer].shrink_to_fit();
+
+        for (u32 level = 0; level < level_count; ++level)
+        {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, levels[level].width, levels[level].height, 1,
+                            GL_RGBA, GL_UNSIGNED_BYTE, levels[level].pixels.data());
+        }
+    }
+
+    // wrapping is done in the shader, inside each rectangle
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, level_count - 1);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    LOG_I("Packed %u of %u textures into %u atlas layers of %ux%u, %.2f MB", atlas->packed,
+          (u32)filenames.size(), atlas->layer_count, layer_size, layer_size, atlas->size / (1024.0 * 1024.0));
+
+    return 0;
+}
+
+void bind(TextureAtlas *atlas, u32 unit)
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, atlas->ID);
+    count_texture_changes(1);
+}
+
+void destroy(TextureAtlas *atlas)
+{
+    if (atlas->ID) glDeleteTextures(1, &atlas->ID);
+    atlas->ID = 0;
+    atlas->layer_count = 0;
+    atlas->packed = 0;
+    atlas->size = 0;
+    atlas->entries.clear();
+}
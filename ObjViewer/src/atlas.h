@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "types.h"
+
+// Small material textures packed into the layers of one 2D texture array,
+// so draws that use them only change two uniforms instead of the binding.
+//
+// Each texture gets a rectangle aligned to, and surrounded by, padding
+// texels filled with its own wrapped content. Mip levels stop where a level
+// texel would span the padding, so neither bilinear filtering nor the
+// smaller levels mix in the neighbours. Repeating UVs wrap in the shader.
+
+#define TEXTURE_ATLAS_NO_LAYER 0xFFFFFFFF
+
+// bottom left skyline: the top edge of everything placed so far as a list of
+// horizontal segments, each rectangle goes where it ends up lowest
+struct SkylineSegment
+{
+    u32 x;
+    u32 y;
+    u32 width;
+};
+
+struct SkylinePacker
+{
+    u32 width;
+    u32 height;
+    std::vector<SkylineSegment> skyline;
+};
+
+void init(SkylinePacker *packer, u32 width, u32 height);
+
+// false when the rectangle does not fit anymore
+bool pack(SkylinePacker *packer, u32 width, u32 height, u32 *x, u32 *y);
+
+struct TextureAtlasOptions
+{
+    u32 layer_size;
+    u32 max_texture_size; // bigger textures are left out of the atlas
+    u32 padding;          // 0 or a power of two, also the rectangle alignment
+};
+
+TextureAtlasOptions default_texture_atlas_options();
+
+struct TextureAtlasEntry
+{
+    u32 layer;      // TEXTURE_ATLAS_NO_LAYER when not in the atlas
+    glm::vec4 rect; // uv offset and scale of the texture in its layer
+};
+
+struct TextureAtlas
+{
+    u32 ID; // GL_TEXTURE_2D_ARRAY, 0 when nothing was packed
+    u32 layer_count;
+    u32 level_count;
+
+    std::vector<TextureAtlasEntry> entries; // one per input file, in order
+
+    u32 packed;
+    u64 size; // bytes of all the levels on the GPU
+};
+
+// loads the images and packs the small enough ones, empty filenames and
+// files that cannot be loaded get no layer either
+s32 init(TextureAtlas *atlas, const std::vector<std::string> &filenames, const TextureAtlasOptions &options);
+
+void bind(TextureAtlas *atlas, u32 unit);
+
+void destroy(TextureAtlas *atlas);
@@ -0,0 +1,1175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <thread>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "stb_image.h"
+
+#include "bench.h"
+#include "image.h"
+#include "file.h"
+#include "transform.h"
+#include "texbake.h"
+#include "vtex.h"
+#include "jobs.h"
+#include "obj.h"
+#include "normals.h"
+#include "chunk.h"
+#include "scene.h"
+#include "scenegen.h"
+#include "occlusion.h"
+#include "raster.h"
+#include "camera.h"
+#include "number.h"
+#include "objstream.h"
+
+local double
+now_seconds()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// runs fn until at least min_seconds elapsed and returns the best time of a
+// single run in milliseconds
+template <typename F>
+local double
+measure_ms(F fn, double min_seconds = 0.25)
+{
+    double best = 1e30;
+    double start = now_seconds();
+    u32 runs = 0;
+
+    do
+    {
+        double t0 = now_seconds();
+        fn();
+        double t1 = now_seconds();
+
+        best = glm::min(best, (t1 - t0) * 1000.0);
+        ++runs;
+    }
+    while (now_seconds() - start < min_seconds || runs < 3);
+
+    return best;
+}
+
+local void
+print_result(const char *name, u32 count, double ms)
+{
+    printf("  %-36s %10.3f ms  %8.2f ns/object\n", name, ms, ms * 1.0e6 / count);
+}
+
+// simple deterministic generator, the numbers only need to look random
+local u32 bench_seed = 12345;
+local float
+random_float(float min, float max)
+{
+    bench_seed = bench_seed * 1664525u + 1013904223u;
+    return min + (max - min) * (float)(bench_seed >> 8) / (float)(1 << 24);
+}
+
+local void
+bench_transforms(u32 count)
+{
+    printf("transforms: %u objects, %u workers\n", count, worker_count());
+
+    std::vector<glm::vec3> positions(count);
+    for (u32 i = 0; i < count; ++i)
+    {
+        positions[i] = glm::vec3(random_float(-100.0f, 100.0f), random_float(-100.0f, 100.0f), random_float(-100.0f, 100.0f));
+    }
+
+    glm::vec3 axis(1.0f, 0.3f, 0.5f);
+    std::vector<glm::mat4> models(count);
+
+    // what main.cpp used to do per cube: time query + translate + rotate
+    double glm_ms = measure_ms([&] {
+        for (u32 i = 0; i < count; ++i)
+        {
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model, positions[i]);
+            float angle = (float)now_seconds();
+            if (i % 2 == 0) angle = -angle;
+            model = glm::rotate(model, glm::radians(angle * 20.0f), axis);
+            models[i] = model;
+        }
+    });
+    print_result("glm per object (+ time query)", count, glm_ms);
+
+    double glm_no_time_ms = measure_ms([&] {
+        float angle = (float)now_seconds();
+        for (u32 i = 0; i < count; ++i)
+        {
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model, positions[i]);
+            model = glm::rotate(model, glm::radians((i % 2 == 0 ? -angle : angle) * 20.0f), axis);
+            models[i] = model;
+        }
+    });
+    print_result("glm per object", count, glm_no_time_ms);
+
+    TransformSystem system;
+    init(&system, count);
+    for (u32 i = 0; i < count; ++i)
+    {
+        add_transform(&system, positions[i], glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+    }
+
+    glm::vec3 unit_axis = glm::normalize(axis);
+    auto animate = [&](u32 stride) {
+        float angle = (float)now_seconds();
+        for (u32 i = 0; i < count; i += stride)
+        {
+            float a = glm::radians((i % 2 == 0 ? -angle : angle) * 20.0f);
+            set_rotation(&system, i, glm::angleAxis(a, unit_axis));
+        }
+    };
+
+    double scalar_ms = measure_ms([&] { animate(1); update_transforms_scalar(&system); });
+    print_result("soa scalar, all dirty", count, scalar_ms);
+
+    double simd_ms = measure_ms([&] { animate(1); update_transforms(&system, false); });
+    print_result("soa simd, all dirty", count, simd_ms);
+
+    double simd_mt_ms = measure_ms([&] { animate(1); update_transforms(&system, true); });
+    print_result("soa simd threaded, all dirty", count, simd_mt_ms);
+
+    double simd_sparse_ms = measure_ms([&] { animate(100); update_transforms(&system, true); });
+    print_result("soa simd threaded, 1% dirty", count, simd_sparse_ms);
+
+    double simd_static_ms = measure_ms([&] { update_transforms(&system, true); });
+    print_result("soa simd threaded, static", count, simd_static_ms);
+
+    // keep the compiler from dropping the glm loops
+    volatile float sink = models[count / 2][3][0] + system.world[count / 2][3][0];
+    (void)sink;
+
+    destroy(&system);
+}
+
+local double
+psnr(const u8 *a, const u8 *b, u64 count, u32 channels)
+{
+    double error = 0.0;
+    for (u64 i = 0; i < count; ++i)
+    {
+        for (u32 c = 0; c < channels; ++c)
+        {
+            double d = (double)a[i * 4 + c] - b[i * 4 + c];
+            error += d * d;
+        }
+    }
+
+    double mse = error / (count * channels);
+    return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+// a test image when no file is given: gradients, hard edges and noise
+local void
+make_test_image(std::vector<u8> *pixels, u32 width, u32 height)
+{
+    pixels->resize((u64)width * height * 4);
+    for (u32 y = 0; y < height; ++y)
+    {
+        for (u32 x = 0; x < width; ++x)
+        {
+            u8 *texel = pixels->data() + ((u64)y * width + x) * 4;
+            bool checker = ((x / 64) + (y / 64)) % 2 == 0;
+            texel[0] = (u8)(x * 255 / width);
+            texel[1] = checker ? 200 : (u8)(y * 255 / height);
+            texel[2] = (u8)random_float(0.0f, 255.0f);
+            texel[3] = (u8)((x ^ y) & 0xFF);
+        }
+    }
+}
+
+local void
+bench_textures(const char *image_filename)
+{
+    std::vector<u8> image;
+    s32 width = 2048, height = 2048;
+
+    if (image_filename)
+    {
+        Image loaded;
+        if (load_image(&loaded, image_filename, 4) != 0)
+        {
+            fprintf(stderr, "cannot load '%s': %s\n", image_filename, image_failure_reason());
+            return;
+        }
+        width = loaded.width;
+        height = loaded.height;
+        image.assign(loaded.pixels, loaded.pixels + (u64)width * height * 4);
+        destroy(&loaded);
+    }
+    else
+    {
+        make_test_image(&image, width, height);
+    }
+
+    double megapixels = (double)width * height / 1.0e6;
+    printf("textures: %s %dx%d, %u workers\n", image_filename ? image_filename : "test image",
+           width, height, worker_count());
+
+    std::vector<TextureLevel> levels;
+    double mip_ms = measure_ms([&] { build_mip_chain(image.data(), width, height, true, &levels); });
+    printf("  %-20s %10.3f ms  %8.1f MPix/s\n", "srgb mip chain", mip_ms, megapixels / (mip_ms / 1000.0));
+
+    u64 rgba_size = 0;
+    for (const TextureLevel &level : levels) rgba_size += texture_level_size(TEXTURE_FORMAT_RGBA8, level.width, level.height);
+
+    printf("  %-6s %12s %12s %10s %12s %10s\n", "format", "1 thread", "all threads", "psnr", "vram", "vs rgba8");
+
+    for (u32 format = TEXTURE_FORMAT_BC1; format < TEXTURE_FORMAT_COUNT; ++format)
+    {
+        std::vector<u8> blocks(texture_level_size((TextureFormat)format, width, height));
+        double single_ms = measure_ms([&] {
+            compress_image((TextureFormat)format, image.data(), width, height, blocks.data(), false);
+        });
+        double threaded_ms = measure_ms([&] {
+            compress_image((TextureFormat)format, image.data(), width, height, blocks.data(), true);
+        });
+
+        std::vector<u8> decoded(image.size());
+        decompress_image((TextureFormat)format, blocks.data(), width, height, decoded.data());
+        u32 channels = format == TEXTURE_FORMAT_BC1 ? 3 : format == TEXTURE_FORMAT_BC5 ? 2 : 4;
+
+        u64 size = 0;
+        for (const TextureLevel &level : levels) size += texture_level_size((TextureFormat)format, level.width, level.height);
+
+        printf("  %-6s %7.1f MP/s %7.1f MP/s %7.2f dB %9.2f MB %9.0f%%\n", texture_format_name((TextureFormat)format),
+               megapixels / (single_ms / 1000.0), megapixels / (threaded_ms / 1000.0),
+               psnr(image.data(), decoded.data(), (u64)width * height, channels),
+               size / (1024.0 * 1024.0), 100.0 * size / rgba_size);
+    }
+
+    printf("  %-6s %52.2f MB\n", "rgba8", rgba_size / (1024.0 * 1024.0));
+}
+
+// stb_image as it is against the decoder the loaders use, on the same bytes
+// in memory so the disk is out of the picture
+local void
+bench_decode(const char *filename)
+{
+    MappedFile file;
+    if (map_file(&file, filename) != 0)
+    {
+        fprintf(stderr, "cannot open '%s'\n", filename);
+        return;
+    }
+
+    s32 width, height, n_channels;
+    u8 *reference = stbi_load_from_memory(file.data, (int)file.size, &width, &height, &n_channels, 0);
+    if (!reference)
+    {
+        fprintf(stderr, "cannot decode '%s': %s\n", filename, stbi_failure_reason());
+        unmap_file(&file);
+        return;
+    }
+
+    double megapixels = (double)width * height / 1.0e6;
+
+    double stb_ms = measure_ms([&] {
+        s32 w, h, n;
+        stbi_image_free(stbi_load_from_memory(file.data, (int)file.size, &w, &h, &n, 0));
+    });
+
+    Image image = {};
+    double image_ms = measure_ms([&] {
+        destroy(&image);
+        decode_image(&image, file.data, file.size, 0);
+    });
+
+    // the same pixels, only bottom up
+    bool identical = image.pixels && image.width == (u32)width && image.height == (u32)height &&
+                     image.channels == (u32)n_channels;
+    u64 row_size = (u64)width * n_channels;
+    for (s32 y = 0; identical && y < height; ++y)
+    {
+        identical = memcmp(image.pixels + (u64)(height - 1 - y) * row_size, reference + y * row_size, row_size) == 0;
+    }
+
+    char path[32] = "single thread";
+    u32 strip_count = jpeg_strip_count(file.data, file.size);
+    if (strip_count > 1) snprintf(path, sizeof(path), "%u jpeg strips", strip_count);
+
+    printf("  %-28s %5dx%-5d %u  %8.1f MPix/s %8.1f MPix/s %6.2fx  %-16s %s\n", filename, width, height, n_channels,
+           megapixels / (stb_ms / 1000.0), megapixels / (image_ms / 1000.0), stb_ms / image_ms, path,
+           identical ? "identical" : "MISMATCH");
+
+    destroy(&image);
+    stbi_image_free(reference);
+    unmap_file(&file);
+}
+
+// what a camera looking over a plane sees: fine pages at the bottom of the
+// screen, coarser and wider towards the top, centered on (pan_u, pan_v)
+local void
+make_feedback(const VirtualTexture *vt, u32 width, u32 height, float pan_u, float pan_v, std::vector<u32> *pixels)
+{
+    pixels->resize((u64)width * height);
+    u32 max_level = glm::min((u32)vt->levels.size() - 1, 3u);
+
+    for (u32 y = 0; y < height; ++y)
+    {
+        float t = (y + 0.5f) / height;
+        u32 level = glm::min((u32)(t * (max_level + 1)), max_level);
+        float span = 0.1f * (1.0f + 3.0f * t);
+        const VirtualTextureLevel &info = vt->levels[level];
+
+        for (u32 x = 0; x < width; ++x)
+        {
+            float u = pan_u + ((x + 0.5f) / width - 0.5f) * span;
+            float v = pan_v + (t - 0.5f) * 0.3f;
+            u -= floorf(u);
+            v -= floorf(v);
+
+            u32 page_x = glm::min((u32)(u * info.width / VT_PAGE_SIZE), info.pages_x - 1);
+            u32 page_y = glm::min((u32)(v * info.height / VT_PAGE_SIZE), info.pages_y - 1);
+            (*pixels)[(u64)y * width + x] = pack_feedback(level, page_x, page_y);
+        }
+    }
+}
+
+local void
+bench_virtual_texture(const char *filename)
+{
+    const char *test_filename = "bench_test.vt";
+    if (!filename)
+    {
+        std::vector<u8> image;
+        make_test_image(&image, 4096, 4096);
+        if (bake_virtual_texture(image.data(), 4096, 4096, test_filename, default_virtual_texture_bake_options()) != 0) return;
+        filename = test_filename;
+    }
+
+    VirtualTexture vt;
+    if (init(&vt, filename, default_virtual_texture_options()) != 0) return;
+
+    printf("virtual texture: %s %ux%u, %u levels, %u pages\n", filename,
+           vt.header.width, vt.header.height, vt.header.level_count, vt.header.page_count);
+
+    // a 1080p screen with the default feedback divisor of 8
+    const u32 feedback_width = 240;
+    const u32 feedback_height = 135;
+    std::vector<u32> feedback;
+    make_feedback(&vt, feedback_width, feedback_height, 0.5f, 0.5f, &feedback);
+
+    double analysis_ms = measure_ms([&] { process_feedback(&vt, feedback.data(), (u32)feedback.size()); });
+    printf("  %-20s %10.3f ms  %8.2f ns/pixel  %u pages seen\n", "feedback analysis", analysis_ms,
+           analysis_ms * 1.0e6 / feedback.size(), vt.stats.pages_seen);
+
+    // pan over the texture and run frames until every page in view is in
+    // the atlas, checking each upload against the file
+    const float pans[][2] = { {0.5f, 0.5f}, {0.55f, 0.5f}, {0.2f, 0.8f}, {0.9f, 0.1f}, {0.5f, 0.5f} };
+    u32 mismatches = 0;
+    u64 bytes_before = vt.stats.bytes_read;
+    double stream_start = now_seconds();
+
+    printf("  %-14s %8s %10s %8s %10s\n", "view", "frames", "time", "loaded", "evictions");
+    for (const float *pan : pans)
+    {
+        make_feedback(&vt, feedback_width, feedback_height, pan[0], pan[1], &feedback);
+
+        u32 evictions = vt.stats.evictions;
+        u64 bytes = vt.stats.bytes_read;
+        double start = now_seconds();
+        u32 frames = 0;
+
+        for (; frames < 10000; ++frames)
+        {
+            process_feedback(&vt, feedback.data(), (u32)feedback.size());
+            update(&vt);
+
+            for (const VirtualPageUpload &upload : vt.uploads)
+            {
+                u32 page = vt.slot_page[upload.slot];
+                const u8 *expected = vt.file.data + vt.header.page_data_offset + (u64)page * VT_PAGE_BYTES;
+                if (memcmp(upload.pixels, expected, VT_PAGE_BYTES) != 0) ++mismatches;
+            }
+            finish_uploads(&vt);
+
+            if (vt.stats.pages_missing == 0 && vt.stats.pending_loads == 0) break;
+
+            // leave the io thread a frame's worth of time, like a renderer would
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+
+        // every page in view must resolve to itself
+        for (u32 page : vt.seen)
+        {
+            u32 level = 0;
+            while (level + 1 < (u32)vt.levels.size() && page >= vt.levels[level + 1].first_page) ++level;
+            const VirtualTextureLevel &info = vt.levels[level];
+            u32 local_index = page - info.first_page;
+
+            u32 slot_x, slot_y, resident_level;
+            lookup_page(&vt, level, local_index % info.pages_x, local_index / info.pages_x, &slot_x, &slot_y, &resident_level);
+            if (resident_level != level || vt.slot_page[slot_y * vt.options.slots_x + slot_x] != page) ++mismatches;
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "%.2f %.2f", pan[0], pan[1]);
+        printf("  %-14s %8u %7.2f ms %7.2f MB %10u%s\n", name, frames + 1, (now_seconds() - start) * 1000.0,
+               (vt.stats.bytes_read - bytes) / (1024.0 * 1024.0), vt.stats.evictions - evictions,
+               frames == 10000 ? "  did not converge" : "");
+    }
+
+    double stream_seconds = now_seconds() - stream_start;
+    printf("  %-20s %10.1f MB/s  %s\n", "page streaming",
+           (vt.stats.bytes_read - bytes_before) / (1024.0 * 1024.0) / stream_seconds,
+           mismatches == 0 ? "pages and indirection ok" : "MISMATCH");
+
+    destroy(&vt);
+    if (filename == test_filename) remove(test_filename);
+}
+
+local u64 number_seed = 0x853C49E6748FEA9Bull;
+local u64
+random_u64()
+{
+    // xorshift, the bits of doubles need to be random all the way down
+    number_seed ^= number_seed << 13;
+    number_seed ^= number_seed >> 7;
+    number_seed ^= number_seed << 17;
+    return number_seed;
+}
+
+struct NumberCheck
+{
+    u32 checked;
+    u32 mismatches;
+};
+
+// text is copied behind padding, like a file would have it
+local void
+check_number(NumberCheck *check, const char *text)
+{
+    char buffer[512 + FILE_PADDING] = {};
+    memcpy(buffer, text, strnlen(text, 511));
+
+    char *expected_end = nullptr;
+    double expected_double = strtod(buffer, &expected_end);
+    double parsed_double = 0.0;
+    const char *double_end = parse_double(buffer, &parsed_double);
+
+    float expected_float = strtof(buffer, &expected_end);
+    float parsed_float = 0.0f;
+    const char *float_end = parse_float(buffer, &parsed_float);
+
+    bool same_double = memcmp(&expected_double, &parsed_double, sizeof(double)) == 0 ||
+                       (expected_double != expected_double && parsed_double != parsed_double);
+    bool same_float = memcmp(&expected_float, &parsed_float, sizeof(float)) == 0 ||
+                      (expected_float != expected_float && parsed_float != parsed_float);
+
+    ++check->checked;
+    if (!same_double || !same_float || double_end != expected_end || float_end != expected_end)
+    {
+        if (++check->mismatches <= 10)
+        {
+            printf("  MISMATCH '%s': double %.17g (strtod %.17g), float %.9g (strtof %.9g), end %d/%d (strtod %d)\n",
+                   text, parsed_double, expected_double, parsed_float, expected_float,
+                   (int)(double_end - buffer), (int)(float_end - buffer), (int)(expected_end - buffer));
+        }
+    }
+}
+
+local void
+check_index(NumberCheck *check, const char *text)
+{
+    char buffer[64 + FILE_PADDING] = {};
+    memcpy(buffer, text, strnlen(text, 63));
+
+    char *expected_end = nullptr;
+    s64 expected = strtoll(buffer, &expected_end, 10);
+    s64 parsed = 0;
+    const char *end = parse_index(buffer, &parsed);
+
+    ++check->checked;
+    if (parsed != expected || end != expected_end)
+    {
+        if (++check->mismatches <= 10)
+        {
+            printf("  MISMATCH index '%s': %lld (strtoll %lld)\n", text, (long long)parsed, (long long)expected);
+        }
+    }
+}
+
+// parse_* against the C library on awkward and random input, strtod is
+// the reference for rounding
+local u32
+check_number_parsing(u32 count)
+{
+    NumberCheck check = {};
+    char text[512];
+
+    const char *special[] = {
+        "0", "-0", "+0", "0.0", ".5", "5.", "-.5e1", ".", "-", "+.", "e5", "1e", "1e+", "1e-x", "1.5e+3x",
+        "00000000000000000000000001", "0.00000000000000000000000000000000000001",
+        "1e-400", "1e400", "-1e400", "1e-45", "1e-46", "7e-46", "1.4e-45", "3.4028235e38", "3.4028236e38",
+        "4.9406564584124654e-324", "2.4703282292062327e-324", "2.4703282292062328e-324",
+        "2.2250738585072011e-308", "2.2250738585072014e-308", "1.7976931348623157e308", "1.7976931348623158e308",
+        "1.7976931348623159e308", "9007199254740993", "9007199254740992.5", "9007199254740993.0000000000000001",
+        "123456789012345678901234567890", "0.1234567890123456789012345678901234567890",
+        "1.00000000000000011102230246251565404236316680908203125",
+        "1.00000000000000011102230246251565404236316680908203124",
+        "1.00000000000000011102230246251565404236316680908203126",
+        "16777217", "16777217.000000000000000000001", "33554435", "0.1", "0.2", "0.3", "1e22", "1e23", "1e-22", "1e-23",
+        "inf", "-Infinity", "nan", "0x1p-2", "0X1.8p3", "1e99999999999999999", "1e-99999999999999999",
+        "3.14159265358979323846264338327950288419716939937510", "  42", "\t-7.25",
+    };
+    for (const char *s : special) check_number(&check, s);
+
+    for (u32 i = 0; i < count; ++i)
+    {
+        // any finite double, at different precisions
+        u64 bits = random_u64();
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        if (d != d || d - d != 0.0) continue;
+
+        const char *formats[] = { "%.17g", "%.15g", "%.9g", "%.6e", "%.3f" };
+        snprintf(text, sizeof(text), formats[i % 5], d);
+        check_number(&check, text);
+
+        // floats of every magnitude
+        u32 float_bits = (u32)random_u64();
+        float f;
+        memcpy(&f, &float_bits, sizeof(f));
+        if (f == f && f - f == 0.0f)
+        {
+            snprintf(text, sizeof(text), (i & 1) ? "%.9g" : "%.8g", f);
+            check_number(&check, text);
+        }
+
+        // exact ties between two doubles, and between two floats
+        u32 shift = 1 + (u32)(random_u64() % 11);
+        u64 tie = ((random_u64() | (1ull << 63)) >> shift << shift) | (1ull << (shift - 1));
+        snprintf(text, sizeof(text), "%llu", (unsigned long long)(tie >> (11 - shift)));
+        check_number(&check, text);
+
+        u32 float_tie = (u32)(((random_u64() | (1ull << 63)) >> 39) << 1 | 1);
+        snprintf(text, sizeof(text), "%u", float_tie);
+        check_number(&check, text);
+
+        // the midpoint of two floats is a double, printed exactly
+        float below = ldexpf(1.0f + (float)(random_u64() % (1 << 23)) / (1 << 23), (int)(random_u64() % 60) - 30);
+        double midpoint = ((double)below + (double)nextafterf(below, 1e30f)) * 0.5;
+        snprintf(text, sizeof(text), "%.60g", midpoint);
+        check_number(&check, text);
+
+        // random digit strings, too many digits included
+        u32 digits = 1 + (u32)(random_u64() % 25);
+        u32 dot = (u32)(random_u64() % (digits + 1));
+        char *p = text;
+        if (random_u64() & 1) *p++ = '-';
+        for (u32 k = 0; k < digits; ++k)
+        {
+            if (k == dot) *p++ = '.';
+            *p++ = (char)('0' + random_u64() % 10);
+        }
+        snprintf(p, 32, "e%d", (int)(random_u64() % 700) - 350);
+        check_number(&check, text);
+
+        snprintf(text, sizeof(text), "%lld", (long long)(random_u64() >> (random_u64() % 64)) * ((i & 1) ? -1 : 1));
+        check_index(&check, text);
+    }
+
+    printf("  %u numbers checked against strtod, strtof and strtoll: %u mismatches\n", check.checked, check.mismatches);
+    return check.mismatches;
+}
+
+local void
+bench_numbers(u32 count)
+{
+    printf("numbers: %u lines\n", count);
+
+    if (check_number_parsing(count) != 0) return;
+
+    // what exporters write: six decimals, a few hundred units around 0
+    std::string vertices;
+    std::string faces;
+    char line[128];
+    for (u32 i = 0; i < count; ++i)
+    {
+        snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", random_float(-500.0f, 500.0f),
+                 random_float(-500.0f, 500.0f), random_float(-500.0f, 500.0f));
+        vertices += line;
+
+        u32 a = (u32)random_u64() % count + 1;
+        snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, a + 1, a + 1, a + 1, a + 2, a + 2, a + 2);
+        faces += line;
+    }
+    vertices.append(FILE_PADDING, '\0');
+    faces.append(FILE_PADDING, '\0');
+
+    double sum = 0.0;
+    auto parse_vertices = [&](bool library) {
+        const char *at = vertices.c_str();
+        while (*at)
+        {
+            double x, y, z;
+            if (library)
+            {
+                char *end;
+                x = strtod(at + 1, &end);
+                y = strtod(end, &end);
+                z = strtod(end, &end);
+                at = end;
+            }
+            else
+            {
+                at = parse_double(at + 1, &x);
+                at = parse_double(at, &y);
+                at = parse_double(at, &z);
+            }
+            sum += x + y + z;
+            at = find_line_end(at) + 1;
+        }
+    };
+
+    s64 index_sum = 0;
+    auto parse_faces = [&](bool library) {
+        const char *at = faces.c_str();
+        while (*at)
+        {
+            at = skip_spaces(at + 1);
+            while (*at != '\n')
+            {
+                s64 v, vt, vn;
+                if (library)
+                {
+                    char *end;
+                    v = strtoll(at, &end, 10);
+                    vt = strtoll(end + 1, &end, 10);
+                    vn = strtoll(end + 1, &end, 10);
+                    at = end;
+                }
+                else
+                {
+                    at = parse_face_corner(at, &v, &vt, &vn);
+                }
+                index_sum += v + vt + vn;
+                at = skip_spaces(at);
+            }
+            ++at;
+        }
+    };
+
+    double vertex_mb = (vertices.size() - FILE_PADDING) / (1024.0 * 1024.0);
+    double face_mb = (faces.size() - FILE_PADDING) / (1024.0 * 1024.0);
+
+    double strtod_ms = measure_ms([&] { parse_vertices(true); });
+    double parse_ms = measure_ms([&] { parse_vertices(false); });
+    double strtoll_ms = measure_ms([&] { parse_faces(true); });
+    double corner_ms = measure_ms([&] { parse_faces(false); });
+
+    printf("  %-20s %10.3f ms  %8.1f MB/s\n", "v lines, strtod", strtod_ms, vertex_mb * 1000.0 / strtod_ms);
+    printf("  %-20s %10.3f ms  %8.1f MB/s  %.2fx\n", "v lines, parse", parse_ms, vertex_mb * 1000.0 / parse_ms, strtod_ms / parse_ms);
+    printf("  %-20s %10.3f ms  %8.1f MB/s\n", "f lines, strtoll", strtoll_ms, face_mb * 1000.0 / strtoll_ms);
+    printf("  %-20s %10.3f ms  %8.1f MB/s  %.2fx\n", "f lines, parse", corner_ms, face_mb * 1000.0 / corner_ms, strtoll_ms / corner_ms);
+
+    // keeps the loops from being thrown away
+    if (sum == 1.0 && index_sum == 1) printf(" ");
+}
+
+// the regression suite: each step of getting a generated scene from disk to
+// the screen, timed and compared against a baseline saved on the same machine
+#define SUITE_MAX_RESULTS 16
+
+struct SuiteResult
+{
+    const char *name;
+    double ms;
+};
+
+struct SuiteBaseline
+{
+    SceneGeneratorOptions options;
+    u32 count;
+    SuiteResult results[SUITE_MAX_RESULTS];
+};
+
+// like measure_ms but with untimed setup before every run
+template <typename S, typename F>
+local double
+measure_with_setup_ms(S setup, F fn, double min_seconds = 0.25)
+{
+    double best = 1e30;
+    double start = now_seconds();
+    u32 runs = 0;
+
+    do
+    {
+        setup();
+        double t0 = now_seconds();
+        fn();
+        double t1 = now_seconds();
+
+        best = glm::min(best, (t1 - t0) * 1000.0);
+        ++runs;
+    }
+    while (now_seconds() - start < min_seconds || runs < 3);
+
+    return best;
+}
+
+// everything the chunk streamer would read for the whole model: header,
+// node table and the data of every node, returns the bytes read
+local u64
+read_chunk_file(const char *filename, std::vector<u8> *data)
+{
+    FILE *file = fopen(filename, "rb");
+    if (!file) return 0;
+
+    ChunkFileHeader header;
+    std::vector<ChunkNode> nodes;
+    u64 bytes = 0;
+
+    if (fread(&header, sizeof(header), 1, file) == 1 && header.magic == CHUNK_FILE_MAGIC &&
+        seek_file(file, header.node_table_offset) == 0)
+    {
+        nodes.resize(header.node_count);
+        if (fread(nodes.data(), sizeof(ChunkNode), nodes.size(), file) == nodes.size())
+        {
+            bytes = sizeof(header) + nodes.size() * sizeof(ChunkNode);
+            for (const ChunkNode &node : nodes)
+            {
+                data->resize(node.data_size);
+                if (seek_file(file, node.data_offset) != 0 ||
+                    fread(data->data(), 1, node.data_size, file) != node.data_size)
+                {
+                    bytes = 0;
+                    break;
+                }
+                bytes += node.data_size;
+            }
+        }
+    }
+
+    fclose(file);
+    return bytes;
+}
+
+local bool
+json_number(const char *text, const char *key, double *value)
+{
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+
+    const char *found = strstr(text, pattern);
+    if (!found) return false;
+
+    *value = strtod(found + strlen(pattern), nullptr);
+    return true;
+}
+
+// only reads what save_suite_baseline writes
+local s32
+load_suite_baseline(SuiteBaseline *baseline, const char *filename, const SuiteResult *results, u32 count)
+{
+    FileContent fc = read_entire_file_in_memory_and_zero_terminate(filename, true);
+    if (!fc.data) return -1;
+
+    const char *text = (const char *)fc.data;
+    double value = 0.0;
+
+    *baseline = {};
+    if (json_number(text, "seed", &value)) baseline->options.seed = (u32)value;
+    if (json_number(text, "terrain_triangles", &value)) baseline->options.terrain_triangles = (u32)value;
+    if (json_number(text, "instances", &value)) baseline->options.instances = (u32)value;
+    if (json_number(text, "hierarchy_depth", &value)) baseline->options.hierarchy_depth = (u32)value;
+
+    const char *section = strstr(text, "\"results\"");
+    for (u32 i = 0; section && i < count; ++i)
+    {
+        baseline->results[i].name = results[i].name;
+        baseline->results[i].ms = json_number(section, results[i].name, &value) ? value : 0.0;
+    }
+    baseline->count = section ? count : 0;
+
+    delete_file_content(&fc);
+    return 0;
+}
+
+local s32
+save_suite_baseline(const char *filename, const SceneGeneratorOptions &options, const SuiteResult *results, u32 count)
+{
+    FILE *file = fopen(filename, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "cannot write '%s'\n", filename);
+        return -1;
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"seed\": %u,\n", options.seed);
+    fprintf(file, "  \"terrain_triangles\": %u,\n", options.terrain_triangles);
+    fprintf(file, "  \"instances\": %u,\n", options.instances);
+    fprintf(file, "  \"hierarchy_depth\": %u,\n", options.hierarchy_depth);
+    fprintf(file, "  \"results\": {\n");
+    for (u32 i = 0; i < count; ++i)
+    {
+        fprintf(file, "    \"%s\": %.4f%s\n", results[i].name, results[i].ms, i + 1 < count ? "," : "");
+    }
+    fprintf(file, "  }\n");
+    fprintf(file, "}\n");
+
+    fclose(file);
+    return 0;
+}
+
+local s32
+bench_suite(int argc, char **argv)
+{
+    SceneGeneratorOptions options = default_scene_generator_options();
+    const char *baseline_filename = nullptr;
+    const char *save_filename = nullptr;
+    double threshold = 0.10;
+
+    for (int arg = 0; arg + 1 < argc; arg += 2)
+    {
+        const char *name = argv[arg];
+        const char *value = argv[arg + 1];
+
+        if (strcmp(name, "--seed") == 0) options.seed = (u32)strtoul(value, nullptr, 10);
+        else if (strcmp(name, "--triangles") == 0) options.terrain_triangles = (u32)strtoul(value, nullptr, 10);
+        else if (strcmp(name, "--instances") == 0) options.instances = (u32)strtoul(value, nullptr, 10);
+        else if (strcmp(name, "--depth") == 0) options.hierarchy_depth = (u32)strtoul(value, nullptr, 10);
+        else if (strcmp(name, "--baseline") == 0) baseline_filename = value;
+        else if (strcmp(name, "--save-baseline") == 0) save_filename = value;
+        else if (strcmp(name, "--threshold") == 0) threshold = strtod(value, nullptr);
+        else
+        {
+            fprintf(stderr, "unknown suite option '%s'\n", name);
+            return -1;
+        }
+    }
+
+    char obj_filename[64];
+    char chunk_filename[64];
+    snprintf(obj_filename, sizeof(obj_filename), "bench_scene_%u.obj", options.seed);
+    snprintf(chunk_filename, sizeof(chunk_filename), "bench_scene_%u.chunks", options.seed);
+
+    printf("suite: seed %u, %u terrain triangles, %u instances %u levels deep, %u workers\n",
+           options.seed, options.terrain_triangles, options.instances, options.hierarchy_depth, worker_count());
+
+    Mesh generated;
+    generate_mesh(&generated, options);
+    if (save_generated_textures(&generated, options) != 0 || save_obj(&generated, obj_filename) != 0)
+    {
+        return -1;
+    }
+
+    SuiteResult results[SUITE_MAX_RESULTS];
+    u32 result_count = 0;
+
+    // parse
+    Mesh mesh = {};
+    results[result_count++] = SuiteResult{"parse", measure_ms([&] { load_obj(&mesh, obj_filename); })};
+    if (mesh.indices.size() != generated.indices.size())
+    {
+        fprintf(stderr, "'%s' did not load back\n", obj_filename);
+        return -1;
+    }
+
+    // the same file in bounded memory, as the converter reads it
+    u64 streamed_faces = 0;
+    results[result_count++] = SuiteResult{"stream_parse", measure_ms([&] {
+        ObjStream stream;
+        if (init(&stream, obj_filename, default_obj_stream_options()) != 0) return;
+        for (streamed_faces = 0; read_block(&stream);) streamed_faces += stream.block.faces.size();
+        destroy(&stream);
+    })};
+    if (streamed_faces * 3 != generated.indices.size())
+    {
+        fprintf(stderr, "'%s' did not stream back\n", obj_filename);
+        return -1;
+    }
+
+    Mesh with_normals;
+    results[result_count++] = SuiteResult{"normals", measure_with_setup_ms([&] { with_normals = mesh; },
+                                                                           [&] { generate_normals(&with_normals, default_normal_options()); })};
+
+    // simplification, baking builds the lod of every inner node; the old
+    // file goes first, truncating it can cost more than the bake
+    results[result_count++] = SuiteResult{"bake", measure_with_setup_ms([&] { remove(chunk_filename); },
+                                                                        [&] { bake_chunks(&mesh, chunk_filename, default_bake_options()); })};
+
+    // the same bake straight from the obj, out of core through temp files
+    char streamed_chunk_filename[64];
+    snprintf(streamed_chunk_filename, sizeof(streamed_chunk_filename), "bench_scene_%u_obj.chunks", options.seed);
+    s32 streamed_bake = 0;
+    results[result_count++] = SuiteResult{"bake_obj", measure_with_setup_ms([&] { remove(streamed_chunk_filename); }, [&] {
+        streamed_bake = bake_chunks(obj_filename, streamed_chunk_filename, default_bake_options());
+    })};
+    if (streamed_bake != 0)
+    {
+        fprintf(stderr, "cannot bake '%s' from '%s'\n", streamed_chunk_filename, obj_filename);
+        return -1;
+    }
+
+    std::vector<u8> chunk_data;
+    u64 chunk_bytes = 0;
+    results[result_count++] = SuiteResult{"cache_load", measure_ms([&] { chunk_bytes = read_chunk_file(chunk_filename, &chunk_data); })};
+    if (chunk_bytes == 0)
+    {
+        fprintf(stderr, "cannot read back '%s'\n", chunk_filename);
+        return -1;
+    }
+
+    results[result_count++] = SuiteResult{"textures", measure_ms([&] {
+        for (const Material &material : mesh.materials)
+        {
+            Image image;
+            if (load_image(&image, material.diffuse_texture.c_str(), 4) == 0) destroy(&image);
+        }
+    })};
+
+    SceneGraph scene;
+    init(&scene);
+    u32 instances = generate_scene(&scene, &mesh, options);
+    update_scene(&scene);
+
+    std::vector<u32> roots;
+    for (u32 node = 0; node < scene.count; ++node)
+    {
+        if (scene.parent[node] == SCENE_NO_PARENT) roots.push_back(node);
+    }
+
+    results[result_count++] = SuiteResult{"scene_update", measure_ms([&] {
+        for (u32 root : roots) set_local(&scene, root, scene.local_transform[root]);
+        update_scene(&scene);
+    })};
+
+    // a few moving nodes per frame, the common case
+    u32 random = options.seed;
+    results[result_count++] = SuiteResult{"scene_update_1%", measure_ms([&] {
+        for (u32 i = 0; i < scene.count / 100; ++i)
+        {
+            random = random * 1664525u + 1013904223u;
+            u32 node = random % scene.count;
+            set_local(&scene, node, scene.local_transform[node]);
+        }
+        update_scene(&scene);
+    })};
+
+    // over the terrain towards the middle, the instances in front
+    const u32 width = 1280;
+    const u32 height = 720;
+    Camera camera = init(glm::vec3(0.0f, 120.0f, -600.0f), glm::vec3(0.0f, 1.0f, 0.0f), 90.0f, -12.0f);
+    update_matrices(&camera, (float)width / (float)height, 0.1f, 5000.0f, false);
+
+    std::vector<u32> visible;
+    results[result_count++] = SuiteResult{"frustum_cull", measure_ms([&] {
+        visible.clear();
+        cull_scene(&scene, &camera.frustum, &visible);
+    })};
+    u32 frustum_visible = (u32)visible.size();
+
+    OcclusionCuller occlusion;
+    init(&occlusion, default_occlusion_options());
+    std::vector<u32> occluder_nodes;
+    std::vector<u32> occlusion_visible;
+
+    results[result_count++] = SuiteResult{"occlusion_cull", measure_ms([&] {
+        occlusion_visible = visible;
+        begin_frame(&occlusion, camera.view_projection);
+        select_occluders(&occlusion, &scene, occlusion_visible, &occluder_nodes);
+        for (u32 node : occluder_nodes)
+        {
+            const MeshGroup &group = mesh.groups[scene.mesh[node]];
+            add_occluder(&occlusion, mesh.vertices.data(), mesh.indices.data() + group.first_index,
+                         group.index_count, scene.world[node]);
+        }
+        end_occluders(&occlusion);
+        cull_occluded(&occlusion, &scene, &occlusion_visible);
+    })};
+
+    // headless, so the frame goes through the software rasterizer
+    RasterTexture texture_a, texture_b;
+    init(&texture_a, mesh.materials.front().diffuse_texture.c_str());
+    init(&texture_b, mesh.materials.back().diffuse_texture.c_str());
+
+    RasterTarget target;
+    init(&target, width, height);
+    set_textures(&target, &texture_a, &texture_b);
+
+    results[result_count++] = SuiteResult{"render", measure_ms([&] {
+        clear(&target, glm::vec4(0.2f, 0.3f, 0.3f, 1.0f));
+        for (u32 node : occlusion_visible)
+        {
+            const MeshGroup &group = mesh.groups[scene.mesh[node]];
+            draw(&target, mesh.vertices.data(), mesh.indices.data() + group.first_index, group.index_count,
+                 camera.view_projection * scene.world[node]);
+        }
+        resolve(&target);
+    })};
+
+    printf("  %u nodes, %u instances, %u frustum visible, %u after occlusion, %u triangles drawn, %.1f MB of chunks\n",
+           scene.count, instances, frustum_visible, (u32)occlusion_visible.size(),
+           target.stats.triangles_binned, chunk_bytes / (1024.0 * 1024.0));
+
+    destroy(&target);
+    destroy(&texture_a);
+    destroy(&texture_b);
+    destroy(&occlusion);
+
+    SuiteBaseline baseline = {};
+    bool compare = false;
+    if (baseline_filename)
+    {
+        if (load_suite_baseline(&baseline, baseline_filename, results, result_count) != 0)
+        {
+            fprintf(stderr, "cannot read baseline '%s'\n", baseline_filename);
+            return -1;
+        }
+
+        compare = baseline.options.seed == options.seed &&
+                  baseline.options.terrain_triangles == options.terrain_triangles &&
+                  baseline.options.instances == options.instances &&
+                  baseline.options.hierarchy_depth == options.hierarchy_depth;
+        if (!compare)
+        {
+            printf("  baseline '%s' is of a different scene, not comparing\n", baseline_filename);
+        }
+    }
+
+    u32 regressions = 0;
+    printf("  %-20s %12s %12s %9s\n", "step", "time", "baseline", "change");
+    for (u32 i = 0; i < result_count; ++i)
+    {
+        const SuiteResult &result = results[i];
+        double base = compare ? baseline.results[i].ms : 0.0;
+
+        if (base > 0.0)
+        {
+            double change = result.ms / base - 1.0;
+            bool regressed = change > threshold;
+            regressions += regressed;
+            printf("  %-20s %9.3f ms %9.3f ms %+8.1f%%%s\n", result.name, result.ms, base, change * 100.0,
+                   regressed ? "  REGRESSION" : "");
+        }
+        else
+        {
+            printf("  %-20s %9.3f ms %12s %9s\n", result.name, result.ms, "-", "-");
+        }
+    }
+
+    if (save_filename && save_suite_baseline(save_filename, options, results, result_count) == 0)
+    {
+        printf("  baseline saved to '%s'\n", save_filename);
+    }
+
+    if (regressions)
+    {
+        printf("  %u steps slower than the baseline by more than %.0f%%\n", regressions, threshold * 100.0);
+        return 1;
+    }
+
+    return 0;
+}
+
+s32 run_benchmark(int argc, char **argv)
+{
+    if (argc < 1)
+    {
+        fprintf(stderr, "usage: ObjViewer --bench transforms [count...]\n"
+                        "       ObjViewer --bench textures [image...]\n"
+                        "       ObjViewer --bench vt [file.vt...]\n"
+                        "       ObjViewer --bench decode [image...]\n"
+                        "       ObjViewer --bench numbers [count...]\n"
+                        "       ObjViewer --bench suite [--seed n] [--triangles n] [--instances n] [--depth n]\n"
+                        "                               [--baseline file] [--save-baseline file] [--threshold 0.1]\n");
+        return -1;
+    }
+
+    if (strcmp(argv[0], "transforms") == 0)
+    {
+        if (argc > 1)
+        {
+            for (int arg = 1; arg < argc; ++arg) bench_transforms((u32)strtoul(argv[arg], nullptr, 10));
+        }
+        else
+        {
+            bench_transforms(10000);
+            bench_transforms(100000);
+            bench_transforms(1000000);
+        }
+        return 0;
+    }
+
+    if (strcmp(argv[0], "textures") == 0)
+    {
+        if (argc > 1)
+        {
+            for (int arg = 1; arg < argc; ++arg) bench_textures(argv[arg]);
+        }
+        else
+        {
+            bench_textures(nullptr);
+        }
+        return 0;
+    }
+
+    if (strcmp(argv[0], "vt") == 0)
+    {
+        if (argc > 1)
+        {
+            for (int arg = 1; arg < argc; ++arg) bench_virtual_texture(argv[arg]);
+        }
+        else
+        {
+            bench_virtual_texture(nullptr);
+        }
+        return 0;
+    }
+
+    if (strcmp(argv[0], "decode") == 0)
+    {
+        const char *corpus[] = { "texture\\container.jpg", "texture\\wall.jpg", "texture\\awesomeface_alpha.png" };
+
+        printf("decode: %u workers\n", worker_count());
+        printf("  %-28s %11s %s  %15s %15s %7s  %-16s\n", "file", "size", "n", "stb_image", "image", "speedup", "path");
+
+        if (argc > 1)
+        {
+            for (int arg = 1; arg < argc; ++arg) bench_decode(argv[arg]);
+        }
+        else
+        {
+            for (const char *filename : corpus) bench_decode(filename);
+        }
+        return 0;
+    }
+
+    if (strcmp(argv[0], "numbers") == 0)
+    {
+        if (argc > 1)
+        {
+            for (int arg = 1; arg < argc; ++arg) bench_numbers((u32)strtoul(argv[arg], nullptr, 10));
+        }
+        else
+        {
+            bench_numbers(1000000);
+        }
+        return 0;
+    }
+
+    if (strcmp(argv[0], "suite") == 0)
+    {
+        return bench_suite(argc - 1, argv + 1);
+    }
+
+    fprintf(stderr, "unknown benchmark '%s'\n", argv[0]);
+    return -1;
+}
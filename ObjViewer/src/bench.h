@@ -0,0 +1,27 @@
+#pragma once
+
+#include "types.h"
+
+// Headless benchmarks, no window or GL context involved:
+//
+//   ObjViewer --bench transforms [count...]
+//   ObjViewer --bench textures [image...]
+//   ObjViewer --bench vt [file.vt...]
+//   ObjViewer --bench decode [image...]
+//   ObjViewer --bench numbers [count...]
+//   ObjViewer --bench suite [--seed n] [--triangles n] [--instances n] [--depth n]
+//                           [--baseline file] [--save-baseline file] [--threshold 0.1]
+//
+// numbers checks parse_double/parse_float/parse_index (number.h) against
+// strtod, strtof and strtoll on edge cases and random input, then times
+// them on v and f lines.
+//
+// suite generates a scene from the seed (scenegen.h), times parse, streamed
+// parse, normals, chunk baking from the mesh and from the obj, chunk read
+// back, texture loads, scene update, culling and a software rendered frame,
+// and compares them against a baseline saved with --save-baseline on the
+// same machine; it returns 1 when a step got slower than the baseline by
+// more than the threshold.
+//
+// argv starts after --bench.
+s32 run_benchmark(int argc, char **argv);
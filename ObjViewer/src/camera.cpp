@@ -1,11 +1,22 @@
+#include <math.h>
+#include <float.h>
+
 #include "camera.h"
 
+// orbit distance can not shrink below this, the camera would pass the target
+#define CAMERA_MIN_ORBIT_DISTANCE 0.01f
+// smoothed values closer than this to their goal snap to it
+#define CAMERA_SMOOTHING_EPSILON 1e-3f
+// far plane when the bounds are behind the camera or a point
+#define CAMERA_MIN_DEPTH_RANGE 1.0f
+
 void update(Camera *cam);
 
 Camera init(const glm::vec3 &position, const glm::vec3 &up, float yaw, float pitch)
 {
     Camera cam;
 
+    cam.origin = glm::dvec3(0.0);
     cam.position = position;
 
     cam.front = glm::vec3(0.0f, 0.0f, -1.0f);
@@ -20,6 +31,23 @@ Camera init(const glm::vec3 &position, const glm::vec3 &up, float yaw, float pit
 
     cam.flying = true;
 
+    cam.orbiting = false;
+    cam.orbit_target = glm::vec3(0.0f);
+    cam.orbit_distance = glm::length(position);
+
+    cam.smoothing = 0.05f;
+    cam.goal_yaw = yaw;
+    cam.goal_pitch = pitch;
+    cam.goal_fov = cam.fov;
+    cam.goal_distance = cam.orbit_distance;
+
+    cam.version = 1;
+    cam.cached_version = 0;
+    cam.aspect = 0.0f;
+    cam.near_plane = 0.0f;
+    cam.far_plane = 0.0f;
+    cam.reverse_z = false;
+
     update(&cam);
 
     return cam;
@@ -27,6 +55,8 @@ Camera init(const glm::vec3 &position, const glm::vec3 &up, float yaw, float pit
 
 glm::mat4 get_view_matrix(Camera *cam)
 {
+    if (cam->cached_version == cam->version) return cam->view;
+
     glm::vec3 center = cam->position + cam->front; // target ?
 
     glm::mat4 view_matrix = glm::lookAt(cam->position, // eye
@@ -38,10 +68,24 @@ glm::mat4 get_view_matrix(Camera *cam)
 
 void move(Camera *cam, const glm::vec3 &new_pos, float dt)
 {
-    cam->prev_y_pos = cam->position.y;
-
     float velocity = cam->speed * dt;
 
+    // forward and back dolly towards the target, sideways circles it
+    if (cam->orbiting)
+    {
+        cam->goal_distance = glm::max(cam->goal_distance - velocity * new_pos.z, CAMERA_MIN_ORBIT_DISTANCE);
+        cam->goal_yaw += glm::degrees(velocity * new_pos.x / glm::max(cam->orbit_distance, CAMERA_MIN_ORBIT_DISTANCE));
+        if (cam->smoothing <= 0.0f)
+        {
+            cam->orbit_distance = cam->goal_distance;
+            cam->yaw = cam->goal_yaw;
+        }
+        update(cam);
+        return;
+    }
+
+    cam->prev_y_pos = cam->position.y;
+
 #if 1
     cam->position += cam->right * velocity * new_pos.x;
     cam->position += cam->front * velocity * new_pos.z;
@@ -71,25 +115,208 @@ void move(Camera *cam, const glm::vec3 &new_pos, float dt)
 #endif
 
     if (!cam->flying) cam->position.y = cam->prev_y_pos;
+
+    ++cam->version;
 }
 
 void rotate(Camera *cam, float yaw, float pitch)
 {
-    cam->yaw   += yaw;
-    cam->pitch += pitch;
+    cam->goal_yaw   += yaw;
+    cam->goal_pitch += pitch;
 
-    if (cam->pitch > 89.0f) cam->pitch = 89.0f;
-    else if (cam->pitch < -89.0f) cam->pitch = -89.0f;
+    if (cam->goal_pitch > 89.0f) cam->goal_pitch = 89.0f;
+    else if (cam->goal_pitch < -89.0f) cam->goal_pitch = -89.0f;
+
+    if (cam->smoothing <= 0.0f)
+    {
+        cam->yaw = cam->goal_yaw;
+        cam->pitch = cam->goal_pitch;
+    }
 
     update(cam);
 }
 
+// orbiting moves closer instead of narrowing the view
 void zoom(Camera *cam, float zoom)
 {
-    cam->fov -= zoom;
+    if (cam->orbiting)
+    {
+        cam->goal_distance = glm::max(cam->goal_distance * (1.0f - zoom * 0.1f), CAMERA_MIN_ORBIT_DISTANCE);
+    }
+    else
+    {
+        cam->goal_fov -= zoom;
+
+        if (cam->goal_fov > 45.0f) cam->goal_fov = 45.0f;
+        else if (cam->goal_fov < 1.0f) cam->goal_fov = 1.0f;
+    }
+
+    if (cam->smoothing <= 0.0f)
+    {
+        cam->fov = cam->goal_fov;
+        cam->orbit_distance = cam->goal_distance;
+    }
+
+    update(cam);
+}
+
+local bool
+ease(float *value, float goal, float k)
+{
+    if (*value == goal) return false;
 
-    if (cam->fov > 45.0f) cam->fov = 45.0f;
-    else if (cam->fov < 1.0f) cam->fov = 1.0f;
+    if (fabsf(goal - *value) < CAMERA_SMOOTHING_EPSILON) *value = goal;
+    else *value += (goal - *value) * k;
+    return true;
+}
+
+bool step(Camera *cam, float dt)
+{
+    if (cam->smoothing <= 0.0f) return false;
+
+    float k = 1.0f - expf(-dt / cam->smoothing);
+
+    bool moving = false;
+    moving |= ease(&cam->yaw, cam->goal_yaw, k);
+    moving |= ease(&cam->pitch, cam->goal_pitch, k);
+    moving |= ease(&cam->fov, cam->goal_fov, k);
+    moving |= ease(&cam->orbit_distance, cam->goal_distance, k);
+
+    if (moving) update(cam);
+    return moving;
+}
+
+void set_orbit(Camera *cam, bool orbiting, const glm::vec3 &target)
+{
+    if (orbiting)
+    {
+        glm::vec3 offset = target - cam->position;
+        float distance = glm::max(glm::length(offset), CAMERA_MIN_ORBIT_DISTANCE);
+        glm::vec3 direction = offset / distance;
+
+        cam->yaw = glm::degrees(atan2f(direction.z, direction.x));
+        cam->pitch = glm::clamp(glm::degrees(asinf(glm::clamp(direction.y, -1.0f, 1.0f))), -89.0f, 89.0f);
+        cam->goal_yaw = cam->yaw;
+        cam->goal_pitch = cam->pitch;
+
+        cam->orbit_target = target;
+        cam->orbit_distance = distance;
+        cam->goal_distance = distance;
+    }
+
+    cam->orbiting = orbiting;
+    update(cam);
+}
+
+void touch(Camera *cam)
+{
+    ++cam->version;
+}
+
+void rebase(Camera *cam, const glm::dvec3 &origin)
+{
+    glm::vec3 shift = glm::vec3(cam->origin - origin);
+
+    cam->origin = origin;
+    cam->position += shift;
+    cam->orbit_target += shift;
+    ++cam->version;
+}
+
+glm::dvec3 world_position(const Camera *cam)
+{
+    return cam->origin + glm::dvec3(cam->position);
+}
+
+glm::mat4 camera_relative_model(const glm::mat4 &model, const glm::dvec3 &model_origin,
+                                const glm::dvec3 &camera_world_position)
+{
+    // the rotation and scale part is small already, only the translation
+    // carries the large numbers
+    glm::dvec3 translation = model_origin + glm::dvec3(glm::vec3(model[3])) - camera_world_position;
+
+    glm::mat4 result = model;
+    result[3] = glm::vec4(glm::vec3(translation), model[3].w);
+    return result;
+}
+
+void update_matrices(Camera *cam, float aspect, float near_plane, float far_plane, bool reverse_z)
+{
+    if (aspect != cam->aspect || near_plane != cam->near_plane || far_plane != cam->far_plane ||
+        reverse_z != cam->reverse_z)
+    {
+        cam->aspect = aspect;
+        cam->near_plane = near_plane;
+        cam->far_plane = far_plane;
+        cam->reverse_z = reverse_z;
+        ++cam->version;
+    }
+
+    if (cam->cached_version == cam->version) return;
+
+    cam->view = glm::lookAt(cam->position, cam->position + cam->front, cam->up);
+    cam->projection = glm::perspective(glm::radians(cam->fov), aspect, near_plane, far_plane);
+    cam->view_projection = cam->projection * cam->view;
+    cam->inverse_view_projection = glm::inverse(cam->view_projection);
+    cam->frustum = make_frustum(cam->view_projection);
+
+    cam->relative_view = glm::lookAt(glm::vec3(0.0f), cam->front, cam->up);
+    cam->gpu_projection = reverse_z ? infinite_reverse_z_perspective(glm::radians(cam->fov), aspect, near_plane) :
+                                      cam->projection;
+
+    cam->cached_version = cam->version;
+}
+
+void fit_depth_range(const Camera *cam, const glm::vec3 &bounds_min, const glm::vec3 &bounds_max,
+                     float max_depth_ratio, float *near_plane, float *far_plane)
+{
+    float nearest = FLT_MAX;
+    float farthest = -FLT_MAX;
+    for (u32 corner = 0; corner < 8; ++corner)
+    {
+        glm::vec3 p((corner & 1) ? bounds_max.x : bounds_min.x,
+                    (corner & 2) ? bounds_max.y : bounds_min.y,
+                    (corner & 4) ? bounds_max.z : bounds_min.z);
+        float depth = glm::dot(p - cam->position, cam->front);
+        nearest = glm::min(nearest, depth);
+        farthest = glm::max(farthest, depth);
+    }
+
+    // a little slack so the bounds never touch either plane
+    float far_depth = glm::max(farthest * 1.01f, CAMERA_MIN_DEPTH_RANGE);
+    float near_depth = glm::max(nearest * 0.99f, far_depth * max_depth_ratio);
+
+    *near_plane = glm::min(near_depth, far_depth * 0.5f);
+    *far_plane = far_depth;
+}
+
+glm::mat4 infinite_reverse_z_perspective(float fovy, float aspect, float near_plane)
+{
+    // clip z is near for every point and w is the distance, so depth falls
+    // from 1 at the near plane towards 0 far away
+    float f = 1.0f / tanf(fovy * 0.5f);
+
+    glm::mat4 projection(0.0f);
+    projection[0][0] = f / aspect;
+    projection[1][1] = f;
+    projection[2][3] = -1.0f;
+    projection[3][2] = near_plane;
+    return projection;
+}
+
+Camera interpolate(const Camera &from, const Camera &to, float t)
+{
+    Camera cam = to;
+
+    cam.position = glm::mix(from.position, to.position, t);
+    cam.yaw = glm::mix(from.yaw, to.yaw, t);
+    cam.pitch = glm::mix(from.pitch, to.pitch, t);
+    cam.fov = glm::mix(from.fov, to.fov, t);
+    cam.orbit_distance = glm::mix(from.orbit_distance, to.orbit_distance, t);
+
+    update(&cam);
+
+    return cam;
 }
 
 void update(Camera *cam)
@@ -102,4 +329,8 @@ void update(Camera *cam)
     cam->front = glm::normalize(new_front);
     cam->right = glm::normalize(glm::cross(cam->world_up, cam->front));
     cam->up    = glm::normalize(glm::cross(cam->right, cam->front));
+
+    if (cam->orbiting) cam->position = cam->orbit_target - cam->front * cam->orbit_distance;
+
+    ++cam->version;
 }
\ No newline at end of file
@@ -4,24 +4,77 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "types.h"
+#include "frustum.h"
+
+// Fly camera, or turntable around a target when orbiting: yaw and pitch
+// then place the camera on a sphere around orbit_target instead of turning
+// it in place.
+//
+// With smoothing above 0 rotation and zoom go to goal_* first and the
+// camera eases towards them in step(), smoothing being the time it takes to
+// cover about two thirds of the way.
+//
+// The view, projection and frustum are cached: every change bumps version
+// and update_matrices only rebuilds them when it differs from the version
+// they were built for. Code that changes fields directly calls touch().
+//
+// Two sets come out of it. view_projection and the frustum are the usual
+// world space ones with a finite far plane, for culling on the CPU. The
+// shaders get relative_view, which leaves the camera at the origin so model
+// matrices are offset by -position on the CPU and large coordinates cancel
+// before they reach floats on the GPU, and gpu_projection, which with
+// reverse Z has no far plane at all.
+//
+// position and every matrix are relative to origin, a world position in
+// double precision, usually the origin of the loaded model. Geometry with
+// another origin gets its model matrix from camera_relative_model, which
+// does the subtraction in double so only small floats reach the GPU.
+
 struct Camera
 {
+    glm::dvec3 origin;
     glm::vec3 position;
 
     glm::vec3 front;
     glm::vec3 up;
     glm::vec3 right;
-    
+
     glm::vec3 world_up;
 
     float yaw;
     float pitch;
-    
+
     float fov;
     float speed;
 
     bool flying;
     float prev_y_pos;
+
+    bool orbiting;
+    glm::vec3 orbit_target;
+    float orbit_distance;
+
+    float smoothing;
+    float goal_yaw;
+    float goal_pitch;
+    float goal_fov;
+    float goal_distance;
+
+    // derived from the above and the lens
+    u32 version;
+    u32 cached_version;
+    float aspect;
+    float near_plane;
+    float far_plane;
+    bool reverse_z;
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 view_projection;
+    glm::mat4 inverse_view_projection;
+    Frustum frustum;
+    glm::mat4 relative_view;
+    glm::mat4 gpu_projection;
 };
 
 Camera init(const glm::vec3 &position, const glm::vec3 &up, float yaw, float pitch);
@@ -34,3 +87,36 @@ void rotate(Camera *cam, float yaw, float pitch);
 
 void zoom(Camera *cam, float zoom);
 
+// eases the smoothed values towards their goals, false once they are there
+bool step(Camera *cam, float dt);
+
+// switches to orbiting around target from where the camera is, looking at
+// it, or back to flying from the current position
+void set_orbit(Camera *cam, bool orbiting, const glm::vec3 &target);
+
+// after changing position or the other fields directly
+void touch(Camera *cam);
+
+// moves origin keeping the camera where it is in the world
+void rebase(Camera *cam, const glm::dvec3 &origin);
+
+glm::dvec3 world_position(const Camera *cam);
+
+// model matrix for relative_view of geometry whose world space is relative
+// to model_origin
+glm::mat4 camera_relative_model(const glm::mat4 &model, const glm::dvec3 &model_origin,
+                                const glm::dvec3 &camera_world_position);
+
+// rebuilds the cached matrices and frustum if the camera or lens changed
+void update_matrices(Camera *cam, float aspect, float near_plane, float far_plane, bool reverse_z);
+
+// near and far planes that just contain the bounds in front of the camera,
+// with near kept within max_depth_ratio of far for fixed point depth
+void fit_depth_range(const Camera *cam, const glm::vec3 &bounds_min, const glm::vec3 &bounds_max,
+                     float max_depth_ratio, float *near_plane, float *far_plane);
+
+// depth 1 at near and 0 at infinity, for clip control's [0, 1] depth range
+glm::mat4 infinite_reverse_z_perspective(float fovy, float aspect, float near_plane);
+
+// position, angles and fov blended from one state to the next, t in [0, 1]
+Camera interpolate(const Camera &from, const Camera &to, float t);
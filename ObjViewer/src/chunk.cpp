@@ -0,0 +1,1417 @@
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "chunk.h"
+#include "obj.h"
+#include "objstream.h"
+#include "normals.h"
+#include "profile.h"
+#include "frustum.h"
+#include "file.h"
+#include "log.h"
+
+// --- BAKE ---
+
+// a node whose geometry is already in the file, the rest goes into the
+// node table at the end
+struct BakeNode
+{
+    glm::vec3 bounds_min;
+    glm::vec3 bounds_max;
+    float geometric_error;
+    u32 vertex_count;
+    u32 index_count;
+    u64 data_offset;
+
+    std::vector<u32> children;
+};
+
+// geometry of a node, kept until its parent has been simplified from it
+struct BakeGeometry
+{
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+};
+
+struct BakeWriter
+{
+    FILE *file;
+    BakeOptions options;
+    std::vector<BakeNode> nodes;
+    bool failed; // a temp file could not be written or read, the bake stops
+};
+
+BakeOptions default_bake_options()
+{
+    BakeOptions options;
+    options.max_triangles_per_cell = 64 * 1024;
+    options.max_depth = 16;
+    options.lod_grid_resolution = 64;
+    options.cache_size = 512ull * 1024 * 1024;
+    return options;
+}
+
+local inline u32
+octant_of(const glm::vec3 &centroid, const glm::vec3 &center)
+{
+    return (centroid.x > center.x ? 1 : 0) |
+           (centroid.y > center.y ? 2 : 0) |
+           (centroid.z > center.z ? 4 : 0);
+}
+
+local void
+octant_cell(u32 octant, const glm::vec3 &cell_min, const glm::vec3 &cell_max,
+            glm::vec3 *child_min, glm::vec3 *child_max)
+{
+    glm::vec3 center = (cell_min + cell_max) * 0.5f;
+    *child_min = glm::vec3((octant & 1) ? center.x : cell_min.x,
+                           (octant & 2) ? center.y : cell_min.y,
+                           (octant & 4) ? center.z : cell_min.z);
+    *child_max = glm::vec3((octant & 1) ? cell_max.x : center.x,
+                           (octant & 2) ? cell_max.y : center.y,
+                           (octant & 4) ? cell_max.z : center.z);
+}
+
+// writes the geometry of a node right away, only its table entry is kept
+local u32
+add_bake_node(BakeWriter *writer, const BakeGeometry &geometry, float geometric_error, const std::vector<u32> &children)
+{
+    BakeNode node;
+    node.bounds_min = glm::vec3(FLT_MAX);
+    node.bounds_max = glm::vec3(-FLT_MAX);
+    for (const Vertex &vertex : geometry.vertices)
+    {
+        node.bounds_min = glm::min(node.bounds_min, vertex.position);
+        node.bounds_max = glm::max(node.bounds_max, vertex.position);
+    }
+
+    node.geometric_error = geometric_error;
+    node.vertex_count = (u32)geometry.vertices.size();
+    node.index_count = (u32)geometry.indices.size();
+    node.data_offset = tell_file(writer->file);
+    node.children = children;
+
+    fwrite(geometry.vertices.data(), sizeof(Vertex), geometry.vertices.size(), writer->file);
+    fwrite(geometry.indices.data(), sizeof(u32), geometry.indices.size(), writer->file);
+
+    writer->nodes.push_back(std::move(node));
+    return (u32)writer->nodes.size() - 1;
+}
+
+local void
+extract_triangles(const Mesh *mesh, const std::vector<u32> &triangles, BakeGeometry *geometry)
+{
+    std::unordered_map<u32, u32> remap;
+    remap.reserve(triangles.size() * 3);
+
+    for (u32 triangle : triangles)
+    {
+        for (u32 corner = 0; corner < 3; ++corner)
+        {
+            u32 source_index = mesh->indices[triangle * 3 + corner];
+
+            auto it = remap.find(source_index);
+            if (it == remap.end())
+            {
+                it = remap.emplace(source_index, (u32)geometry->vertices.size()).first;
+                geometry->vertices.push_back(mesh->vertices[source_index]);
+            }
+
+            geometry->indices.push_back(it->second);
+        }
+    }
+}
+
+// vertex clustering: every vertex snaps to the average of its grid cell,
+// triangles collapsing inside a cell are dropped
+local void
+cluster_simplify(const std::vector<Vertex> &vertices, const std::vector<u32> &indices,
+                 const glm::vec3 &cell_min, const glm::vec3 &cell_max, u32 resolution,
+                 BakeGeometry *geometry)
+{
+    glm::vec3 extent = cell_max - cell_min;
+    float cell_size = glm::max(extent.x, glm::max(extent.y, extent.z)) / (float)resolution;
+    if (cell_size <= 0.0f) cell_size = 1.0f;
+
+    std::unordered_map<u64, u32> clusters;
+    std::vector<u32> remap(vertices.size());
+    std::vector<u32> counts;
+
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        glm::vec3 q = glm::floor((vertices[i].position - cell_min) / cell_size);
+        q = glm::clamp(q, glm::vec3(0.0f), glm::vec3((float)(resolution - 1)));
+
+        u64 key = (u64)q.x | ((u64)q.y << 21) | ((u64)q.z << 42);
+
+        auto it = clusters.find(key);
+        if (it == clusters.end())
+        {
+            it = clusters.emplace(key, (u32)geometry->vertices.size()).first;
+            geometry->vertices.push_back(Vertex{});
+            counts.push_back(0);
+        }
+
+        u32 cluster = it->second;
+        geometry->vertices[cluster].position += vertices[i].position;
+        geometry->vertices[cluster].tex_coord += vertices[i].tex_coord;
+        geometry->vertices[cluster].normal += vertices[i].normal;
+        geometry->vertices[cluster].tangent += vertices[i].tangent;
+        ++counts[cluster];
+
+        remap[i] = cluster;
+    }
+
+    for (size_t i = 0; i < geometry->vertices.size(); ++i)
+    {
+        Vertex *vertex = &geometry->vertices[i];
+        vertex->position /= (float)counts[i];
+        vertex->tex_coord /= (float)counts[i];
+
+        float normal_length = glm::length(vertex->normal);
+        float tangent_length = glm::length(glm::vec3(vertex->tangent));
+        if (normal_length > 0.0f) vertex->normal /= normal_length;
+        if (tangent_length > 0.0f)
+        {
+            vertex->tangent = glm::vec4(glm::vec3(vertex->tangent) / tangent_length,
+                                        vertex->tangent.w < 0.0f ? -1.0f : 1.0f);
+        }
+    }
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        u32 a = remap[indices[i + 0]];
+        u32 b = remap[indices[i + 1]];
+        u32 c = remap[indices[i + 2]];
+
+        if (a == b || b == c || a == c) continue;
+
+        geometry->indices.push_back(a);
+        geometry->indices.push_back(b);
+        geometry->indices.push_back(c);
+    }
+}
+
+// the inner node is a simplification of the union of its children, whose
+// geometry is released once it is folded in
+local u32
+add_inner_node(BakeWriter *writer, const std::vector<u32> &children, std::vector<BakeGeometry> *child_geometry,
+               const glm::vec3 &cell_min, const glm::vec3 &cell_max, BakeGeometry *geometry)
+{
+    std::vector<Vertex> merged_vertices;
+    std::vector<u32> merged_indices;
+    float max_child_error = 0.0f;
+
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        BakeGeometry *child = &(*child_geometry)[i];
+        u32 base = (u32)merged_vertices.size();
+
+        merged_vertices.insert(merged_vertices.end(), child->vertices.begin(), child->vertices.end());
+        for (u32 index : child->indices) merged_indices.push_back(base + index);
+
+        max_child_error = glm::max(max_child_error, writer->nodes[children[i]].geometric_error);
+        *child = BakeGeometry{};
+    }
+
+    u32 resolution = writer->options.lod_grid_resolution;
+    cluster_simplify(merged_vertices, merged_indices, cell_min, cell_max, resolution, geometry);
+
+    glm::vec3 extent = cell_max - cell_min;
+    float geometric_error = glm::max(extent.x, glm::max(extent.y, extent.z)) / (float)resolution + max_child_error;
+
+    return add_bake_node(writer, *geometry, geometric_error, children);
+}
+
+local u32
+build_node(BakeWriter *writer, const Mesh *mesh, const std::vector<u32> &triangles,
+           const glm::vec3 &cell_min, const glm::vec3 &cell_max, u32 depth, BakeGeometry *geometry)
+{
+    const BakeOptions &options = writer->options;
+    bool split = triangles.size() > options.max_triangles_per_cell && depth < options.max_depth;
+
+    std::vector<u32> octants[8];
+    glm::vec3 center = (cell_min + cell_max) * 0.5f;
+
+    if (split)
+    {
+        for (u32 triangle : triangles)
+        {
+            glm::vec3 centroid = (mesh->vertices[mesh->indices[triangle * 3 + 0]].position +
+                                  mesh->vertices[mesh->indices[triangle * 3 + 1]].position +
+                                  mesh->vertices[mesh->indices[triangle * 3 + 2]].position) / 3.0f;
+
+            octants[octant_of(centroid, center)].push_back(triangle);
+        }
+
+        // everything landed in one octant, splitting further won't help
+        for (u32 octant = 0; octant < 8; ++octant)
+        {
+            if (octants[octant].size() == triangles.size()) split = false;
+        }
+    }
+
+    if (!split)
+    {
+        extract_triangles(mesh, triangles, geometry);
+        return add_bake_node(writer, *geometry, 0.0f, std::vector<u32>());
+    }
+
+    std::vector<u32> children;
+    std::vector<BakeGeometry> child_geometry;
+    for (u32 octant = 0; octant < 8; ++octant)
+    {
+        if (octants[octant].empty()) continue;
+
+        glm::vec3 child_min, child_max;
+        octant_cell(octant, cell_min, cell_max, &child_min, &child_max);
+
+        std::vector<u32> child_triangles;
+        child_triangles.swap(octants[octant]);
+
+        child_geometry.emplace_back();
+        children.push_back(build_node(writer, mesh, child_triangles, child_min, child_max, depth + 1,
+                                      &child_geometry.back()));
+    }
+
+    return add_inner_node(writer, children, &child_geometry, cell_min, cell_max, geometry);
+}
+
+local s32
+begin_bake(BakeWriter *writer, const char *filename, const BakeOptions &options)
+{
+    writer->file = fopen(filename, "wb");
+    if (!writer->file)
+    {
+        LOG_E("Cannot open '%s' for writing", filename);
+        return -1;
+    }
+
+    writer->options = options;
+    writer->nodes.clear();
+    writer->failed = false;
+
+    // the real header goes in once the node table is known
+    ChunkFileHeader header = {};
+    fwrite(&header, sizeof(header), 1, writer->file);
+
+    return 0;
+}
+
+// the node table in breadth first order, so the children of every node end
+// up contiguous, then the header
+local s32
+finish_bake(BakeWriter *writer, const char *filename, u32 root, const glm::vec3 &bounds_min,
+            const glm::vec3 &bounds_max, const glm::dvec3 &origin)
+{
+    FILE *file = writer->file;
+    const std::vector<BakeNode> &nodes = writer->nodes;
+
+    std::vector<u32> order;
+    std::vector<u32> new_index(nodes.size());
+    order.push_back(root);
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        new_index[order[i]] = (u32)i;
+        for (u32 child : nodes[order[i]].children) order.push_back(child);
+    }
+
+    std::vector<ChunkNode> table(order.size());
+    for (u32 i = 0; i < (u32)order.size(); ++i)
+    {
+        const BakeNode &bake_node = nodes[order[i]];
+        ChunkNode &node = table[i];
+
+        node = {};
+        node.bounds_min = bake_node.bounds_min;
+        node.bounds_max = bake_node.bounds_max;
+        node.geometric_error = bake_node.geometric_error;
+        node.child_count = (u32)bake_node.children.size();
+        node.first_child = node.child_count ? new_index[bake_node.children[0]] : 0;
+        node.vertex_count = bake_node.vertex_count;
+        node.index_count = bake_node.index_count;
+        node.data_offset = bake_node.data_offset;
+        node.data_size = (u64)node.vertex_count * sizeof(Vertex) + (u64)node.index_count * sizeof(u32);
+    }
+
+    // simplified inner nodes must at least cover their children
+    for (u32 i = (u32)table.size(); i-- > 0;)
+    {
+        for (u32 child = 0; child < table[i].child_count; ++child)
+        {
+            table[i].bounds_min = glm::min(table[i].bounds_min, table[table[i].first_child + child].bounds_min);
+            table[i].bounds_max = glm::max(table[i].bounds_max, table[table[i].first_child + child].bounds_max);
+        }
+    }
+
+    ChunkFileHeader header = {};
+    header.magic = CHUNK_FILE_MAGIC;
+    header.version = CHUNK_FILE_VERSION;
+    header.vertex_size = sizeof(Vertex);
+    header.node_count = (u32)table.size();
+    header.node_table_offset = tell_file(file);
+    header.bounds_min = bounds_min;
+    header.bounds_max = bounds_max;
+    header.origin = origin;
+
+    fwrite(table.data(), sizeof(ChunkNode), table.size(), file);
+
+    seek_file(file, 0);
+    fwrite(&header, sizeof(header), 1, file);
+
+    bool write_error = ferror(file) != 0;
+    fclose(file);
+    writer->file = nullptr;
+
+    if (write_error)
+    {
+        LOG_E("Error writing '%s'", filename);
+        return -1;
+    }
+
+    LOG_I("Baked '%s': %u nodes", filename, header.node_count);
+
+    return 0;
+}
+
+s32 bake_chunks(const Mesh *mesh, const char *filename, const BakeOptions &options)
+{
+    PROFILE_SCOPE("bake chunks");
+
+    if (mesh->indices.empty())
+    {
+        LOG_E("Cannot bake '%s', the mesh is empty", filename);
+        return -1;
+    }
+
+    // cubic root cell so the octree cells stay cubic
+    glm::vec3 center = (mesh->bounds_min + mesh->bounds_max) * 0.5f;
+    glm::vec3 extent = mesh->bounds_max - mesh->bounds_min;
+    float half_size = glm::max(extent.x, glm::max(extent.y, extent.z)) * 0.5f;
+
+    std::vector<u32> triangles(mesh->indices.size() / 3);
+    for (u32 i = 0; i < (u32)triangles.size(); ++i) triangles[i] = i;
+
+    BakeWriter writer;
+    if (begin_bake(&writer, filename, options) != 0) return -1;
+
+    BakeGeometry root_geometry;
+    u32 root = build_node(&writer, mesh, triangles, center - glm::vec3(half_size), center + glm::vec3(half_size), 0,
+                          &root_geometry);
+
+    return finish_bake(&writer, filename, root, mesh->bounds_min, mesh->bounds_max, mesh->origin);
+}
+
+
+// --- BAKE FROM A STREAM ---
+//
+// The obj is read twice through an ObjStream. The first pass copies the
+// attributes into record files, the second resolves the faces against them
+// into a file of triangles. Cells over the triangle limit are split into
+// eight child files in one sequential pass each, depth first, and leaves
+// load only their own triangles; inner nodes are simplified bottom up from
+// their children as in the in memory bake.
+
+#define BAKE_PAGE_SIZE (64 * 1024)
+#define BAKE_NO_PAGE 0xFFFFFFFFFFFFFFFFull
+#define BAKE_BATCH_TRIANGLES 4096
+
+// positions are welded by value against this many distinct recent ones,
+// exporters that repeat a position per face write the copies close together
+#define BAKE_WELD_WINDOW (256 * 1024)
+
+// fixed size records in a temp file behind a direct mapped page cache, so
+// lookups by index stay in bounded memory whatever the size of the file
+struct BakeRecords
+{
+    FILE *file;
+    std::string filename;
+    u32 record_size;
+    u32 records_per_page;
+    u64 record_count; // appended, or expected for a file only written through lookups
+    u64 cache_size;
+
+    std::vector<u8> pages; // allocated on the first lookup, no more than the file needs
+    std::vector<u64> page_ids; // BAKE_NO_PAGE for an empty slot
+    std::vector<u8> page_dirty;
+    bool failed;
+};
+
+local s32
+init(BakeRecords *records, const std::string &filename, u32 record_size, u64 cache_size)
+{
+    records->filename = filename;
+    records->file = fopen(filename.c_str(), "w+b");
+    if (!records->file)
+    {
+        LOG_W("Cannot open '%s' for writing", filename.c_str());
+        return -1;
+    }
+
+    records->record_size = record_size;
+    records->records_per_page = BAKE_PAGE_SIZE / record_size;
+    records->record_count = 0;
+    records->cache_size = cache_size;
+    records->pages.clear();
+    records->failed = false;
+
+    return 0;
+}
+
+local void
+destroy(BakeRecords *records)
+{
+    if (records->file)
+    {
+        fclose(records->file);
+        remove(records->filename.c_str());
+    }
+    records->file = nullptr;
+
+    std::vector<u8>().swap(records->pages);
+}
+
+// only before the first lookup, records go to the end of the file
+local inline void
+append(BakeRecords *records, const void *record)
+{
+    fwrite(record, records->record_size, 1, records->file);
+    ++records->record_count;
+}
+
+// pages past the end of the file read as zeros, written ones are flushed
+// when their slot is taken
+local u8 *
+lookup(BakeRecords *records, u64 index, bool write)
+{
+    u64 page = index / records->records_per_page;
+    u64 page_bytes = (u64)records->records_per_page * records->record_size;
+
+    if (records->pages.empty())
+    {
+        u64 file_pages = records->record_count / records->records_per_page + 1;
+        size_t slots = (size_t)glm::clamp(records->cache_size / page_bytes, (u64)1, file_pages);
+        records->pages.assign(slots * (size_t)page_bytes, 0);
+        records->page_ids.assign(slots, BAKE_NO_PAGE);
+        records->page_dirty.assign(slots, 0);
+    }
+
+    size_t slots = records->page_ids.size();
+    size_t slot = (size_t)(page % slots);
+    u8 *data = records->pages.data() + slot * (size_t)page_bytes;
+
+    if (records->page_ids[slot] != page)
+    {
+        if (records->page_dirty[slot])
+        {
+            if (seek_file(records->file, records->page_ids[slot] * page_bytes) != 0 ||
+                fwrite(data, 1, (size_t)page_bytes, records->file) != page_bytes)
+            {
+                records->failed = true;
+            }
+        }
+
+        size_t read = 0;
+        if (seek_file(records->file, page * page_bytes) == 0) read = fread(data, 1, (size_t)page_bytes, records->file);
+        memset(data + read, 0, (size_t)(page_bytes - read));
+
+        records->page_ids[slot] = page;
+        records->page_dirty[slot] = 0;
+    }
+
+    if (write) records->page_dirty[slot] = 1;
+    return data + (index % records->records_per_page) * records->record_size;
+}
+
+// a record of the position file
+struct BakePosition
+{
+    glm::dvec3 position;
+    u64 weld; // index of the first position with the same value, the key of its normal sum
+};
+
+struct BakePositionHash
+{
+    size_t operator()(const glm::dvec3 &p) const
+    {
+        const u64 *words = (const u64 *)&p;
+        u64 h = words[0] * 0x9E3779B97F4A7C15ull;
+        h ^= words[1] * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+        h ^= words[2] * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+        return (size_t)h;
+    }
+};
+
+struct BakeCorner
+{
+    glm::vec3 position;
+    glm::vec2 tex_coord;
+    glm::vec3 normal;
+};
+
+// a record of the cell files
+struct BakeTriangle
+{
+    BakeCorner corners[3];
+    u64 positions[3]; // welded source positions, generated normals are summed per position
+    u32 smoothing_group;
+    u32 padding;
+};
+
+#define BAKE_GROUP_NONE 0
+#define BAKE_GROUP_MIXED 0xFFFFFFFF
+
+// a record of the normal sums when the obj has no normals of its own
+struct BakeNormalSum
+{
+    glm::vec3 sum;
+    u32 group; // of the faces summed, BAKE_GROUP_MIXED once two groups meet here
+};
+
+struct BakeCornerHash
+{
+    size_t operator()(const BakeCorner &corner) const
+    {
+        const u32 *words = (const u32 *)&corner;
+        u64 h = 0;
+        for (u32 i = 0; i < sizeof(BakeCorner) / sizeof(u32); ++i)
+        {
+            h ^= (u64)words[i] * 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+        }
+        return (size_t)h;
+    }
+};
+
+struct BakeCornerEqual
+{
+    bool operator()(const BakeCorner &a, const BakeCorner &b) const
+    {
+        return memcmp(&a, &b, sizeof(BakeCorner)) == 0;
+    }
+};
+
+local FILE *
+open_cell_file(const std::string &filename, const char *mode)
+{
+    FILE *file = fopen(filename.c_str(), mode);
+    if (!file)
+    {
+        LOG_W("Cannot open '%s'", filename.c_str());
+        return nullptr;
+    }
+
+    // a split writes eight of them at once, small writes each
+    setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    return file;
+}
+
+local void
+face_normal(const BakeTriangle &triangle, glm::vec3 *normal, glm::vec3 *weights)
+{
+    const glm::vec3 &p0 = triangle.corners[0].position;
+    const glm::vec3 &p1 = triangle.corners[1].position;
+    const glm::vec3 &p2 = triangle.corners[2].position;
+
+    glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+    float length = glm::length(n);
+    *normal = length > 0.0f ? n / length : glm::vec3(0.0f);
+
+    // the corner angles, as generate_normals weights them by default
+    glm::vec3 e01 = p1 - p0, e02 = p2 - p0, e12 = p2 - p1;
+    auto angle = [](const glm::vec3 &a, const glm::vec3 &b) {
+        float l = sqrtf(glm::dot(a, a) * glm::dot(b, b));
+        return l > 0.0f ? acosf(glm::clamp(glm::dot(a, b) / l, -1.0f, 1.0f)) : 0.0f;
+    };
+    *weights = glm::vec3(angle(e01, e02), angle(-e01, e12), angle(-e02, -e12));
+}
+
+// smoothing group 0 is 's off', flat shaded; a position where faces of
+// different groups meet gets flat normals as well
+local void
+add_normal_sums(BakeRecords *sums, const BakeTriangle &triangle)
+{
+    if (triangle.smoothing_group == 0) return;
+
+    glm::vec3 normal, weights;
+    face_normal(triangle, &normal, &weights);
+
+    for (u32 corner = 0; corner < 3; ++corner)
+    {
+        BakeNormalSum *sum = (BakeNormalSum *)lookup(sums, triangle.positions[corner], true);
+        if (sum->group == BAKE_GROUP_NONE) sum->group = triangle.smoothing_group;
+        else if (sum->group != triangle.smoothing_group) sum->group = BAKE_GROUP_MIXED;
+        sum->sum += normal * weights[corner];
+    }
+}
+
+local void
+resolve_normals(BakeRecords *sums, BakeTriangle *triangle)
+{
+    glm::vec3 normal, weights;
+    face_normal(*triangle, &normal, &weights);
+
+    for (u32 corner = 0; corner < 3; ++corner)
+    {
+        glm::vec3 n = normal;
+        if (triangle->smoothing_group != 0)
+        {
+            const BakeNormalSum *sum = (const BakeNormalSum *)lookup(sums, triangle->positions[corner], false);
+            float length = glm::length(sum->sum);
+            if (sum->group != BAKE_GROUP_MIXED && length > 0.0f) n = sum->sum / length;
+        }
+        triangle->corners[corner].normal = n;
+    }
+}
+
+// rewrites the normals of the root cell file in place
+local bool
+resolve_cell_normals(BakeRecords *sums, const std::string &filename)
+{
+    FILE *file = fopen(filename.c_str(), "r+b");
+    if (!file) return false;
+
+    std::vector<BakeTriangle> batch(BAKE_BATCH_TRIANGLES);
+    u64 offset = 0;
+    bool ok = true;
+    for (;;)
+    {
+        seek_file(file, offset);
+        size_t read = fread(batch.data(), sizeof(BakeTriangle), batch.size(), file);
+        if (read == 0) break;
+
+        for (size_t i = 0; i < read; ++i) resolve_normals(sums, &batch[i]);
+
+        seek_file(file, offset);
+        if (fwrite(batch.data(), sizeof(BakeTriangle), read, file) != read) ok = false;
+        offset += read * sizeof(BakeTriangle);
+    }
+
+    ok = ok && !ferror(file) && !sums->failed;
+    fclose(file);
+    return ok;
+}
+
+// welds the corners of a leaf and works out its tangents
+local void
+leaf_geometry(const std::vector<BakeTriangle> &triangles, BakeGeometry *geometry)
+{
+    Mesh mesh = {};
+    std::unordered_map<BakeCorner, u32, BakeCornerHash, BakeCornerEqual> remap;
+    remap.reserve(triangles.size() * 2);
+
+    for (const BakeTriangle &triangle : triangles)
+    {
+        for (const BakeCorner &corner : triangle.corners)
+        {
+            auto it = remap.find(corner);
+            if (it == remap.end())
+            {
+                it = remap.emplace(corner, (u32)mesh.vertices.size()).first;
+
+                Vertex vertex = {};
+                vertex.position = corner.position;
+                vertex.tex_coord = corner.tex_coord;
+                vertex.normal = corner.normal;
+                mesh.vertices.push_back(vertex);
+            }
+
+            mesh.indices.push_back(it->second);
+        }
+    }
+
+    generate_tangents(&mesh);
+
+    geometry->vertices.swap(mesh.vertices);
+    geometry->indices.swap(mesh.indices);
+}
+
+local u32
+build_cell(BakeWriter *writer, const std::string &filename, u64 triangle_count,
+           const glm::vec3 &cell_min, const glm::vec3 &cell_max, u32 depth, BakeGeometry *geometry)
+{
+    const BakeOptions &options = writer->options;
+    bool split = triangle_count > options.max_triangles_per_cell && depth < options.max_depth;
+
+    std::string leaf_filename = filename;
+    std::string child_filenames[8];
+    u64 child_counts[8] = {};
+
+    if (split)
+    {
+        FILE *input = open_cell_file(filename, "rb");
+        FILE *outputs[8] = {};
+        bool opened = input != nullptr;
+        for (u32 octant = 0; octant < 8 && opened; ++octant)
+        {
+            child_filenames[octant] = filename + (char)('0' + octant);
+            outputs[octant] = open_cell_file(child_filenames[octant], "wb");
+            opened = outputs[octant] != nullptr;
+        }
+
+        glm::vec3 center = (cell_min + cell_max) * 0.5f;
+        std::vector<BakeTriangle> batch(BAKE_BATCH_TRIANGLES);
+        while (opened)
+        {
+            size_t read = fread(batch.data(), sizeof(BakeTriangle), batch.size(), input);
+            if (read == 0) break;
+
+            for (size_t i = 0; i < read; ++i)
+            {
+                const BakeCorner *corners = batch[i].corners;
+                glm::vec3 centroid = (corners[0].position + corners[1].position + corners[2].position) / 3.0f;
+
+                u32 octant = octant_of(centroid, center);
+                fwrite(&batch[i], sizeof(BakeTriangle), 1, outputs[octant]);
+                ++child_counts[octant];
+            }
+        }
+
+        if (!opened || ferror(input)) writer->failed = true;
+        if (input) fclose(input);
+        for (u32 octant = 0; octant < 8; ++octant)
+        {
+            if (!outputs[octant]) continue;
+            if (ferror(outputs[octant])) writer->failed = true;
+            fclose(outputs[octant]);
+        }
+        remove(filename.c_str());
+
+        // everything landed in one octant, splitting further won't help
+        for (u32 octant = 0; octant < 8; ++octant)
+        {
+            if (child_counts[octant] == triangle_count)
+            {
+                split = false;
+                leaf_filename = child_filenames[octant];
+            }
+        }
+
+        if (writer->failed || !split)
+        {
+            for (u32 octant = 0; octant < 8; ++octant)
+            {
+                if (child_filenames[octant] != leaf_filename) remove(child_filenames[octant].c_str());
+            }
+            if (writer->failed)
+            {
+                remove(leaf_filename.c_str());
+                return 0;
+            }
+        }
+    }
+
+    if (!split)
+    {
+        std::vector<BakeTriangle> triangles((size_t)triangle_count);
+        FILE *input = open_cell_file(leaf_filename, "rb");
+        if (!input || fread(triangles.data(), sizeof(BakeTriangle), triangles.size(), input) != triangles.size())
+        {
+            writer->failed = true;
+        }
+        if (input) fclose(input);
+        remove(leaf_filename.c_str());
+
+        if (writer->failed) return 0;
+
+        leaf_geometry(triangles, geometry);
+        return add_bake_node(writer, *geometry, 0.0f, std::vector<u32>());
+    }
+
+    std::vector<u32> children;
+    std::vector<BakeGeometry> child_geometry;
+    for (u32 octant = 0; octant < 8; ++octant)
+    {
+        if (child_counts[octant] == 0 || writer->failed)
+        {
+            remove(child_filenames[octant].c_str());
+            continue;
+        }
+
+        glm::vec3 child_min, child_max;
+        octant_cell(octant, cell_min, cell_max, &child_min, &child_max);
+
+        child_geometry.emplace_back();
+        children.push_back(build_cell(writer, child_filenames[octant], child_counts[octant], child_min, child_max,
+                                      depth + 1, &child_geometry.back()));
+    }
+
+    if (writer->failed) return 0;
+
+    return add_inner_node(writer, children, &child_geometry, cell_min, cell_max, geometry);
+}
+
+s32 bake_chunks(const char *obj_filename, const char *filename, const BakeOptions &options)
+{
+    PROFILE_SCOPE("bake chunks");
+
+    ObjStream stream;
+    if (init(&stream, obj_filename, default_obj_stream_options()) != 0) return -1;
+
+    // the lookups share the cache, positions and normal sums are the biggest
+    std::string temp = std::string(filename) + ".tmp";
+    u64 cache_eighth = options.cache_size / 8;
+    BakeRecords positions = {}, tex_coords = {}, normals = {}, sums = {};
+    if (init(&positions, temp + ".v", sizeof(BakePosition), cache_eighth * 3) != 0 ||
+        init(&tex_coords, temp + ".vt", sizeof(glm::vec2), cache_eighth) != 0 ||
+        init(&normals, temp + ".vn", sizeof(glm::vec3), cache_eighth) != 0)
+    {
+        destroy(&positions);
+        destroy(&tex_coords);
+        destroy(&normals);
+        destroy(&stream);
+        return -1;
+    }
+
+    // first pass: the attributes into record files, the bounds and whether
+    // every corner has a normal
+    glm::dvec3 source_min(DBL_MAX);
+    glm::dvec3 source_max(-DBL_MAX);
+    u64 triangle_count = 0;
+    bool missing_normals = false;
+    std::unordered_map<glm::dvec3, u64, BakePositionHash> recent;
+    while (read_block(&stream))
+    {
+        const ObjStreamBlock &block = stream.block;
+        for (size_t i = 0; i < block.positions.size(); ++i)
+        {
+            const glm::dvec3 &p = block.positions[i];
+            if (recent.size() == BAKE_WELD_WINDOW) recent.clear();
+
+            BakePosition record = {p, block.first_position + i};
+            record.weld = recent.emplace(p, record.weld).first->second;
+            append(&positions, &record);
+
+            source_min = glm::min(source_min, p);
+            source_max = glm::max(source_max, p);
+        }
+        for (const glm::vec2 &t : block.tex_coords) append(&tex_coords, &t);
+        for (const glm::vec3 &n : block.normals) append(&normals, &n);
+
+        for (const ObjStreamFace &face : block.faces) triangle_count += face.corner_count - 2;
+        for (const ObjStreamCorner &corner : block.corners) missing_normals |= corner.vn < 0;
+    }
+
+    std::unordered_map<glm::dvec3, u64, BakePositionHash>().swap(recent);
+    bool has_smoothing_groups = stream.has_smoothing_groups;
+    bool failed = stream.failed || ferror(positions.file) || ferror(tex_coords.file) || ferror(normals.file);
+    destroy(&stream);
+
+    if (failed || triangle_count == 0)
+    {
+        if (!failed) LOG_E("Cannot bake '%s', the mesh is empty", filename);
+        destroy(&positions);
+        destroy(&tex_coords);
+        destroy(&normals);
+        return -1;
+    }
+
+    // every position counts for the origin here, load_obj only takes the
+    // ones faces use; it only has to be close to the model
+    glm::dvec3 origin = obj_origin(source_min, source_max);
+
+    // second pass: fan triangles with their corners looked up, into the
+    // file of the root cell
+    std::string root_filename = temp + ".cell";
+    FILE *root_file = open_cell_file(root_filename, "wb");
+    if (!root_file || init(&stream, obj_filename, default_obj_stream_options()) != 0)
+    {
+        if (root_file) fclose(root_file);
+        remove(root_filename.c_str());
+        destroy(&positions);
+        destroy(&tex_coords);
+        destroy(&normals);
+        return -1;
+    }
+
+    if (missing_normals)
+    {
+        if (init(&sums, temp + ".sums", sizeof(BakeNormalSum), cache_eighth * 3) != 0) failed = true;
+        sums.record_count = positions.record_count;
+    }
+
+    glm::vec3 bounds_min(FLT_MAX);
+    glm::vec3 bounds_max(-FLT_MAX);
+    while (!failed && read_block(&stream))
+    {
+        const ObjStreamBlock &block = stream.block;
+        for (const ObjStreamFace &face : block.faces)
+        {
+            const ObjStreamCorner *corners = &block.corners[face.first_corner];
+
+            // without any 's' line every face is smooth
+            u32 group = has_smoothing_groups ? block.states[face.state].smoothing_group : 1;
+
+            for (u32 i = 2; i < face.corner_count; ++i)
+            {
+                const ObjStreamCorner *triangle_corners[3] = { &corners[0], &corners[i - 1], &corners[i] };
+
+                BakeTriangle triangle = {};
+                triangle.smoothing_group = group;
+                for (u32 corner = 0; corner < 3; ++corner)
+                {
+                    const ObjStreamCorner *source = triangle_corners[corner];
+                    BakeCorner *out = &triangle.corners[corner];
+
+                    const BakePosition *position = (const BakePosition *)lookup(&positions, (u64)source->v, false);
+                    out->position = glm::vec3(position->position - origin);
+                    if (source->vt >= 0) out->tex_coord = *(const glm::vec2 *)lookup(&tex_coords, (u64)source->vt, false);
+                    if (source->vn >= 0 && !missing_normals) out->normal = *(const glm::vec3 *)lookup(&normals, (u64)source->vn, false);
+                    triangle.positions[corner] = position->weld;
+
+                    bounds_min = glm::min(bounds_min, out->position);
+                    bounds_max = glm::max(bounds_max, out->position);
+                }
+
+                if (missing_normals) add_normal_sums(&sums, triangle);
+                fwrite(&triangle, sizeof(BakeTriangle), 1, root_file);
+            }
+        }
+    }
+
+    failed = failed || stream.failed || ferror(root_file) || positions.failed || tex_coords.failed || normals.failed;
+    fclose(root_file);
+    destroy(&stream);
+    destroy(&positions);
+    destroy(&tex_coords);
+    destroy(&normals);
+
+    // the sums are complete, the corners take their normals from them
+    if (!failed && missing_normals) failed = !resolve_cell_normals(&sums, root_filename);
+    destroy(&sums);
+
+    if (failed)
+    {
+        LOG_E("Cannot bake '%s', a temp file next to it failed", filename);
+        remove(root_filename.c_str());
+        return -1;
+    }
+
+    // cubic root cell so the octree cells stay cubic
+    glm::vec3 center = (bounds_min + bounds_max) * 0.5f;
+    glm::vec3 extent = bounds_max - bounds_min;
+    float half_size = glm::max(extent.x, glm::max(extent.y, extent.z)) * 0.5f;
+
+    BakeWriter writer;
+    if (begin_bake(&writer, filename, options) != 0)
+    {
+        remove(root_filename.c_str());
+        return -1;
+    }
+
+    BakeGeometry root_geometry;
+    u32 root = build_cell(&writer, root_filename, triangle_count, center - glm::vec3(half_size),
+                          center + glm::vec3(half_size), 0, &root_geometry);
+
+    if (writer.failed)
+    {
+        LOG_E("Cannot bake '%s', a temp file next to it failed", filename);
+        fclose(writer.file);
+        remove(filename);
+        return -1;
+    }
+
+    return finish_bake(&writer, filename, root, bounds_min, bounds_max, origin);
+}
+
+
+// --- STREAMING ---
+
+ChunkStreamOptions default_stream_options()
+{
+    ChunkStreamOptions options;
+    options.ram_budget = 2ull * 1024 * 1024 * 1024;
+    options.vram_budget = 1ull * 1024 * 1024 * 1024;
+    options.max_screen_error = 2.0f;
+    options.max_uploads_per_frame = 4;
+    return options;
+}
+
+local void
+io_thread_proc(ChunkStreamer *streamer)
+{
+    set_profile_thread_name("chunk io");
+
+    std::unique_lock<std::mutex> lock(streamer->mutex);
+
+    for (;;)
+    {
+        streamer->wake.wait(lock, [streamer] { return streamer->quit || !streamer->requests.empty(); });
+
+        if (streamer->quit) break;
+
+        ChunkRequest request = streamer->requests.back();
+        streamer->requests.pop_back();
+
+        lock.unlock();
+
+        // nodes are immutable after init, the file is only touched by this thread
+        const ChunkNode &node = streamer->nodes[request.node];
+        u8 *data = (u8 *)malloc(node.data_size);
+
+        if (data &&
+            (seek_file(streamer->file, node.data_offset) != 0 ||
+             fread(data, 1, node.data_size, streamer->file) != node.data_size))
+        {
+            free(data);
+            data = nullptr;
+        }
+
+        lock.lock();
+        streamer->completed.push_back(ChunkLoad{request.node, data});
+    }
+}
+
+s32 init(ChunkStreamer *streamer, const char *filename, const ChunkStreamOptions &options)
+{
+    streamer->file = fopen(filename, "rb");
+    if (!streamer->file)
+    {
+        LOG_E("Cannot open '%s' for reading", filename);
+        return -1;
+    }
+
+    if (fread(&streamer->header, sizeof(ChunkFileHeader), 1, streamer->file) != 1 ||
+        streamer->header.magic != CHUNK_FILE_MAGIC ||
+        streamer->header.version != CHUNK_FILE_VERSION ||
+        streamer->header.vertex_size != sizeof(Vertex) ||
+        streamer->header.node_count == 0)
+    {
+        LOG_E("'%s' is not a valid chunk file", filename);
+        fclose(streamer->file);
+        streamer->file = nullptr;
+        return -1;
+    }
+
+    streamer->nodes.resize(streamer->header.node_count);
+    seek_file(streamer->file, streamer->header.node_table_offset);
+    if (fread(streamer->nodes.data(), sizeof(ChunkNode), streamer->nodes.size(), streamer->file) != streamer->nodes.size())
+    {
+        LOG_E("'%s' node table is truncated", filename);
+        fclose(streamer->file);
+        streamer->file = nullptr;
+        return -1;
+    }
+
+    streamer->residency.assign(streamer->nodes.size(), ChunkResidency{});
+    streamer->options = options;
+    streamer->quit = false;
+    streamer->frame = 0;
+    streamer->ram_used = 0;
+    streamer->vram_used = 0;
+    streamer->stats = {};
+
+    streamer->io_thread = std::thread(io_thread_proc, streamer);
+
+    return 0;
+}
+
+local inline u64
+gpu_size(const ChunkNode *node)
+{
+    return node->data_size;
+}
+
+local void
+free_ram(ChunkStreamer *streamer, u32 index)
+{
+    ChunkResidency *residency = &streamer->residency[index];
+    if (residency->data)
+    {
+        free(residency->data);
+        residency->data = nullptr;
+        streamer->ram_used -= streamer->nodes[index].data_size;
+    }
+}
+
+local void
+free_vram(ChunkStreamer *streamer, u32 index)
+{
+    ChunkResidency *residency = &streamer->residency[index];
+    if (residency->gpu.VAO)
+    {
+        destroy(&residency->gpu);
+        streamer->vram_used -= gpu_size(&streamer->nodes[index]);
+    }
+}
+
+// least recently used first, anything touched this frame is never evicted
+local void
+collect_eviction_candidates(ChunkStreamer *streamer, bool vram, std::vector<u32> *candidates)
+{
+    candidates->clear();
+    for (u32 i = 0; i < (u32)streamer->residency.size(); ++i)
+    {
+        const ChunkResidency &residency = streamer->residency[i];
+        bool resident = vram ? residency.gpu.VAO != 0 : residency.data != nullptr;
+
+        if (resident && residency.last_used_frame < streamer->frame)
+        {
+            candidates->push_back(i);
+        }
+    }
+
+    std::sort(candidates->begin(), candidates->end(), [streamer](u32 a, u32 b) {
+        return streamer->residency[a].last_used_frame < streamer->residency[b].last_used_frame;
+    });
+}
+
+local bool
+make_room(ChunkStreamer *streamer, bool vram, u64 size, std::vector<u32> *candidates, size_t *next_candidate)
+{
+    u64 *used = vram ? &streamer->vram_used : &streamer->ram_used;
+    u64 budget = vram ? streamer->options.vram_budget : streamer->options.ram_budget;
+
+    if (*used + size <= budget) return true;
+
+    if (*next_candidate == 0 && candidates->empty())
+    {
+        collect_eviction_candidates(streamer, vram, candidates);
+    }
+
+    while (*used + size > budget && *next_candidate < candidates->size())
+    {
+        u32 victim = (*candidates)[(*next_candidate)++];
+        if (vram) free_vram(streamer, victim);
+        else free_ram(streamer, victim);
+    }
+
+    return *used + size <= budget;
+}
+
+struct SelectContext
+{
+    Frustum frustum;
+    glm::vec3 camera_position;
+    float projection_scale;
+};
+
+local inline bool
+is_drawable(ChunkStreamer *streamer, u32 index)
+{
+    return streamer->residency[index].gpu.VAO != 0 || streamer->nodes[index].index_count == 0;
+}
+
+local void
+want(ChunkStreamer *streamer, u32 index, float priority)
+{
+    const ChunkResidency &residency = streamer->residency[index];
+    if (residency.gpu.VAO == 0 && streamer->nodes[index].index_count != 0)
+    {
+        streamer->wanted.push_back(ChunkRequest{index, priority});
+    }
+}
+
+local void
+select_nodes(ChunkStreamer *streamer, const SelectContext *ctx, u32 index)
+{
+    const ChunkNode &node = streamer->nodes[index];
+
+    if (!intersects(&ctx->frustum, node.bounds_min, node.bounds_max)) return;
+
+    streamer->residency[index].last_used_frame = streamer->frame;
+
+    float distance = glm::max(distance_to_bounds(ctx->camera_position, node.bounds_min, node.bounds_max), 1e-3f);
+    float error_px = node.geometric_error * ctx->projection_scale / distance;
+
+    if (node.child_count > 0 && error_px > streamer->options.max_screen_error)
+    {
+        bool children_ready = true;
+        for (u32 child = node.first_child; child < node.first_child + node.child_count; ++child)
+        {
+            const ChunkNode &child_node = streamer->nodes[child];
+            if (!intersects(&ctx->frustum, child_node.bounds_min, child_node.bounds_max)) continue;
+
+            streamer->residency[child].last_used_frame = streamer->frame;
+
+            if (!is_drawable(streamer, child))
+            {
+                children_ready = false;
+                want(streamer, child, error_px);
+            }
+        }
+
+        if (children_ready)
+        {
+            for (u32 child = node.first_child; child < node.first_child + node.child_count; ++child)
+            {
+                select_nodes(streamer, ctx, child);
+            }
+            return;
+        }
+
+        // keep drawing the coarser node while the children stream in
+    }
+
+    if (streamer->residency[index].gpu.VAO)
+    {
+        streamer->draw_list.push_back(index);
+    }
+    else
+    {
+        // the node is needed right now, it goes before any refinement
+        want(streamer, index, FLT_MAX);
+    }
+}
+
+void update(ChunkStreamer *streamer, const Camera *cam, float screen_height)
+{
+    PROFILE_SCOPE("chunk update");
+
+    ++streamer->frame;
+
+    std::vector<ChunkLoad> completed;
+    {
+        std::lock_guard<std::mutex> lock(streamer->mutex);
+        completed.swap(streamer->completed);
+    }
+
+    for (const ChunkLoad &load : completed)
+    {
+        ChunkResidency *residency = &streamer->residency[load.node];
+        residency->loading = false;
+
+        if (!load.data)
+        {
+            LOG_W("Cannot read chunk node %u", load.node);
+            continue;
+        }
+
+        residency->data = load.data;
+        streamer->ram_used += streamer->nodes[load.node].data_size;
+    }
+
+    SelectContext ctx;
+    ctx.frustum = cam->frustum;
+    ctx.camera_position = cam->position;
+    ctx.projection_scale = screen_height / (2.0f * glm::tan(glm::radians(cam->fov) * 0.5f));
+
+    streamer->draw_list.clear();
+    streamer->wanted.clear();
+    select_nodes(streamer, &ctx, 0);
+
+    std::sort(streamer->wanted.begin(), streamer->wanted.end(), [](const ChunkRequest &a, const ChunkRequest &b) {
+        return a.priority > b.priority;
+    });
+
+    std::vector<u32> candidates;
+    size_t next_candidate = 0;
+
+    // nodes already in ram go to the gpu, most important first
+    u32 uploads = 0;
+    for (const ChunkRequest &request : streamer->wanted)
+    {
+        if (uploads >= streamer->options.max_uploads_per_frame) break;
+
+        ChunkResidency *residency = &streamer->residency[request.node];
+        if (!residency->data) continue;
+
+        const ChunkNode &node = streamer->nodes[request.node];
+        if (!make_room(streamer, true, gpu_size(&node), &candidates, &next_candidate)) break;
+
+        const Vertex *vertices = (const Vertex *)residency->data;
+        const u32 *indices = (const u32 *)(residency->data + (u64)node.vertex_count * sizeof(Vertex));
+        init(&residency->gpu, vertices, node.vertex_count, indices, node.index_count);
+
+        streamer->vram_used += gpu_size(&node);
+        ++uploads;
+    }
+
+    // everything else is read from disk, the queue is rebuilt every frame
+    // so requests that are not needed anymore are dropped before being read
+    candidates.clear();
+    next_candidate = 0;
+
+    std::vector<ChunkRequest> requests;
+    u64 ram_in_flight = 0;
+    {
+        std::lock_guard<std::mutex> lock(streamer->mutex);
+        for (const ChunkRequest &request : streamer->requests)
+        {
+            streamer->residency[request.node].loading = false;
+        }
+        streamer->requests.clear();
+    }
+
+    for (u32 i = 0; i < (u32)streamer->residency.size(); ++i)
+    {
+        if (streamer->residency[i].loading) ram_in_flight += streamer->nodes[i].data_size;
+    }
+
+    for (const ChunkRequest &request : streamer->wanted)
+    {
+        ChunkResidency *residency = &streamer->residency[request.node];
+        if (residency->data || residency->loading) continue;
+
+        u64 size = streamer->nodes[request.node].data_size;
+        if (!make_room(streamer, false, ram_in_flight + size, &candidates, &next_candidate)) break;
+
+        residency->loading = true;
+        ram_in_flight += size;
+        requests.push_back(request);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(streamer->mutex);
+        std::reverse(requests.begin(), requests.end());
+        streamer->requests.swap(requests);
+    }
+    streamer->wake.notify_one();
+
+    ChunkStreamStats *stats = &streamer->stats;
+    *stats = {};
+    stats->nodes_drawn = (u32)streamer->draw_list.size();
+    stats->ram_used = streamer->ram_used;
+    stats->vram_used = streamer->vram_used;
+    for (const ChunkResidency &residency : streamer->residency)
+    {
+        if (residency.data) ++stats->nodes_in_ram;
+        if (residency.gpu.VAO) ++stats->nodes_in_vram;
+        if (residency.loading) ++stats->pending_loads;
+    }
+}
+
+void draw(ChunkStreamer *streamer)
+{
+    for (u32 index : streamer->draw_list)
+    {
+        draw(&streamer->residency[index].gpu);
+    }
+}
+
+void destroy(ChunkStreamer *streamer)
+{
+    {
+        std::lock_guard<std::mutex> lock(streamer->mutex);
+        streamer->quit = true;
+    }
+    streamer->wake.notify_one();
+
+    if (streamer->io_thread.joinable())
+    {
+        streamer->io_thread.join();
+    }
+
+    for (const ChunkLoad &load : streamer->completed)
+    {
+        free(load.data);
+    }
+    streamer->completed.clear();
+    streamer->requests.clear();
+
+    for (u32 i = 0; i < (u32)streamer->residency.size(); ++i)
+    {
+        free_ram(streamer, i);
+        free_vram(streamer, i);
+    }
+
+    if (streamer->file)
+    {
+        fclose(streamer->file);
+        streamer->file = nullptr;
+    }
+}
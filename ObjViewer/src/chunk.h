@@ -0,0 +1,155 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <glm/glm.hpp>
+
+#include "types.h"
+#include "mesh.h"
+#include "camera.h"
+
+// Spatially chunked mesh file used to stream models bigger than memory.
+//
+// The file is an octree: leaves hold the original triangles of their cell,
+// inner nodes hold a simplified version of their children so far away parts
+// of the model can be drawn without loading the full resolution cells.
+//
+// [ChunkFileHeader][node 0 data][node 1 data]...[ChunkNode table]
+//
+// Node data is written as soon as a node is done, children before their
+// parent, so a bake only holds the simplified geometry of the nodes whose
+// parent is not done yet.
+
+#define CHUNK_FILE_MAGIC 0x4B43564F // 'OVCK'
+#define CHUNK_FILE_VERSION 3
+
+struct ChunkFileHeader
+{
+    u32 magic;
+    u32 version;
+    u32 vertex_size;
+    u32 node_count;
+    u64 node_table_offset;
+    glm::vec3 bounds_min;
+    glm::vec3 bounds_max;
+    glm::dvec3 origin; // of the baked mesh, every position in the file is relative to it
+};
+
+// children of a node are stored contiguously, node 0 is the root
+struct ChunkNode
+{
+    glm::vec3 bounds_min;
+    float geometric_error; // world space error of the simplified geometry, 0 for leaves
+    glm::vec3 bounds_max;
+    u32 first_child;
+    u32 child_count;
+    u32 vertex_count;
+    u32 index_count;
+    u32 padding;
+    u64 data_offset; // vertex_count Vertex followed by index_count u32
+    u64 data_size;
+};
+
+struct BakeOptions
+{
+    u32 max_triangles_per_cell;
+    u32 max_depth;
+    u32 lod_grid_resolution; // vertex clustering cells per axis for inner nodes
+    u64 cache_size;          // bytes for attribute lookups when baking from an obj
+};
+
+BakeOptions default_bake_options();
+
+s32 bake_chunks(const Mesh *mesh, const char *filename, const BakeOptions &options);
+
+// Bakes straight from the obj without loading it: two streamed passes over
+// the file, then the cells are split on disk in temp files next to the
+// output, so memory stays at options.cache_size plus one leaf and the
+// pending lods however big the model is. Normals are generated per position
+// when the obj lacks any, as load_model would, except that positions where
+// different smoothing groups meet are flat and repeated positions are only
+// welded when they are close together in the file; tangents come per leaf.
+s32 bake_chunks(const char *obj_filename, const char *filename, const BakeOptions &options);
+
+
+struct ChunkStreamOptions
+{
+    u64 ram_budget;
+    u64 vram_budget;
+    float max_screen_error; // in pixels
+    u32 max_uploads_per_frame;
+};
+
+ChunkStreamOptions default_stream_options();
+
+struct ChunkResidency
+{
+    u8 *data;  // cpu copy of the node, null when not in ram
+    GpuMesh gpu; // VAO == 0 when not in vram
+    u64 last_used_frame;
+    bool loading; // queued or being read by the io thread
+};
+
+struct ChunkRequest
+{
+    u32 node;
+    float priority;
+};
+
+struct ChunkLoad
+{
+    u32 node;
+    u8 *data;
+};
+
+struct ChunkStreamStats
+{
+    u32 nodes_drawn;
+    u32 nodes_in_ram;
+    u32 nodes_in_vram;
+    u32 pending_loads;
+    u64 ram_used;
+    u64 vram_used;
+};
+
+struct ChunkStreamer
+{
+    FILE *file;
+    ChunkFileHeader header;
+    std::vector<ChunkNode> nodes;
+    std::vector<ChunkResidency> residency;
+    ChunkStreamOptions options;
+
+    // requests go to the io thread and finished loads come back, under mutex
+    std::thread io_thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<ChunkRequest> requests; // sorted by priority, highest last
+    std::vector<ChunkLoad> completed;
+    bool quit;
+
+    u64 frame;
+    u64 ram_used;
+    u64 vram_used;
+
+    std::vector<u32> draw_list;
+    std::vector<ChunkRequest> wanted;
+
+    ChunkStreamStats stats;
+};
+
+s32 init(ChunkStreamer *streamer, const char *filename, const ChunkStreamOptions &options);
+
+// selects the nodes to draw for this camera, whose matrices must be up to
+// date, queues the missing ones for loading and uploads the ones that
+// arrived, must run on the GL thread
+void update(ChunkStreamer *streamer, const Camera *cam, float screen_height);
+
+void draw(ChunkStreamer *streamer);
+
+void destroy(ChunkStreamer *streamer);
@@ -0,0 +1,302 @@
+#include <float.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "convert.h"
+#include "file.h"
+#include "log.h"
+#include "profile.h"
+
+ConvertOptions default_convert_options()
+{
+    ConvertOptions options;
+    options.grid = 0;
+    options.stream = default_obj_stream_options();
+    return options;
+}
+
+struct ConvertWriter
+{
+    FILE *file;
+    std::string input_directory;
+    bool same_directory;
+
+    ObjStreamState written;
+    bool state_written;
+};
+
+local void
+write_material_library(ConvertWriter *writer, const std::string &library)
+{
+    if (writer->same_directory)
+    {
+        fprintf(writer->file, "mtllib %s\n", library.c_str());
+    }
+    else
+    {
+        fprintf(writer->file, "mtllib %s\n", canonical_path((writer->input_directory + library).c_str()).c_str());
+    }
+}
+
+// only what changed since the last face
+local void
+write_state(ConvertWriter *writer, const ObjStreamState &state)
+{
+    FILE *file = writer->file;
+    ObjStreamState *written = &writer->written;
+    bool first = !writer->state_written;
+
+    bool new_object = first || written->object_name != state.object_name;
+    if (new_object && !state.object_name.empty()) fprintf(file, "o %s\n", state.object_name.c_str());
+
+    if ((new_object || written->group_name != state.group_name) && !state.group_name.empty())
+    {
+        fprintf(file, "g %s\n", state.group_name.c_str());
+    }
+    if ((first || written->material != state.material) && !state.material.empty())
+    {
+        fprintf(file, "usemtl %s\n", state.material.c_str());
+    }
+    if (first ? state.smoothing_group != 0 : written->smoothing_group != state.smoothing_group)
+    {
+        if (state.smoothing_group) fprintf(file, "s %u\n", state.smoothing_group);
+        else fprintf(file, "s off\n");
+    }
+
+    *written = state;
+    writer->state_written = true;
+}
+
+local void
+write_corner(FILE *file, s64 v, s64 vt, s64 vn)
+{
+    if (vt >= 0 && vn >= 0) fprintf(file, " %lld/%lld/%lld", (long long)v + 1, (long long)vt + 1, (long long)vn + 1);
+    else if (vt >= 0) fprintf(file, " %lld/%lld", (long long)v + 1, (long long)vt + 1);
+    else if (vn >= 0) fprintf(file, " %lld//%lld", (long long)v + 1, (long long)vn + 1);
+    else fprintf(file, " %lld", (long long)v + 1);
+}
+
+// 15 digits give back the decimal the position was parsed from, 9 the float
+local void
+write_attributes(FILE *file, const ObjStreamBlock &block)
+{
+    for (const glm::vec2 &t : block.tex_coords) fprintf(file, "vt %.9g %.9g\n", t.x, t.y);
+    for (const glm::vec3 &n : block.normals) fprintf(file, "vn %.9g %.9g %.9g\n", n.x, n.y, n.z);
+}
+
+local s32
+finish_file(FILE *file, const char *filename)
+{
+    bool ok = !ferror(file);
+    fclose(file);
+
+    if (!ok)
+    {
+        LOG_W("Writing '%s' failed", filename);
+        return -1;
+    }
+
+    return 0;
+}
+
+// the output file is closed by the caller
+local s32
+convert_plain(ObjStream *stream, ConvertWriter *writer, const char *output_filename)
+{
+    FILE *file = writer->file;
+    u64 faces = 0;
+
+    while (read_block(stream))
+    {
+        const ObjStreamBlock &block = stream->block;
+
+        for (const std::string &library : block.material_libraries) write_material_library(writer, library);
+        for (const glm::dvec3 &p : block.positions) fprintf(file, "v %.15g %.15g %.15g\n", p.x, p.y, p.z);
+        write_attributes(file, block);
+
+        for (const ObjStreamFace &face : block.faces)
+        {
+            write_state(writer, block.states[face.state]);
+
+            fprintf(file, "f");
+            for (u32 i = 0; i < face.corner_count; ++i)
+            {
+                const ObjStreamCorner &corner = block.corners[face.first_corner + i];
+                write_corner(file, corner.v, corner.vt, corner.vn);
+            }
+            fprintf(file, "\n");
+        }
+        faces += block.faces.size();
+    }
+
+    LOG_I("Converted '%s': %llu positions, %llu faces", output_filename,
+          (unsigned long long)stream->position_count, (unsigned long long)faces);
+
+    return 0;
+}
+
+local s32
+convert_clustered(ObjStream *stream, ConvertWriter *writer, const char *input_filename,
+                  const char *output_filename, u32 grid)
+{
+    // first pass: the bounds the grid covers
+    glm::dvec3 bounds_min(DBL_MAX);
+    glm::dvec3 bounds_max(-DBL_MAX);
+    while (read_block(stream))
+    {
+        for (const glm::dvec3 &p : stream->block.positions)
+        {
+            bounds_min = glm::min(bounds_min, p);
+            bounds_max = glm::max(bounds_max, p);
+        }
+    }
+
+    destroy(stream);
+    if (stream->failed || init(stream, input_filename, stream->options) != 0) return -1;
+
+    glm::dvec3 extent = bounds_max - bounds_min;
+    double cell_size = glm::max(extent.x, glm::max(extent.y, extent.z)) / (double)grid;
+    if (!(cell_size > 0.0)) cell_size = 1.0;
+
+    // second pass: positions into clusters, everything else into a body
+    // file that goes behind the cluster positions once they are known
+    std::string body_filename = std::string(output_filename) + ".body";
+    FILE *body = fopen(body_filename.c_str(), "w+b");
+    if (!body)
+    {
+        LOG_W("Cannot open '%s' for writing", body_filename.c_str());
+        return -1;
+    }
+
+    std::unordered_map<u64, u32> clusters;
+    std::vector<glm::dvec3> cluster_sums;
+    std::vector<u32> cluster_counts;
+    std::vector<u32> position_clusters;
+    std::vector<std::string> libraries;
+    u64 faces = 0;
+    u64 triangles = 0;
+
+    FILE *output = writer->file;
+    writer->file = body;
+
+    while (read_block(stream))
+    {
+        const ObjStreamBlock &block = stream->block;
+
+        for (const std::string &library : block.material_libraries) libraries.push_back(library);
+
+        for (const glm::dvec3 &p : block.positions)
+        {
+            glm::dvec3 q = glm::clamp(glm::floor((p - bounds_min) / cell_size), glm::dvec3(0.0), glm::dvec3(grid - 1));
+            u64 key = (u64)q.x | ((u64)q.y << 21) | ((u64)q.z << 42);
+
+            auto it = clusters.find(key);
+            if (it == clusters.end())
+            {
+                it = clusters.emplace(key, (u32)cluster_sums.size()).first;
+                cluster_sums.push_back(glm::dvec3(0.0));
+                cluster_counts.push_back(0);
+            }
+
+            cluster_sums[it->second] += p;
+            ++cluster_counts[it->second];
+            position_clusters.push_back(it->second);
+        }
+
+        write_attributes(body, block);
+
+        // fans, the triangles that kept three distinct clusters
+        for (const ObjStreamFace &face : block.faces)
+        {
+            const ObjStreamCorner *corners = &block.corners[face.first_corner];
+            for (u32 i = 2; i < face.corner_count; ++i)
+            {
+                const ObjStreamCorner *triangle[3] = { &corners[0], &corners[i - 1], &corners[i] };
+                u32 a = position_clusters[(size_t)triangle[0]->v];
+                u32 b = position_clusters[(size_t)triangle[1]->v];
+                u32 c = position_clusters[(size_t)triangle[2]->v];
+                if (a == b || b == c || a == c) continue;
+
+                write_state(writer, block.states[face.state]);
+
+                fprintf(body, "f");
+                write_corner(body, a, triangle[0]->vt, triangle[0]->vn);
+                write_corner(body, b, triangle[1]->vt, triangle[1]->vn);
+                write_corner(body, c, triangle[2]->vt, triangle[2]->vn);
+                fprintf(body, "\n");
+                ++triangles;
+            }
+        }
+        faces += block.faces.size();
+    }
+
+    writer->file = output;
+
+    for (const std::string &library : libraries) write_material_library(writer, library);
+    for (size_t i = 0; i < cluster_sums.size(); ++i)
+    {
+        glm::dvec3 p = cluster_sums[i] / (double)cluster_counts[i];
+        fprintf(output, "v %.15g %.15g %.15g\n", p.x, p.y, p.z);
+    }
+
+    std::vector<char> copy(1 << 20);
+    rewind(body);
+    for (;;)
+    {
+        size_t read = fread(copy.data(), 1, copy.size(), body);
+        if (read == 0) break;
+        fwrite(copy.data(), 1, read, output);
+    }
+
+    bool body_ok = !ferror(body);
+    fclose(body);
+    remove(body_filename.c_str());
+
+    LOG_I("Converted '%s' on a %u grid: %llu positions to %u, %llu faces to %llu triangles", output_filename, grid,
+          (unsigned long long)stream->position_count, (u32)cluster_sums.size(),
+          (unsigned long long)faces, (unsigned long long)triangles);
+
+    if (!body_ok)
+    {
+        LOG_W("Writing '%s' failed", body_filename.c_str());
+        return -1;
+    }
+
+    return 0;
+}
+
+s32 convert_obj(const char *input_filename, const char *output_filename, const ConvertOptions &options)
+{
+    PROFILE_SCOPE("convert obj");
+
+    ObjStream stream;
+    if (init(&stream, input_filename, options.stream) != 0) return -1;
+
+    ConvertWriter writer;
+    writer.file = fopen(output_filename, "wb");
+    if (!writer.file)
+    {
+        LOG_W("Cannot open '%s' for writing", output_filename);
+        destroy(&stream);
+        return -1;
+    }
+
+    writer.input_directory = directory_of(input_filename);
+    std::string output_directory = directory_of(output_filename);
+    writer.same_directory = canonical_path(writer.input_directory.empty() ? "." : writer.input_directory.c_str()) ==
+                            canonical_path(output_directory.empty() ? "." : output_directory.c_str());
+    writer.written = ObjStreamState{};
+    writer.state_written = false;
+
+    s32 result = options.grid
+        ? convert_clustered(&stream, &writer, input_filename, output_filename, glm::clamp(options.grid, 1u, 1u << 20))
+        : convert_plain(&stream, &writer, output_filename);
+
+    if (finish_file(writer.file, output_filename) != 0 || stream.failed) result = -1;
+    destroy(&stream);
+
+    return result;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "types.h"
+#include "objstream.h"
+
+// Headless OBJ to OBJ conversion for batch nodes, on the streaming reader
+// so memory does not grow with the file:
+//
+//   ObjViewer --convert in.obj out.obj [--grid n] [--block n]
+//
+// Without a grid the output is the same model in plain OBJ: continuations
+// joined, indices absolute, names and materials kept. With a grid it is a
+// LOD: positions cluster on a grid of n cells along the longest side of the
+// bounds, like the inner nodes of a chunk bake, and faces that collapse
+// inside a cell are dropped. That takes two passes over the input and
+// 4 bytes per input position on top of the clusters.
+//
+// Material libraries stay as written when the output sits next to the
+// input, otherwise they get absolute paths.
+
+struct ConvertOptions
+{
+    u32 grid; // 0 keeps every vertex
+    ObjStreamOptions stream;
+};
+
+ConvertOptions default_convert_options();
+
+s32 convert_obj(const char *input_filename, const char *output_filename, const ConvertOptions &options);
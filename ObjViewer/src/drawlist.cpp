@@ -0,0 +1,218 @@
+#include <string.h>
+#include <algorithm>
+
+#include "drawlist.h"
+#include "camera.h"
+#include "texcache.h"
+#include "jobs.h"
+#include "profile.h"
+
+#define DRAW_RECORD_BATCH 256
+
+// draws sharing a texture go together: the atlas array stays bound for all
+// of its materials, the default texture goes last
+#define DRAW_KEY_ATLAS 0u
+#define DRAW_KEY_DEFAULT_TEXTURE 0xFFFFFFFFu
+
+local u64
+make_sort_key(u32 texture_key, float distance2)
+{
+    // non negative floats order the same as their bits
+    u32 depth;
+    memcpy(&depth, &distance2, sizeof(depth));
+    return ((u64)texture_key << 32) | depth;
+}
+
+local void
+record_frame(FramePipeline *pipeline, FrameData *frame)
+{
+    PROFILE_SCOPE("record draws");
+
+    const DrawSources &sources = pipeline->sources;
+    const SceneGraph *scene = sources.scene;
+    const Mesh *mesh = sources.mesh;
+    OcclusionCuller *occlusion = sources.occlusion;
+
+    frame->visible_nodes.clear();
+    cull_scene(scene, &frame->frustum, &frame->visible_nodes);
+
+    u32 mesh_nodes = 0;
+    u64 scene_triangles = 0;
+    for (u32 node = 0; node < scene->count; ++node)
+    {
+        if (scene->mesh[node] == SCENE_NO_MESH) continue;
+        ++mesh_nodes;
+        scene_triangles += mesh->groups[scene->mesh[node]].index_count / 3;
+    }
+    u32 frustum_visible = (u32)frame->visible_nodes.size();
+
+    if (frame->occlusion_culling)
+    {
+        occlusion->options.reproject = frame->occlusion_reprojection;
+        begin_frame(occlusion, frame->view_projection);
+
+        select_occluders(occlusion, scene, frame->visible_nodes, &pipeline->occluder_nodes);
+        for (u32 node : pipeline->occluder_nodes)
+        {
+            const MeshGroup &group = mesh->groups[scene->mesh[node]];
+            add_occluder(occlusion, mesh->vertices.data(),
+                         mesh->indices.data() + group.first_index, group.index_count,
+                         scene->world[node]);
+        }
+
+        end_occluders(occlusion);
+        cull_occluded(occlusion, scene, &frame->visible_nodes);
+    }
+    else
+    {
+        occlusion->stats = {};
+    }
+
+    u32 count = (u32)frame->visible_nodes.size();
+    frame->commands.resize(count);
+
+    frame->nodes_frustum_culled = mesh_nodes - frustum_visible;
+    frame->nodes_occlusion_culled = frustum_visible - count;
+    frame->triangles_culled = scene_triangles;
+
+    const std::vector<u32> &visible = frame->visible_nodes;
+    parallel_for(count, DRAW_RECORD_BATCH, [&](u32 begin, u32 end, u32) {
+        for (u32 i = begin; i < end; ++i)
+        {
+            u32 node = visible[i];
+            const MeshGroup &group = mesh->groups[scene->mesh[node]];
+
+            DrawCommand *command = &frame->commands[i];
+            command->model = camera_relative_model(scene->world[node], scene->origin, frame->camera_world_position);
+            command->material = group.material;
+            command->first_index = group.first_index;
+            command->index_count = group.index_count;
+            command->atlas_layer = -1;
+            command->atlas_rect = glm::vec4(0.0f);
+
+            u32 texture_key = DRAW_KEY_DEFAULT_TEXTURE;
+            if (group.material != MESH_NO_MATERIAL)
+            {
+                const TextureAtlasEntry &entry = sources.atlas->entries[group.material];
+                if (entry.layer != TEXTURE_ATLAS_NO_LAYER)
+                {
+                    command->atlas_layer = (s32)entry.layer;
+                    command->atlas_rect = entry.rect;
+                    texture_key = DRAW_KEY_ATLAS;
+                }
+                else if ((*sources.material_textures)[group.material] != TEXTURE_NO_HANDLE)
+                {
+                    texture_key = group.material + 1;
+                }
+            }
+
+            glm::vec3 center = (scene->bounds_min[node] + scene->bounds_max[node]) * 0.5f;
+            glm::vec3 to_center = center - frame->camera_position;
+            command->sort_key = make_sort_key(texture_key, glm::dot(to_center, to_center));
+        }
+    });
+
+    for (const DrawCommand &command : frame->commands) frame->triangles_culled -= command.index_count / 3;
+
+    std::sort(frame->commands.begin(), frame->commands.end(),
+              [](const DrawCommand &a, const DrawCommand &b) { return a.sort_key < b.sort_key; });
+
+    frame->recorded = true;
+}
+
+local void
+recorder_proc(FramePipeline *pipeline)
+{
+    set_profile_thread_name("draw recorder");
+
+    std::unique_lock<std::mutex> lock(pipeline->mutex);
+    for (;;)
+    {
+        pipeline->wake.wait(lock, [pipeline] { return pipeline->quit || pipeline->recording; });
+        if (pipeline->quit) return;
+
+        FrameData *frame = &pipeline->frames[pipeline->current];
+
+        lock.unlock();
+        record_frame(pipeline, frame);
+        lock.lock();
+
+        pipeline->recording = false;
+        pipeline->done.notify_one();
+    }
+}
+
+void init(FramePipeline *pipeline)
+{
+    for (u32 i = 0; i < 2; ++i)
+    {
+        pipeline->frames[i].visible_nodes.clear();
+        pipeline->frames[i].commands.clear();
+        pipeline->frames[i].recorded = false;
+    }
+    pipeline->current = 0;
+    pipeline->sources = {};
+    pipeline->recording = false;
+    pipeline->quit = false;
+
+    pipeline->thread = std::thread(recorder_proc, pipeline);
+}
+
+void destroy(FramePipeline *pipeline)
+{
+    {
+        std::lock_guard<std::mutex> lock(pipeline->mutex);
+        pipeline->quit = true;
+    }
+    pipeline->wake.notify_one();
+
+    if (pipeline->thread.joinable()) pipeline->thread.join();
+}
+
+FrameData *next_frame(FramePipeline *pipeline)
+{
+    finish_recording(pipeline);
+
+    pipeline->current ^= 1;
+    FrameData *frame = &pipeline->frames[pipeline->current];
+    frame->recorded = false;
+    return frame;
+}
+
+void begin_recording(FramePipeline *pipeline, const DrawSources &sources)
+{
+    {
+        std::lock_guard<std::mutex> lock(pipeline->mutex);
+        pipeline->sources = sources;
+        pipeline->recording = true;
+    }
+    pipeline->wake.notify_one();
+}
+
+const FrameData *finish_recording(FramePipeline *pipeline)
+{
+    PROFILE_SCOPE("wait for draws");
+
+    std::unique_lock<std::mutex> lock(pipeline->mutex);
+    pipeline->done.wait(lock, [pipeline] { return !pipeline->recording; });
+
+    return &pipeline->frames[pipeline->current];
+}
+
+const FrameData *previous_frame(const FramePipeline *pipeline)
+{
+    const FrameData *frame = &pipeline->frames[pipeline->current ^ 1];
+    return frame->recorded ? frame : nullptr;
+}
+
+void reset(FramePipeline *pipeline)
+{
+    finish_recording(pipeline);
+
+    for (u32 i = 0; i < 2; ++i)
+    {
+        pipeline->frames[i].commands.clear();
+        pipeline->frames[i].visible_nodes.clear();
+        pipeline->frames[i].recorded = false;
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <glm/glm.hpp>
+
+#include "types.h"
+#include "mesh.h"
+#include "scene.h"
+#include "occlusion.h"
+#include "atlas.h"
+#include "frustum.h"
+
+// Draw preparation on a recording thread, GL calls on the main thread.
+//
+// Everything a draw needs that is not a GL call is worked out ahead:
+// frustum and occlusion culling, the model matrix and atlas uniforms of
+// every visible node packed next to its index range, and the order, sorted
+// by texture and then front to back. The packing is spread over the job
+// workers. The main thread only walks the finished list and issues it.
+//
+// Frame data is double buffered: while the recorder fills one slot from the
+// scene, the main thread does this frame's uploads and draws the previous
+// slot's list, into the VT feedback target and the main pass, with the view
+// it was culled for. What is on screen is a frame behind, in exchange the
+// two threads never wait on each other. The scene, mesh, occlusion culler
+// and atlas given as sources must not change between begin_recording and
+// finish_recording.
+
+struct DrawCommand
+{
+    u64 sort_key;
+    glm::mat4 model; // from camera_relative_model, for the camera relative view
+    glm::vec4 atlas_rect;
+    s32 atlas_layer; // -1 when the material is not in the atlas
+    u32 material;    // MESH_NO_MATERIAL or a material without a texture of its own draws the default one
+    u32 first_index;
+    u32 index_count;
+};
+
+struct FrameData
+{
+    // filled by the caller before recording
+    glm::mat4 view;            // the camera relative one
+    glm::mat4 projection;      // without the refinement jitter, added when the list is drawn
+    glm::mat4 view_projection; // without the refinement jitter, for culling
+    Frustum frustum;
+    glm::vec3 camera_position; // in the scene's world space, for the draw order
+    glm::dvec3 camera_world_position;
+    bool occlusion_culling;
+    bool occlusion_reprojection;
+
+    // filled by the recorder
+    std::vector<u32> visible_nodes;
+    std::vector<DrawCommand> commands;
+    bool recorded;
+
+    // what culling took away, for the stats
+    u32 nodes_frustum_culled;
+    u32 nodes_occlusion_culled;
+    u64 triangles_culled;
+};
+
+struct DrawSources
+{
+    const SceneGraph *scene;
+    const Mesh *mesh; // scene nodes index its groups
+    OcclusionCuller *occlusion;
+    const TextureAtlas *atlas;
+    const std::vector<u32> *material_textures; // TEXTURE_NO_HANDLE for materials without one
+};
+
+struct FramePipeline
+{
+    FrameData frames[2];
+    u32 current; // slot of the frame being recorded or last recorded
+
+    DrawSources sources;
+    std::vector<u32> occluder_nodes;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool recording;
+    bool quit;
+};
+
+void init(FramePipeline *pipeline);
+
+void destroy(FramePipeline *pipeline);
+
+// switches to the other slot and returns it for the caller to fill in
+FrameData *next_frame(FramePipeline *pipeline);
+
+void begin_recording(FramePipeline *pipeline, const DrawSources &sources);
+
+// waits for the recorder, the list of the current slot is complete after this
+const FrameData *finish_recording(FramePipeline *pipeline);
+
+// the slot recorded before the current one, nullptr when it has no list
+const FrameData *previous_frame(const FramePipeline *pipeline);
+
+// drops both lists, for when the mesh they index is replaced
+void reset(FramePipeline *pipeline);
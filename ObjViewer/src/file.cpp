@@ -0,0 +1,196 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "file.h"
+#include "log.h"
+
+FileContent read_entire_file_in_memory_and_zero_terminate(const char *filename, bool zero_terminate)
+{
+    FileContent fc = {0};
+
+    FILE *file = fopen(filename, "rb");
+
+    if (file)
+    {
+        fseek(file, 0, SEEK_END);
+        fc.size = tell_file(file);
+        rewind(file);
+
+        if (zero_terminate)
+        {
+            ++fc.size;
+        }
+
+        fc.data = calloc(1, fc.size + (zero_terminate ? FILE_PADDING : 0));
+
+        fread(fc.data, 1, fc.size, file);
+
+        fclose(file);
+    }
+    else
+    {
+        LOG_E("Cannot open '%s' for reading", filename);
+    }
+
+    return fc;
+}
+
+void delete_file_content(FileContent *fc)
+{
+    if (fc &&
+        fc->data)
+    {
+        free(fc->data);
+        fc->data = nullptr;
+
+        fc->size = 0;
+    }
+}
+
+s32 seek_file(FILE *file, u64 offset)
+{
+#ifdef _WIN32
+    return _fseeki64(file, (s64)offset, SEEK_SET);
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+u64 tell_file(FILE *file)
+{
+#ifdef _WIN32
+    return (u64)_ftelli64(file);
+#else
+    return (u64)ftello(file);
+#endif
+}
+
+bool has_extension(const char *filename, const char *extension)
+{
+    size_t filename_len = strlen(filename);
+    size_t extension_len = strlen(extension);
+
+    if (filename_len < extension_len) return false;
+
+    const char *tail = filename + filename_len - extension_len;
+    for (size_t i = 0; i < extension_len; ++i)
+    {
+        if (tolower((u8)tail[i]) != tolower((u8)extension[i])) return false;
+    }
+
+    return true;
+}
+
+std::string canonical_path(const char *filename)
+{
+#ifdef _WIN32
+    char full[_MAX_PATH];
+    std::string path = _fullpath(full, filename, _MAX_PATH) ? full : filename;
+#else
+    char *full = realpath(filename, nullptr);
+    std::string path = full ? full : filename;
+    free(full);
+#endif
+
+    for (char &c : path)
+    {
+        if (c == '\\') c = '/';
+#ifdef _WIN32
+        c = (char)tolower((u8)c);
+#endif
+    }
+
+    return path;
+}
+
+std::string directory_of(const char *filename)
+{
+    const char *slash = nullptr;
+    for (const char *at = filename; *at; ++at)
+    {
+        if (*at == '/' || *at == '\\') slash = at;
+    }
+
+    return slash ? std::string(filename, slash + 1) : std::string();
+}
+
+s32 map_file(MappedFile *file, const char *filename)
+{
+    *file = {};
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) return -1;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(handle);
+        return -1;
+    }
+
+    HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view)
+    {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(handle);
+        return -1;
+    }
+
+    file->data = (const u8 *)view;
+    file->size = (u64)size.QuadPart;
+    file->file_handle = handle;
+    file->mapping_handle = mapping;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    void *view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED)
+    {
+        close(fd);
+        return -1;
+    }
+
+    file->data = (const u8 *)view;
+    file->size = (u64)info.st_size;
+    file->fd = fd;
+#endif
+
+    return 0;
+}
+
+void unmap_file(MappedFile *file)
+{
+    if (!file->data) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(file->data);
+    CloseHandle(file->mapping_handle);
+    CloseHandle(file->file_handle);
+#else
+    munmap((void *)file->data, (size_t)file->size);
+    close(file->fd);
+#endif
+
+    *file = {};
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <string>
+
+#include "types.h"
+
+struct FileContent
+{
+    void *data;
+    u64 size;
+};
+
+// zero terminated content is followed by FILE_PADDING more zero bytes, so
+// parsers can read a vector at a time up to the end
+#define FILE_PADDING 16
+
+FileContent read_entire_file_in_memory_and_zero_terminate(const char *filename, bool zero_terminate);
+
+void delete_file_content(FileContent *fc);
+
+// 64 bit safe seek/tell, ftell/fseek are 32 bit on windows
+s32 seek_file(FILE *file, u64 offset);
+u64 tell_file(FILE *file);
+
+bool has_extension(const char *filename, const char *extension);
+
+// absolute path with '/' separators (lower case on windows) so different
+// spellings of one file compare equal; filename as is when it does not exist
+std::string canonical_path(const char *filename);
+
+// the directory of filename with its separator, empty for a bare name
+std::string directory_of(const char *filename);
+
+// read only view of a whole file, pages are read from disk on first touch
+struct MappedFile
+{
+    const u8 *data;
+    u64 size;
+
+#ifdef _WIN32
+    void *file_handle;
+    void *mapping_handle;
+#else
+    int fd;
+#endif
+};
+
+// fails quietly, the caller decides how loud to be
+s32 map_file(MappedFile *file, const char *filename);
+
+void unmap_file(MappedFile *file);
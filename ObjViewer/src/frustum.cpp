@@ -0,0 +1,52 @@
+#include "frustum.h"
+
+Frustum make_frustum(const glm::mat4 &view_projection)
+{
+    // Gribb/Hartmann plane extraction, glm is column major so row i is m[.][i]
+    glm::vec4 row0(view_projection[0][0], view_projection[1][0], view_projection[2][0], view_projection[3][0]);
+    glm::vec4 row1(view_projection[0][1], view_projection[1][1], view_projection[2][1], view_projection[3][1]);
+    glm::vec4 row2(view_projection[0][2], view_projection[1][2], view_projection[2][2], view_projection[3][2]);
+    glm::vec4 row3(view_projection[0][3], view_projection[1][3], view_projection[2][3], view_projection[3][3]);
+
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0; // left
+    frustum.planes[1] = row3 - row0; // right
+    frustum.planes[2] = row3 + row1; // bottom
+    frustum.planes[3] = row3 - row1; // top
+    frustum.planes[4] = row3 + row2; // near
+    frustum.planes[5] = row3 - row2; // far
+
+    for (u32 i = 0; i < 6; ++i)
+    {
+        float length = glm::length(glm::vec3(frustum.planes[i]));
+        if (length > 0.0f) frustum.planes[i] /= length;
+    }
+
+    return frustum;
+}
+
+bool intersects(const Frustum *frustum, const glm::vec3 &bounds_min, const glm::vec3 &bounds_max)
+{
+    for (u32 i = 0; i < 6; ++i)
+    {
+        const glm::vec4 &plane = frustum->planes[i];
+
+        // the box corner furthest along the plane normal
+        glm::vec3 p(plane.x >= 0.0f ? bounds_max.x : bounds_min.x,
+                    plane.y >= 0.0f ? bounds_max.y : bounds_min.y,
+                    plane.z >= 0.0f ? bounds_max.z : bounds_min.z);
+
+        if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+float distance_to_bounds(const glm::vec3 &point, const glm::vec3 &bounds_min, const glm::vec3 &bounds_max)
+{
+    glm::vec3 closest = glm::clamp(point, bounds_min, bounds_max);
+    return glm::length(point - closest);
+}
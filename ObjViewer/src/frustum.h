@@ -0,0 +1,17 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "types.h"
+
+// planes are stored as (normal, distance), pointing inside the frustum
+struct Frustum
+{
+    glm::vec4 planes[6];
+};
+
+Frustum make_frustum(const glm::mat4 &view_projection);
+
+bool intersects(const Frustum *frustum, const glm::vec3 &bounds_min, const glm::vec3 &bounds_max);
+
+float distance_to_bounds(const glm::vec3 &point, const glm::vec3 &bounds_min, const glm::vec3 &bounds_max);
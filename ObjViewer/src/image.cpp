@@ -0,0 +1,1103 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include <vector>
+
+#include <emmintrin.h>
+
+#include <glm/glm.hpp>
+
+#include "stb_image.h"
+
+#include "image.h"
+#include "file.h"
+#include "jobs.h"
+#include "profile.h"
+
+// below this a JPEG is decoded on the calling thread, the strips would not
+// pay for their overlap and the hand off
+#define JPEG_MIN_THREADED_PIXELS (512 * 512)
+
+local thread_local const char *failure_reason = "";
+
+//
+// INFLATE
+//
+
+// Huffman codes are looked up LSB first, as the bits arrive, in a table
+// indexed by the next PRIMARY_BITS bits; longer codes continue in a subtable.
+// An entry is value << 16 | flags << 8 | bits to consume, where the value is
+// a literal, a length or distance base or a subtable offset. Zero entries
+// are codes the stream never defined.
+#define INFLATE_LITERAL  0x20
+#define INFLATE_END      0x40
+#define INFLATE_SUBTABLE 0x80
+#define INFLATE_EXTRA    0x1F // extra bits of a length or distance, or subtable bits
+
+#define LITLEN_PRIMARY_BITS 10
+#define DIST_PRIMARY_BITS   8
+#define CODE_LENGTH_BITS    7
+
+// room for a primary table and a subtable per symbol in the worst case
+#define LITLEN_TABLE_SIZE ((1 << LITLEN_PRIMARY_BITS) + 288 * (1 << (15 - LITLEN_PRIMARY_BITS)))
+#define DIST_TABLE_SIZE   ((1 << DIST_PRIMARY_BITS) + 32 * (1 << (15 - DIST_PRIMARY_BITS)))
+
+local const u16 length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+local const u8 length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+local const u16 dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+local const u8 dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+enum HuffmanKind
+{
+    HUFFMAN_LITLEN,
+    HUFFMAN_DIST,
+    HUFFMAN_CODE_LENGTH,
+};
+
+local u32
+huffman_entry(HuffmanKind kind, u32 symbol, u32 code_length)
+{
+    switch (kind)
+    {
+        case HUFFMAN_LITLEN:
+            if (symbol < 256) return symbol << 16 | INFLATE_LITERAL << 8 | code_length;
+            if (symbol == 256) return INFLATE_END << 8 | code_length;
+            if (symbol < 286) return (u32)length_base[symbol - 257] << 16 | length_extra[symbol - 257] << 8 | code_length;
+            return 0;
+
+        case HUFFMAN_DIST:
+            if (symbol < 30) return (u32)dist_base[symbol] << 16 | dist_extra[symbol] << 8 | code_length;
+            return 0;
+
+        case HUFFMAN_CODE_LENGTH:
+            return symbol << 16 | code_length;
+    }
+    return 0;
+}
+
+local inline u32
+reverse_bits(u32 code, u32 length)
+{
+    u32 reversed = 0;
+    for (u32 i = 0; i < length; ++i, code >>= 1) reversed = (reversed << 1) | (code & 1);
+    return reversed;
+}
+
+// false for over subscribed code lengths; incomplete codes are allowed, a
+// single distance code is common
+local bool
+build_huffman(u32 *table, u32 primary_bits, HuffmanKind kind, const u8 *lengths, u32 count)
+{
+    u32 length_count[16] = {};
+    u32 max_length = 0;
+    for (u32 i = 0; i < count; ++i)
+    {
+        ++length_count[lengths[i]];
+        max_length = glm::max(max_length, (u32)lengths[i]);
+    }
+    length_count[0] = 0;
+
+    s32 left = 1;
+    u32 next_code[16];
+    u32 code = 0;
+    for (u32 length = 1; length <= 15; ++length)
+    {
+        left = (left << 1) - (s32)length_count[length];
+        if (left < 0) return false;
+
+        code = (code + length_count[length - 1]) << 1;
+        next_code[length] = code;
+    }
+
+    memset(table, 0, sizeof(u32) << primary_bits);
+
+    u32 sub_bits = max_length > primary_bits ? max_length - primary_bits : 0;
+    u32 next_subtable = 1 << primary_bits;
+
+    for (u32 symbol = 0; symbol < count; ++symbol)
+    {
+        u32 length = lengths[symbol];
+        if (length == 0) continue;
+
+        u32 reversed = reverse_bits(next_code[length]++, length);
+        u32 entry = huffman_entry(kind, symbol, length);
+
+        if (length <= primary_bits)
+        {
+            for (u32 i = reversed; i < (1u << primary_bits); i += 1 << length) table[i] = entry;
+            continue;
+        }
+
+        u32 *pointer = &table[reversed & ((1 << primary_bits) - 1)];
+        if (!*pointer)
+        {
+            *pointer = next_subtable << 16 | (INFLATE_SUBTABLE | sub_bits) << 8 | primary_bits;
+            memset(table + next_subtable, 0, sizeof(u32) << sub_bits);
+            next_subtable += 1 << sub_bits;
+        }
+
+        u32 *subtable = table + (*pointer >> 16);
+        u32 sub_length = length - primary_bits;
+        entry = (entry & ~0xFFu) | sub_length;
+        for (u32 i = reversed >> primary_bits; i < (1u << sub_bits); i += 1 << sub_length) subtable[i] = entry;
+    }
+
+    return true;
+}
+
+struct BitReader
+{
+    const u8 *in;
+    const u8 *in_end;
+    u64 bits;
+    s32 bit_count; // below zero once the stream ran out
+};
+
+// at least 56 bits in the buffer until the last 8 bytes of the stream, the
+// bytes above bit_count are loaded again by the next refill
+local inline void
+refill(BitReader *reader)
+{
+    if (reader->in_end - reader->in >= 8)
+    {
+        u64 next;
+        memcpy(&next, reader->in, 8);
+        reader->bits |= next << reader->bit_count;
+        reader->in += (63 - reader->bit_count) >> 3;
+        reader->bit_count |= 56;
+        return;
+    }
+
+    while (reader->bit_count <= 56 && reader->in < reader->in_end)
+    {
+        reader->bits |= (u64)*reader->in++ << reader->bit_count;
+        reader->bit_count += 8;
+    }
+}
+
+local inline u32
+take_bits(BitReader *reader, u32 count)
+{
+    u32 value = (u32)(reader->bits & ((1ull << count) - 1));
+    reader->bits >>= count;
+    reader->bit_count -= count;
+    return value;
+}
+
+local inline u32
+decode_symbol(BitReader *reader, const u32 *table, u32 primary_bits)
+{
+    u32 entry = table[reader->bits & ((1 << primary_bits) - 1)];
+    if (entry & (INFLATE_SUBTABLE << 8))
+    {
+        u32 sub_bits = (entry >> 8) & INFLATE_EXTRA;
+        take_bits(reader, entry & 0xFF);
+        entry = table[(entry >> 16) + (reader->bits & ((1 << sub_bits) - 1))];
+    }
+    take_bits(reader, entry & 0xFF);
+    return entry;
+}
+
+local bool
+read_dynamic_tables(BitReader *reader, u32 *litlen_table, u32 *dist_table)
+{
+    refill(reader);
+    u32 litlen_count = take_bits(reader, 5) + 257;
+    u32 dist_count = take_bits(reader, 5) + 1;
+    u32 code_length_count = take_bits(reader, 4) + 4;
+
+    static const u8 order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    u8 code_length_lengths[19] = {};
+    for (u32 i = 0; i < code_length_count; ++i)
+    {
+        refill(reader);
+        code_length_lengths[order[i]] = (u8)take_bits(reader, 3);
+    }
+
+    u32 code_length_table[1 << CODE_LENGTH_BITS];
+    if (!build_huffman(code_length_table, CODE_LENGTH_BITS, HUFFMAN_CODE_LENGTH, code_length_lengths, 19)) return false;
+
+    u8 lengths[288 + 32];
+    u32 total = litlen_count + dist_count;
+    for (u32 i = 0; i < total;)
+    {
+        refill(reader);
+        u32 entry = decode_symbol(reader, code_length_table, CODE_LENGTH_BITS);
+        if ((entry & 0xFF) == 0) return false;
+
+        u32 symbol = entry >> 16;
+        if (symbol < 16)
+        {
+            lengths[i++] = (u8)symbol;
+            continue;
+        }
+
+        u8 value = 0;
+        u32 repeat;
+        if (symbol == 16)
+        {
+            if (i == 0) return false;
+            value = lengths[i - 1];
+            repeat = 3 + take_bits(reader, 2);
+        }
+        else if (symbol == 17)
+        {
+            repeat = 3 + take_bits(reader, 3);
+        }
+        else
+        {
+            repeat = 11 + take_bits(reader, 7);
+        }
+
+        if (i + repeat > total) return false;
+        memset(lengths + i, value, repeat);
+        i += repeat;
+    }
+
+    if (lengths[256] == 0 || reader->bit_count < 0) return false;
+
+    return build_huffman(litlen_table, LITLEN_PRIMARY_BITS, HUFFMAN_LITLEN, lengths, litlen_count) &&
+           build_huffman(dist_table, DIST_PRIMARY_BITS, HUFFMAN_DIST, lengths + litlen_count, dist_count);
+}
+
+local void
+build_fixed_tables(u32 *litlen_table, u32 *dist_table)
+{
+    u8 lengths[288 + 32];
+    memset(lengths, 8, 144);
+    memset(lengths + 144, 9, 112);
+    memset(lengths + 256, 7, 24);
+    memset(lengths + 280, 8, 8);
+    memset(lengths + 288, 5, 32);
+
+    build_huffman(litlen_table, LITLEN_PRIMARY_BITS, HUFFMAN_LITLEN, lengths, 288);
+    build_huffman(dist_table, DIST_PRIMARY_BITS, HUFFMAN_DIST, lengths + 288, 32);
+}
+
+// a match copy may write this far past its end while there is room
+#define INFLATE_COPY_SLACK 8
+
+// table driven, one refill per literal or length and distance pair, and 8
+// byte match copies; the output size is known up front so it never grows
+local bool
+inflate_fast(const u8 *in, u64 in_size, u8 *out, u64 out_size)
+{
+    // zlib header: deflate, no preset dictionary; the adler32 is not checked
+    if (in_size < 2 || (in[0] & 0x0F) != 8 || ((u32)in[0] << 8 | in[1]) % 31 != 0 || (in[1] & 0x20)) return false;
+
+    std::vector<u32> tables(LITLEN_TABLE_SIZE + DIST_TABLE_SIZE);
+    u32 *litlen_table = tables.data();
+    u32 *dist_table = tables.data() + LITLEN_TABLE_SIZE;
+
+    BitReader reader = { in + 2, in + in_size, 0, 0 };
+    u8 *out_begin = out;
+    u8 *out_end = out + out_size;
+
+    for (;;)
+    {
+        refill(&reader);
+        u32 final_block = take_bits(&reader, 1);
+        u32 type = take_bits(&reader, 2);
+        if (reader.bit_count < 0) return false;
+
+        if (type == 0)
+        {
+            // stored: give back the whole bytes still in the bit buffer
+            take_bits(&reader, reader.bit_count & 7);
+            reader.in -= reader.bit_count >> 3;
+            reader.bits = 0;
+            reader.bit_count = 0;
+
+            if (reader.in_end - reader.in < 4) return false;
+            u32 length = reader.in[0] | (u32)reader.in[1] << 8;
+            u32 inverse = reader.in[2] | (u32)reader.in[3] << 8;
+            reader.in += 4;
+            if ((length ^ 0xFFFF) != inverse) return false;
+            if ((u64)(reader.in_end - reader.in) < length || (u64)(out_end - out) < length) return false;
+
+            memcpy(out, reader.in, length);
+            reader.in += length;
+            out += length;
+        }
+        else
+        {
+            if (type == 1)
+            {
+                build_fixed_tables(litlen_table, dist_table);
+            }
+            else if (type != 2 || !read_dynamic_tables(&reader, litlen_table, dist_table))
+            {
+                return false;
+            }
+
+            for (;;)
+            {
+                refill(&reader);
+                if (reader.bit_count < 0) return false;
+
+                u32 entry = decode_symbol(&reader, litlen_table, LITLEN_PRIMARY_BITS);
+                u32 flags = entry >> 8;
+
+                if (flags & INFLATE_LITERAL)
+                {
+                    if (out == out_end) return false;
+                    *out++ = (u8)(entry >> 16);
+                    continue;
+                }
+                if (flags & INFLATE_END) break;
+
+                u32 length = (entry >> 16) + take_bits(&reader, flags & INFLATE_EXTRA);
+                if (length < 3) return false;
+
+                entry = decode_symbol(&reader, dist_table, DIST_PRIMARY_BITS);
+                u32 distance = (entry >> 16) + take_bits(&reader, (entry >> 8) & INFLATE_EXTRA);
+                if ((entry >> 16) == 0) return false;
+
+                if (distance > (u64)(out - out_begin) || length > (u64)(out_end - out)) return false;
+
+                const u8 *from = out - distance;
+                if (distance >= 8 && (u64)(out_end - out) >= length + INFLATE_COPY_SLACK)
+                {
+                    u8 *end = out + length;
+                    do
+                    {
+                        memcpy(out, from, 8);
+                        out += 8;
+                        from += 8;
+                    }
+                    while (out < end);
+                    out = end;
+                }
+                else if (distance == 1)
+                {
+                    memset(out, *from, length);
+                    out += length;
+                }
+                else
+                {
+                    for (u32 i = 0; i < length; ++i) out[i] = from[i];
+                    out += length;
+                }
+            }
+        }
+
+        if (reader.bit_count < 0) return false;
+        if (final_block) break;
+    }
+
+    return out == out_end;
+}
+
+local ImageInflateFunction image_inflate = inflate_fast;
+
+ImageDecodeOptions default_image_decode_options()
+{
+    ImageDecodeOptions options;
+    options.fast_png = true;
+    options.threaded_jpeg = true;
+    return options;
+}
+
+void set_image_inflate(ImageInflateFunction inflate)
+{
+    image_inflate = inflate ? inflate : inflate_fast;
+}
+
+const char *image_failure_reason()
+{
+    return failure_reason;
+}
+
+void destroy(Image *image)
+{
+    // stb_image allocates with malloc too
+    free(image->pixels);
+    image->pixels = nullptr;
+}
+
+local inline u32
+read_u16_be(const u8 *p)
+{
+    return ((u32)p[0] << 8) | p[1];
+}
+
+local inline u32
+read_u32_be(const u8 *p)
+{
+    return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | p[3];
+}
+
+local void
+flip_rows(u8 *pixels, u32 height, u64 row_size)
+{
+    std::vector<u8> temp(row_size);
+    for (u32 y = 0; y < height / 2; ++y)
+    {
+        u8 *top = pixels + y * row_size;
+        u8 *bottom = pixels + (height - 1 - y) * row_size;
+        memcpy(temp.data(), top, row_size);
+        memcpy(top, bottom, row_size);
+        memcpy(bottom, temp.data(), row_size);
+    }
+}
+
+local inline u8
+luminance(const u8 *rgb)
+{
+    return (u8)((rgb[0] * 77 + rgb[1] * 150 + rgb[2] * 29) >> 8);
+}
+
+// stb_image's channel conversions, so both paths give the same pixels
+local void
+convert_row(const u8 *in, u32 in_channels, u8 *out, u32 out_channels, u32 width)
+{
+    if (in_channels == out_channels)
+    {
+        memcpy(out, in, (u64)width * in_channels);
+        return;
+    }
+
+    for (u32 x = 0; x < width; ++x, in += in_channels, out += out_channels)
+    {
+        switch (in_channels * 8 + out_channels)
+        {
+            case 1 * 8 + 2: out[0] = in[0]; out[1] = 255; break;
+            case 1 * 8 + 3: out[0] = out[1] = out[2] = in[0]; break;
+            case 1 * 8 + 4: out[0] = out[1] = out[2] = in[0]; out[3] = 255; break;
+            case 2 * 8 + 1: out[0] = in[0]; break;
+            case 2 * 8 + 3: out[0] = out[1] = out[2] = in[0]; break;
+            case 2 * 8 + 4: out[0] = out[1] = out[2] = in[0]; out[3] = in[1]; break;
+            case 3 * 8 + 1: out[0] = luminance(in); break;
+            case 3 * 8 + 2: out[0] = luminance(in); out[1] = 255; break;
+            case 3 * 8 + 4: out[0] = in[0]; out[1] = in[1]; out[2] = in[2]; out[3] = 255; break;
+            case 4 * 8 + 1: out[0] = luminance(in); break;
+            case 4 * 8 + 2: out[0] = luminance(in); out[1] = in[3]; break;
+            case 4 * 8 + 3: out[0] = in[0]; out[1] = in[1]; out[2] = in[2]; break;
+        }
+    }
+}
+
+//
+// PNG
+//
+
+enum PngFilter
+{
+    PNG_FILTER_NONE,
+    PNG_FILTER_SUB,
+    PNG_FILTER_UP,
+    PNG_FILTER_AVERAGE,
+    PNG_FILTER_PAETH,
+};
+
+template <u32 bpp>
+local inline __m128i
+load_pixel(const u8 *p)
+{
+    s32 value = 0;
+    memcpy(&value, p, bpp);
+    return _mm_cvtsi32_si128(value);
+}
+
+template <u32 bpp>
+local inline void
+store_pixel(u8 *p, __m128i v)
+{
+    s32 value = _mm_cvtsi128_si32(v);
+    memcpy(p, &value, bpp);
+}
+
+local inline __m128i
+pick(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+local inline u8
+paeth(s32 a, s32 b, s32 c)
+{
+    s32 p = a + b - c;
+    s32 pa = abs(p - a);
+    s32 pb = abs(p - b);
+    s32 pc = abs(p - c);
+    if (pa <= pb && pa <= pc) return (u8)a;
+    if (pb <= pc) return (u8)b;
+    return (u8)c;
+}
+
+// sub, average and paeth depend on the pixel to the left, so 3 and 4 byte
+// pixels go one whole pixel per step in the low lanes of a register
+template <u32 bpp>
+local void
+unfilter_row_simd(u32 filter, u8 *row, const u8 *prior, u32 row_size)
+{
+    __m128i zero = _mm_setzero_si128();
+
+    switch (filter)
+    {
+        case PNG_FILTER_SUB:
+        {
+            __m128i left = zero;
+            for (u32 i = 0; i < row_size; i += bpp)
+            {
+                left = _mm_add_epi8(load_pixel<bpp>(row + i), left);
+                store_pixel<bpp>(row + i, left);
+            }
+        } break;
+
+        case PNG_FILTER_AVERAGE:
+        {
+            // avg_epu8 rounds up, the filter rounds down
+            __m128i one = _mm_set1_epi8(1);
+            __m128i left = zero;
+            for (u32 i = 0; i < row_size; i += bpp)
+            {
+                __m128i up = load_pixel<bpp>(prior + i);
+                __m128i average = _mm_sub_epi8(_mm_avg_epu8(left, up), _mm_and_si128(_mm_xor_si128(left, up), one));
+                left = _mm_add_epi8(load_pixel<bpp>(row + i), average);
+                store_pixel<bpp>(row + i, left);
+            }
+        } break;
+
+        case PNG_FILTER_PAETH:
+        {
+            // 16 bit lanes, p - a is b - c and p - b is a - c
+            __m128i a = zero, b = zero, c, d = zero;
+            for (u32 i = 0; i < row_size; i += bpp)
+            {
+                c = b;
+                b = _mm_unpacklo_epi8(load_pixel<bpp>(prior + i), zero);
+                a = d;
+                d = _mm_unpacklo_epi8(load_pixel<bpp>(row + i), zero);
+
+                __m128i pa = _mm_sub_epi16(b, c);
+                __m128i pb = _mm_sub_epi16(a, c);
+                __m128i pc = _mm_add_epi16(pa, pb);
+                pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+                pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+                pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+
+                __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+                __m128i nearest = pick(_mm_cmpeq_epi16(smallest, pa), a,
+                                      pick(_mm_cmpeq_epi16(smallest, pb), b, c));
+
+                // byte adds never carry into the zero high halves
+                d = _mm_add_epi8(d, nearest);
+                store_pixel<bpp>(row + i, _mm_packus_epi16(d, d));
+            }
+        } break;
+    }
+}
+
+local void
+unfilter_row(u32 filter, u8 *row, const u8 *prior, u32 row_size, u32 bpp)
+{
+    switch (filter)
+    {
+        case PNG_FILTER_NONE:
+            return;
+
+        case PNG_FILTER_UP:
+        {
+            u32 i = 0;
+            for (; i + 16 <= row_size; i += 16)
+            {
+                __m128i value = _mm_add_epi8(_mm_loadu_si128((const __m128i *)(row + i)),
+                                             _mm_loadu_si128((const __m128i *)(prior + i)));
+                _mm_storeu_si128((__m128i *)(row + i), value);
+            }
+            for (; i < row_size; ++i) row[i] = (u8)(row[i] + prior[i]);
+            return;
+        }
+    }
+
+    if (bpp >= 3)
+    {
+        if (bpp == 4) unfilter_row_simd<4>(filter, row, prior, row_size);
+        else unfilter_row_simd<3>(filter, row, prior, row_size);
+        return;
+    }
+
+    for (u32 i = 0; i < row_size; ++i)
+    {
+        s32 left = i >= bpp ? row[i - bpp] : 0;
+        s32 up = prior[i];
+        s32 up_left = i >= bpp ? prior[i - bpp] : 0;
+
+        switch (filter)
+        {
+            case PNG_FILTER_SUB:     row[i] = (u8)(row[i] + left); break;
+            case PNG_FILTER_AVERAGE: row[i] = (u8)(row[i] + ((left + up) >> 1)); break;
+            case PNG_FILTER_PAETH:   row[i] = (u8)(row[i] + paeth(left, up, up_left)); break;
+        }
+    }
+}
+
+// false hands the file to stb_image, which also reports any real error
+local bool
+decode_png_fast(Image *image, const u8 *data, u64 size, u32 channels)
+{
+    static const u8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if (size < 8 + 25 || memcmp(data, signature, 8) != 0) return false;
+
+    u32 width = 0, height = 0, color_type = 0;
+    u8 palette[256 * 4];
+    u32 palette_size = 0;
+    bool palette_alpha = false;
+    std::vector<u8> compressed;
+
+    u64 pos = 8;
+    bool seen_header = false;
+    for (;;)
+    {
+        if (pos + 12 > size) return false;
+
+        u32 length = read_u32_be(data + pos);
+        const u8 *type = data + pos + 4;
+        const u8 *chunk = data + pos + 8;
+        if (pos + 12 + length > size) return false;
+
+        if (memcmp(type, "IHDR", 4) == 0)
+        {
+            if (length != 13) return false;
+            width = read_u32_be(chunk);
+            height = read_u32_be(chunk + 4);
+            color_type = chunk[9];
+
+            // bit depth 8, deflate, adaptive filtering, not interlaced
+            if (chunk[8] != 8 || chunk[10] != 0 || chunk[11] != 0 || chunk[12] != 0) return false;
+            if (color_type != 0 && color_type != 2 && color_type != 3 && color_type != 4 && color_type != 6) return false;
+            if (width == 0 || height == 0 || width > (1 << 24) || height > (1 << 24)) return false;
+            seen_header = true;
+        }
+        else if (memcmp(type, "PLTE", 4) == 0)
+        {
+            palette_size = length / 3;
+            if (palette_size > 256 || palette_size * 3 != length) return false;
+            for (u32 i = 0; i < palette_size; ++i)
+            {
+                palette[i * 4 + 0] = chunk[i * 3 + 0];
+                palette[i * 4 + 1] = chunk[i * 3 + 1];
+                palette[i * 4 + 2] = chunk[i * 3 + 2];
+                palette[i * 4 + 3] = 255;
+            }
+        }
+        else if (memcmp(type, "tRNS", 4) == 0)
+        {
+            // color keyed gray and rgb are rare, stb_image does them
+            if (color_type != 3 || length > palette_size) return false;
+            for (u32 i = 0; i < length; ++i) palette[i * 4 + 3] = chunk[i];
+            palette_alpha = true;
+        }
+        else if (memcmp(type, "IDAT", 4) == 0)
+        {
+            compressed.insert(compressed.end(), chunk, chunk + length);
+        }
+        else if (memcmp(type, "IEND", 4) == 0)
+        {
+            break;
+        }
+        else if (!(type[0] & 0x20))
+        {
+            // unknown critical chunk
+            return false;
+        }
+
+        pos += 12 + length;
+    }
+
+    if (!seen_header || compressed.empty() || (color_type == 3 && palette_size == 0)) return false;
+
+    const u32 bytes_per_pixel[7] = { 1, 0, 3, 1, 2, 0, 4 };
+    u32 bpp = bytes_per_pixel[color_type];
+    u32 file_channels = color_type == 3 ? (palette_alpha ? 4 : 3) : bpp;
+    u32 out_channels = channels ? channels : file_channels;
+
+    u64 row_size = (u64)width * bpp;
+    u64 raw_size = height * (row_size + 1);
+    u8 *raw = (u8 *)malloc(raw_size);
+    u8 *pixels = (u8 *)malloc((u64)width * height * out_channels);
+    std::vector<u8> zero_row(row_size, 0);
+    std::vector<u8> expanded(color_type == 3 ? (u64)width * 4 : 0);
+
+    bool ok = raw && pixels && image_inflate(compressed.data(), compressed.size(), raw, raw_size);
+
+    for (u32 y = 0; ok && y < height; ++y)
+    {
+        // each row is a filter type byte and the filtered bytes
+        u8 *row = raw + y * (row_size + 1) + 1;
+        u32 filter = row[-1];
+        if (filter > PNG_FILTER_PAETH)
+        {
+            ok = false;
+            break;
+        }
+
+        const u8 *prior = y > 0 ? row - (row_size + 1) : zero_row.data();
+        unfilter_row(filter, row, prior, (u32)row_size, bpp);
+
+        const u8 *source = row;
+        if (color_type == 3)
+        {
+            for (u32 x = 0; x < width; ++x)
+            {
+                memcpy(expanded.data() + x * 4, palette + row[x] * 4, 4);
+            }
+            source = expanded.data();
+        }
+
+        u8 *out = pixels + (u64)(height - 1 - y) * width * out_channels;
+        convert_row(source, color_type == 3 ? 4 : bpp, out, out_channels, width);
+        if (color_type == 3 && !palette_alpha && out_channels == 4)
+        {
+            for (u32 x = 0; x < width; ++x) out[x * 4 + 3] = 255;
+        }
+    }
+
+    free(raw);
+
+    if (!ok)
+    {
+        free(pixels);
+        return false;
+    }
+
+    image->pixels = pixels;
+    image->width = width;
+    image->height = height;
+    image->channels = out_channels;
+    image->file_channels = file_channels;
+    return true;
+}
+
+//
+// JPEG
+//
+
+struct JpegLayout
+{
+    u64 header_size;  // up to the end of the scan header
+    u64 height_offset; // of the frame height, patched per strip
+    u32 width;
+    u32 height;
+    u32 mcu_width;
+    u32 mcu_height;
+    u32 restart_interval; // in MCUs
+
+    std::vector<u64> segment_begin; // entropy coded data between restart markers
+    std::vector<u64> segment_end;
+};
+
+// baseline, one interleaved scan, restart markers present and consistent
+local bool
+parse_jpeg(const u8 *data, u64 size, JpegLayout *layout)
+{
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) return false;
+
+    bool baseline = false;
+    u32 component_count = 0;
+    layout->restart_interval = 0;
+
+    u64 pos = 2;
+    for (;;)
+    {
+        if (pos + 4 > size || data[pos] != 0xFF) return false;
+
+        u32 marker = data[pos + 1];
+        if (marker == 0xFF)
+        {
+            ++pos;
+            continue;
+        }
+
+        u32 length = read_u16_be(data + pos + 2);
+        const u8 *segment = data + pos + 4;
+        if (length < 2 || pos + 2 + length > size) return false;
+
+        if (marker == 0xC0 || marker == 0xC1)
+        {
+            if (length < 8 || segment[0] != 8) return false;
+            layout->height_offset = pos + 5;
+            layout->height = read_u16_be(segment + 1);
+            layout->width = read_u16_be(segment + 3);
+            component_count = segment[5];
+            if (length < 8 + 3 * component_count) return false;
+
+            u32 max_h = 1, max_v = 1;
+            for (u32 i = 0; i < component_count; ++i)
+            {
+                u32 sampling = segment[6 + i * 3 + 1];
+                max_h = glm::max(max_h, sampling >> 4);
+                max_v = glm::max(max_v, sampling & 15);
+            }
+            layout->mcu_width = 8 * max_h;
+            layout->mcu_height = 8 * max_v;
+            baseline = true;
+        }
+        else if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+        {
+            // progressive, lossless or arithmetic coded
+            return false;
+        }
+        else if (marker == 0xDD)
+        {
+            if (length != 4) return false;
+            layout->restart_interval = read_u16_be(segment);
+        }
+        else if (marker == 0xDA)
+        {
+            if (!baseline || segment[0] != component_count) return false;
+            layout->header_size = pos + 2 + length;
+            break;
+        }
+
+        pos += 2 + length;
+    }
+
+    if (layout->restart_interval == 0 || layout->width == 0 || layout->height == 0) return false;
+
+    // split the entropy coded data at the restart markers, 0xFF00 is a
+    // stuffed byte and 0xFFFF padding before a marker
+    layout->segment_begin.assign(1, layout->header_size);
+    layout->segment_end.clear();
+
+    pos = layout->header_size;
+    for (;;)
+    {
+        const u8 *found = pos < size ? (const u8 *)memchr(data + pos, 0xFF, size - pos) : nullptr;
+        if (!found || found + 1 >= data + size) return false;
+
+        u64 at = found - data;
+        u32 marker = data[at + 1];
+        if (marker == 0x00)
+        {
+            pos = at + 2;
+        }
+        else if (marker == 0xFF)
+        {
+            pos = at + 1;
+        }
+        else if (marker >= 0xD0 && marker <= 0xD7)
+        {
+            layout->segment_end.push_back(at);
+            layout->segment_begin.push_back(at + 2);
+            pos = at + 2;
+        }
+        else
+        {
+            layout->segment_end.push_back(at);
+            break;
+        }
+    }
+
+    u64 mcus_per_row = (layout->width + layout->mcu_width - 1) / layout->mcu_width;
+    u64 mcu_rows = (layout->height + layout->mcu_height - 1) / layout->mcu_height;
+    u64 segment_count = (mcus_per_row * mcu_rows + layout->restart_interval - 1) / layout->restart_interval;
+
+    return layout->segment_begin.size() == segment_count;
+}
+
+struct JpegCut
+{
+    u32 mcu_row;
+    u32 segment;
+};
+
+// restart intervals that begin a row of MCUs, the first and the end included
+local void
+find_cuts(const JpegLayout *layout, std::vector<JpegCut> *cuts)
+{
+    u32 mcus_per_row = (layout->width + layout->mcu_width - 1) / layout->mcu_width;
+    u32 mcu_rows = (layout->height + layout->mcu_height - 1) / layout->mcu_height;
+    u32 segment_count = (u32)layout->segment_begin.size();
+
+    cuts->clear();
+    for (u32 segment = 0; segment < segment_count; ++segment)
+    {
+        u64 mcu = (u64)segment * layout->restart_interval;
+        if (mcu % mcus_per_row == 0) cuts->push_back(JpegCut{(u32)(mcu / mcus_per_row), segment});
+    }
+    cuts->push_back(JpegCut{mcu_rows, segment_count});
+}
+
+u32 jpeg_strip_count(const u8 *data, u64 size)
+{
+    JpegLayout layout;
+    if (!parse_jpeg(data, size, &layout) || (u64)layout.width * layout.height < JPEG_MIN_THREADED_PIXELS) return 1;
+
+    std::vector<JpegCut> cuts;
+    find_cuts(&layout, &cuts);
+    return glm::min((u32)cuts.size() - 1, worker_count());
+}
+
+// a standalone JPEG of the segments between two cuts: the same headers with
+// the frame height patched, the segments with their restart markers
+// renumbered from 0, and an end marker
+local void
+build_strip(const u8 *data, const JpegLayout *layout, const JpegCut &first, const JpegCut &last, std::vector<u8> *strip)
+{
+    strip->assign(data, data + layout->header_size);
+
+    u32 strip_height = glm::min(last.mcu_row * layout->mcu_height, layout->height) - first.mcu_row * layout->mcu_height;
+    (*strip)[layout->height_offset + 0] = (u8)(strip_height >> 8);
+    (*strip)[layout->height_offset + 1] = (u8)(strip_height & 0xFF);
+
+    for (u32 segment = first.segment; segment < last.segment; ++segment)
+    {
+        if (segment > first.segment)
+        {
+            strip->push_back(0xFF);
+            strip->push_back((u8)(0xD0 + ((segment - first.segment - 1) & 7)));
+        }
+        strip->insert(strip->end(), data + layout->segment_begin[segment], data + layout->segment_end[segment]);
+    }
+
+    strip->push_back(0xFF);
+    strip->push_back(0xD9);
+}
+
+local bool
+decode_jpeg_threaded(Image *image, const u8 *data, u64 size, u32 channels)
+{
+    JpegLayout layout;
+    if (!parse_jpeg(data, size, &layout) || (u64)layout.width * layout.height < JPEG_MIN_THREADED_PIXELS) return false;
+
+    std::vector<JpegCut> cuts;
+    find_cuts(&layout, &cuts);
+
+    u32 strip_count = glm::min((u32)cuts.size() - 1, worker_count());
+    if (strip_count < 2) return false;
+
+    // strip i owns the cuts [owned[i], owned[i + 1]) and decodes one more
+    // interval each side, chroma upsampling reads the neighbouring rows
+    std::vector<u32> owned(strip_count + 1);
+    for (u32 i = 0; i <= strip_count; ++i) owned[i] = (u32)((u64)i * (cuts.size() - 1) / strip_count);
+
+    std::vector<u8 *> decoded(strip_count, nullptr);
+    std::vector<s32> decoded_channels(strip_count, 0);
+
+    parallel_for(strip_count, 1, [&](u32 begin, u32 end, u32) {
+        std::vector<u8> strip;
+        for (u32 i = begin; i < end; ++i)
+        {
+            const JpegCut &first = cuts[owned[i] > 0 ? owned[i] - 1 : 0];
+            const JpegCut &last = cuts[glm::min(owned[i + 1] + 1, (u32)cuts.size() - 1)];
+            build_strip(data, &layout, first, last, &strip);
+
+            s32 width, height;
+            decoded[i] = stbi_load_from_memory(strip.data(), (int)strip.size(), &width, &height, &decoded_channels[i], channels);
+            if (decoded[i] && (u32)width != layout.width)
+            {
+                free(decoded[i]);
+                decoded[i] = nullptr;
+            }
+        }
+    });
+
+    bool ok = true;
+    for (u8 *pixels : decoded) ok = ok && pixels;
+
+    u32 file_channels = decoded_channels[0];
+    u32 out_channels = channels ? channels : file_channels;
+    u64 row_size = (u64)layout.width * out_channels;
+    u8 *pixels = ok ? (u8 *)malloc(row_size * layout.height) : nullptr;
+
+    for (u32 i = 0; pixels && i < strip_count; ++i)
+    {
+        u32 decoded_first_row = cuts[owned[i] > 0 ? owned[i] - 1 : 0].mcu_row * layout.mcu_height;
+        u32 first_row = cuts[owned[i]].mcu_row * layout.mcu_height;
+        u32 end_row = glm::min(cuts[owned[i + 1]].mcu_row * layout.mcu_height, layout.height);
+
+        for (u32 y = first_row; y < end_row; ++y)
+        {
+            memcpy(pixels + (u64)(layout.height - 1 - y) * row_size,
+                   decoded[i] + (u64)(y - decoded_first_row) * row_size, row_size);
+        }
+    }
+
+    for (u8 *strip_pixels : decoded) free(strip_pixels);
+
+    if (!pixels) return false;
+
+    image->pixels = pixels;
+    image->width = layout.width;
+    image->height = layout.height;
+    image->channels = out_channels;
+    image->file_channels = file_channels;
+    return true;
+}
+
+s32 decode_image(Image *image, const u8 *data, u64 size, u32 channels, const ImageDecodeOptions &options)
+{
+    PROFILE_SCOPE("decode image");
+
+    *image = {};
+
+    if (options.fast_png && decode_png_fast(image, data, size, channels)) return 0;
+    if (options.threaded_jpeg && decode_jpeg_threaded(image, data, size, channels)) return 0;
+
+    if (size > INT_MAX)
+    {
+        failure_reason = "file too large";
+        return -1;
+    }
+
+    s32 width, height, file_channels;
+    image->pixels = stbi_load_from_memory(data, (int)size, &width, &height, &file_channels, channels);
+    if (!image->pixels)
+    {
+        failure_reason = stbi_failure_reason();
+        return -1;
+    }
+
+    image->width = width;
+    image->height = height;
+    image->file_channels = file_channels;
+    image->channels = channels ? channels : file_channels;
+    flip_rows(image->pixels, image->height, (u64)image->width * image->channels);
+
+    return 0;
+}
+
+s32 decode_image(Image *image, const u8 *data, u64 size, u32 channels)
+{
+    return decode_image(image, data, size, channels, default_image_decode_options());
+}
+
+s32 load_image(Image *image, const char *filename, u32 channels)
+{
+    *image = {};
+
+    MappedFile file;
+    if (map_file(&file, filename) != 0)
+    {
+        failure_reason = "can't open";
+        return -1;
+    }
+
+    s32 result = decode_image(image, file.data, file.size, channels);
+    unmap_file(&file);
+
+    return result;
+}
+
+bool image_info(const char *filename, u32 *width, u32 *height, u32 *channels)
+{
+    s32 w, h, n;
+    if (!stbi_info(filename, &w, &h, &n)) return false;
+
+    *width = w;
+    *height = h;
+    *channels = n;
+    return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "types.h"
+
+// Image decoding for every loader in the program.
+//
+// stb_image handles all the formats; the two most common cases in texture
+// sets take faster routes with the same output:
+//
+// - 8 bit non interlaced PNGs are inflated into one exactly sized buffer
+//   by a table driven inflate, or a replacement plugged in below, then
+//   unfiltered with SSE2 and converted and flipped in the same pass
+// - baseline JPEGs with restart markers are cut into strips at restart
+//   intervals that begin a row of MCUs, and the strips are decoded on the
+//   job workers
+//
+// Rows come out bottom up, as GL wants them. stb_image's own flip flag is a
+// global shared by all threads and is never set.
+
+struct Image
+{
+    u8 *pixels;
+    u32 width;
+    u32 height;
+    u32 channels;      // of pixels
+    u32 file_channels; // what the file has, and what channels 0 asks for
+};
+
+struct ImageDecodeOptions
+{
+    bool fast_png;
+    bool threaded_jpeg;
+};
+
+ImageDecodeOptions default_image_decode_options();
+
+// channels 1 to 4 convert like stb_image does, 0 keeps the file's count;
+// both fail quietly, image_failure_reason() says why
+s32 load_image(Image *image, const char *filename, u32 channels);
+s32 decode_image(Image *image, const u8 *data, u64 size, u32 channels);
+s32 decode_image(Image *image, const u8 *data, u64 size, u32 channels, const ImageDecodeOptions &options);
+
+bool image_info(const char *filename, u32 *width, u32 *height, u32 *channels);
+
+// of the last failed load or decode on the calling thread
+const char *image_failure_reason();
+
+void destroy(Image *image);
+
+// inflates a zlib stream, header included, into exactly out_size bytes.
+// A libdeflate style decompressor that is handed the whole output buffer at
+// once plugs in here; nullptr goes back to the built in one
+typedef bool (*ImageInflateFunction)(const u8 *in, u64 in_size, u8 *out, u64 out_size);
+
+void set_image_inflate(ImageInflateFunction inflate);
+
+// strips a JPEG would be decoded in, 1 when it takes the single threaded path
+u32 jpeg_strip_count(const u8 *data, u64 size);
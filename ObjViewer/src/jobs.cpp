@@ -0,0 +1,131 @@
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+
+#include "jobs.h"
+#include "profile.h"
+
+struct JobPool
+{
+    std::vector<std::thread> threads;
+
+    std::mutex submit_mutex; // one parallel_for at a time
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    u64 generation;
+    u32 busy_workers;
+
+    const JobFunction *fn;
+    u32 count;
+    u32 batch_size;
+    std::atomic<u32> next;
+};
+
+local JobPool *pool;
+local std::once_flag pool_once;
+local thread_local bool inside_job;
+
+local void
+run_batches(JobPool *job_pool, u32 worker)
+{
+    for (;;)
+    {
+        u32 begin = job_pool->next.fetch_add(job_pool->batch_size);
+        if (begin >= job_pool->count) break;
+
+        u32 end = begin + job_pool->batch_size;
+        if (end > job_pool->count || end < begin) end = job_pool->count;
+
+        (*job_pool->fn)(begin, end, worker);
+    }
+}
+
+local void
+worker_proc(JobPool *job_pool, u32 worker)
+{
+    inside_job = true;
+
+    char name[32];
+    snprintf(name, sizeof(name), "worker %u", worker);
+    set_profile_thread_name(name);
+
+    u64 seen_generation = 0;
+    std::unique_lock<std::mutex> lock(job_pool->mutex);
+
+    for (;;)
+    {
+        job_pool->wake.wait(lock, [&] { return job_pool->generation != seen_generation; });
+        seen_generation = job_pool->generation;
+
+        lock.unlock();
+        run_batches(job_pool, worker);
+        lock.lock();
+
+        if (--job_pool->busy_workers == 0)
+        {
+            job_pool->done.notify_one();
+        }
+    }
+}
+
+local void
+create_pool()
+{
+    pool = new JobPool();
+    pool->generation = 0;
+    pool->busy_workers = 0;
+
+    u32 thread_count = std::thread::hardware_concurrency();
+    if (thread_count == 0) thread_count = 1;
+
+    // the calling thread is worker 0
+    for (u32 worker = 1; worker < thread_count; ++worker)
+    {
+        pool->threads.emplace_back(worker_proc, pool, worker);
+        pool->threads.back().detach();
+    }
+}
+
+u32 worker_count()
+{
+    std::call_once(pool_once, create_pool);
+    return (u32)pool->threads.size() + 1;
+}
+
+void parallel_for(u32 count, u32 batch_size, const JobFunction &fn)
+{
+    if (count == 0) return;
+    if (batch_size == 0) batch_size = 1;
+
+    u32 workers = worker_count();
+
+    if (inside_job || workers == 1 || count <= batch_size)
+    {
+        fn(0, count, 0);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit_lock(pool->submit_mutex);
+
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->fn = &fn;
+        pool->count = count;
+        pool->batch_size = batch_size;
+        pool->next = 0;
+        pool->busy_workers = workers - 1;
+        ++pool->generation;
+    }
+    pool->wake.notify_all();
+
+    inside_job = true;
+    run_batches(pool, 0);
+    inside_job = false;
+
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    pool->done.wait(lock, [] { return pool->busy_workers == 0; });
+}
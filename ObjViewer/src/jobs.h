@@ -0,0 +1,18 @@
+#pragma once
+
+#include <functional>
+
+#include "types.h"
+
+// Fork/join helper on top of a lazily created pool of worker threads.
+//
+// The range [0, count) is handed out in batches, fn is called with the
+// batch range and the index of the worker running it, in [0, worker_count()),
+// so callers can keep per worker scratch data without any locking.
+// Nested calls from inside a job run serially on the calling worker.
+
+typedef std::function<void(u32 begin, u32 end, u32 worker)> JobFunction;
+
+u32 worker_count();
+
+void parallel_for(u32 count, u32 batch_size, const JobFunction &fn);
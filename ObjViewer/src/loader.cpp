@@ -0,0 +1,218 @@
+#include <chrono>
+
+#include "loader.h"
+#include "obj.h"
+#include "normals.h"
+#include "profile.h"
+
+// share of each stage in the overall fraction, parsing is usually most of it
+#define LOAD_PARSE_SHARE   0.7f
+#define LOAD_NORMALS_SHARE 0.2f
+
+local u64
+now_ns()
+{
+    using namespace std::chrono;
+    return (u64)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+local void
+set_stage(ModelLoader *loader, ModelLoadStage stage)
+{
+    if (!loader) return;
+
+    std::lock_guard<std::mutex> lock(loader->mutex);
+    loader->stage = stage;
+    if (stage == MODEL_LOAD_DONE || stage == MODEL_LOAD_FAILED) loader->end_ns = now_ns();
+}
+
+local s32
+load_model_stages(Mesh *mesh, const char *filename, ModelLoader *loader)
+{
+    if (load_obj(mesh, filename, loader ? &loader->parse_progress : nullptr) != 0)
+    {
+        set_stage(loader, MODEL_LOAD_FAILED);
+        return -1;
+    }
+
+    if (loader)
+    {
+        std::lock_guard<std::mutex> lock(loader->mutex);
+        loader->has_bounds = !mesh->vertices.empty();
+        loader->origin = mesh->origin;
+        loader->bounds_min = mesh->bounds_min;
+        loader->bounds_max = mesh->bounds_max;
+    }
+
+    set_stage(loader, MODEL_LOAD_NORMALS);
+    if (!mesh->has_normals)
+    {
+        generate_normals(mesh, default_normal_options());
+    }
+
+    set_stage(loader, MODEL_LOAD_TANGENTS);
+    generate_tangents(mesh);
+
+    return 0;
+}
+
+s32 load_model(Mesh *mesh, const char *filename)
+{
+    return load_model_stages(mesh, filename, nullptr);
+}
+
+local void
+load_thread_proc(ModelLoader *loader, std::string filename)
+{
+    set_profile_thread_name("model loader");
+
+    Mesh mesh = {};
+    if (load_model_stages(&mesh, filename.c_str(), loader) != 0) return;
+
+    std::lock_guard<std::mutex> lock(loader->mutex);
+    loader->mesh = std::move(mesh);
+    loader->stage = MODEL_LOAD_DONE;
+    loader->end_ns = now_ns();
+}
+
+void init(ModelLoader *loader)
+{
+    loader->parse_progress = 0.0f;
+    loader->stage = MODEL_LOAD_IDLE;
+    loader->mesh = {};
+    loader->has_bounds = false;
+    loader->taken = false;
+    loader->begin_ns = 0;
+    loader->end_ns = 0;
+    loader->pending_filename.clear();
+}
+
+local bool
+running(ModelLoader *loader)
+{
+    return loader->stage != MODEL_LOAD_IDLE && loader->stage != MODEL_LOAD_DONE && loader->stage != MODEL_LOAD_FAILED;
+}
+
+void begin_load(ModelLoader *loader, const char *filename)
+{
+    {
+        std::lock_guard<std::mutex> lock(loader->mutex);
+        if (running(loader))
+        {
+            loader->pending_filename = filename;
+            return;
+        }
+    }
+
+    if (loader->thread.joinable()) loader->thread.join();
+
+    loader->parse_progress = 0.0f;
+    loader->stage = MODEL_LOAD_PARSING;
+    loader->mesh = {};
+    loader->has_bounds = false;
+    loader->taken = false;
+    loader->begin_ns = now_ns();
+    loader->end_ns = 0;
+    loader->pending_filename.clear();
+
+    loader->thread = std::thread(load_thread_proc, loader, std::string(filename));
+}
+
+ModelLoadProgress get_progress(ModelLoader *loader)
+{
+    std::lock_guard<std::mutex> lock(loader->mutex);
+
+    ModelLoadProgress progress = {};
+    progress.stage = loader->stage;
+    progress.has_bounds = loader->has_bounds;
+    progress.origin = loader->origin;
+    progress.bounds_min = loader->bounds_min;
+    progress.bounds_max = loader->bounds_max;
+    progress.queued = !loader->pending_filename.empty();
+
+    switch (loader->stage)
+    {
+        case MODEL_LOAD_IDLE:     progress.fraction = 0.0f; break;
+        case MODEL_LOAD_PARSING:  progress.fraction = LOAD_PARSE_SHARE * loader->parse_progress.load(std::memory_order_relaxed); break;
+        case MODEL_LOAD_NORMALS:  progress.fraction = LOAD_PARSE_SHARE; break;
+        case MODEL_LOAD_TANGENTS: progress.fraction = LOAD_PARSE_SHARE + LOAD_NORMALS_SHARE; break;
+        case MODEL_LOAD_DONE:     progress.fraction = 1.0f; break;
+        case MODEL_LOAD_FAILED:   progress.fraction = 1.0f; break;
+    }
+
+    if (loader->stage != MODEL_LOAD_IDLE)
+    {
+        u64 end_ns = loader->end_ns ? loader->end_ns : now_ns();
+        progress.elapsed_ms = (end_ns - loader->begin_ns) / 1.0e6;
+    }
+
+    return progress;
+}
+
+bool take_mesh(ModelLoader *loader, Mesh *mesh)
+{
+    std::string pending;
+    bool taken = false;
+    {
+        std::lock_guard<std::mutex> lock(loader->mutex);
+        if (running(loader)) return false;
+
+        pending.swap(loader->pending_filename);
+
+        // the file changed after this one read it, the pending load replaces it
+        if (loader->stage == MODEL_LOAD_DONE && !loader->taken && pending.empty())
+        {
+            *mesh = std::move(loader->mesh);
+            loader->mesh = {};
+            loader->taken = true;
+            taken = true;
+        }
+    }
+
+    if (!pending.empty()) begin_load(loader, pending.c_str());
+
+    return taken;
+}
+
+void destroy(ModelLoader *loader)
+{
+    if (loader->thread.joinable()) loader->thread.join();
+    loader->mesh = {};
+}
+
+const char *model_load_stage_name(ModelLoadStage stage)
+{
+    switch (stage)
+    {
+        case MODEL_LOAD_IDLE:     return "idle";
+        case MODEL_LOAD_PARSING:  return "parsing";
+        case MODEL_LOAD_NORMALS:  return "normals";
+        case MODEL_LOAD_TANGENTS: return "tangents";
+        case MODEL_LOAD_DONE:     return "done";
+        case MODEL_LOAD_FAILED:   return "failed";
+    }
+    return "";
+}
+
+void init(LoadTimeline *timeline)
+{
+    timeline->begin_ns = now_ns();
+    timeline->first_frame_ms = 0.0;
+    timeline->full_quality_ms = 0.0;
+}
+
+bool mark_first_frame(LoadTimeline *timeline)
+{
+    if (timeline->first_frame_ms > 0.0) return false;
+
+    timeline->first_frame_ms = (now_ns() - timeline->begin_ns) / 1.0e6;
+    return true;
+}
+
+bool mark_full_quality(LoadTimeline *timeline)
+{
+    if (timeline->full_quality_ms > 0.0) return false;
+
+    timeline->full_quality_ms = (now_ns() - timeline->begin_ns) / 1.0e6;
+    return true;
+}
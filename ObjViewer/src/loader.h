@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+// Loads an .obj model on a background thread so the window opens and draws
+// right away.
+//
+// Each stage publishes what it has: the bounds once the file is parsed, so
+// the caller can frame the camera and draw a proxy box, and the mesh once
+// normals and tangents are done. GL objects are made by the caller on its
+// own thread when it takes the mesh.
+
+enum ModelLoadStage
+{
+    MODEL_LOAD_IDLE,
+    MODEL_LOAD_PARSING,
+    MODEL_LOAD_NORMALS,
+    MODEL_LOAD_TANGENTS,
+    MODEL_LOAD_DONE,
+    MODEL_LOAD_FAILED,
+};
+
+struct ModelLoadProgress
+{
+    ModelLoadStage stage;
+    float fraction; // of the whole load, parsing is weighted by the bytes read
+
+    bool has_bounds;
+    glm::dvec3 origin; // the bounds are relative to it, see Mesh::origin
+    glm::vec3 bounds_min;
+    glm::vec3 bounds_max;
+
+    double elapsed_ms; // since begin_load, until done or failed
+    bool queued;       // another load waits for this one
+};
+
+struct ModelLoader
+{
+    std::thread thread;
+    std::atomic<float> parse_progress;
+
+    // shared with the load thread
+    std::mutex mutex;
+    ModelLoadStage stage;
+    Mesh mesh;
+    bool has_bounds;
+    glm::dvec3 origin;
+    glm::vec3 bounds_min;
+    glm::vec3 bounds_max;
+    bool taken;
+    u64 begin_ns;
+    u64 end_ns;
+
+    // a load asked for while one runs starts when that one finishes
+    std::string pending_filename;
+};
+
+// loads the whole model on the calling thread
+s32 load_model(Mesh *mesh, const char *filename);
+
+void init(ModelLoader *loader);
+
+void begin_load(ModelLoader *loader, const char *filename);
+
+ModelLoadProgress get_progress(ModelLoader *loader);
+
+// moves the finished mesh out, true only on that call; also starts a load
+// that was waiting for the previous one
+bool take_mesh(ModelLoader *loader, Mesh *mesh);
+
+// waits for a load in progress
+void destroy(ModelLoader *loader);
+
+const char *model_load_stage_name(ModelLoadStage stage);
+
+// Startup milestones in ms since init: the first frame on screen, and full
+// quality once the model, textures, chunks and pages asked for are all in.
+struct LoadTimeline
+{
+    u64 begin_ns;
+    double first_frame_ms;  // 0 until reached
+    double full_quality_ms;
+};
+
+void init(LoadTimeline *timeline);
+
+// true on the call that reaches the milestone
+bool mark_first_frame(LoadTimeline *timeline);
+bool mark_full_quality(LoadTimeline *timeline);
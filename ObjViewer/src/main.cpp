@@ -1,12 +1,13 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <float.h>
 
 #include <glad\glad.h> 
 
 #include <GLFW\glfw3.h>
 
-#include "stb_image.h"
-
 #include <glm\glm.hpp>
 #include <glm\gtc\matrix_transform.hpp>
 #include <glm\gtc\type_ptr.hpp>
@@ -14,26 +15,80 @@
 #include "log.h"
 #include "shader.h"
 #include "camera.h"
-
-#define ArrayCount(a) (sizeof(a) / sizeof(a[0]))
+#include "file.h"
+#include "mesh.h"
+#include "obj.h"
+#include "normals.h"
+#include "transform.h"
+#include "bench.h"
+#include "scene.h"
+#include "frustum.h"
+#include "chunk.h"
+#include "texture.h"
+#include "upload.h"
+#include "texbake.h"
+#include "texcache.h"
+#include "atlas.h"
+#include "vtex.h"
+#include "vtexgpu.h"
+#include "watch.h"
+#include "raster.h"
+#include "png.h"
+#include "jobs.h"
+#include "occlusion.h"
+#include "profile.h"
+#include "loader.h"
+#include "accum.h"
+#include "sim.h"
+#include "drawlist.h"
+#include "target.h"
+#include "stats.h"
+#include "overlay.h"
+#include "convert.h"
 
 u32 screen_width = 800;
 u32 screen_height = 600;
 
 bool draw_wireframe = false;
+bool occlusion_culling = true;
+bool occlusion_reprojection = false;
+bool progressive_refinement = true;
+bool show_stats = true;
+
+// the overlay font is 3x5, scaled up by this
+#define STATS_PIXEL_SCALE 2
+
+// nearest the near plane gets to the far one: 24 bit fixed point depth
+// needs a modest ratio, float depth with reverse Z hardly any
+#define DEPTH_RATIO_FIXED 1e-4f
+#define DEPTH_RATIO_REVERSE_Z 1e-6f
+
+// frames are only drawn when something changed; a change asks for two so
+// the draw list, which is a frame behind, and work that reads back last
+// frame's results, like the VT feedback, settle
+#define REDRAW_FRAMES 2
+// longest sleep between checks for file changes while nothing happens
+#define IDLE_WAIT_SECONDS 0.25
+u32 frames_to_draw = REDRAW_FRAMES;
 
 float delta_time;
 float last_frame;
 
+// drawn this frame, the simulation thread owns the one that moves
 Camera cam;
+Simulation sim;
 float mouse_last_x = screen_width / 2.0f;
 float mouse_last_y = screen_height / 2.0f;
 
 float mouse_sensitivity = 0.05f;
 
 
+void request_redraw(u32 frame_count);
+
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
+void window_refresh_callback(GLFWwindow *window);
+
 void window_size_callback(GLFWwindow *window, int width, int height);
 
 void window_content_scale_callback(GLFWwindow* window, float xscale, float yscale);
@@ -42,15 +97,214 @@ void error_callback(int error_code, const char *error_str);
 
 void process_input(GLFWwindow *window);
 
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
+
 void mouse_callback(GLFWwindow *window, double mouse_x, double mouse_y);
 
 void scroll_callback(GLFWwindow *window, double x_offset, double y_offset);
 
-
-
-int main(void)
+std::string find_baked_texture(const char *image_filename);
+
+void acquire_materials(TextureCache *cache, TextureAtlas *atlas, const Mesh *mesh, std::vector<u32> *material_textures);
+
+void release_materials(TextureCache *cache, std::vector<u32> *material_textures);
+
+void build_cube(Mesh *cube);
+
+u32 init_cube_scene(SceneGraph *scene, TransformSystem *cube_transforms);
+
+void animate_cubes(SceneGraph *scene, TransformSystem *cube_transforms, u32 first_cube_node, float time);
+
+void frame_model(const glm::dvec3 &origin, const glm::vec3 &bounds_min, const glm::vec3 &bounds_max, float *far_plane);
+
+s32 render_software(const char *model_filename, const char *png_filename, u32 frame_count,
+                    u32 width, u32 height, const char *stats_filename);
+
+float cube_vertices[] = {
+    -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+    0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
+    0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+    0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+    -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+
+    -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+    0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+    0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
+    0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
+    -0.5f,  0.5f,  0.5f,  0.0f, 1.0f,
+    -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+
+    -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+    -0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+    -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+    -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+    -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+
+    0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+    0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+    0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+    0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+    0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+    0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+
+    -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+    0.5f, -0.5f, -0.5f,  1.0f, 1.0f,
+    0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+    0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+    -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+    -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+
+    -0.5f,  0.5f, -0.5f,  0.0f, 2.0f,
+    0.5f,  0.5f, -0.5f,   2.0f, 2.0f,
+    0.5f,  0.5f,  0.5f,   2.0f, 0.0f,
+    0.5f,  0.5f,  0.5f,   2.0f, 0.0f,
+    -0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
+    -0.5f,  0.5f, -0.5f,  0.0f, 2.0f
+};
+
+glm::vec3 cube_positions[] = {
+    glm::vec3( 0.0f,  0.0f,  0.0f), 
+    glm::vec3( 2.0f,  5.0f, -15.0f), 
+    glm::vec3(-1.5f, -2.2f, -2.5f),  
+    glm::vec3(-3.8f, -2.0f, -12.3f),  
+    glm::vec3( 2.4f, -0.4f, -3.5f),  
+    glm::vec3(-1.7f,  3.0f, -7.5f),  
+    glm::vec3( 1.3f, -2.0f, -2.5f),  
+    glm::vec3( 1.5f,  2.0f, -2.5f), 
+    glm::vec3( 1.5f,  0.2f, -1.5f), 
+    glm::vec3(-1.3f,  1.0f, -1.5f)  
+};
+
+
+
+int main(int argc, char **argv)
 {
     init_logger();
+    init_profiler();
+    set_profile_thread_name("main");
+
+    LoadTimeline timeline;
+    init(&timeline);
+
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    {
+        return run_benchmark(argc - 2, argv + 2);
+    }
+
+    // usage: ObjViewer --bake-texture image.png out.tex [rgba8|bc1|bc3|bc5|bc7] [--linear]
+    //        ObjViewer --bake-texture image.png out.vt [--linear]
+    if (argc > 3 && strcmp(argv[1], "--bake-texture") == 0)
+    {
+        if (has_extension(argv[3], ".vt"))
+        {
+            VirtualTextureBakeOptions options = default_virtual_texture_bake_options();
+            options.srgb = !(argc > 4 && strcmp(argv[4], "--linear") == 0);
+            return bake_virtual_texture(argv[2], argv[3], options);
+        }
+
+        TextureBakeOptions options = default_texture_bake_options();
+        for (int arg = 4; arg < argc; ++arg)
+        {
+            if (strcmp(argv[arg], "--linear") == 0)
+            {
+                options.srgb = false;
+            }
+            else if (!parse_texture_format(argv[arg], &options.format))
+            {
+                LOG_E("Unknown texture format '%s'", argv[arg]);
+                return -1;
+            }
+        }
+
+        return bake_texture(argv[2], argv[3], options);
+    }
+
+    // usage: ObjViewer --convert in.obj out.obj [--grid n] [--block n]
+    if (argc > 3 && strcmp(argv[1], "--convert") == 0)
+    {
+        ConvertOptions options = default_convert_options();
+        for (int arg = 4; arg < argc; ++arg)
+        {
+            if (strcmp(argv[arg], "--grid") == 0 && arg + 1 < argc)
+            {
+                options.grid = (u32)strtoul(argv[++arg], nullptr, 10);
+            }
+            else if (strcmp(argv[arg], "--block") == 0 && arg + 1 < argc)
+            {
+                options.stream.block_records = glm::max((u32)strtoul(argv[++arg], nullptr, 10), 1u);
+            }
+            else
+            {
+                LOG_E("Unknown convert option '%s'", argv[arg]);
+                return -1;
+            }
+        }
+
+        return convert_obj(argv[2], argv[3], options);
+    }
+
+    // usage: ObjViewer [model.obj [--bake model.chunks] | model.chunks]
+    //                  [--software out.png [--frames n] [--size WxH]]
+    //                  [--virtual-texture scan.vt] [--stats last_frame.json]
+    const char *model_filename = argc > 1 && argv[1][0] != '-' ? argv[1] : nullptr;
+    const char *bake_filename = nullptr;
+    const char *virtual_texture_filename = nullptr;
+    const char *software_filename = nullptr;
+    const char *stats_filename = nullptr;
+    u32 software_frames = 1;
+    u32 software_width = screen_width;
+    u32 software_height = screen_height;
+    for (int arg = model_filename ? 2 : 1; arg < argc; ++arg)
+    {
+        if (strcmp(argv[arg], "--bake") == 0 && arg + 1 < argc)
+        {
+            bake_filename = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--software") == 0 && arg + 1 < argc)
+        {
+            software_filename = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--frames") == 0 && arg + 1 < argc)
+        {
+            software_frames = (u32)strtoul(argv[++arg], nullptr, 10);
+        }
+        else if (strcmp(argv[arg], "--size") == 0 && arg + 1 < argc)
+        {
+            sscanf(argv[++arg], "%ux%u", &software_width, &software_height);
+        }
+        else if (strcmp(argv[arg], "--virtual-texture") == 0 && arg + 1 < argc)
+        {
+            virtual_texture_filename = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--stats") == 0 && arg + 1 < argc)
+        {
+            stats_filename = argv[++arg];
+        }
+    }
+
+    bool stream_model = model_filename && has_extension(model_filename, ".chunks");
+
+    if (software_filename)
+    {
+        if (stream_model)
+        {
+            LOG_E("The software renderer cannot draw streamed models, pass the .obj");
+            return -1;
+        }
+
+        return render_software(model_filename, software_filename, software_frames,
+                               software_width, software_height, stats_filename);
+    }
+
+    // straight from the file, the model never has to fit in memory
+    if (model_filename && !stream_model && bake_filename)
+    {
+        return bake_chunks(model_filename, bake_filename, default_bake_options());
+    }
+
+    Mesh mesh = {};
 
     glfwInit();
     
@@ -66,6 +320,7 @@ int main(void)
         return -1;
     }
     glfwMakeContextCurrent(window);
+    glfwSwapInterval(1);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
 
@@ -77,11 +332,15 @@ int main(void)
         return -1;
     }
 
+    init_gpu_profiler();
+
     glfwSetWindowContentScaleCallback(window, window_content_scale_callback);
     glfwSetWindowSizeCallback(window, window_size_callback);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetKeyCallback(window, key_callback);
     glfwSetErrorCallback(error_callback);
 
     int nr_attributes = 0;
@@ -89,142 +348,124 @@ int main(void)
 
     glEnable(GL_DEPTH_TEST);
 
+    // the scene draws offscreen, with float depth when reverse Z is there
+    bool reverse_z = init_reverse_z();
+    LOG_I("Depth: %s", reverse_z ? "reverse Z, 32 bit float, infinite far plane" : "24 bit, near and far fitted to the scene");
+
+    RenderTarget scene_target;
+    init(&scene_target, screen_width, screen_height, reverse_z);
+
     glViewport(0, 0, 800, 600);
     
     cam = init(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
 
+    GpuMesh gpu_mesh = {};
+    ChunkStreamer streamer;
+    float far_plane = 100.0f;
+
+    // the window shows up before the model is parsed: a box at its bounds
+    // stands in until the mesh arrives, textures follow through the uploader
+    ModelLoader model_loader;
+    init(&model_loader);
+    bool model_framed = false;
+    bool model_loaded = false;
+
+    if (stream_model)
+    {
+        if (init(&streamer, model_filename, default_stream_options()) != 0)
+        {
+            glfwTerminate();
+            return -1;
+        }
+
+        frame_model(streamer.header.origin, streamer.header.bounds_min, streamer.header.bounds_max, &far_plane);
+        model_framed = true;
+    }
+    else if (model_filename)
+    {
+        begin_load(&model_loader, model_filename);
+    }
+
     Shader shader;
     init(&shader, "shader\\vertex_shader.vert", "shader\\fragment_shader.frag");
     
-    float vertices[] = {
-        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-        0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
-        0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-        0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-        0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-        0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-        0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-
-        -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-        -0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-        -0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-        0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-        0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-        0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-        0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-        0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-        0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-        0.5f, -0.5f, -0.5f,  1.0f, 1.0f,
-        0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-        0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-        -0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-
-        -0.5f,  0.5f, -0.5f,  0.0f, 2.0f,
-        0.5f,  0.5f, -0.5f,   2.0f, 2.0f,
-        0.5f,  0.5f,  0.5f,   2.0f, 0.0f,
-        0.5f,  0.5f,  0.5f,   2.0f, 0.0f,
-        -0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
-        -0.5f,  0.5f, -0.5f,  0.0f, 2.0f
-    };
-
-    glm::vec3 cube_positions[] = {
-        glm::vec3( 0.0f,  0.0f,  0.0f), 
-        glm::vec3( 2.0f,  5.0f, -15.0f), 
-        glm::vec3(-1.5f, -2.2f, -2.5f),  
-        glm::vec3(-3.8f, -2.0f, -12.3f),  
-        glm::vec3( 2.4f, -0.4f, -3.5f),  
-        glm::vec3(-1.7f,  3.0f, -7.5f),  
-        glm::vec3( 1.3f, -2.0f, -2.5f),  
-        glm::vec3( 1.5f,  2.0f, -2.5f), 
-        glm::vec3( 1.5f,  0.2f, -1.5f), 
-        glm::vec3(-1.3f,  1.0f, -1.5f)  
-    };
-        
-    unsigned int cube_VAO, cube_VBO;
-    glGenVertexArrays(1, &cube_VAO);
-    glGenBuffers(1, &cube_VBO);
-    
-    glBindVertexArray(cube_VAO);
+    // jittered samples averaged while the view stands still
+    AccumulationBuffer accumulation;
+    init(&accumulation, screen_width, screen_height, default_accumulation_options());
 
-    glBindBuffer(GL_ARRAY_BUFFER, cube_VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    TextOverlay overlay;
+    init(&overlay);
 
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    Mesh cube = {};
+    build_cube(&cube);
 
-    // texture coord attribute
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    GpuMesh cube_mesh;
+    init(&cube_mesh, &cube);
 
+    TransformSystem cube_transforms = {};
+    SceneGraph scene;
+    init(&scene);
+    u32 first_cube_node = 0;
 
-    // --- TEXTURE ---
-
-    u32 texture_container, texture_awesomeface;
-    glGenTextures(1, &texture_container);
-    glBindTexture(GL_TEXTURE_2D, texture_container);
+    // scene nodes index the groups of one of these
+    const Mesh *scene_mesh = model_filename ? &mesh : &cube;
+    GpuMesh *scene_gpu_mesh = model_filename ? &gpu_mesh : &cube_mesh;
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    OcclusionCuller occlusion;
+    init(&occlusion, default_occlusion_options());
 
-    s32 width, height, n_channels;
-    const char *texture_filename = "texture\\container.jpg";
-    stbi_set_flip_vertically_on_load(true);
-    u8 *data = stbi_load(texture_filename, &width, &height, &n_channels, 0);
+    // draw lists are recorded on their own thread, double buffered
+    FramePipeline pipeline;
+    init(&pipeline);
 
-    if (data)
+    if (!model_filename)
     {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        stbi_image_free(data);
-    }
-    else
-    {
-        LOG_E("Cannot load texture '%s'", texture_filename);
+        first_cube_node = init_cube_scene(&scene, &cube_transforms);
     }
 
 
-    glGenTextures(1, &texture_awesomeface);
-    glBindTexture(GL_TEXTURE_2D, texture_awesomeface);
+    // --- TEXTURE ---
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // decoded and uploaded over the first frames, coarsest level first
+    TextureUploader uploader;
+    init(&uploader, default_upload_options());
 
-    texture_filename = "texture\\awesomeface_alpha.png";
-    data = stbi_load(texture_filename, &width, &height, &n_channels, 0);
+    // materials share textures through the cache, evicted ones come back when drawn
+    TextureCache texture_cache;
+    init(&texture_cache, &uploader, 512ull * 1024 * 1024);
 
-    if (data)
-    {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        stbi_image_free(data);
-    }
-    else
-    {
-        LOG_E("Cannot load texture '%s'", texture_filename);
-    }
+    u32 texture_container = acquire_texture(&texture_cache, find_baked_texture("texture\\container.jpg").c_str());
+    u32 texture_awesomeface = acquire_texture(&texture_cache, find_baked_texture("texture\\awesomeface_alpha.png").c_str());
 
+    // diffuse texture per material of the model, small ones share the atlas
+    // and the rest comes from the cache; filled when the model arrives
+    TextureAtlas material_atlas = {};
+    std::vector<u32> material_textures;
 
     use(&shader);
     set_int(&shader, "texture_container", 0);
     set_int(&shader, "texture_awesomeface", 1);
+    set_int(&shader, "texture_atlas", 4);
+
+    // a scan too big for VRAM replaces the container and the material
+    // textures, pages are streamed in as the feedback pass asks for them
+    VirtualTexture vt;
+    VirtualTextureGpu vt_gpu = {};
+    Shader vt_shader = {};
+    Shader vt_feedback_shader = {};
+    bool use_virtual_texture = false;
+    if (virtual_texture_filename && init(&vt, virtual_texture_filename, default_virtual_texture_options()) == 0)
+    {
+        init(&vt_gpu, &vt, screen_width, screen_height, default_virtual_texture_gpu_options());
+        init(&vt_shader, "shader\\vertex_shader.vert", "shader\\fragment_shader_vt.frag");
+        init(&vt_feedback_shader, "shader\\vertex_shader.vert", "shader\\vt_feedback.frag");
+
+        use(&vt_shader);
+        set_int(&vt_shader, "texture_awesomeface", 1);
+        set_int(&vt_shader, "vt_atlas", 2);
+        set_int(&vt_shader, "vt_indirection", 3);
+        use_virtual_texture = true;
+    }
 
     // --- TEXTURE ---
 
@@ -237,25 +478,236 @@ int main(void)
 
 
 
+    // only the asset whose file changed is reloaded, everything else stays
+    FileWatcher watcher;
+    init(&watcher);
+    u32 watch_vertex_shader = watch_file(&watcher, shader.vertex_shader_filename.c_str());
+    u32 watch_fragment_shader = watch_file(&watcher, shader.fragment_shader_filename.c_str());
+    u32 watch_container = texture_container != TEXTURE_NO_HANDLE ?
+        watch_file(&watcher, texture_path(&texture_cache, texture_container)) : WATCH_NONE;
+    u32 watch_awesomeface = texture_awesomeface != TEXTURE_NO_HANDLE ?
+        watch_file(&watcher, texture_path(&texture_cache, texture_awesomeface)) : WATCH_NONE;
+    u32 watch_model = model_filename && !stream_model ? watch_file(&watcher, model_filename) : WATCH_NONE;
+    u32 watch_vt_shader = use_virtual_texture ? watch_file(&watcher, vt_shader.fragment_shader_filename.c_str()) : WATCH_NONE;
+    u32 watch_vt_feedback_shader = use_virtual_texture ?
+        watch_file(&watcher, vt_feedback_shader.fragment_shader_filename.c_str()) : WATCH_NONE;
+    std::vector<u32> changed_files;
+
+    // camera motion ticks on its own thread, a publish wakes the loop
+    init(&sim, cam, default_simulation_options(), glfwPostEmptyEvent);
+
     while (!glfwWindowShouldClose(window))
     {
+        // nothing to draw: sleep until input arrives, waking now and then
+        // for the file watcher
+        bool refine_frame = progressive_refinement && refining(&accumulation);
+        if (frames_to_draw > 0 || refine_frame)
+        {
+            glfwPollEvents();
+        }
+        else
+        {
+            glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+        }
+
         float current_frame = glfwGetTime();
-        delta_time = current_frame - last_frame;
+        delta_time = glm::min(current_frame - last_frame, 0.1f);
         last_frame = current_frame;
 
-        fprintf(stderr, "elapsed: %.3fs  dt: %.4f  ms/frame: %.4f  FPS: %.1f"
-                "  Flying cam: %3s"
-                "  Cam.pos: [%.3f %.3f %.3f]  Cam.up: [%.3f %.3f %.3f] \r", 
-               current_frame, 
-               delta_time,
-               delta_time * 1000.0f,
-               1.0f / delta_time,
-                cam.flying ? "ON" : "OFF",
-                (float)cam.position.x, (float)cam.position.y, (float)cam.position.z,
-                (float)cam.up.x,(float)cam.up.y,(float)cam.up.z);
-
         process_input(window);
 
+        if (sample_camera(&sim, &cam)) request_redraw(REDRAW_FRAMES);
+
+        changed_files.clear();
+        poll_changes(&watcher, &changed_files);
+        if (!changed_files.empty()) request_redraw(REDRAW_FRAMES);
+
+        ModelLoadProgress model_progress = get_progress(&model_loader);
+
+        // anything still arriving or moving keeps the frames coming
+        bool model_loading = model_progress.stage == MODEL_LOAD_PARSING ||
+                             model_progress.stage == MODEL_LOAD_NORMALS ||
+                             model_progress.stage == MODEL_LOAD_TANGENTS ||
+                             (model_progress.stage == MODEL_LOAD_DONE && !model_loaded);
+        if (model_loading ||
+            uploader.stats.pending_textures > 0 ||
+            (stream_model && streamer.stats.pending_loads > 0) ||
+            (use_virtual_texture && vt.stats.pages_missing > 0) ||
+            !model_filename)
+        {
+            request_redraw(REDRAW_FRAMES);
+        }
+
+        // a changed frame starts the average over, a still one adds a sample
+        // to it; with neither the loop goes back to waiting
+        bool dirty = frames_to_draw > 0;
+        refine_frame = !dirty && progressive_refinement && refining(&accumulation);
+        if (dirty) reset(&accumulation);
+        if (!dirty && !refine_frame) continue;
+
+        u64 frame_begin_ns = profile_now_ns();
+
+        profile_begin_gpu_frame();
+
+        PROFILE_SCOPE("frame");
+
+        bool shader_changed = false;
+        for (u32 id : changed_files)
+        {
+            if (id == watch_vertex_shader || id == watch_fragment_shader ||
+                id == watch_vt_shader || id == watch_vt_feedback_shader)
+            {
+                shader_changed = true;
+            }
+            else if (id == watch_container)
+            {
+                reload_texture(&texture_cache, texture_container);
+            }
+            else if (id == watch_awesomeface)
+            {
+                reload_texture(&texture_cache, texture_awesomeface);
+            }
+            else if (id == watch_model)
+            {
+                begin_load(&model_loader, model_filename);
+            }
+        }
+
+        if (model_progress.has_bounds && !model_framed)
+        {
+            frame_model(model_progress.origin, model_progress.bounds_min, model_progress.bounds_max, &far_plane);
+            set_camera(&sim, cam);
+            model_framed = true;
+        }
+
+        Mesh loaded_mesh;
+        if (take_mesh(&model_loader, &loaded_mesh))
+        {
+            mesh = std::move(loaded_mesh);
+
+            destroy(&gpu_mesh);
+            init(&gpu_mesh, &mesh);
+
+            // acquire first so textures both versions use stay loaded
+            std::vector<u32> previous_textures = material_textures;
+            TextureAtlas previous_atlas = material_atlas;
+            acquire_materials(&texture_cache, &material_atlas, &mesh, &material_textures);
+            release_materials(&texture_cache, &previous_textures);
+            destroy(&previous_atlas);
+
+            reset(&pipeline);
+            init(&scene);
+            add_mesh_nodes(&scene, SCENE_NO_PARENT, glm::mat4(1.0f), &mesh);
+
+            // a reload may have moved the origin, the camera follows so
+            // culling and the depth range stay in the scene's space
+            if (cam.origin != scene.origin)
+            {
+                rebase(&cam, scene.origin);
+                set_camera(&sim, cam);
+            }
+
+            if (model_loaded) LOG_I("Reloaded model '%s'", model_filename);
+            else LOG_I("Model ready after %.1f ms", get_progress(&model_loader).elapsed_ms);
+            model_loaded = true;
+        }
+
+        // both stages usually change together, rebuild the program once
+        if (shader_changed && reload(&shader) == 0)
+        {
+            use(&shader);
+            set_int(&shader, "texture_container", 0);
+            set_int(&shader, "texture_awesomeface", 1);
+            set_int(&shader, "texture_atlas", 4);
+        }
+
+        if (shader_changed && use_virtual_texture)
+        {
+            if (reload(&vt_shader) == 0)
+            {
+                use(&vt_shader);
+                set_int(&vt_shader, "texture_awesomeface", 1);
+                set_int(&vt_shader, "vt_atlas", 2);
+                set_int(&vt_shader, "vt_indirection", 3);
+            }
+            reload(&vt_feedback_shader);
+        }
+
+        if (!stream_model)
+        {
+            if (!model_filename)
+            {
+                animate_cubes(&scene, &cube_transforms, first_cube_node, current_frame);
+            }
+
+            update_scene(&scene);
+        }
+
+        // the depth range hugs whatever is there to see, so a site scan a
+        // few kilometers across neither clips nor fights in the distance
+        glm::vec3 world_min, world_max;
+        bool has_world_bounds = false;
+        if (stream_model)
+        {
+            world_min = streamer.header.bounds_min;
+            world_max = streamer.header.bounds_max;
+            has_world_bounds = true;
+        }
+        else if (get_scene_bounds(&scene, &world_min, &world_max))
+        {
+            has_world_bounds = true;
+        }
+        else if (model_progress.has_bounds)
+        {
+            world_min = model_progress.bounds_min;
+            world_max = model_progress.bounds_max;
+            has_world_bounds = true;
+        }
+
+        float near_plane = 0.1f;
+        float depth_far_plane = far_plane;
+        if (has_world_bounds)
+        {
+            fit_depth_range(&cam, world_min, world_max, reverse_z ? DEPTH_RATIO_REVERSE_Z : DEPTH_RATIO_FIXED,
+                            &near_plane, &depth_far_plane);
+        }
+
+        // rebuilt only when the camera moved, the window was resized or the
+        // depth range changed
+        update_matrices(&cam, (float)screen_width / (float)screen_height, near_plane, depth_far_plane, reverse_z);
+
+        // shaders see the world around a camera at the origin
+        glm::mat4 view = cam.relative_view;
+        glm::mat4 projection = cam.gpu_projection;
+        if (refine_frame) projection = jitter_projection(&accumulation, projection);
+        glm::dvec3 camera_world = world_position(&cam);
+
+        // culling and draw packing run on the recorder from here on, the
+        // scene stays untouched until the end of the frame waits for them;
+        // meanwhile the draws below use the list recorded last frame
+        const FrameData *previous = nullptr;
+        if (!stream_model)
+        {
+            FrameData *frame = next_frame(&pipeline);
+            previous = previous_frame(&pipeline);
+            frame->view = view;
+            frame->projection = cam.gpu_projection;
+            frame->view_projection = cam.view_projection;
+            frame->frustum = cam.frustum;
+            frame->camera_position = glm::vec3(camera_world - scene.origin);
+            frame->camera_world_position = camera_world;
+            frame->occlusion_culling = occlusion_culling;
+            frame->occlusion_reprojection = occlusion_reprojection;
+
+            DrawSources sources;
+            sources.scene = &scene;
+            sources.mesh = scene_mesh;
+            sources.occlusion = &occlusion;
+            sources.atlas = &material_atlas;
+            sources.material_textures = &material_textures;
+            begin_recording(&pipeline, sources);
+        }
+
         if (draw_wireframe)
         {
             glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -264,57 +716,537 @@ int main(void)
         {
             glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         }
-               
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture_container);
+        update(&uploader);
+
+        // the geometry of the previous frame into the small feedback target,
+        // read back and turned into page requests one frame later; the view
+        // has not moved while refining, so neither have the pages it needs
+        if (use_virtual_texture && !refine_frame && (stream_model || previous))
+        {
+            PROFILE_SCOPE("vt feedback pass");
+            PROFILE_GPU_SCOPE("vt feedback");
+
+            begin_feedback(&vt_gpu, screen_width, screen_height);
+
+            use(&vt_feedback_shader);
+            set_virtual_texture_uniforms(&vt_feedback_shader, &vt_gpu, &vt, feedback_lod_bias(&vt_gpu));
+
+            if (stream_model)
+            {
+                set_mat4(&vt_feedback_shader, "view", view);
+                set_mat4(&vt_feedback_shader, "projection", projection);
+                set_mat4(&vt_feedback_shader, "model",
+                         camera_relative_model(glm::mat4(1.0f), streamer.header.origin, camera_world));
+                draw(&streamer);
+            }
+            else
+            {
+                set_mat4(&vt_feedback_shader, "view", previous->view);
+                set_mat4(&vt_feedback_shader, "projection", previous->projection);
+
+                s32 model_location = glGetUniformLocation(vt_feedback_shader.ID, "model");
+                for (const DrawCommand &command : previous->commands)
+                {
+                    glUniformMatrix4fv(model_location, 1, GL_FALSE, glm::value_ptr(command.model));
+                    draw(scene_gpu_mesh, command.first_index, command.index_count);
+                }
+            }
+
+            end_feedback(&vt_gpu, &vt, screen_width, screen_height);
+        }
+
+        bind(&scene_target, screen_width, screen_height);
+
+        {
+            PROFILE_GPU_SCOPE("clear");
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+
+        Texture *container = texture_container != TEXTURE_NO_HANDLE ? use_texture(&texture_cache, texture_container) : nullptr;
+        if (container) bind(container, 0);
+        if (texture_awesomeface != TEXTURE_NO_HANDLE) bind(use_texture(&texture_cache, texture_awesomeface), 1);
+
+        // pages asked for by last frame's feedback go into the atlas
+        Shader *draw_shader = &shader;
+        if (use_virtual_texture)
+        {
+            update(&vt_gpu, &vt);
+            bind(&vt_gpu, 2, 3);
+
+            draw_shader = &vt_shader;
+            use(draw_shader);
+            set_virtual_texture_uniforms(draw_shader, &vt_gpu, &vt, 0.0f);
+        }
+        else
+        {
+            use(draw_shader);
+            if (material_atlas.ID) bind(&material_atlas, 4);
+            set_int(draw_shader, "atlas_layer", -1);
+        }
+
+        set_mat4(draw_shader, "view", view);
+        set_mat4(draw_shader, "projection", projection);
+
+        if (stream_model)
+        {
+            set_mat4(draw_shader, "model", camera_relative_model(glm::mat4(1.0f), streamer.header.origin, camera_world));
 
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture_awesomeface);
+            update(&streamer, &cam, (float)screen_height);
 
+            PROFILE_GPU_SCOPE("draw chunks");
+            draw(&streamer);
 
+            frame_stats()->nodes_drawn = streamer.stats.nodes_drawn;
+        }
+        else
+        {
+            // only the first frame after a reset has no list of its own yet
+            const FrameData *frame = previous ? previous : finish_recording(&pipeline);
+
+            // culled and packed for last frame's camera, drawn with it; the
+            // jitter is this frame's, the sample accumulate() adds below
+            set_mat4(draw_shader, "view", frame->view);
+            set_mat4(draw_shader, "projection",
+                     refine_frame ? jitter_projection(&accumulation, frame->projection) : frame->projection);
+
+            FrameStats *stats = frame_stats();
+            stats->nodes_drawn = (u32)frame->commands.size();
+            stats->nodes_frustum_culled = frame->nodes_frustum_culled;
+            stats->nodes_occlusion_culled = frame->nodes_occlusion_culled;
+            stats->triangles_culled = frame->triangles_culled;
+
+            PROFILE_SCOPE("draw submit");
+            PROFILE_GPU_SCOPE("draw");
+
+            // looked up once, these are set for every draw
+            s32 model_location = glGetUniformLocation(draw_shader->ID, "model");
+            s32 atlas_layer_location = glGetUniformLocation(draw_shader->ID, "atlas_layer");
+            s32 atlas_rect_location = glGetUniformLocation(draw_shader->ID, "atlas_rect");
+
+            Texture *bound = container;
+            s32 bound_layer = -1;
+            u32 bound_material = MESH_NO_MATERIAL;
+            for (const DrawCommand &command : frame->commands)
+            {
+                glUniformMatrix4fv(model_location, 1, GL_FALSE, glm::value_ptr(command.model));
+
+                if (command.material != bound_material && !use_virtual_texture)
+                {
+                    // atlas textures only change uniforms, the array stays bound
+                    if (command.atlas_layer != bound_layer) glUniform1i(atlas_layer_location, command.atlas_layer);
+                    if (command.atlas_layer >= 0) glUniform4fv(atlas_rect_location, 1, glm::value_ptr(command.atlas_rect));
+                    bound_layer = command.atlas_layer;
+
+                    // groups without a textured material keep the container
+                    Texture *diffuse = container;
+                    if (command.material != MESH_NO_MATERIAL && material_textures[command.material] != TEXTURE_NO_HANDLE)
+                    {
+                        diffuse = use_texture(&texture_cache, material_textures[command.material]);
+                    }
+                    if (diffuse && diffuse != bound && command.atlas_layer < 0)
+                    {
+                        bind(diffuse, 0);
+                        bound = diffuse;
+                    }
+
+                    bound_material = command.material;
+                }
+
+                draw(scene_gpu_mesh, command.first_index, command.index_count);
+            }
+
+            if (model_filename && !model_loaded && model_progress.has_bounds)
+            {
+                glm::vec3 center = (model_progress.bounds_min + model_progress.bounds_max) * 0.5f;
+                glm::vec3 size = glm::max(model_progress.bounds_max - model_progress.bounds_min, glm::vec3(1e-3f));
+                glm::mat4 proxy = glm::scale(glm::translate(glm::mat4(1.0f), center), size);
+                set_mat4(draw_shader, "model", camera_relative_model(proxy, model_progress.origin, frame->camera_world_position));
+
+                glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+                draw(&cube_mesh);
+                glPolygonMode(GL_FRONT_AND_BACK, draw_wireframe ? GL_LINE : GL_FILL);
+            }
+        }
 
+        if (refine_frame)
+        {
+            accumulate(&accumulation, &scene_target);
+        }
+        else
+        {
+            present(&scene_target);
+        }
 
-        glm::mat4 projection = glm::mat4(1.0f);
-        projection = glm::perspective(glm::radians(cam.fov),
-                                      (float)screen_width / (float)screen_height,
-                                      0.1f, 100.0f);
+        // the scene changes at the start of the next frame
+        if (!stream_model) finish_recording(&pipeline);
 
-        set_mat4(&shader, "view", get_view_matrix(&cam));
-        set_mat4(&shader, "projection", projection);
+        update(&texture_cache);
 
-        glBindVertexArray(cube_VAO);
-        for (u32 index = 0; 
-             index < ArrayCount(cube_positions);
-             ++index)
         {
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, cube_positions[index]);
-            float angle = glfwGetTime();
-            if (index % 2 == 0) angle = -angle;
-            model = glm::rotate(model, glm::radians(angle*20.0f), glm::vec3(1.0f, 0.3f, 0.5f));
+            FrameStats *stats = frame_stats();
+
+            u64 *memory = stats->memory;
+            memory[MEMORY_MESH_CPU] = (mesh.vertices.capacity() + cube.vertices.capacity()) * sizeof(Vertex) +
+                                      (mesh.indices.capacity() + cube.indices.capacity()) * sizeof(u32) +
+                                      scene_memory(&scene);
+            if (gpu_mesh.VAO) memory[MEMORY_MESH_GPU] += mesh.vertices.size() * sizeof(Vertex) + gpu_mesh.index_count * sizeof(u32);
+            memory[MEMORY_MESH_GPU] += cube.vertices.size() * sizeof(Vertex) + cube_mesh.index_count * sizeof(u32);
+            memory[MEMORY_TEXTURES] = texture_cache.stats.vram_used;
+            memory[MEMORY_MATERIAL_ATLAS] = material_atlas.size;
+            if (use_virtual_texture)
+            {
+                memory[MEMORY_VIRTUAL_TEXTURE] = (u64)vt_gpu.atlas_width * vt_gpu.atlas_height * 4 +
+                                                 (u64)vt_gpu.feedback_width * vt_gpu.feedback_height * 8;
+                for (const VirtualTextureLevel &level : vt.levels)
+                {
+                    memory[MEMORY_VIRTUAL_TEXTURE] += (u64)level.indirection_width * level.indirection_height * 4;
+                }
+            }
+            if (stream_model)
+            {
+                memory[MEMORY_CHUNKS_RAM] = streamer.stats.ram_used;
+                memory[MEMORY_CHUNKS_VRAM] = streamer.stats.vram_used;
+            }
+            memory[MEMORY_UPLOAD_BUFFERS] = (u64)uploader.pbos.size() * uploader.options.pbo_size;
+            memory[MEMORY_RENDER_TARGETS] = (u64)scene_target.width * scene_target.height * 8 +
+                                            (u64)accumulation.width * accumulation.height * 8;
+            for (const FrameData &frame : pipeline.frames)
+            {
+                memory[MEMORY_DRAW_LISTS] += frame.commands.capacity() * sizeof(DrawCommand) +
+                                             frame.visible_nodes.capacity() * sizeof(u32);
+            }
+
+            stats->upload_bytes = uploader.stats.bytes_started;
+            if (use_virtual_texture) stats->upload_bytes += (u64)vt.stats.uploads * VT_PAGE_BYTES;
+            stats->upload_queue = uploader.stats.pending_textures;
+            stats->chunk_queue = stream_model ? streamer.stats.pending_loads : 0;
+            stats->page_queue = use_virtual_texture ? vt.stats.pending_loads : 0;
+            stats->model_queue = (model_loading ? 1 : 0) + (model_progress.queued ? 1 : 0);
+
+            // the overlay shows the last finished frame, this one is not
+            // counted until it ends
+            if (show_stats)
+            {
+                char text[2048];
+                u32 length = format_stats(last_frame_stats(), text, sizeof(text));
+                snprintf(text + length, sizeof(text) - length,
+                         "camera %s%s  [%.2f %.2f %.2f]\n"
+                         "occlusion %s%s  refinement %s  samples %u\n"
+                         "textures %u/%u resident  vt %u pages %u missing\n"
+                         "load %s %.0f%%  first frame %.0f ms  full quality %.0f ms\n"
+                         "input latency %.1f ms avg  %.1f max\n",
+                         cam.flying ? "flying" : "walking", cam.orbiting ? " orbit" : "",
+                         world_position(&cam).x, world_position(&cam).y, world_position(&cam).z,
+                         occlusion_culling ? "on" : "off", occlusion_reprojection ? " reprojection" : "",
+                         progressive_refinement ? "on" : "off", accumulation.sample_count,
+                         texture_cache.stats.resident, texture_cache.stats.entries,
+                         use_virtual_texture ? vt.stats.pages_resident : 0, use_virtual_texture ? vt.stats.pages_missing : 0,
+                         model_load_stage_name(model_progress.stage), model_progress.fraction * 100.0f,
+                         timeline.first_frame_ms, timeline.full_quality_ms,
+                         sim.latency.average_ms, sim.latency.max_ms);
+
+                PROFILE_SCOPE("stats overlay");
+                draw_text(&overlay, text, screen_width, screen_height, STATS_PIXEL_SCALE);
+            }
+
+            end_frame_stats((profile_now_ns() - frame_begin_ns) / 1.0e6);
+        }
 
-            set_mat4(&shader, "model", model);
+        profile_end_gpu_frame();
 
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+        {
+            PROFILE_SCOPE("swap");
+            glfwSwapBuffers(window);
+        }
+        if (frames_to_draw > 0) --frames_to_draw;
+
+        mark_presented(&sim);
+
+        if (mark_first_frame(&timeline))
+        {
+            LOG_I("First frame after %.1f ms", timeline.first_frame_ms);
         }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        bool full_quality = (!model_filename || stream_model || model_loaded) &&
+                            uploader.stats.pending_textures == 0 &&
+                            (!stream_model || streamer.stats.pending_loads == 0) &&
+                            (!use_virtual_texture || vt.stats.pages_missing == 0);
+        if (full_quality && mark_full_quality(&timeline))
+        {
+            LOG_I("Full quality after %.1f ms", timeline.full_quality_ms);
+        }
 
-        Sleep(10);
+        profile_frame();
     }
 
-    glDeleteVertexArrays(1, &cube_VAO);
-    glDeleteBuffers(1, &cube_VBO);
+    destroy(&watcher);
+    destroy(&pipeline);
+    destroy(&occlusion);
+    destroy(&accumulation);
+    destroy(&scene_target);
+    destroy(&overlay);
+    destroy(&sim);
+    destroy(&model_loader);
+
+    if (use_virtual_texture)
+    {
+        destroy(&vt_gpu);
+        destroy(&vt);
+        destroy(&vt_shader);
+        destroy(&vt_feedback_shader);
+    }
+
+    destroy(&material_atlas);
+    destroy(&texture_cache);
+    destroy(&uploader);
+    destroy(&shader);
+
+    if (stream_model) destroy(&streamer);
+    destroy(&gpu_mesh);
+
+    destroy(&cube_transforms);
+    destroy(&cube_mesh);
+
+    print_profile_summary(stdout);
+    end_profiler();
+
+    if (stats_filename) save_stats_json(stats_filename, last_frame_stats());
 
     glfwTerminate();
     return 0;
 }
 
 
+// the atlas is built anew from the mesh, only textures it left out are
+// acquired from the cache
+void acquire_materials(TextureCache *cache, TextureAtlas *atlas, const Mesh *mesh, std::vector<u32> *material_textures)
+{
+    std::vector<std::string> filenames;
+    for (const Material &material : mesh->materials) filenames.push_back(material.diffuse_texture);
+    init(atlas, filenames, default_texture_atlas_options());
+
+    material_textures->assign(mesh->materials.size(), TEXTURE_NO_HANDLE);
+
+    for (u32 i = 0; i < (u32)mesh->materials.size(); ++i)
+    {
+        const Material &material = mesh->materials[i];
+        if (!material.diffuse_texture.empty() && atlas->entries[i].layer == TEXTURE_ATLAS_NO_LAYER)
+        {
+            (*material_textures)[i] = acquire_texture(cache, find_baked_texture(material.diffuse_texture.c_str()).c_str());
+        }
+    }
+}
+
+void release_materials(TextureCache *cache, std::vector<u32> *material_textures)
+{
+    for (u32 handle : *material_textures) release_texture(cache, handle);
+    material_textures->clear();
+}
+
+// a baked .tex next to the image wins over it
+std::string find_baked_texture(const char *image_filename)
+{
+    std::string baked = image_filename;
+    baked = baked.substr(0, baked.find_last_of('.')) + ".tex";
+
+    FILE *file = fopen(baked.c_str(), "rb");
+    if (!file) return image_filename;
+
+    fclose(file);
+    return baked;
+}
+
+// the cube is 36 unindexed position/uv vertices, normals and tangents
+// are generated, faces meet at 90 degrees so every face stays flat
+void build_cube(Mesh *cube)
+{
+    for (u32 i = 0; i < ArrayCount(cube_vertices) / 5; ++i)
+    {
+        Vertex vertex = {};
+        vertex.position = glm::vec3(cube_vertices[i * 5 + 0], cube_vertices[i * 5 + 1], cube_vertices[i * 5 + 2]);
+        vertex.tex_coord = glm::vec2(cube_vertices[i * 5 + 3], cube_vertices[i * 5 + 4]);
+
+        cube->vertices.push_back(vertex);
+        cube->indices.push_back(i);
+    }
+
+    // one group so cube nodes draw the same way as obj groups
+    MeshGroup group = {};
+    group.material = MESH_NO_MATERIAL;
+    group.first_index = 0;
+    group.index_count = (u32)cube->indices.size();
+    cube->groups.push_back(group);
+
+    compute_bounds(cube);
+
+    NormalOptions cube_normal_options = default_normal_options();
+    cube_normal_options.crease_angle = 45.0f;
+    generate_normals(cube, cube_normal_options);
+    generate_tangents(cube);
+}
+
+// a root node with one child per cube, returns the node of the first cube
+u32 init_cube_scene(SceneGraph *scene, TransformSystem *cube_transforms)
+{
+    init(cube_transforms, ArrayCount(cube_positions));
+    for (u32 index = 0; index < ArrayCount(cube_positions); ++index)
+    {
+        add_transform(cube_transforms, cube_positions[index], glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+    }
+
+    u32 root = add_node(scene, SCENE_NO_PARENT, glm::mat4(1.0f), SCENE_NO_MESH, glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+    for (u32 index = 0; index < cube_transforms->count; ++index)
+    {
+        add_node(scene, root, glm::mat4(1.0f), 0, glm::vec3(-0.5f), glm::vec3(0.5f));
+    }
+
+    return root + 1;
+}
+
+void animate_cubes(SceneGraph *scene, TransformSystem *cube_transforms, u32 first_cube_node, float time)
+{
+    glm::vec3 cube_rotation_axis = glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f));
+
+    for (u32 index = 0; index < cube_transforms->count; ++index)
+    {
+        float angle = time;
+        if (index % 2 == 0) angle = -angle;
+        set_rotation(cube_transforms, index, glm::angleAxis(glm::radians(angle*20.0f), cube_rotation_axis));
+    }
+    update_transforms(cube_transforms, true);
+
+    for (u32 index = 0; index < cube_transforms->count; ++index)
+    {
+        set_local(scene, first_cube_node + index, cube_transforms->world[index]);
+    }
+}
+
+// puts the camera in front of the whole model
+void frame_model(const glm::dvec3 &origin, const glm::vec3 &bounds_min, const glm::vec3 &bounds_max, float *far_plane)
+{
+    cam.origin = origin;
+    float radius = glm::length(bounds_max - bounds_min) * 0.5f;
+    glm::vec3 center = (bounds_min + bounds_max) * 0.5f;
+    cam.position = center + glm::vec3(0.0f, 0.0f, radius * 2.0f);
+    cam.speed = glm::max(cam.speed, radius * 0.5f);
+    cam.orbit_target = center;
+    if (cam.orbiting) set_orbit(&cam, true, center);
+    touch(&cam);
+    *far_plane = glm::max(*far_plane, radius * 8.0f);
+}
+
+// renders the same scene as the GL path on the CPU, without a window, and
+// saves the last frame; the cubes animate at a fixed 60 fps time step so
+// the output is reproducible
+s32 render_software(const char *model_filename, const char *png_filename, u32 frame_count,
+                    u32 width, u32 height, const char *stats_filename)
+{
+    cam = init(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
+    float far_plane = 100.0f;
+
+    Mesh mesh = {};
+    SceneGraph scene;
+    init(&scene);
+    TransformSystem cube_transforms = {};
+    u32 first_cube_node = 0;
+
+    if (model_filename)
+    {
+        if (load_model(&mesh, model_filename) != 0)
+        {
+            return -1;
+        }
+
+        add_mesh_nodes(&scene, SCENE_NO_PARENT, glm::mat4(1.0f), &mesh);
+        frame_model(mesh.origin, mesh.bounds_min, mesh.bounds_max, &far_plane);
+    }
+    else
+    {
+        build_cube(&mesh);
+        first_cube_node = init_cube_scene(&scene, &cube_transforms);
+    }
+
+    RasterTexture texture_container, texture_awesomeface;
+    init(&texture_container, "texture\\container.jpg");
+    init(&texture_awesomeface, "texture\\awesomeface_alpha.png");
+
+    RasterTarget target;
+    init(&target, width, height);
+    set_textures(&target, &texture_container, &texture_awesomeface);
+
+    std::vector<u32> visible_nodes;
+    double total_ms = 0.0;
+
+    for (u32 frame = 0; frame < frame_count; ++frame)
+    {
+        if (!model_filename)
+        {
+            animate_cubes(&scene, &cube_transforms, first_cube_node, frame / 60.0f);
+        }
+
+        update_scene(&scene);
+
+        update_matrices(&cam, (float)width / (float)height, 0.1f, far_plane, false);
+        glm::mat4 view_projection = cam.view_projection;
+
+        visible_nodes.clear();
+        cull_scene(&scene, &cam.frustum, &visible_nodes);
+
+        clear(&target, glm::vec4(0.2f, 0.3f, 0.3f, 1.0f));
+
+        for (u32 node : visible_nodes)
+        {
+            const MeshGroup &group = mesh.groups[scene.mesh[node]];
+            draw(&target, mesh.vertices.data(), mesh.indices.data() + group.first_index, group.index_count,
+                 view_projection * scene.world[node]);
+        }
+
+        resolve(&target);
+        profile_frame();
+
+        const RasterStats &stats = target.stats;
+        double frame_ms = stats.setup_ms + stats.raster_ms;
+        total_ms += frame_ms;
+
+        FrameStats *frame_counters = frame_stats();
+        frame_counters->draw_calls = stats.draws;
+        frame_counters->triangles_submitted = stats.triangles_submitted;
+        frame_counters->triangles_culled = stats.triangles_submitted - stats.triangles_binned;
+        frame_counters->nodes_drawn = (u32)visible_nodes.size();
+        u32 mesh_nodes = 0;
+        for (u32 node = 0; node < scene.count; ++node) mesh_nodes += scene.mesh[node] != SCENE_NO_MESH;
+        frame_counters->nodes_frustum_culled = mesh_nodes - (u32)visible_nodes.size();
+        frame_counters->memory[MEMORY_MESH_CPU] = mesh.vertices.capacity() * sizeof(Vertex) +
+                                                  mesh.indices.capacity() * sizeof(u32) + scene_memory(&scene);
+        frame_counters->memory[MEMORY_RENDER_TARGETS] = (u64)target.stride * target.height * 8;
+        end_frame_stats(frame_ms);
+
+        printf("frame %3u: %8.3f ms  (setup %7.3f  raster %7.3f)  %u/%u triangles  %.1f%% blocks rejected\n",
+               frame, frame_ms, stats.setup_ms, stats.raster_ms,
+               stats.triangles_binned, stats.triangles_submitted,
+               stats.blocks_tested ? 100.0 * stats.blocks_rejected / stats.blocks_tested : 0.0);
+    }
+
+    printf("%u frames at %ux%u, %u workers: %.3f ms/frame\n",
+           frame_count, width, height, worker_count(), frame_count ? total_ms / frame_count : 0.0);
+
+    print_profile_summary(stdout);
+
+    if (stats_filename) save_stats_json(stats_filename, last_frame_stats());
+
+    s32 result = write_png(png_filename, width, height, target.stride, target.color, true);
+
+    destroy(&target);
+    destroy(&texture_container);
+    destroy(&texture_awesomeface);
+    destroy(&cube_transforms);
+
+    return result;
+}
+
+
 void process_input(GLFWwindow *window)
 {
     if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
@@ -334,6 +1266,7 @@ void process_input(GLFWwindow *window)
         if ((current_time - last_time) > 0.05)
         {
             draw_wireframe = !draw_wireframe;
+            request_redraw(REDRAW_FRAMES);
         }
         last_time = current_time;
 
@@ -347,45 +1280,131 @@ void process_input(GLFWwindow *window)
         if ((current_time - last_time) > 0.05)
         {
             cam.flying = !cam.flying;
+            set_flying(&sim, cam.flying);
+            request_redraw(REDRAW_FRAMES);
         }
         last_time = current_time;
     }
 
-    if (glfwGetKey(window, GLFW_KEY_PAGE_UP) == GLFW_PRESS)
+    // turntable around the model, or back to flying from where it is
+    if (glfwGetKey(window, GLFW_KEY_F8) == GLFW_PRESS)
     {
+        static double last_time = 0.0;
+
+        double current_time = glfwGetTime();
+        if ((current_time - last_time) > 0.05)
+        {
+            set_orbit(&sim, !cam.orbiting, cam.orbit_target);
+        }
+        last_time = current_time;
     }
-    if (glfwGetKey(window, GLFW_KEY_PAGE_DOWN) == GLFW_PRESS)
+
+    if (glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS)
     {
+        static double last_time = 0.0;
+
+        double current_time = glfwGetTime();
+        if ((current_time - last_time) > 0.05)
+        {
+            occlusion_culling = !occlusion_culling;
+            request_redraw(REDRAW_FRAMES);
+        }
+        last_time = current_time;
     }
 
-    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+    if (glfwGetKey(window, GLFW_KEY_F4) == GLFW_PRESS)
     {
+        static double last_time = 0.0;
+
+        double current_time = glfwGetTime();
+        if ((current_time - last_time) > 0.05)
+        {
+            occlusion_reprojection = !occlusion_reprojection;
+            request_redraw(REDRAW_FRAMES);
+        }
+        last_time = current_time;
     }
-    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+
+    if (glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS)
     {
+        // a trace of idle waits would show nothing, draw every frame it covers
+        capture_trace(120, "objviewer_trace.json");
+        request_redraw(120);
     }
-    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
+
+    if (glfwGetKey(window, GLFW_KEY_F7) == GLFW_PRESS)
     {
+        static double last_time = 0.0;
+
+        double current_time = glfwGetTime();
+        if ((current_time - last_time) > 0.05)
+        {
+            progressive_refinement = !progressive_refinement;
+            request_redraw(REDRAW_FRAMES);
+        }
+        last_time = current_time;
     }
-    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+
+    if (glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS)
     {
+        static double last_time = 0.0;
+
+        double current_time = glfwGetTime();
+        if ((current_time - last_time) > 0.05)
+        {
+            show_stats = !show_stats;
+            request_redraw(REDRAW_FRAMES);
+        }
+        last_time = current_time;
     }
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    if (glfwGetKey(window, GLFW_KEY_F6) == GLFW_PRESS)
     {
-        move(&cam, glm::vec3(0.0f, 0.0f, 1.0f), delta_time);
+        static double last_time = 0.0;
+
+        double current_time = glfwGetTime();
+        if ((current_time - last_time) > 0.05)
+        {
+            fprintf(stdout, "\n");
+            print_profile_summary(stdout);
+        }
+        last_time = current_time;
     }
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+
+    if (glfwGetKey(window, GLFW_KEY_PAGE_UP) == GLFW_PRESS)
     {
-        move(&cam, glm::vec3(0.0f, 0.0f, -1.0f), delta_time);
     }
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    if (glfwGetKey(window, GLFW_KEY_PAGE_DOWN) == GLFW_PRESS)
     {
-        move(&cam, glm::vec3(-1.0f, 0.0f, 0.0f), delta_time);
     }
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+
+    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
     {
-        move(&cam, glm::vec3(1.0f, 0.0f, 0.0f), delta_time);
+    }
+    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+    {
+    }
+    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
+    {
+    }
+    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+    {
+    }
+}
+
+// movement keys go to the simulation as they change, it moves the camera
+// at its own rate for as long as they are held
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    if (action == GLFW_REPEAT) return;
+
+    bool pressed = action == GLFW_PRESS;
+    switch (key)
+    {
+        case GLFW_KEY_W: set_key(&sim, SIMULATION_KEY_FORWARD, pressed); break;
+        case GLFW_KEY_S: set_key(&sim, SIMULATION_KEY_BACK, pressed); break;
+        case GLFW_KEY_A: set_key(&sim, SIMULATION_KEY_LEFT, pressed); break;
+        case GLFW_KEY_D: set_key(&sim, SIMULATION_KEY_RIGHT, pressed); break;
     }
 }
 
@@ -408,12 +1427,12 @@ void mouse_callback(GLFWwindow *window, double mouse_x, double mouse_y)
     mouse_x_offset *= mouse_sensitivity;
     mouse_y_offset *= mouse_sensitivity;
 
-    rotate(&cam, -mouse_x_offset, -mouse_y_offset);
+    add_rotation(&sim, -mouse_x_offset, -mouse_y_offset);
 }
 
 void scroll_callback(GLFWwindow *window, double x_offset, double y_offset)
 {
-    zoom(&cam, y_offset);
+    add_zoom(&sim, y_offset);
 }
 
 
@@ -425,6 +1444,18 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height)
     screen_width = width;
     screen_height = height;
     glViewport(0, 0, width, height);
+    request_redraw(REDRAW_FRAMES);
+}
+
+// the window was uncovered or restored and its contents are gone
+void window_refresh_callback(GLFWwindow *window)
+{
+    request_redraw(REDRAW_FRAMES);
+}
+
+void request_redraw(u32 frame_count)
+{
+    if (frame_count > frames_to_draw) frames_to_draw = frame_count;
 }
 
 void window_size_callback(GLFWwindow *window, int width, int height)
@@ -0,0 +1,112 @@
+#include <float.h>
+#include <stddef.h>
+
+#include <glad/glad.h>
+
+#include "mesh.h"
+#include "stats.h"
+
+void compute_bounds(Mesh *mesh)
+{
+    mesh->bounds_min = glm::vec3(FLT_MAX);
+    mesh->bounds_max = glm::vec3(-FLT_MAX);
+
+    for (const Vertex &vertex : mesh->vertices)
+    {
+        mesh->bounds_min = glm::min(mesh->bounds_min, vertex.position);
+        mesh->bounds_max = glm::max(mesh->bounds_max, vertex.position);
+    }
+
+    if (mesh->vertices.empty())
+    {
+        mesh->bounds_min = glm::vec3(0.0f);
+        mesh->bounds_max = glm::vec3(0.0f);
+    }
+
+    for (MeshGroup &group : mesh->groups)
+    {
+        group.bounds_min = glm::vec3(FLT_MAX);
+        group.bounds_max = glm::vec3(-FLT_MAX);
+
+        for (u32 i = group.first_index; i < group.first_index + group.index_count; ++i)
+        {
+            const glm::vec3 &position = mesh->vertices[mesh->indices[i]].position;
+            group.bounds_min = glm::min(group.bounds_min, position);
+            group.bounds_max = glm::max(group.bounds_max, position);
+        }
+    }
+}
+
+void set_vertex_layout()
+{
+    // position attribute
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+    glEnableVertexAttribArray(0);
+
+    // texture coord attribute
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tex_coord));
+    glEnableVertexAttribArray(1);
+
+    // normal attribute
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+    glEnableVertexAttribArray(2);
+
+    // tangent attribute
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
+    glEnableVertexAttribArray(3);
+}
+
+s32 init(GpuMesh *gpu_mesh, const Mesh *mesh)
+{
+    return init(gpu_mesh,
+                mesh->vertices.data(), (u32)mesh->vertices.size(),
+                mesh->indices.data(), (u32)mesh->indices.size());
+}
+
+s32 init(GpuMesh *gpu_mesh, const Vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count)
+{
+    *gpu_mesh = {};
+
+    glGenVertexArrays(1, &gpu_mesh->VAO);
+    glGenBuffers(1, &gpu_mesh->VBO);
+    glGenBuffers(1, &gpu_mesh->EBO);
+
+    glBindVertexArray(gpu_mesh->VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, gpu_mesh->VBO);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertex_count * sizeof(Vertex), vertices, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu_mesh->EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)index_count * sizeof(u32), indices, GL_STATIC_DRAW);
+
+    set_vertex_layout();
+
+    glBindVertexArray(0);
+
+    gpu_mesh->index_count = index_count;
+
+    return 0;
+}
+
+void draw(GpuMesh *gpu_mesh)
+{
+    glBindVertexArray(gpu_mesh->VAO);
+    glDrawElements(GL_TRIANGLES, gpu_mesh->index_count, GL_UNSIGNED_INT, (void*)0);
+    count_draw(gpu_mesh->index_count);
+}
+
+void draw(GpuMesh *gpu_mesh, u32 first_index, u32 index_count)
+{
+    glBindVertexArray(gpu_mesh->VAO);
+    glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, (void*)((u64)first_index * sizeof(u32)));
+    count_draw(index_count);
+}
+
+void destroy(GpuMesh *gpu_mesh)
+{
+    if (gpu_mesh->VAO) glDeleteVertexArrays(1, &gpu_mesh->VAO);
+    if (gpu_mesh->VBO) glDeleteBuffers(1, &gpu_mesh->VBO);
+    if (gpu_mesh->EBO) glDeleteBuffers(1, &gpu_mesh->EBO);
+
+    *gpu_mesh = {};
+}
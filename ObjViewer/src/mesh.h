@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "types.h"
+
+// NOTE: layout must match set_vertex_layout() and the vertex shader inputs
+struct Vertex
+{
+    glm::vec3 position;
+    glm::vec2 tex_coord;
+    glm::vec3 normal;
+    glm::vec4 tangent; // w is the bitangent sign
+};
+
+#define MESH_NO_MATERIAL 0xFFFFFFFF
+
+// from an obj material library, only what the viewer draws
+struct Material
+{
+    std::string name;
+    std::string diffuse_texture; // map_Kd relative to the working directory, empty when none
+};
+
+// named range of triangles, from obj 'o', 'g' and 'usemtl' statements
+struct MeshGroup
+{
+    std::string object_name;
+    std::string group_name;
+    u32 material; // index in Mesh::materials or MESH_NO_MATERIAL
+
+    u32 first_index;
+    u32 index_count;
+
+    glm::vec3 bounds_min;
+    glm::vec3 bounds_max;
+};
+
+struct Mesh
+{
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+    std::vector<u32> smoothing_groups; // per triangle, empty when the source has none
+    std::vector<MeshGroup> groups;     // cover all the indices, in order
+    std::vector<Material> materials;
+
+    bool has_normals;
+
+    // world position the vertex positions are offsets from, the bounds are
+    // relative to it as well
+    glm::dvec3 origin;
+
+    glm::vec3 bounds_min;
+    glm::vec3 bounds_max;
+};
+
+struct GpuMesh
+{
+    u32 VAO;
+    u32 VBO;
+    u32 EBO;
+    u32 index_count;
+};
+
+// bounds of the whole mesh and of each group
+void compute_bounds(Mesh *mesh);
+
+// configures the attribute pointers of the currently bound VAO/VBO for Vertex
+void set_vertex_layout();
+
+s32 init(GpuMesh *gpu_mesh, const Mesh *mesh);
+s32 init(GpuMesh *gpu_mesh, const Vertex *vertices, u32 vertex_count, const u32 *indices, u32 index_count);
+
+void draw(GpuMesh *gpu_mesh);
+void draw(GpuMesh *gpu_mesh, u32 first_index, u32 index_count);
+
+void destroy(GpuMesh *gpu_mesh);
@@ -0,0 +1,668 @@
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "normals.h"
+#include "jobs.h"
+#include "profile.h"
+
+// triangles/vertices handed to a worker at a time
+#define NORMAL_BATCH_SIZE 4096
+
+// positions or vertices one worker groups the corners of in one go, its
+// counters span only this many
+#define NORMAL_KEYS_PER_RANGE (64 * 1024)
+
+NormalOptions default_normal_options()
+{
+    NormalOptions options;
+    options.angle_weighted = true;
+    options.use_smoothing_groups = true;
+    options.crease_angle = 180.0f;
+    return options;
+}
+
+// same index for vertices at exactly the same position, so normals are
+// shared across texture coordinate seams
+local u32
+weld_positions(const Mesh *mesh, std::vector<u32> *canonical)
+{
+    u32 vertex_count = (u32)mesh->vertices.size();
+
+    std::vector<u32> order(vertex_count);
+    std::iota(order.begin(), order.end(), 0);
+
+    const Vertex *vertices = mesh->vertices.data();
+    std::sort(order.begin(), order.end(), [vertices](u32 a, u32 b) {
+        const glm::vec3 &pa = vertices[a].position;
+        const glm::vec3 &pb = vertices[b].position;
+        if (pa.x != pb.x) return pa.x < pb.x;
+        if (pa.y != pb.y) return pa.y < pb.y;
+        return pa.z < pb.z;
+    });
+
+    canonical->resize(vertex_count);
+
+    u32 count = 0;
+    for (u32 i = 0; i < vertex_count; ++i)
+    {
+        if (i == 0 || vertices[order[i]].position != vertices[order[i - 1]].position) ++count;
+        (*canonical)[order[i]] = count - 1;
+    }
+
+    return count;
+}
+
+local inline float
+corner_angle(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+{
+    glm::vec3 e0 = b - a;
+    glm::vec3 e1 = c - a;
+    float length = sqrtf(glm::dot(e0, e0) * glm::dot(e1, e1));
+    if (length <= 0.0f) return 0.0f;
+    return acosf(glm::clamp(glm::dot(e0, e1) / length, -1.0f, 1.0f));
+}
+
+// corners grouped by a key, a position or a vertex: the corners of key k
+// are corners[offsets[k]] up to corners[offsets[k + 1]], in corner order
+struct CornerGroups
+{
+    std::vector<u32> offsets;
+    std::vector<u32> corners;
+};
+
+// a counting sort in two steps so no worker needs counters for every key:
+// the corners are first bucketed by range of keys, each batch of corners
+// into its own place in the bucket, then every range is sorted on its own
+template <typename KeyFunction>
+local void
+group_corners(u32 corner_count, u32 key_count, KeyFunction key_of, CornerGroups *groups)
+{
+    u32 ranges = glm::max((key_count + NORMAL_KEYS_PER_RANGE - 1) / NORMAL_KEYS_PER_RANGE, 1u);
+    u32 batches = glm::clamp(corner_count / NORMAL_BATCH_SIZE, 1u, worker_count() * 4);
+    u32 corners_per_batch = (corner_count + batches - 1) / batches;
+
+    std::vector<u32> cursors((size_t)batches * ranges, 0);
+    parallel_for(batches, 1, [&](u32 begin, u32 end, u32) {
+        for (u32 batch = begin; batch < end; ++batch)
+        {
+            u32 *counts = &cursors[(size_t)batch * ranges];
+            u32 last = glm::min((batch + 1) * corners_per_batch, corner_count);
+            for (u32 c = batch * corners_per_batch; c < last; ++c) ++counts[key_of(c) / NORMAL_KEYS_PER_RANGE];
+        }
+    });
+
+    std::vector<u32> range_offsets(ranges + 1);
+    u32 total = 0;
+    for (u32 range = 0; range < ranges; ++range)
+    {
+        range_offsets[range] = total;
+        for (u32 batch = 0; batch < batches; ++batch)
+        {
+            u32 count = cursors[(size_t)batch * ranges + range];
+            cursors[(size_t)batch * ranges + range] = total;
+            total += count;
+        }
+    }
+    range_offsets[ranges] = total;
+
+    std::vector<u32> bucketed(corner_count);
+    parallel_for(batches, 1, [&](u32 begin, u32 end, u32) {
+        for (u32 batch = begin; batch < end; ++batch)
+        {
+            u32 *cursor = &cursors[(size_t)batch * ranges];
+            u32 last = glm::min((batch + 1) * corners_per_batch, corner_count);
+            for (u32 c = batch * corners_per_batch; c < last; ++c) bucketed[cursor[key_of(c) / NORMAL_KEYS_PER_RANGE]++] = c;
+        }
+    });
+
+    groups->offsets.assign((size_t)key_count + 1, 0);
+    groups->corners.resize(corner_count);
+
+    parallel_for(ranges, 1, [&](u32 begin, u32 end, u32) {
+        for (u32 range = begin; range < end; ++range)
+        {
+            u32 first_key = range * NORMAL_KEYS_PER_RANGE;
+            u32 last_key = glm::min(first_key + NORMAL_KEYS_PER_RANGE, key_count);
+            u32 *offsets = groups->offsets.data();
+
+            for (u32 i = range_offsets[range]; i < range_offsets[range + 1]; ++i) ++offsets[key_of(bucketed[i])];
+
+            u32 running = range_offsets[range];
+            for (u32 key = first_key; key < last_key; ++key)
+            {
+                u32 count = offsets[key];
+                offsets[key] = running;
+                running += count;
+            }
+
+            // filling moves every offset to the end of its group, which is
+            // where the next group starts
+            for (u32 i = range_offsets[range]; i < range_offsets[range + 1]; ++i)
+            {
+                u32 c = bucketed[i];
+                groups->corners[offsets[key_of(c)]++] = c;
+            }
+            for (u32 key = last_key; key-- > first_key + 1;) offsets[key] = offsets[key - 1];
+            if (last_key > first_key) offsets[first_key] = range_offsets[range];
+        }
+    });
+
+    groups->offsets[key_count] = corner_count;
+}
+
+struct FaceNormal
+{
+    glm::vec3 normal;  // unit length
+    glm::vec3 weights; // per corner contribution
+};
+
+local void
+compute_face_normals(const Mesh *mesh, bool angle_weighted, std::vector<FaceNormal> *faces)
+{
+    u32 triangle_count = (u32)mesh->indices.size() / 3;
+    faces->resize(triangle_count);
+
+    const Vertex *vertices = mesh->vertices.data();
+    const u32 *indices = mesh->indices.data();
+    FaceNormal *out = faces->data();
+
+    parallel_for(triangle_count, NORMAL_BATCH_SIZE, [=](u32 begin, u32 end, u32) {
+        for (u32 t = begin; t < end; ++t)
+        {
+            const glm::vec3 &p0 = vertices[indices[t * 3 + 0]].position;
+            const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].position;
+
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float length = glm::length(n);
+
+            FaceNormal face;
+            face.normal = length > 0.0f ? n / length : glm::vec3(0.0f);
+
+            if (angle_weighted)
+            {
+                face.weights = glm::vec3(corner_angle(p0, p1, p2),
+                                         corner_angle(p1, p2, p0),
+                                         corner_angle(p2, p0, p1));
+            }
+            else
+            {
+                face.weights = glm::vec3(length);
+            }
+
+            out[t] = face;
+        }
+    });
+}
+
+// every face shares its normal with all the faces around a position:
+// each position gathers from its own corners, no atomics or per worker
+// copies of the normals involved
+local void
+smooth_normals(Mesh *mesh, const std::vector<FaceNormal> &faces)
+{
+    std::vector<u32> canonical;
+    u32 position_count = weld_positions(mesh, &canonical);
+
+    const u32 *indices = mesh->indices.data();
+    const u32 *canonical_index = canonical.data();
+    const FaceNormal *face_normals = faces.data();
+
+    CornerGroups groups;
+    group_corners((u32)mesh->indices.size(), position_count,
+                  [=](u32 c) { return canonical_index[indices[c]]; }, &groups);
+
+    std::vector<glm::vec3> normals(position_count);
+
+    parallel_for(position_count, NORMAL_BATCH_SIZE, [&](u32 begin, u32 end, u32) {
+        for (u32 p = begin; p < end; ++p)
+        {
+            glm::vec3 sum(0.0f);
+            for (u32 i = groups.offsets[p]; i < groups.offsets[p + 1]; ++i)
+            {
+                u32 c = groups.corners[i];
+                sum += face_normals[c / 3].normal * face_normals[c / 3].weights[c % 3];
+            }
+
+            float length = glm::length(sum);
+            normals[p] = length > 0.0f ? sum / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+    });
+
+    Vertex *vertices = mesh->vertices.data();
+    parallel_for((u32)mesh->vertices.size(), NORMAL_BATCH_SIZE, [&](u32 begin, u32 end, u32) {
+        for (u32 v = begin; v < end; ++v)
+        {
+            vertices[v].normal = normals[canonical_index[v]];
+        }
+    });
+}
+
+// the distinct normals around one position. With only smoothing groups
+// every group is one fan; with a crease angle two faces join the same fan
+// when they share an edge through the position and are in the same group
+// under the crease angle, so fans split at sharp edges without comparing
+// every pair of faces
+struct CreaseVertex
+{
+    u32 source;
+    glm::vec3 normal;
+};
+
+struct CreaseScratch
+{
+    std::vector<u32> corner_fans; // per corner of the position
+    std::vector<glm::vec3> fan_normals;
+    std::vector<u32> fan_groups;
+    std::vector<u32> parents;    // union find over the corners
+    std::vector<u64> edge_table; // (other end + 1) << 32 | corner, open addressing
+    std::vector<CreaseVertex> vertices;
+    std::vector<u32> vertex_table;    // vertex + 1, open addressing on (source, normal)
+    std::vector<u32> corner_vertices; // into vertices, per corner of the position
+};
+
+struct CreaseContext
+{
+    const CornerGroups *groups;
+    const FaceNormal *faces;
+    const u32 *indices;
+    const u32 *canonical;
+    const u32 *smoothing_groups; // null when every face is in the same group
+    float cos_crease;
+    bool crease_angle;           // under 180 degrees, fans follow edges
+};
+
+local inline u32
+face_group(const CreaseContext *ctx, u32 corner)
+{
+    return ctx->smoothing_groups ? ctx->smoothing_groups[corner / 3] : 1;
+}
+
+// group 0 is 's off', flat shaded, a fan of its own
+local inline bool
+can_share(const CreaseContext *ctx, u32 a, u32 b)
+{
+    u32 group = face_group(ctx, a);
+    return group != 0 && group == face_group(ctx, b) &&
+           glm::dot(ctx->faces[a / 3].normal, ctx->faces[b / 3].normal) >= ctx->cos_crease;
+}
+
+local u32
+find_root(std::vector<u32> *parents, u32 i)
+{
+    while ((*parents)[i] != i)
+    {
+        (*parents)[i] = (*parents)[(*parents)[i]];
+        i = (*parents)[i];
+    }
+    return i;
+}
+
+local void
+link_edge(const CreaseContext *ctx, CreaseScratch *scratch, u32 first, u32 local_corner, u32 other_end)
+{
+    std::vector<u64> &table = scratch->edge_table;
+    size_t mask = table.size() - 1;
+    u64 key = (u64)other_end + 1;
+    u32 corner = ctx->groups->corners[first + local_corner];
+
+    for (size_t slot = (size_t)(other_end * 0x9E3779B1u) & mask;; slot = (slot + 1) & mask)
+    {
+        if (table[slot] == 0)
+        {
+            table[slot] = key << 32 | local_corner;
+            return;
+        }
+        if (table[slot] >> 32 == key)
+        {
+            u32 other = (u32)table[slot];
+            if (can_share(ctx, corner, ctx->groups->corners[first + other]))
+            {
+                scratch->parents[find_root(&scratch->parents, local_corner)] = find_root(&scratch->parents, other);
+            }
+            return;
+        }
+    }
+}
+
+local void
+fan_position(const CreaseContext *ctx, u32 p, CreaseScratch *scratch)
+{
+    const CornerGroups *groups = ctx->groups;
+    u32 first = groups->offsets[p];
+    u32 count = groups->offsets[p + 1] - first;
+
+    scratch->corner_fans.assign(count, 0);
+    scratch->fan_normals.clear();
+    scratch->fan_groups.clear();
+
+    if (ctx->crease_angle)
+    {
+        scratch->parents.resize(count);
+        for (u32 i = 0; i < count; ++i) scratch->parents[i] = i;
+
+        size_t table_size = 4;
+        while (table_size < (size_t)count * 4) table_size *= 2;
+        scratch->edge_table.assign(table_size, 0);
+
+        for (u32 i = 0; i < count; ++i)
+        {
+            u32 c = groups->corners[first + i];
+            u32 t = c / 3;
+            link_edge(ctx, scratch, first, i, ctx->canonical[ctx->indices[t * 3 + (c + 1) % 3]]);
+            link_edge(ctx, scratch, first, i, ctx->canonical[ctx->indices[t * 3 + (c + 2) % 3]]);
+        }
+
+        // fans numbered in the order their first corner comes
+        for (u32 i = 0; i < count; ++i)
+        {
+            u32 root = find_root(&scratch->parents, i);
+            if (root == i)
+            {
+                scratch->corner_fans[i] = (u32)scratch->fan_normals.size();
+                scratch->fan_normals.push_back(glm::vec3(0.0f));
+            }
+            else
+            {
+                scratch->corner_fans[i] = scratch->corner_fans[root];
+            }
+        }
+    }
+    else
+    {
+        for (u32 i = 0; i < count; ++i)
+        {
+            u32 group = face_group(ctx, groups->corners[first + i]);
+            u32 fan = 0;
+            u32 fan_count = (u32)scratch->fan_groups.size();
+            if (group != 0)
+            {
+                while (fan < fan_count && scratch->fan_groups[fan] != group) ++fan;
+            }
+            else
+            {
+                fan = fan_count;
+            }
+
+            if (fan == fan_count)
+            {
+                scratch->fan_groups.push_back(group);
+                scratch->fan_normals.push_back(glm::vec3(0.0f));
+            }
+            scratch->corner_fans[i] = fan;
+        }
+    }
+
+    for (u32 i = 0; i < count; ++i)
+    {
+        u32 c = groups->corners[first + i];
+        scratch->fan_normals[scratch->corner_fans[i]] += ctx->faces[c / 3].normal * ctx->faces[c / 3].weights[c % 3];
+    }
+
+    for (glm::vec3 &n : scratch->fan_normals)
+    {
+        float length = glm::length(n);
+        if (length > 0.0f) n /= length;
+    }
+}
+
+// a fan whose faces cancel out takes the normal of the corner's own face
+local inline glm::vec3
+corner_normal(const CreaseContext *ctx, const CreaseScratch *scratch, u32 p, u32 local_corner)
+{
+    const glm::vec3 &n = scratch->fan_normals[scratch->corner_fans[local_corner]];
+    if (n != glm::vec3(0.0f)) return n;
+    return ctx->faces[ctx->groups->corners[ctx->groups->offsets[p] + local_corner] / 3].normal;
+}
+
+local inline u32
+vertex_hash(u32 source, const glm::vec3 &normal)
+{
+    u32 bits[3];
+    memcpy(bits, &normal, sizeof(bits));
+    return (source * 0x9E3779B1u) ^ (bits[0] * 0x85EBCA6Bu) ^ (bits[1] * 0xC2B2AE35u) ^ (bits[2] * 0x27D4EB2Fu);
+}
+
+// a vertex for every distinct (source vertex, normal) pair, fans that came
+// out with the same normal share it; corner_vertices gets the vertex of each
+local void
+emit_vertices(const CreaseContext *ctx, u32 p, CreaseScratch *scratch)
+{
+    const CornerGroups *groups = ctx->groups;
+    u32 first = groups->offsets[p];
+    u32 count = groups->offsets[p + 1] - first;
+
+    scratch->vertices.clear();
+    scratch->corner_vertices.resize(count);
+
+    // vertex + 1 per slot, 0 is empty
+    size_t table_size = 4;
+    while (table_size < (size_t)count * 2) table_size *= 2;
+    scratch->vertex_table.assign(table_size, 0);
+    size_t mask = table_size - 1;
+
+    for (u32 i = 0; i < count; ++i)
+    {
+        u32 source = ctx->indices[groups->corners[first + i]];
+        glm::vec3 normal = corner_normal(ctx, scratch, p, i);
+
+        size_t slot = vertex_hash(source, normal) & mask;
+        while (scratch->vertex_table[slot] != 0)
+        {
+            const CreaseVertex &vertex = scratch->vertices[scratch->vertex_table[slot] - 1];
+            if (vertex.source == source && vertex.normal == normal) break;
+            slot = (slot + 1) & mask;
+        }
+
+        if (scratch->vertex_table[slot] == 0)
+        {
+            scratch->vertices.push_back(CreaseVertex{source, normal});
+            scratch->vertex_table[slot] = (u32)scratch->vertices.size();
+        }
+        scratch->corner_vertices[i] = scratch->vertex_table[slot] - 1;
+    }
+}
+
+// faces only share normals with neighbours in the same smoothing group
+// and under the crease angle, vertices are split where they differ
+local void
+crease_normals(Mesh *mesh, const std::vector<FaceNormal> &faces, const NormalOptions &options)
+{
+    std::vector<u32> canonical;
+    u32 position_count = weld_positions(mesh, &canonical);
+
+    u32 corner_count = (u32)mesh->indices.size();
+    const u32 *indices = mesh->indices.data();
+    const u32 *canonical_index = canonical.data();
+
+    CornerGroups groups;
+    group_corners(corner_count, position_count, [=](u32 c) { return canonical_index[indices[c]]; }, &groups);
+
+    bool use_groups = options.use_smoothing_groups && !mesh->smoothing_groups.empty();
+
+    CreaseContext ctx;
+    ctx.groups = &groups;
+    ctx.faces = faces.data();
+    ctx.indices = indices;
+    ctx.canonical = canonical_index;
+    ctx.smoothing_groups = use_groups ? mesh->smoothing_groups.data() : nullptr;
+    ctx.cos_crease = cosf(glm::radians(glm::min(options.crease_angle, 180.0f)));
+    ctx.crease_angle = options.crease_angle < 180.0f;
+
+    std::vector<CreaseScratch> scratch(worker_count());
+
+    // vertices are counted per position first so the output slots can be
+    // assigned in parallel, the fans are worked out again to fill them
+    std::vector<u32> first_vertex(position_count + 1, 0);
+
+    parallel_for(position_count, NORMAL_BATCH_SIZE, [&](u32 begin, u32 end, u32 worker) {
+        CreaseScratch *local_scratch = &scratch[worker];
+        for (u32 p = begin; p < end; ++p)
+        {
+            fan_position(&ctx, p, local_scratch);
+            emit_vertices(&ctx, p, local_scratch);
+            first_vertex[p + 1] = (u32)local_scratch->vertices.size();
+        }
+    });
+
+    for (u32 p = 0; p < position_count; ++p) first_vertex[p + 1] += first_vertex[p];
+
+    std::vector<Vertex> vertices(first_vertex[position_count]);
+    std::vector<u32> new_index(corner_count);
+    const Vertex *source = mesh->vertices.data();
+
+    parallel_for(position_count, NORMAL_BATCH_SIZE, [&](u32 begin, u32 end, u32 worker) {
+        CreaseScratch *local_scratch = &scratch[worker];
+        for (u32 p = begin; p < end; ++p)
+        {
+            fan_position(&ctx, p, local_scratch);
+            emit_vertices(&ctx, p, local_scratch);
+
+            for (u32 v = 0; v < (u32)local_scratch->vertices.size(); ++v)
+            {
+                const CreaseVertex &vertex = local_scratch->vertices[v];
+                vertices[first_vertex[p] + v] = source[vertex.source];
+                vertices[first_vertex[p] + v].normal = vertex.normal;
+            }
+
+            for (u32 i = groups.offsets[p]; i < groups.offsets[p + 1]; ++i)
+            {
+                new_index[groups.corners[i]] = first_vertex[p] + local_scratch->corner_vertices[i - groups.offsets[p]];
+            }
+        }
+    });
+
+    mesh->vertices.swap(vertices);
+    mesh->indices.swap(new_index);
+}
+
+void generate_normals(Mesh *mesh, const NormalOptions &options)
+{
+    PROFILE_SCOPE("generate normals");
+
+    if (mesh->indices.empty()) return;
+
+    std::vector<FaceNormal> faces;
+    compute_face_normals(mesh, options.angle_weighted, &faces);
+
+    bool creases = options.crease_angle < 180.0f ||
+                   (options.use_smoothing_groups && !mesh->smoothing_groups.empty());
+
+    if (creases)
+    {
+        crease_normals(mesh, faces, options);
+    }
+    else
+    {
+        smooth_normals(mesh, faces);
+    }
+
+    mesh->has_normals = true;
+}
+
+void generate_tangents(Mesh *mesh)
+{
+    PROFILE_SCOPE("generate tangents");
+
+    u32 vertex_count = (u32)mesh->vertices.size();
+    u32 triangle_count = (u32)mesh->indices.size() / 3;
+    if (triangle_count == 0) return;
+
+    struct FaceTangent
+    {
+        glm::vec3 tangent;
+        glm::vec3 bitangent;
+    };
+
+    Vertex *vertices = mesh->vertices.data();
+    const u32 *indices = mesh->indices.data();
+
+    std::vector<FaceTangent> face_tangents(triangle_count);
+
+    parallel_for(triangle_count, NORMAL_BATCH_SIZE, [&](u32 begin, u32 end, u32) {
+        for (u32 t = begin; t < end; ++t)
+        {
+            const Vertex &v0 = vertices[indices[t * 3 + 0]];
+            const Vertex &v1 = vertices[indices[t * 3 + 1]];
+            const Vertex &v2 = vertices[indices[t * 3 + 2]];
+
+            glm::vec3 e1 = v1.position - v0.position;
+            glm::vec3 e2 = v2.position - v0.position;
+            glm::vec2 duv1 = v1.tex_coord - v0.tex_coord;
+            glm::vec2 duv2 = v2.tex_coord - v0.tex_coord;
+
+            // zero for faces without usable texture coordinates
+            float det = duv1.x * duv2.y - duv2.x * duv1.y;
+            if (fabsf(det) < 1e-20f)
+            {
+                face_tangents[t] = FaceTangent{glm::vec3(0.0f), glm::vec3(0.0f)};
+                continue;
+            }
+
+            float sign = det > 0.0f ? 1.0f : -1.0f;
+            face_tangents[t].tangent = (e1 * duv2.y - e2 * duv1.y) * sign;
+            face_tangents[t].bitangent = (e2 * duv1.x - e1 * duv2.x) * sign;
+        }
+    });
+
+    // every vertex gathers from its own corners
+    CornerGroups groups;
+    group_corners(triangle_count * 3, vertex_count, [=](u32 c) { return indices[c]; }, &groups);
+
+    parallel_for(vertex_count, NORMAL_BATCH_SIZE, [&](u32 begin, u32 end, u32) {
+        for (u32 v = begin; v < end; ++v)
+        {
+            const glm::vec3 &n = vertices[v].normal;
+            glm::vec3 sum_tangent(0.0f);
+            glm::vec3 sum_bitangent(0.0f);
+
+            for (u32 i = groups.offsets[v]; i < groups.offsets[v + 1]; ++i)
+            {
+                u32 c = groups.corners[i];
+                const FaceTangent &face = face_tangents[c / 3];
+                if (face.tangent == glm::vec3(0.0f) && face.bitangent == glm::vec3(0.0f)) continue;
+
+                u32 t = c / 3;
+                u32 corner = c % 3;
+                const glm::vec3 &p0 = vertices[indices[t * 3 + corner]].position;
+                const glm::vec3 &p1 = vertices[indices[t * 3 + (corner + 1) % 3]].position;
+                const glm::vec3 &p2 = vertices[indices[t * 3 + (corner + 2) % 3]].position;
+                float angle = corner_angle(p0, p1, p2);
+
+                // like MikkTSpace: project on the vertex tangent plane,
+                // normalize, then weight by the corner angle
+                glm::vec3 t_proj = face.tangent - n * glm::dot(n, face.tangent);
+                glm::vec3 b_proj = face.bitangent - n * glm::dot(n, face.bitangent);
+
+                float t_length = glm::length(t_proj);
+                float b_length = glm::length(b_proj);
+                if (t_length > 0.0f) t_proj /= t_length;
+                if (b_length > 0.0f) b_proj /= b_length;
+
+                sum_tangent += t_proj * angle;
+                sum_bitangent += b_proj * angle;
+            }
+
+            glm::vec3 t = sum_tangent - n * glm::dot(n, sum_tangent);
+
+            float length = glm::length(t);
+            if (length > 1e-12f)
+            {
+                t /= length;
+            }
+            else
+            {
+                // no usable texture coordinates, any vector on the tangent plane
+                glm::vec3 axis = fabsf(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                t = glm::normalize(glm::cross(axis, n));
+            }
+
+            float w = glm::dot(glm::cross(n, t), sum_bitangent) < 0.0f ? -1.0f : 1.0f;
+            vertices[v].tangent = glm::vec4(t, w);
+        }
+    });
+}
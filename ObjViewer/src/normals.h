@@ -0,0 +1,20 @@
+#pragma once
+
+#include "mesh.h"
+
+struct NormalOptions
+{
+    bool angle_weighted;       // weight face normals by the corner angle instead of the face area
+    bool use_smoothing_groups; // obj 's' groups, faces only share normals inside the same group
+    float crease_angle;        // degrees, faces meeting across an edge at a sharper angle get split normals
+};
+
+NormalOptions default_normal_options();
+
+// Replaces the vertex normals, vertices are split where a crease or a
+// smoothing group boundary needs different normals at the same position.
+void generate_normals(Mesh *mesh, const NormalOptions &options);
+
+// Per vertex tangents following the MikkTSpace conventions: tangent
+// orthogonalized against the normal, bitangent sign in w.
+void generate_tangents(Mesh *mesh);
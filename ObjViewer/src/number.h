@@ -0,0 +1,44 @@
+#pragma once
+
+#include "types.h"
+
+// Number and whitespace scanning for the text geometry formats, locale
+// independent.
+//
+// Floats and doubles round like strtof/strtod in the C locale. Numbers of
+// up to 19 significant digits take the exact double fast path when they
+// can, otherwise Eisel-Lemire: the digits times a 128 bit truncated power
+// of five, which decides the rounding by itself. Longer numbers that land
+// too close to a rounding boundary, hex, inf and nan go to strtod.
+//
+// Digits and spaces are scanned 8 or 16 bytes at a time, so every function
+// may read up to 16 bytes past the end of what it parses: the text needs
+// FILE_PADDING readable bytes after its terminator, which zero terminated
+// FileContent has.
+
+// all of them return the end of what they parsed, or at itself (and a zero
+// value) when there is no number there; leading spaces and tabs are skipped
+
+const char *parse_double(const char *at, double *value);
+const char *parse_float(const char *at, float *value);
+
+// decimal with an optional '-', saturates instead of overflowing
+const char *parse_index(const char *at, s64 *value);
+
+// obj face corner: v, v/vt, v//vn or v/vt/vn, the missing ones are 0
+const char *parse_face_corner(const char *at, s64 *v, s64 *vt, s64 *vn);
+
+// a 1 based (or negative, relative to the end of count) obj index as a 0
+// based one, -1 for the 0 parse_face_corner leaves when there is none
+inline s64 resolve_index(s64 index, u64 count)
+{
+    if (index > 0) return index - 1;
+    if (index < 0) return (s64)count + index;
+    return -1;
+}
+
+// spaces, tabs and carriage returns, not newlines
+const char *skip_spaces(const char *at);
+
+// the next '\n' or the terminator
+const char *find_line_end(const char *at);
@@ -0,0 +1,539 @@
+#include <math.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unordered_map>
+
+#include "obj.h"
+#include "file.h"
+#include "number.h"
+#include "log.h"
+#include "profile.h"
+
+// the mesh origin is the center of the bounds snapped to this grid, so
+// models that fit around the world origin keep their coordinates as they are
+#define OBJ_ORIGIN_GRID 1024.0
+
+struct ObjCorner
+{
+    s64 v;
+    s64 vt;
+    s64 vn;
+
+    bool operator==(const ObjCorner &other) const
+    {
+        return v == other.v && vt == other.vt && vn == other.vn;
+    }
+};
+
+struct ObjCornerHash
+{
+    size_t operator()(const ObjCorner &corner) const
+    {
+        u64 h = (u64)corner.v * 0x9E3779B97F4A7C15ull;
+        h ^= (u64)(corner.vt + 1) * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+        h ^= (u64)(corner.vn + 1) * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+        return (size_t)h;
+    }
+};
+
+local inline bool
+is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// after a keyword; a bare 'g' or 'usemtl' resets the group or material
+local inline bool
+ends_keyword(char c)
+{
+    return is_space(c) || c == '\n' || c == 0;
+}
+
+local inline const char *
+skip_line(const char *at)
+{
+    at = find_line_end(at);
+    if (*at == '\n') ++at;
+    return at;
+}
+
+// rest of the line without trailing spaces
+local const char *
+line_end(const char *at)
+{
+    const char *end = find_line_end(at);
+    while (end > at && is_space(end[-1])) --end;
+    return end;
+}
+
+// a line ending in '\' continues on the next one: blanking the '\' and the
+// newline joins them in place, warnings count the joined lines as one
+local void
+join_continued_lines(char *text, u64 size)
+{
+    char *end = text + size;
+    char *at = text;
+    while ((at = (char *)memchr(at, '\\', (size_t)(end - at))) != nullptr)
+    {
+        char *next = at + 1;
+        if (next < end && *next == '\r') ++next;
+        if (next == end || *next == '\n')
+        {
+            // on the last line of the file it continues into nothing
+            if (next == end) --next;
+            memset(at, ' ', (size_t)(next - at + 1));
+            at = next + 1;
+        }
+        else
+        {
+            at += 1;
+        }
+    }
+}
+
+local u32
+find_material(const Mesh *mesh, const std::string &name)
+{
+    for (u32 i = 0; i < (u32)mesh->materials.size(); ++i)
+    {
+        if (mesh->materials[i].name == name) return i;
+    }
+    return MESH_NO_MATERIAL;
+}
+
+// newmtl and map_Kd, paths in the library are relative to its directory
+local void
+load_mtl(Mesh *mesh, const char *filename)
+{
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+    {
+        LOG_W("Cannot open material library '%s'", filename);
+        return;
+    }
+    fclose(file);
+
+    FileContent fc = read_entire_file_in_memory_and_zero_terminate(filename, true);
+    if (!fc.data) return;
+
+    std::string directory = directory_of(filename);
+    Material *material = nullptr;
+
+    const char *at = (const char *)fc.data;
+    while (*at)
+    {
+        at = skip_spaces(at);
+        const char *end = line_end(at);
+
+        if (strncmp(at, "newmtl", 6) == 0 && is_space(at[6]))
+        {
+            std::string name(skip_spaces(at + 6), end);
+            u32 index = find_material(mesh, name);
+            if (index == MESH_NO_MATERIAL)
+            {
+                index = (u32)mesh->materials.size();
+                mesh->materials.push_back(Material{name, std::string()});
+            }
+            material = &mesh->materials[index];
+        }
+        else if (material && strncmp(at, "map_Kd", 6) == 0 && is_space(at[6]))
+        {
+            // options like -s 1 1 1 come first, the path is the last word
+            const char *path = end;
+            while (path > at && !is_space(path[-1])) --path;
+            material->diffuse_texture = directory + std::string(path, end);
+        }
+
+        at = skip_line(at);
+    }
+
+    delete_file_content(&fc);
+}
+
+glm::dvec3 obj_origin(const glm::dvec3 &bounds_min, const glm::dvec3 &bounds_max)
+{
+    glm::dvec3 center = (bounds_min + bounds_max) * 0.5;
+    return glm::dvec3(floor(center.x / OBJ_ORIGIN_GRID + 0.5),
+                      floor(center.y / OBJ_ORIGIN_GRID + 0.5),
+                      floor(center.z / OBJ_ORIGIN_GRID + 0.5)) * OBJ_ORIGIN_GRID;
+}
+
+s32 load_obj(Mesh *mesh, const char *filename)
+{
+    return load_obj(mesh, filename, nullptr);
+}
+
+s32 load_obj(Mesh *mesh, const char *filename, std::atomic<float> *progress)
+{
+    PROFILE_SCOPE("load obj");
+
+    FileContent fc = read_entire_file_in_memory_and_zero_terminate(filename, true);
+
+    if (!fc.data)
+    {
+        return -1;
+    }
+
+    join_continued_lines((char *)fc.data, fc.size);
+
+    // positions stay double until the origin is known, vertices remember
+    // which one they use and get their float offset at the end
+    std::vector<glm::dvec3> positions;
+    std::vector<u32> vertex_positions;
+    std::vector<glm::vec2> tex_coords;
+    std::vector<glm::vec3> normals;
+    std::unordered_map<ObjCorner, u32, ObjCornerHash> vertex_lookup;
+
+    mesh->vertices.clear();
+    mesh->indices.clear();
+    mesh->smoothing_groups.clear();
+    mesh->groups.clear();
+    mesh->materials.clear();
+
+    std::string directory = directory_of(filename);
+    std::string object_name;
+    std::string group_name;
+    u32 material = MESH_NO_MATERIAL;
+
+    u32 smoothing_group = 0;
+    bool has_smoothing_groups = false;
+    bool missing_normals = false;
+
+    u32 polygon[64];
+    u32 line_number = 0;
+
+    const char *at = (const char *)fc.data;
+    while (*at)
+    {
+        ++line_number;
+
+        if (progress && (line_number & 0xFFFF) == 0)
+        {
+            progress->store((float)(at - (const char *)fc.data) / fc.size, std::memory_order_relaxed);
+        }
+        at = skip_spaces(at);
+
+        if (at[0] == 'v' && is_space(at[1]))
+        {
+            glm::dvec3 p;
+            at = parse_double(at + 1, &p.x);
+            at = parse_double(at, &p.y);
+            at = parse_double(at, &p.z);
+            positions.push_back(p);
+        }
+        else if (at[0] == 'v' && at[1] == 't' && is_space(at[2]))
+        {
+            glm::vec2 t;
+            at = parse_float(at + 2, &t.x);
+            at = parse_float(at, &t.y);
+            tex_coords.push_back(t);
+        }
+        else if (at[0] == 'v' && at[1] == 'n' && is_space(at[2]))
+        {
+            glm::vec3 n;
+            at = parse_float(at + 2, &n.x);
+            at = parse_float(at, &n.y);
+            at = parse_float(at, &n.z);
+            normals.push_back(n);
+        }
+        else if (at[0] == 's' && is_space(at[1]))
+        {
+            at = skip_spaces(at + 1);
+            smoothing_group = (strncmp(at, "off", 3) == 0) ? 0 : (u32)strtoul(at, nullptr, 10);
+            has_smoothing_groups = true;
+        }
+        else if ((at[0] == 'o' || at[0] == 'g') && ends_keyword(at[1]))
+        {
+            const char *name = skip_spaces(at + 1);
+            const char *name_end = name;
+            while (*name_end && *name_end != '\n' && *name_end != '\r') ++name_end;
+
+            if (at[0] == 'o')
+            {
+                object_name.assign(name, name_end);
+                group_name.clear();
+            }
+            else
+            {
+                group_name.assign(name, name_end);
+            }
+
+            at = name_end;
+        }
+        else if (strncmp(at, "mtllib", 6) == 0 && is_space(at[6]))
+        {
+            const char *end = line_end(at);
+            load_mtl(mesh, (directory + std::string(skip_spaces(at + 6), end)).c_str());
+            at = end;
+        }
+        else if (strncmp(at, "usemtl", 6) == 0 && ends_keyword(at[6]))
+        {
+            const char *end = line_end(at);
+            std::string name(skip_spaces(at + 6), end);
+
+            material = find_material(mesh, name);
+            if (material == MESH_NO_MATERIAL && !name.empty())
+            {
+                LOG_W("%s:%u unknown material '%s'", filename, line_number, name.c_str());
+            }
+            at = end;
+        }
+        else if (at[0] == 'f' && is_space(at[1]))
+        {
+            at += 1;
+
+            if (mesh->groups.empty() ||
+                mesh->groups.back().object_name != object_name ||
+                mesh->groups.back().group_name != group_name ||
+                mesh->groups.back().material != material)
+            {
+                MeshGroup group = {};
+                group.object_name = object_name;
+                group.group_name = group_name;
+                group.material = material;
+                group.first_index = (u32)mesh->indices.size();
+                mesh->groups.push_back(group);
+            }
+
+            u32 corner_count = 0;
+            for (;;)
+            {
+                at = skip_spaces(at);
+                if (*at == '\n' || *at == '\0') break;
+
+                s64 v, vt, vn;
+                at = parse_face_corner(at, &v, &vt, &vn);
+                v = resolve_index(v, positions.size());
+                vt = resolve_index(vt, tex_coords.size());
+                vn = resolve_index(vn, normals.size());
+
+                while (*at && !is_space(*at) && *at != '\n') ++at;
+
+                if (v < 0 || v >= (s64)positions.size() ||
+                    vt >= (s64)tex_coords.size() ||
+                    vn >= (s64)normals.size())
+                {
+                    LOG_W("%s:%u invalid face index", filename, line_number);
+                    continue;
+                }
+
+                if (vn < 0) missing_normals = true;
+
+                ObjCorner key = {v, vt, vn};
+                auto it = vertex_lookup.find(key);
+                u32 vertex_index;
+                if (it == vertex_lookup.end())
+                {
+                    Vertex vertex = {};
+                    if (vt >= 0) vertex.tex_coord = tex_coords[(size_t)vt];
+                    if (vn >= 0) vertex.normal = normals[(size_t)vn];
+
+                    vertex_index = (u32)mesh->vertices.size();
+                    mesh->vertices.push_back(vertex);
+                    vertex_positions.push_back((u32)v);
+                    vertex_lookup.emplace(key, vertex_index);
+                }
+                else
+                {
+                    vertex_index = it->second;
+                }
+
+                if (corner_count < ArrayCount(polygon))
+                {
+                    polygon[corner_count++] = vertex_index;
+                }
+            }
+
+            for (u32 corner = 2; corner < corner_count; ++corner)
+            {
+                mesh->indices.push_back(polygon[0]);
+                mesh->indices.push_back(polygon[corner - 1]);
+                mesh->indices.push_back(polygon[corner]);
+                mesh->smoothing_groups.push_back(smoothing_group);
+            }
+        }
+
+        at = skip_line(at);
+    }
+
+    delete_file_content(&fc);
+    if (progress) progress->store(1.0f, std::memory_order_relaxed);
+
+    for (size_t i = 0; i < mesh->groups.size(); ++i)
+    {
+        u32 end = i + 1 < mesh->groups.size() ? mesh->groups[i + 1].first_index : (u32)mesh->indices.size();
+        mesh->groups[i].index_count = end - mesh->groups[i].first_index;
+    }
+
+    if (!has_smoothing_groups)
+    {
+        mesh->smoothing_groups.clear();
+    }
+
+    mesh->has_normals = !missing_normals && !mesh->indices.empty();
+
+    // only the positions faces use count, stray ones would move the origin
+    glm::dvec3 used_min(DBL_MAX);
+    glm::dvec3 used_max(-DBL_MAX);
+    for (u32 position : vertex_positions)
+    {
+        used_min = glm::min(used_min, positions[position]);
+        used_max = glm::max(used_max, positions[position]);
+    }
+
+    mesh->origin = vertex_positions.empty() ? glm::dvec3(0.0) : obj_origin(used_min, used_max);
+
+    for (size_t i = 0; i < mesh->vertices.size(); ++i)
+    {
+        mesh->vertices[i].position = glm::vec3(positions[vertex_positions[i]] - mesh->origin);
+    }
+
+    compute_bounds(mesh);
+
+    LOG_I("Loaded '%s': %u vertices, %u triangles, %u materials",
+          filename, (u32)mesh->vertices.size(), (u32)mesh->indices.size() / 3, (u32)mesh->materials.size());
+    if (mesh->origin != glm::dvec3(0.0))
+    {
+        LOG_I("Vertices are relative to [%.1f %.1f %.1f]", mesh->origin.x, mesh->origin.y, mesh->origin.z);
+    }
+
+    return 0;
+}
+
+// the mtl sits next to the obj, its texture paths are made relative to it
+local s32
+save_mtl(const Mesh *mesh, const char *filename, const std::string &directory)
+{
+    FILE *file = fopen(filename, "wb");
+    if (!file)
+    {
+        LOG_W("Cannot open '%s' for writing", filename);
+        return -1;
+    }
+
+    for (const Material &material : mesh->materials)
+    {
+        fprintf(file, "newmtl %s\n", material.name.c_str());
+        if (!material.diffuse_texture.empty())
+        {
+            const std::string &path = material.diffuse_texture;
+            bool inside = !directory.empty() && path.compare(0, directory.size(), directory) == 0;
+            fprintf(file, "map_Kd %s\n", inside ? path.c_str() + directory.size() : path.c_str());
+        }
+        fprintf(file, "\n");
+    }
+
+    fclose(file);
+    return 0;
+}
+
+// the keyword alone when name is empty, which sets the state back to none
+local void
+write_state_line(FILE *file, const char *keyword, const std::string &name)
+{
+    if (name.empty()) fprintf(file, "%s\n", keyword);
+    else fprintf(file, "%s %s\n", keyword, name.c_str());
+}
+
+s32 save_obj(const Mesh *mesh, const char *filename)
+{
+    PROFILE_SCOPE("save obj");
+
+    FILE *file = fopen(filename, "wb");
+    if (!file)
+    {
+        LOG_W("Cannot open '%s' for writing", filename);
+        return -1;
+    }
+
+    std::string directory = directory_of(filename);
+    if (!mesh->materials.empty())
+    {
+        std::string mtl_filename = filename;
+        size_t dot = mtl_filename.find_last_of('.');
+        if (dot != std::string::npos && dot >= directory.size()) mtl_filename.resize(dot);
+        mtl_filename += ".mtl";
+
+        if (save_mtl(mesh, mtl_filename.c_str(), directory) != 0)
+        {
+            fclose(file);
+            return -1;
+        }
+        fprintf(file, "mtllib %s\n", mtl_filename.c_str() + directory.size());
+    }
+
+    // vertices are already unique per position/uv/normal, so the three
+    // streams share one index
+    for (const Vertex &vertex : mesh->vertices)
+    {
+        // the sum is a double, nine digits would round coordinates in the
+        // millions to whole units; fifteen as the converter writes them
+        glm::dvec3 p = mesh->origin + glm::dvec3(vertex.position);
+        fprintf(file, "v %.15g %.15g %.15g\n", p.x, p.y, p.z);
+    }
+    for (const Vertex &vertex : mesh->vertices)
+    {
+        fprintf(file, "vt %.7g %.7g\n", vertex.tex_coord.x, vertex.tex_coord.y);
+    }
+    if (mesh->has_normals)
+    {
+        for (const Vertex &vertex : mesh->vertices)
+        {
+            fprintf(file, "vn %.7g %.7g %.7g\n", vertex.normal.x, vertex.normal.y, vertex.normal.z);
+        }
+    }
+
+    // the loader carries object, group and material over to the next faces,
+    // so every change is written, back to none included
+    const MeshGroup *previous = nullptr;
+    for (const MeshGroup &group : mesh->groups)
+    {
+        bool new_object = !previous || previous->object_name != group.object_name;
+        if (new_object)
+        {
+            write_state_line(file, "o", group.object_name);
+        }
+
+        // an 'o' line clears the group already
+        if (new_object ? !group.group_name.empty() : previous->group_name != group.group_name)
+        {
+            write_state_line(file, "g", group.group_name);
+        }
+
+        u32 previous_material = previous ? previous->material : MESH_NO_MATERIAL;
+        if (group.material != previous_material)
+        {
+            write_state_line(file, "usemtl",
+                             group.material != MESH_NO_MATERIAL ? mesh->materials[group.material].name : std::string());
+        }
+        previous = &group;
+
+        for (u32 i = group.first_index; i + 2 < group.first_index + group.index_count; i += 3)
+        {
+            u32 a = mesh->indices[i + 0] + 1;
+            u32 b = mesh->indices[i + 1] + 1;
+            u32 c = mesh->indices[i + 2] + 1;
+            if (mesh->has_normals)
+            {
+                fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+            }
+            else
+            {
+                fprintf(file, "f %u/%u %u/%u %u/%u\n", a, a, b, b, c, c);
+            }
+        }
+    }
+
+    bool ok = !ferror(file);
+    fclose(file);
+
+    if (!ok)
+    {
+        LOG_W("Writing '%s' failed", filename);
+        return -1;
+    }
+
+    return 0;
+}
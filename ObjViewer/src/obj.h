@@ -0,0 +1,27 @@
+#pragma once
+
+#include <atomic>
+
+#include "mesh.h"
+
+// Loads the geometry of a wavefront .obj file (v, vt, vn, f, s) into an
+// indexed triangle mesh, polygons are fan triangulated.
+// has_normals is false when any face corner lacks a vn reference.
+// Every change of 'o'/'g'/'usemtl' starts a new MeshGroup. Materials come
+// from the 'mtllib' files, of those only the names and map_Kd are read.
+// Positions are read in double and stored as float offsets from
+// Mesh::origin, so georeferenced scans with coordinates in the millions
+// keep their precision.
+s32 load_obj(Mesh *mesh, const char *filename);
+
+// progress goes from 0 to 1 as the file is parsed, for another thread to show
+s32 load_obj(Mesh *mesh, const char *filename, std::atomic<float> *progress);
+
+// the origin load_obj picks for positions within these bounds: their
+// center snapped to a coarse grid
+glm::dvec3 obj_origin(const glm::dvec3 &bounds_min, const glm::dvec3 &bounds_max);
+
+// writes positions (plus the origin), texture coordinates, normals when the
+// mesh has them, one o/g/usemtl per group and a .mtl next to the file with
+// map_Kd relative to it
+s32 save_obj(const Mesh *mesh, const char *filename);
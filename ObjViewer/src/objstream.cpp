@@ -0,0 +1,340 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "objstream.h"
+#include "number.h"
+#include "file.h"
+#include "log.h"
+
+ObjStreamOptions default_obj_stream_options()
+{
+    ObjStreamOptions options;
+    options.read_size = 1 << 20;
+    options.block_records = 64 * 1024;
+    return options;
+}
+
+s32 init(ObjStream *stream, const char *filename, const ObjStreamOptions &options)
+{
+    stream->options = options;
+    stream->filename = filename;
+    stream->file = fopen(filename, "rb");
+    if (!stream->file)
+    {
+        LOG_W("Cannot open '%s' for reading", filename);
+        return -1;
+    }
+
+    stream->end_of_file = false;
+    stream->failed = false;
+    stream->buffer.assign((size_t)glm::max(options.read_size, 4096u) + FILE_PADDING, 0);
+    stream->begin = 0;
+    stream->end = 0;
+    stream->joined.clear();
+    stream->bytes_read = 0;
+    stream->line_number = 0;
+
+    stream->position_count = 0;
+    stream->tex_coord_count = 0;
+    stream->normal_count = 0;
+    stream->state = ObjStreamState{};
+    stream->state_changed = true;
+    stream->has_smoothing_groups = false;
+
+    return 0;
+}
+
+void destroy(ObjStream *stream)
+{
+    if (stream->file) fclose(stream->file);
+    stream->file = nullptr;
+
+    std::vector<char>().swap(stream->buffer);
+    stream->block = ObjStreamBlock{};
+}
+
+local inline bool
+is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// after a keyword; a bare 'g' or 'usemtl' resets the group or material
+local inline bool
+ends_keyword(char c)
+{
+    return is_space(c) || c == '\n' || c == 0;
+}
+
+// moves the unparsed rest to the front and reads behind it, the buffer
+// only grows when one line fills all of it
+local void
+refill(ObjStream *stream)
+{
+    char *data = stream->buffer.data();
+    u64 remaining = stream->end - stream->begin;
+    memmove(data, data + stream->begin, (size_t)remaining);
+    stream->begin = 0;
+    stream->end = remaining;
+
+    u64 capacity = stream->buffer.size() - FILE_PADDING;
+    if (remaining == capacity)
+    {
+        capacity *= 2;
+        stream->buffer.resize((size_t)capacity + FILE_PADDING);
+        data = stream->buffer.data();
+    }
+
+    size_t wanted = (size_t)(capacity - remaining);
+    size_t read = fread(data + remaining, 1, wanted, stream->file);
+    if (read < wanted)
+    {
+        stream->end_of_file = true;
+        if (ferror(stream->file))
+        {
+            LOG_W("Error reading '%s'", stream->filename.c_str());
+            stream->failed = true;
+        }
+    }
+
+    stream->end += read;
+    stream->bytes_read += read;
+    memset(data + stream->end, 0, FILE_PADDING);
+}
+
+// the physical line ends with a '\', carriage return aside
+local inline bool
+is_continued(const char *line, const char *line_end)
+{
+    if (line_end > line && line_end[-1] == '\r') --line_end;
+    return line_end > line && line_end[-1] == '\\';
+}
+
+// the next logical line, false when it is not all in the buffer yet
+local bool
+next_line(ObjStream *stream, const char **line, const char **line_end)
+{
+    const char *data = stream->buffer.data();
+    const char *limit = data + stream->end;
+    const char *at = data + stream->begin;
+
+    // a zero in the file ends its line like a newline would
+    const char *end = find_line_end(at);
+    if (end == limit && !stream->end_of_file) return false;
+
+    if (!is_continued(at, end))
+    {
+        *line = at;
+        *line_end = end;
+        stream->begin = (u64)(end - data) + (end < limit);
+        ++stream->line_number;
+        return true;
+    }
+
+    // the pieces go together with a space where the '\' and newline were
+    stream->joined.clear();
+    u32 lines = 1;
+    while (is_continued(at, end) && end < limit)
+    {
+        const char *piece_end = end[-1] == '\r' ? end - 2 : end - 1;
+        stream->joined.append(at, piece_end);
+        stream->joined += ' ';
+
+        at = end + 1;
+        end = find_line_end(at);
+        if (end == limit && !stream->end_of_file) return false;
+        ++lines;
+    }
+
+    // a '\' on the last line of the file continues into nothing
+    const char *piece_end = end;
+    if (is_continued(at, end)) piece_end = end[-1] == '\r' ? end - 2 : end - 1;
+    stream->joined.append(at, piece_end);
+
+    stream->begin = (u64)(end - data) + (end < limit);
+    stream->line_number += lines;
+
+    size_t length = stream->joined.size();
+    stream->joined.append(FILE_PADDING, '\0');
+    *line = stream->joined.data();
+    *line_end = stream->joined.data() + length;
+    return true;
+}
+
+// the rest of the line without surrounding spaces
+local std::string
+line_text(const char *at, const char *line_end)
+{
+    at = skip_spaces(at);
+    while (line_end > at && is_space(line_end[-1])) --line_end;
+    return std::string(at, line_end);
+}
+
+local void
+parse_face(ObjStream *stream, const char *at, const char *line_end)
+{
+    ObjStreamBlock *block = &stream->block;
+    u32 first_corner = (u32)block->corners.size();
+
+    for (;;)
+    {
+        at = skip_spaces(at);
+        if (at >= line_end) break;
+
+        ObjStreamCorner corner;
+        at = parse_face_corner(at, &corner.v, &corner.vt, &corner.vn);
+        while (at < line_end && !is_space(*at)) ++at;
+
+        corner.v = resolve_index(corner.v, stream->position_count);
+        corner.vt = resolve_index(corner.vt, stream->tex_coord_count);
+        corner.vn = resolve_index(corner.vn, stream->normal_count);
+
+        if (corner.v < 0 || corner.v >= (s64)stream->position_count ||
+            corner.vt >= (s64)stream->tex_coord_count ||
+            corner.vn >= (s64)stream->normal_count)
+        {
+            LOG_W("%s:%u invalid face index", stream->filename.c_str(), stream->line_number);
+            continue;
+        }
+
+        if (corner.vt < 0) corner.vt = -1;
+        if (corner.vn < 0) corner.vn = -1;
+        block->corners.push_back(corner);
+    }
+
+    u32 corner_count = (u32)block->corners.size() - first_corner;
+    if (corner_count < 3)
+    {
+        block->corners.resize(first_corner);
+        return;
+    }
+
+    if (stream->state_changed)
+    {
+        block->states.push_back(stream->state);
+        stream->state_changed = false;
+    }
+
+    block->faces.push_back(ObjStreamFace{first_corner, corner_count, (u32)block->states.size() - 1});
+}
+
+// returns the vertex and face records the line added
+local u32
+parse_line(ObjStream *stream, const char *at, const char *line_end)
+{
+    ObjStreamBlock *block = &stream->block;
+    at = skip_spaces(at);
+
+    if (at[0] == 'v' && is_space(at[1]))
+    {
+        glm::dvec3 p;
+        at = parse_double(at + 1, &p.x);
+        at = parse_double(at, &p.y);
+        parse_double(at, &p.z);
+        block->positions.push_back(p);
+        ++stream->position_count;
+        return 1;
+    }
+
+    if (at[0] == 'v' && at[1] == 't' && is_space(at[2]))
+    {
+        glm::vec2 t;
+        at = parse_float(at + 2, &t.x);
+        parse_float(at, &t.y);
+        block->tex_coords.push_back(t);
+        ++stream->tex_coord_count;
+        return 1;
+    }
+
+    if (at[0] == 'v' && at[1] == 'n' && is_space(at[2]))
+    {
+        glm::vec3 n;
+        at = parse_float(at + 2, &n.x);
+        at = parse_float(at, &n.y);
+        parse_float(at, &n.z);
+        block->normals.push_back(n);
+        ++stream->normal_count;
+        return 1;
+    }
+
+    if (at[0] == 'f' && is_space(at[1]))
+    {
+        u32 faces = (u32)block->faces.size();
+        parse_face(stream, at + 1, line_end);
+        return (u32)block->faces.size() - faces;
+    }
+
+    if (at[0] == 'o' && ends_keyword(at[1]))
+    {
+        stream->state.object_name = line_text(at + 1, line_end);
+        stream->state.group_name.clear();
+        stream->state_changed = true;
+    }
+    else if (at[0] == 'g' && ends_keyword(at[1]))
+    {
+        stream->state.group_name = line_text(at + 1, line_end);
+        stream->state_changed = true;
+    }
+    else if (strncmp(at, "usemtl", 6) == 0 && ends_keyword(at[6]))
+    {
+        stream->state.material = line_text(at + 6, line_end);
+        stream->state_changed = true;
+    }
+    else if (at[0] == 's' && is_space(at[1]))
+    {
+        std::string group = line_text(at + 1, line_end);
+        stream->state.smoothing_group = group == "off" ? 0 : (u32)strtoul(group.c_str(), nullptr, 10);
+        stream->state_changed = true;
+        stream->has_smoothing_groups = true;
+    }
+    else if (strncmp(at, "mtllib", 6) == 0 && is_space(at[6]))
+    {
+        block->material_libraries.push_back(line_text(at + 6, line_end));
+    }
+
+    return 0;
+}
+
+bool read_block(ObjStream *stream)
+{
+    ObjStreamBlock *block = &stream->block;
+    block->first_position = stream->position_count;
+    block->first_tex_coord = stream->tex_coord_count;
+    block->first_normal = stream->normal_count;
+    block->positions.clear();
+    block->tex_coords.clear();
+    block->normals.clear();
+    block->corners.clear();
+    block->faces.clear();
+    block->states.clear();
+    block->material_libraries.clear();
+
+    // the first face of the block needs its state even when it did not change
+    stream->state_changed = true;
+
+    if (!stream->file) return false;
+
+    u32 records = 0;
+    while (records < stream->options.block_records)
+    {
+        if (stream->begin == stream->end)
+        {
+            if (stream->end_of_file) break;
+            refill(stream);
+            continue;
+        }
+
+        const char *line;
+        const char *line_end;
+        if (!next_line(stream, &line, &line_end))
+        {
+            refill(stream);
+            continue;
+        }
+
+        records += parse_line(stream, line, line_end);
+    }
+
+    return !block->positions.empty() || !block->tex_coords.empty() || !block->normals.empty() ||
+           !block->faces.empty() || !block->material_libraries.empty();
+}
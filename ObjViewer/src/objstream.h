@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "types.h"
+
+// Pull based OBJ reading in bounded memory, for batch jobs that never need
+// the whole model at once.
+//
+// The file is read options.read_size bytes at a time and handed out in
+// blocks of at most options.block_records vertex and face records, in file
+// order. Indices come out 0 based and absolute, negative (relative) ones
+// resolved against what was read before them, and lines ending in '\'
+// continue on the next one. Memory is the read buffer plus one block
+// whatever the size of the file; only a single line longer than the buffer
+// grows it.
+//
+//   ObjStream stream;
+//   init(&stream, "model.obj", default_obj_stream_options());
+//   while (read_block(&stream)) { ...stream.block... }
+//   destroy(&stream);
+
+struct ObjStreamOptions
+{
+    u32 read_size;
+    u32 block_records;
+};
+
+ObjStreamOptions default_obj_stream_options();
+
+// -1 for a missing tex coord or normal
+struct ObjStreamCorner
+{
+    s64 v;
+    s64 vt;
+    s64 vn;
+};
+
+// o, g, usemtl and s as they were for the faces that follow
+struct ObjStreamState
+{
+    std::string object_name;
+    std::string group_name;
+    std::string material;
+    u32 smoothing_group;
+};
+
+struct ObjStreamFace
+{
+    u32 first_corner;
+    u32 corner_count; // 3 or more
+    u32 state;        // into ObjStreamBlock::states
+};
+
+struct ObjStreamBlock
+{
+    // file wide index of the first position, tex coord and normal below
+    u64 first_position;
+    u64 first_tex_coord;
+    u64 first_normal;
+
+    std::vector<glm::dvec3> positions;
+    std::vector<glm::vec2> tex_coords;
+    std::vector<glm::vec3> normals;
+
+    std::vector<ObjStreamCorner> corners;
+    std::vector<ObjStreamFace> faces;
+    std::vector<ObjStreamState> states; // the first face of a block always starts one
+
+    std::vector<std::string> material_libraries; // as written in the file
+};
+
+struct ObjStream
+{
+    ObjStreamOptions options;
+    std::string filename;
+
+    FILE *file;
+    bool end_of_file;
+    bool failed; // a read error, the blocks so far are all there is
+
+    // unparsed text in [begin, end), FILE_PADDING zeros behind it
+    std::vector<char> buffer;
+    u64 begin;
+    u64 end;
+    std::string joined; // a line with continuations, put together
+
+    u64 bytes_read;
+    u32 line_number;
+
+    u64 position_count;
+    u64 tex_coord_count;
+    u64 normal_count;
+    ObjStreamState state;
+    bool state_changed;
+    bool has_smoothing_groups; // an 's' line was read, even 's off'
+
+    ObjStreamBlock block;
+};
+
+s32 init(ObjStream *stream, const char *filename, const ObjStreamOptions &options);
+
+// the next block into stream->block, false once the file is done
+bool read_block(ObjStream *stream);
+
+void destroy(ObjStream *stream);
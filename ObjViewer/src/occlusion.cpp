@@ -0,0 +1,327 @@
+#include <float.h>
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "occlusion.h"
+#include "profile.h"
+
+local double
+now_ms()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+OcclusionOptions default_occlusion_options()
+{
+    OcclusionOptions options;
+    options.width = 256;
+    options.height = 144;
+    options.max_occluders = 32;
+    options.min_occluder_area = 0.002f;
+    options.reproject = false;
+    return options;
+}
+
+void init(OcclusionCuller *culler, const OcclusionOptions &options)
+{
+    culler->options = options;
+
+    init(&culler->target, options.width, options.height);
+    culler->target.depth_only = true;
+
+    culler->level_offset.clear();
+    culler->level_width.clear();
+    culler->level_height.clear();
+
+    u32 offset = 0;
+    u32 width = options.width;
+    u32 height = options.height;
+    for (;;)
+    {
+        culler->level_offset.push_back(offset);
+        culler->level_width.push_back(width);
+        culler->level_height.push_back(height);
+        offset += width * height;
+
+        if (width == 1 && height == 1) break;
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+
+    culler->pyramid.assign(offset, 1.0f);
+    culler->reprojected.assign(options.width * options.height, 1.0f);
+    culler->has_previous = false;
+    culler->stats = {};
+}
+
+void destroy(OcclusionCuller *culler)
+{
+    destroy(&culler->target);
+
+    culler->pyramid.clear();
+    culler->reprojected.clear();
+    culler->candidates.clear();
+}
+
+// scatters last frame's level 0 into the new view, keeping the farthest
+// depth where samples collide and leaving holes at the far plane
+local void
+reproject_depth(OcclusionCuller *culler)
+{
+    u32 width = culler->options.width;
+    u32 height = culler->options.height;
+    RasterTarget *target = &culler->target;
+
+    std::fill(culler->reprojected.begin(), culler->reprojected.end(), -1.0f);
+
+    glm::mat4 reprojection = culler->view_projection * glm::inverse(culler->previous_view_projection);
+
+    for (u32 y = 0; y < height; ++y)
+    {
+        for (u32 x = 0; x < width; ++x)
+        {
+            float depth = culler->pyramid[y * width + x];
+            if (depth >= 1.0f) continue;
+
+            glm::vec4 ndc((x + 0.5f) / width * 2.0f - 1.0f,
+                          (y + 0.5f) / height * 2.0f - 1.0f,
+                          depth * 2.0f - 1.0f,
+                          1.0f);
+
+            glm::vec4 clip = reprojection * ndc;
+            if (clip.w <= 0.0f || clip.z < -clip.w) continue;
+
+            float inv_w = 1.0f / clip.w;
+            s32 new_x = (s32)floorf((clip.x * inv_w * 0.5f + 0.5f) * width);
+            s32 new_y = (s32)floorf((clip.y * inv_w * 0.5f + 0.5f) * height);
+            if (new_x < 0 || new_y < 0 || new_x >= (s32)width || new_y >= (s32)height) continue;
+
+            float new_depth = clip.z * inv_w * 0.5f + 0.5f;
+            float *texel = &culler->reprojected[new_y * width + new_x];
+            *texel = glm::max(*texel, new_depth);
+        }
+    }
+
+    for (u32 y = 0; y < height; ++y)
+    {
+        for (u32 x = 0; x < width; ++x)
+        {
+            float depth = culler->reprojected[y * width + x];
+            target->depth[y * target->stride + x] = depth < 0.0f ? 1.0f : depth;
+        }
+    }
+
+    refresh_depth_hierarchy(target);
+}
+
+void begin_frame(OcclusionCuller *culler, const glm::mat4 &view_projection)
+{
+    PROFILE_SCOPE("occlusion begin");
+    double start = now_ms();
+
+    culler->stats = {};
+    culler->view_projection = view_projection;
+
+    clear(&culler->target, glm::vec4(0.0f));
+
+    if (culler->options.reproject && culler->has_previous)
+    {
+        reproject_depth(culler);
+    }
+
+    culler->stats.reproject_ms = now_ms() - start;
+}
+
+// screen rectangle in level 0 texels and nearest depth of world space
+// bounds, false when they cross the near plane
+local bool
+project_bounds(const OcclusionCuller *culler, const glm::vec3 &bounds_min, const glm::vec3 &bounds_max,
+               glm::vec2 *rect_min, glm::vec2 *rect_max, float *min_depth)
+{
+    glm::vec2 ndc_min(FLT_MAX);
+    glm::vec2 ndc_max(-FLT_MAX);
+    float nearest = FLT_MAX;
+
+    for (u32 corner = 0; corner < 8; ++corner)
+    {
+        glm::vec4 position((corner & 1) ? bounds_max.x : bounds_min.x,
+                           (corner & 2) ? bounds_max.y : bounds_min.y,
+                           (corner & 4) ? bounds_max.z : bounds_min.z,
+                           1.0f);
+
+        glm::vec4 clip = culler->view_projection * position;
+        if (clip.w <= 0.0f || clip.z < -clip.w) return false;
+
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        ndc_min = glm::min(ndc_min, glm::vec2(ndc));
+        ndc_max = glm::max(ndc_max, glm::vec2(ndc));
+        nearest = glm::min(nearest, ndc.z * 0.5f + 0.5f);
+    }
+
+    glm::vec2 size((float)culler->options.width, (float)culler->options.height);
+    *rect_min = (ndc_min * 0.5f + 0.5f) * size;
+    *rect_max = (ndc_max * 0.5f + 0.5f) * size;
+    *min_depth = nearest;
+
+    return true;
+}
+
+void select_occluders(OcclusionCuller *culler, const SceneGraph *scene, const std::vector<u32> &visible,
+                      std::vector<u32> *occluders)
+{
+    float screen_area = (float)(culler->options.width * culler->options.height);
+
+    culler->candidates.clear();
+    for (u32 node : visible)
+    {
+        glm::vec2 rect_min, rect_max;
+        float min_depth;
+        if (!project_bounds(culler, scene->bounds_min[node], scene->bounds_max[node], &rect_min, &rect_max, &min_depth))
+        {
+            continue;
+        }
+
+        rect_min = glm::clamp(rect_min, glm::vec2(0.0f), glm::vec2(culler->options.width, culler->options.height));
+        rect_max = glm::clamp(rect_max, glm::vec2(0.0f), glm::vec2(culler->options.width, culler->options.height));
+
+        float area = (rect_max.x - rect_min.x) * (rect_max.y - rect_min.y) / screen_area;
+        if (area >= culler->options.min_occluder_area)
+        {
+            culler->candidates.push_back(std::make_pair(area, node));
+        }
+    }
+
+    u32 count = glm::min((u32)culler->candidates.size(), culler->options.max_occluders);
+    std::partial_sort(culler->candidates.begin(), culler->candidates.begin() + count, culler->candidates.end(),
+                      [](const std::pair<float, u32> &a, const std::pair<float, u32> &b) { return a.first > b.first; });
+
+    occluders->clear();
+    for (u32 i = 0; i < count; ++i)
+    {
+        occluders->push_back(culler->candidates[i].second);
+    }
+}
+
+void add_occluder(OcclusionCuller *culler, const Vertex *vertices, const u32 *indices, u32 index_count,
+                  const glm::mat4 &model)
+{
+    draw(&culler->target, vertices, indices, index_count, culler->view_projection * model);
+
+    culler->stats.occluders += 1;
+    culler->stats.occluder_triangles += index_count / 3;
+}
+
+void end_occluders(OcclusionCuller *culler)
+{
+    PROFILE_SCOPE("occlusion raster");
+    double start = now_ms();
+
+    RasterTarget *target = &culler->target;
+    resolve(target);
+
+    double raster_end = now_ms();
+
+    u32 width = culler->options.width;
+    u32 height = culler->options.height;
+    float *level0 = culler->pyramid.data();
+    for (u32 y = 0; y < height; ++y)
+    {
+        for (u32 x = 0; x < width; ++x)
+        {
+            level0[y * width + x] = target->depth[y * target->stride + x];
+        }
+    }
+
+    for (u32 level = 1; level < culler->level_offset.size(); ++level)
+    {
+        const float *source = culler->pyramid.data() + culler->level_offset[level - 1];
+        float *destination = culler->pyramid.data() + culler->level_offset[level];
+        u32 source_width = culler->level_width[level - 1];
+        u32 source_height = culler->level_height[level - 1];
+
+        for (u32 y = 0; y < culler->level_height[level]; ++y)
+        {
+            u32 y0 = y * 2;
+            u32 y1 = glm::min(y0 + 1, source_height - 1);
+
+            for (u32 x = 0; x < culler->level_width[level]; ++x)
+            {
+                u32 x0 = x * 2;
+                u32 x1 = glm::min(x0 + 1, source_width - 1);
+
+                destination[y * culler->level_width[level] + x] =
+                    glm::max(glm::max(source[y0 * source_width + x0], source[y0 * source_width + x1]),
+                             glm::max(source[y1 * source_width + x0], source[y1 * source_width + x1]));
+            }
+        }
+    }
+
+    culler->previous_view_projection = culler->view_projection;
+    culler->has_previous = true;
+
+    culler->stats.raster_ms = raster_end - start;
+    culler->stats.pyramid_ms = now_ms() - raster_end;
+}
+
+bool is_occluded(OcclusionCuller *culler, const glm::vec3 &bounds_min, const glm::vec3 &bounds_max)
+{
+    glm::vec2 rect_min, rect_max;
+    float min_depth;
+    if (!project_bounds(culler, bounds_min, bounds_max, &rect_min, &rect_max, &min_depth))
+    {
+        return false;
+    }
+
+    s32 x0 = glm::max(0, (s32)floorf(rect_min.x));
+    s32 y0 = glm::max(0, (s32)floorf(rect_min.y));
+    s32 x1 = glm::min((s32)culler->options.width - 1, (s32)floorf(rect_max.x));
+    s32 y1 = glm::min((s32)culler->options.height - 1, (s32)floorf(rect_max.y));
+
+    // off screen, the frustum already decided
+    if (x0 > x1 || y0 > y1) return false;
+
+    u32 level = 0;
+    while (x1 - x0 >= 4 || y1 - y0 >= 4)
+    {
+        x0 >>= 1; y0 >>= 1;
+        x1 >>= 1; y1 >>= 1;
+        ++level;
+    }
+
+    const float *texels = culler->pyramid.data() + culler->level_offset[level];
+    u32 level_width = culler->level_width[level];
+
+    for (s32 y = y0; y <= y1; ++y)
+    {
+        for (s32 x = x0; x <= x1; ++x)
+        {
+            if (min_depth <= texels[y * level_width + x]) return false;
+        }
+    }
+
+    return true;
+}
+
+void cull_occluded(OcclusionCuller *culler, const SceneGraph *scene, std::vector<u32> *visible)
+{
+    PROFILE_SCOPE("occlusion test");
+    double start = now_ms();
+
+    u32 kept = 0;
+    for (u32 node : *visible)
+    {
+        if (!is_occluded(culler, scene->bounds_min[node], scene->bounds_max[node]))
+        {
+            (*visible)[kept++] = node;
+        }
+    }
+
+    culler->stats.tested += (u32)visible->size();
+    culler->stats.culled += (u32)visible->size() - kept;
+    visible->resize(kept);
+
+    culler->stats.test_ms = now_ms() - start;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "types.h"
+#include "mesh.h"
+#include "scene.h"
+#include "raster.h"
+
+// CPU occlusion culling: the biggest on screen nodes are rasterized as
+// occluders into a small depth only RasterTarget, a max depth pyramid is
+// built from it and the bounds of the remaining nodes are tested against
+// the pyramid level where they cover at most 4x4 texels.
+//
+// Optionally last frame's occluder depth is reprojected into the new view
+// first, so what was hidden stays hidden even when this frame picks other
+// occluders. Reprojection assumes the occluders did not move, it can cull
+// wrongly for one frame around animated geometry, hence off by default.
+//
+// Per frame:
+//   begin_frame -> select_occluders -> add_occluder... -> end_occluders -> cull_occluded
+
+struct OcclusionOptions
+{
+    u32 width;
+    u32 height;
+    u32 max_occluders;
+    float min_occluder_area; // fraction of the screen covered by the bounds
+    bool reproject;
+};
+
+struct OcclusionStats
+{
+    u32 occluders;
+    u32 occluder_triangles;
+    u32 tested;
+    u32 culled;
+
+    double reproject_ms;
+    double raster_ms;
+    double pyramid_ms;
+    double test_ms;
+};
+
+struct OcclusionCuller
+{
+    OcclusionOptions options;
+    RasterTarget target;
+
+    // level 0 is width x height, every level keeps the farthest depth of 2x2
+    // texels of the one below
+    std::vector<float> pyramid;
+    std::vector<u32> level_offset;
+    std::vector<u32> level_width;
+    std::vector<u32> level_height;
+
+    glm::mat4 view_projection;
+    glm::mat4 previous_view_projection;
+    bool has_previous;
+    std::vector<float> reprojected;
+
+    std::vector<std::pair<float, u32>> candidates;
+
+    OcclusionStats stats;
+};
+
+OcclusionOptions default_occlusion_options();
+
+void init(OcclusionCuller *culler, const OcclusionOptions &options);
+void destroy(OcclusionCuller *culler);
+
+void begin_frame(OcclusionCuller *culler, const glm::mat4 &view_projection);
+
+// the nodes of visible with the largest projected bounds, largest first
+void select_occluders(OcclusionCuller *culler, const SceneGraph *scene, const std::vector<u32> &visible,
+                      std::vector<u32> *occluders);
+
+void add_occluder(OcclusionCuller *culler, const Vertex *vertices, const u32 *indices, u32 index_count,
+                  const glm::mat4 &model);
+
+void end_occluders(OcclusionCuller *culler);
+
+// world space bounds against the pyramid, conservative: anything crossing
+// the near plane is visible
+bool is_occluded(OcclusionCuller *culler, const glm::vec3 &bounds_min, const glm::vec3 &bounds_max);
+
+// removes the hidden nodes from visible, keeping the order
+void cull_occluded(OcclusionCuller *culler, const SceneGraph *scene, std::vector<u32> *visible);
@@ -0,0 +1,216 @@
+#include <stddef.h>
+
+#include <glad\glad.h>
+
+#include "overlay.h"
+#include "stats.h"
+#include "log.h"
+
+#define FONT_FIRST_CHAR ' '
+#define FONT_GLYPH_COUNT 64
+#define FONT_GLYPH_WIDTH 3
+#define FONT_GLYPH_HEIGHT 5
+
+// glyphs sit in cells one texel larger so nearest sampling never reaches the
+// neighbour; the cell after the last glyph is solid, for the panel
+#define FONT_CELL_WIDTH (FONT_GLYPH_WIDTH + 1)
+#define FONT_CELL_HEIGHT (FONT_GLYPH_HEIGHT + 1)
+#define FONT_SOLID_CELL FONT_GLYPH_COUNT
+#define FONT_TEXTURE_WIDTH ((FONT_GLYPH_COUNT + 1) * FONT_CELL_WIDTH)
+#define FONT_TEXTURE_HEIGHT FONT_CELL_HEIGHT
+
+// text padding inside the panel, in font pixels
+#define OVERLAY_MARGIN 2
+
+// rows top to bottom, 3 bits each with the left column highest
+local const u16 font_glyphs[FONT_GLYPH_COUNT] = {
+    0x0000, 0x2482, 0x5A00, 0x5F7D, 0x3C9E, 0x52A5, 0x2AAB, 0x2400,
+    0x1491, 0x4494, 0x0AA8, 0x05D0, 0x0014, 0x01C0, 0x0002, 0x12A4,
+    0x7B6F, 0x2C97, 0x73E7, 0x72CF, 0x5BC9, 0x79CF, 0x79EF, 0x7252,
+    0x7BEF, 0x7BCF, 0x0410, 0x0414, 0x1511, 0x0E38, 0x4454, 0x72C2,
+    0x7BE7, 0x2BED, 0x6BAE, 0x3923, 0x6B6E, 0x79A7, 0x79A4, 0x396B,
+    0x5BED, 0x7497, 0x126A, 0x5BAD, 0x4927, 0x5FED, 0x6B6D, 0x2B6A,
+    0x6BA4, 0x2B73, 0x6BAD, 0x388E, 0x7492, 0x5B6F, 0x5B6A, 0x5BFD,
+    0x5AAD, 0x5A92, 0x72A7, 0x3493, 0x4889, 0x6496, 0x2A00, 0x0007,
+};
+
+local u32
+glyph_index(char c)
+{
+    if (c >= 'a' && c <= 'z') c = c - 'a' + 'A';
+    if (c < FONT_FIRST_CHAR || c >= FONT_FIRST_CHAR + FONT_GLYPH_COUNT) return 0;
+    return (u32)(c - FONT_FIRST_CHAR);
+}
+
+local void
+build_font(TextOverlay *overlay)
+{
+    u8 texels[FONT_TEXTURE_WIDTH * FONT_TEXTURE_HEIGHT] = {};
+
+    for (u32 glyph = 0; glyph <= FONT_GLYPH_COUNT; ++glyph)
+    {
+        u16 bits = glyph < FONT_GLYPH_COUNT ? font_glyphs[glyph] : 0x7FFF;
+        for (u32 y = 0; y < FONT_GLYPH_HEIGHT; ++y)
+        {
+            for (u32 x = 0; x < FONT_GLYPH_WIDTH; ++x)
+            {
+                u32 bit = (FONT_GLYPH_HEIGHT - 1 - y) * FONT_GLYPH_WIDTH + (FONT_GLYPH_WIDTH - 1 - x);
+                if (bits & (1 << bit)) texels[y * FONT_TEXTURE_WIDTH + glyph * FONT_CELL_WIDTH + x] = 255;
+            }
+        }
+    }
+
+    glGenTextures(1, &overlay->font);
+    glBindTexture(GL_TEXTURE_2D, overlay->font);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, FONT_TEXTURE_WIDTH, FONT_TEXTURE_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, texels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+s32 init(TextOverlay *overlay)
+{
+    *overlay = {};
+
+    if (init(&overlay->shader, "shader\\overlay.vert", "shader\\overlay.frag") != 0) return -1;
+    use(&overlay->shader);
+    set_int(&overlay->shader, "font", 0);
+    set_vec2(&overlay->shader, "font_size", glm::vec2((float)FONT_TEXTURE_WIDTH, (float)FONT_TEXTURE_HEIGHT));
+
+    build_font(overlay);
+
+    glGenVertexArrays(1, &overlay->vao);
+    glGenBuffers(1, &overlay->vbo);
+
+    glBindVertexArray(overlay->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, overlay->vbo);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), (void*)offsetof(OverlayVertex, position_tex_coord));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), (void*)offsetof(OverlayVertex, shade_alpha));
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+
+    return 0;
+}
+
+void destroy(TextOverlay *overlay)
+{
+    if (overlay->font) glDeleteTextures(1, &overlay->font);
+    if (overlay->vbo) glDeleteBuffers(1, &overlay->vbo);
+    if (overlay->vao) glDeleteVertexArrays(1, &overlay->vao);
+    destroy(&overlay->shader);
+    *overlay = {};
+}
+
+local void
+add_quad(TextOverlay *overlay, float x, float y, float width, float height, u32 cell, float shade, float alpha)
+{
+    float u0 = (float)(cell * FONT_CELL_WIDTH);
+    float u1 = u0 + FONT_GLYPH_WIDTH;
+    float v1 = (float)FONT_GLYPH_HEIGHT;
+
+    OverlayVertex corners[4] = {
+        {glm::vec4(x, y, u0, 0.0f), glm::vec2(shade, alpha)},
+        {glm::vec4(x + width, y, u1, 0.0f), glm::vec2(shade, alpha)},
+        {glm::vec4(x + width, y + height, u1, v1), glm::vec2(shade, alpha)},
+        {glm::vec4(x, y + height, u0, v1), glm::vec2(shade, alpha)},
+    };
+
+    overlay->vertices.push_back(corners[0]);
+    overlay->vertices.push_back(corners[1]);
+    overlay->vertices.push_back(corners[2]);
+    overlay->vertices.push_back(corners[0]);
+    overlay->vertices.push_back(corners[2]);
+    overlay->vertices.push_back(corners[3]);
+}
+
+void draw_text(TextOverlay *overlay, const char *text, u32 screen_width, u32 screen_height, u32 pixel_scale)
+{
+    if (!overlay->vao || !text[0]) return;
+
+    float scale = (float)(pixel_scale ? pixel_scale : 1);
+    float advance = FONT_CELL_WIDTH * scale;
+    float line_height = (FONT_CELL_HEIGHT + 1) * scale;
+    float margin = OVERLAY_MARGIN * scale;
+
+    // the panel goes first so the text blends over it
+    u32 columns = 0;
+    u32 lines = 1;
+    u32 column = 0;
+    for (const char *c = text; *c; ++c)
+    {
+        if (*c == '\n')
+        {
+            if (c[1]) ++lines;
+            column = 0;
+            continue;
+        }
+        columns = column + 1 > columns ? column + 1 : columns;
+        ++column;
+    }
+
+    overlay->vertices.clear();
+    add_quad(overlay, 0.0f, 0.0f, columns * advance + margin * 2.0f, lines * line_height + margin * 2.0f,
+             FONT_SOLID_CELL, 0.0f, 0.6f);
+
+    float x = margin;
+    float y = margin;
+    for (const char *c = text; *c; ++c)
+    {
+        if (*c == '\n')
+        {
+            x = margin;
+            y += line_height;
+            continue;
+        }
+
+        u32 glyph = glyph_index(*c);
+        if (glyph != 0)
+        {
+            add_quad(overlay, x, y, FONT_GLYPH_WIDTH * scale, FONT_GLYPH_HEIGHT * scale, glyph, 1.0f, 1.0f);
+        }
+        x += advance;
+    }
+
+    u32 vertex_count = (u32)overlay->vertices.size();
+
+    glBindBuffer(GL_ARRAY_BUFFER, overlay->vbo);
+    if (vertex_count > overlay->vbo_capacity)
+    {
+        overlay->vbo_capacity = vertex_count * 2;
+        glBufferData(GL_ARRAY_BUFFER, overlay->vbo_capacity * sizeof(OverlayVertex), nullptr, GL_STREAM_DRAW);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertex_count * sizeof(OverlayVertex), overlay->vertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+    GLboolean cull_face = glIsEnabled(GL_CULL_FACE);
+    GLint polygon_mode[2];
+    glGetIntegerv(GL_POLYGON_MODE, polygon_mode);
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glViewport(0, 0, screen_width, screen_height);
+
+    use(&overlay->shader);
+    set_vec2(&overlay->shader, "screen_size", glm::vec2((float)screen_width, (float)screen_height));
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, overlay->font);
+    glBindVertexArray(overlay->vao);
+    glDrawArrays(GL_TRIANGLES, 0, vertex_count);
+    count_draw(vertex_count);
+    glBindVertexArray(0);
+
+    glDisable(GL_BLEND);
+    if (depth_test) glEnable(GL_DEPTH_TEST);
+    if (cull_face) glEnable(GL_CULL_FACE);
+    glPolygonMode(GL_FRONT_AND_BACK, polygon_mode[0]);
+}
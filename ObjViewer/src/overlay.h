@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "types.h"
+#include "shader.h"
+
+// Text drawn over the frame, for the stats.
+//
+// The font is 3x5 pixels, upper case ASCII from ' ' to '_' in one small
+// texture; lower case is drawn as upper case and anything else as a space.
+// Each character is a quad scaled up by a whole number of pixels, so the
+// glyphs stay sharp, on top of a translucent panel sized to the text.
+
+struct OverlayVertex
+{
+    glm::vec4 position_tex_coord; // pixels from the top left, font texels
+    glm::vec2 shade_alpha;
+};
+
+struct TextOverlay
+{
+    Shader shader;
+    u32 vao;
+    u32 vbo;
+    u32 vbo_capacity; // in vertices
+    u32 font;
+
+    std::vector<OverlayVertex> vertices;
+};
+
+s32 init(TextOverlay *overlay);
+
+void destroy(TextOverlay *overlay);
+
+// into the top left corner of the bound framebuffer, '\n' starts a line
+void draw_text(TextOverlay *overlay, const char *text, u32 screen_width, u32 screen_height, u32 pixel_scale);
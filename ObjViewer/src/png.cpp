@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "png.h"
+#include "log.h"
+
+#define PNG_MAX_STORED_BLOCK 65535
+
+local u32 crc_table[256];
+local bool crc_table_ready;
+
+local u32
+crc32(u32 crc, const u8 *data, size_t size)
+{
+    if (!crc_table_ready)
+    {
+        for (u32 n = 0; n < 256; ++n)
+        {
+            u32 c = n;
+            for (u32 k = 0; k < 8; ++k)
+            {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            crc_table[n] = c;
+        }
+        crc_table_ready = true;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+local void
+put_u32_be(std::vector<u8> *out, u32 value)
+{
+    out->push_back((u8)(value >> 24));
+    out->push_back((u8)(value >> 16));
+    out->push_back((u8)(value >> 8));
+    out->push_back((u8)value);
+}
+
+local void
+write_chunk(FILE *file, const char *type, const std::vector<u8> &data)
+{
+    std::vector<u8> chunk;
+    put_u32_be(&chunk, (u32)data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    put_u32_be(&chunk, crc32(0, chunk.data() + 4, chunk.size() - 4));
+
+    fwrite(chunk.data(), 1, chunk.size(), file);
+}
+
+s32 write_png(const char *filename, u32 width, u32 height, u32 stride, const u32 *pixels, bool flip_y)
+{
+    // raw scanlines: filter type 0 then the row
+    size_t row_size = (size_t)width * 4 + 1;
+    std::vector<u8> raw(row_size * height);
+    for (u32 y = 0; y < height; ++y)
+    {
+        u32 source_row = flip_y ? height - 1 - y : y;
+        u8 *row = raw.data() + y * row_size;
+        row[0] = 0;
+        memcpy(row + 1, pixels + (size_t)source_row * stride, (size_t)width * 4);
+    }
+
+    // zlib stream made of stored deflate blocks
+    std::vector<u8> idat;
+    idat.push_back(0x78);
+    idat.push_back(0x01);
+
+    u32 adler_a = 1, adler_b = 0;
+    for (size_t i = 0; i < raw.size(); ++i)
+    {
+        adler_a = (adler_a + raw[i]) % 65521;
+        adler_b = (adler_b + adler_a) % 65521;
+    }
+
+    size_t offset = 0;
+    do
+    {
+        size_t size = raw.size() - offset;
+        if (size > PNG_MAX_STORED_BLOCK) size = PNG_MAX_STORED_BLOCK;
+        bool last = offset + size == raw.size();
+
+        idat.push_back(last ? 1 : 0);
+        idat.push_back((u8)size);
+        idat.push_back((u8)(size >> 8));
+        idat.push_back((u8)~size);
+        idat.push_back((u8)(~size >> 8));
+        idat.insert(idat.end(), raw.begin() + offset, raw.begin() + offset + size);
+
+        offset += size;
+    }
+    while (offset < raw.size());
+
+    put_u32_be(&idat, (adler_b << 16) | adler_a);
+
+    std::vector<u8> ihdr;
+    put_u32_be(&ihdr, width);
+    put_u32_be(&ihdr, height);
+    ihdr.push_back(8); // bit depth
+    ihdr.push_back(6); // rgba
+    ihdr.push_back(0); // deflate
+    ihdr.push_back(0); // adaptive filtering
+    ihdr.push_back(0); // no interlace
+
+    FILE *file = fopen(filename, "wb");
+    if (!file)
+    {
+        LOG_E("Cannot open '%s' for writing", filename);
+        return -1;
+    }
+
+    const u8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    fwrite(signature, 1, sizeof(signature), file);
+
+    write_chunk(file, "IHDR", ihdr);
+    write_chunk(file, "IDAT", idat);
+    write_chunk(file, "IEND", std::vector<u8>());
+
+    bool failed = ferror(file) != 0;
+    fclose(file);
+
+    if (failed)
+    {
+        LOG_E("Error writing '%s'", filename);
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "types.h"
+
+// Minimal PNG encoder for screenshots: 8 bit RGBA, no filtering and stored
+// (uncompressed) deflate blocks, so it needs no zlib. Files are big but
+// byte exact, which is what diffing renders needs.
+//
+// pixels are rgba8 rows of stride pixels; with flip_y the first row is the
+// bottom of the image, like GL framebuffers.
+s32 write_png(const char *filename, u32 width, u32 height, u32 stride, const u32 *pixels, bool flip_y);
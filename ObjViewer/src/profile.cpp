@@ -0,0 +1,512 @@
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <glad\glad.h>
+
+#include "profile.h"
+#include "log.h"
+
+// the trace thread id of GPU scopes
+#define PROFILE_GPU_THREAD PROFILE_MAX_THREADS
+
+struct ProfileEvent
+{
+    const char *name;
+    u64 begin;
+    u64 end;
+};
+
+struct ProfileThread
+{
+    ProfileEvent events[PROFILE_RING_SIZE];
+    std::atomic<u32> write; // advanced by the owning thread
+    std::atomic<u32> read;  // advanced by profile_frame
+    std::atomic<u32> dropped;
+
+    u32 index;
+    char name[32];
+};
+
+struct ProfileStage
+{
+    std::string name;
+    bool gpu;
+
+    double frame_ms;
+    u32 frame_calls;
+
+    float history[PROFILE_HISTORY];
+    u32 history_count;
+    u32 history_next;
+};
+
+struct CapturedEvent
+{
+    const char *name;
+    u64 begin;
+    u64 end;
+    u32 thread;
+};
+
+struct GpuFrame
+{
+    u32 timestamps[PROFILE_GPU_MAX_SCOPES * 2];
+    const char *names[PROFILE_GPU_MAX_SCOPES];
+    u32 scope_count;
+    u32 elapsed_query;
+    bool pending;
+};
+
+struct Profiler
+{
+    std::chrono::steady_clock::time_point start;
+
+    std::atomic<ProfileThread *> threads[PROFILE_MAX_THREADS];
+    std::atomic<u32> thread_count;
+
+    std::vector<ProfileStage> stages;
+
+    u32 capture_frames_left;
+    std::string capture_filename;
+    std::vector<CapturedEvent> captured;
+
+    bool gpu_ready;
+    s64 gpu_offset; // gpu timestamp - cpu ns
+    GpuFrame gpu_frames[PROFILE_GPU_LATENCY];
+    u32 gpu_frame;
+    bool gpu_in_frame;
+    u32 gpu_stack[PROFILE_GPU_MAX_SCOPES];
+    u32 gpu_stack_size;
+    u32 gpu_dropped_frames;
+};
+
+local Profiler *profiler;
+local thread_local ProfileThread *current_thread;
+
+void init_profiler()
+{
+    profiler = new Profiler();
+    profiler->start = std::chrono::steady_clock::now();
+    profiler->thread_count = 0;
+    profiler->capture_frames_left = 0;
+    profiler->gpu_ready = false;
+    profiler->gpu_frame = 0;
+    profiler->gpu_in_frame = false;
+    profiler->gpu_stack_size = 0;
+    profiler->gpu_dropped_frames = 0;
+}
+
+u64 profile_now_ns()
+{
+    using namespace std::chrono;
+    if (!profiler) return 0;
+    return (u64)duration_cast<nanoseconds>(steady_clock::now() - profiler->start).count();
+}
+
+local ProfileThread *
+get_profile_thread()
+{
+    if (current_thread) return current_thread;
+    if (!profiler) return nullptr;
+
+    u32 index = profiler->thread_count.fetch_add(1);
+    if (index >= PROFILE_MAX_THREADS)
+    {
+        return nullptr;
+    }
+
+    ProfileThread *thread = new ProfileThread();
+    thread->write = 0;
+    thread->read = 0;
+    thread->dropped = 0;
+    thread->index = index;
+    snprintf(thread->name, sizeof(thread->name), "thread %u", index);
+
+    profiler->threads[index].store(thread, std::memory_order_release);
+    current_thread = thread;
+
+    return thread;
+}
+
+void set_profile_thread_name(const char *name)
+{
+    ProfileThread *thread = get_profile_thread();
+    if (thread)
+    {
+        snprintf(thread->name, sizeof(thread->name), "%s", name);
+    }
+}
+
+ProfileScope::ProfileScope(const char *scope_name)
+{
+    name = scope_name;
+    begin = profile_now_ns();
+}
+
+ProfileScope::~ProfileScope()
+{
+    u64 end = profile_now_ns();
+
+    ProfileThread *thread = get_profile_thread();
+    if (!thread) return;
+
+    u32 write = thread->write.load(std::memory_order_relaxed);
+    u32 read = thread->read.load(std::memory_order_acquire);
+    if (write - read >= PROFILE_RING_SIZE)
+    {
+        thread->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    ProfileEvent &event = thread->events[write % PROFILE_RING_SIZE];
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+
+    thread->write.store(write + 1, std::memory_order_release);
+}
+
+local ProfileStage *
+get_stage(const char *name, bool gpu)
+{
+    for (ProfileStage &stage : profiler->stages)
+    {
+        if (stage.gpu == gpu && stage.name == name) return &stage;
+    }
+
+    ProfileStage stage = {};
+    stage.name = name;
+    stage.gpu = gpu;
+    profiler->stages.push_back(stage);
+
+    return &profiler->stages.back();
+}
+
+local void
+add_stage_time(const char *name, bool gpu, double ms)
+{
+    ProfileStage *stage = get_stage(name, gpu);
+    stage->frame_ms += ms;
+    stage->frame_calls += 1;
+}
+
+local void
+add_event(const char *name, u64 begin, u64 end, u32 thread, bool gpu)
+{
+    add_stage_time(name, gpu, (end - begin) * 1.0e-6);
+
+    if (profiler->capture_frames_left > 0 && end > begin)
+    {
+        profiler->captured.push_back(CapturedEvent{name, begin, end, thread});
+    }
+}
+
+void init_gpu_profiler()
+{
+    if (!profiler) return;
+
+    for (u32 i = 0; i < PROFILE_GPU_LATENCY; ++i)
+    {
+        GpuFrame *frame = &profiler->gpu_frames[i];
+        glGenQueries(PROFILE_GPU_MAX_SCOPES * 2, frame->timestamps);
+        glGenQueries(1, &frame->elapsed_query);
+        frame->scope_count = 0;
+        frame->pending = false;
+    }
+
+    // GL_TIMESTAMP counts in ns on its own clock, remember where it stands
+    // against ours to put GPU scopes on the same timeline
+    GLint64 gpu_now = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+    profiler->gpu_offset = gpu_now - (s64)profile_now_ns();
+
+    profiler->gpu_ready = true;
+}
+
+void profile_begin_gpu_frame()
+{
+    if (!profiler || !profiler->gpu_ready) return;
+
+    GpuFrame *frame = &profiler->gpu_frames[profiler->gpu_frame % PROFILE_GPU_LATENCY];
+    if (frame->pending)
+    {
+        // still not available after PROFILE_GPU_LATENCY frames, give it up
+        // rather than stall; reusing the query objects discards the results
+        frame->pending = false;
+        ++profiler->gpu_dropped_frames;
+    }
+
+    frame->scope_count = 0;
+    profiler->gpu_stack_size = 0;
+    profiler->gpu_in_frame = true;
+
+    glBeginQuery(GL_TIME_ELAPSED, frame->elapsed_query);
+}
+
+void profile_end_gpu_frame()
+{
+    if (!profiler || !profiler->gpu_ready || !profiler->gpu_in_frame) return;
+
+    glEndQuery(GL_TIME_ELAPSED);
+
+    GpuFrame *frame = &profiler->gpu_frames[profiler->gpu_frame % PROFILE_GPU_LATENCY];
+    frame->pending = true;
+
+    profiler->gpu_in_frame = false;
+    ++profiler->gpu_frame;
+}
+
+void profile_begin_gpu(const char *name)
+{
+    if (!profiler || !profiler->gpu_ready || !profiler->gpu_in_frame) return;
+
+    GpuFrame *frame = &profiler->gpu_frames[profiler->gpu_frame % PROFILE_GPU_LATENCY];
+
+    u32 scope = 0xFFFFFFFF;
+    if (frame->scope_count < PROFILE_GPU_MAX_SCOPES)
+    {
+        scope = frame->scope_count++;
+        frame->names[scope] = name;
+        glQueryCounter(frame->timestamps[scope * 2], GL_TIMESTAMP);
+    }
+
+    if (profiler->gpu_stack_size < PROFILE_GPU_MAX_SCOPES)
+    {
+        profiler->gpu_stack[profiler->gpu_stack_size++] = scope;
+    }
+}
+
+void profile_end_gpu()
+{
+    if (!profiler || !profiler->gpu_ready || !profiler->gpu_in_frame || profiler->gpu_stack_size == 0) return;
+
+    u32 scope = profiler->gpu_stack[--profiler->gpu_stack_size];
+    if (scope == 0xFFFFFFFF) return;
+
+    GpuFrame *frame = &profiler->gpu_frames[profiler->gpu_frame % PROFILE_GPU_LATENCY];
+    glQueryCounter(frame->timestamps[scope * 2 + 1], GL_TIMESTAMP);
+}
+
+// reads back the frames whose queries finished, never blocks
+local void
+collect_gpu_frames()
+{
+    for (u32 age = PROFILE_GPU_LATENCY; age > 0; --age)
+    {
+        if (profiler->gpu_frame < age) continue;
+
+        GpuFrame *frame = &profiler->gpu_frames[(profiler->gpu_frame - age) % PROFILE_GPU_LATENCY];
+        if (!frame->pending) continue;
+
+        // queries complete in order, the frame query ends after every scope
+        u32 available = 0;
+        glGetQueryObjectuiv(frame->elapsed_query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(frame->elapsed_query, GL_QUERY_RESULT, &elapsed);
+        add_stage_time("frame", true, elapsed * 1.0e-6);
+
+        for (u32 scope = 0; scope < frame->scope_count; ++scope)
+        {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(frame->timestamps[scope * 2], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(frame->timestamps[scope * 2 + 1], GL_QUERY_RESULT, &end);
+            if (end < begin) continue;
+
+            add_event(frame->names[scope], (u64)((s64)begin - profiler->gpu_offset),
+                      (u64)((s64)end - profiler->gpu_offset), PROFILE_GPU_THREAD, true);
+        }
+
+        frame->pending = false;
+    }
+}
+
+local void
+append_json_string(std::string *out, const char *text)
+{
+    out->push_back('"');
+    for (const char *at = text; *at; ++at)
+    {
+        if (*at == '"' || *at == '\\') out->push_back('\\');
+        out->push_back(*at);
+    }
+    out->push_back('"');
+}
+
+local void
+write_trace()
+{
+    std::string json = "{\"traceEvents\":[\n";
+    char buffer[256];
+
+    u32 thread_count = std::min(profiler->thread_count.load(), (u32)PROFILE_MAX_THREADS);
+    for (u32 index = 0; index <= thread_count; ++index)
+    {
+        const char *name = "GPU";
+        u32 tid = PROFILE_GPU_THREAD;
+        if (index < thread_count)
+        {
+            ProfileThread *thread = profiler->threads[index].load(std::memory_order_acquire);
+            if (!thread) continue;
+            name = thread->name;
+            tid = thread->index;
+        }
+
+        snprintf(buffer, sizeof(buffer), "{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", tid);
+        json += buffer;
+        append_json_string(&json, name);
+        json += "}},\n";
+    }
+
+    for (const CapturedEvent &event : profiler->captured)
+    {
+        json += "{\"ph\":\"X\",\"pid\":1,\"name\":";
+        append_json_string(&json, event.name);
+        snprintf(buffer, sizeof(buffer), ",\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f},\n",
+                 event.thread, event.begin * 1.0e-3, (event.end - event.begin) * 1.0e-3);
+        json += buffer;
+    }
+
+    // the metadata events always precede, so there is a trailing ",\n"
+    json.resize(json.size() - 2);
+    json += "\n]}\n";
+
+    FILE *file = fopen(profiler->capture_filename.c_str(), "wb");
+    if (!file)
+    {
+        LOG_W("Cannot open '%s' for writing", profiler->capture_filename.c_str());
+        return;
+    }
+
+    fwrite(json.data(), 1, json.size(), file);
+    fclose(file);
+
+    LOG_I("Wrote %u trace events to '%s'", (u32)profiler->captured.size(), profiler->capture_filename.c_str());
+}
+
+void profile_frame()
+{
+    if (!profiler) return;
+
+    for (ProfileStage &stage : profiler->stages)
+    {
+        stage.frame_ms = 0.0;
+        stage.frame_calls = 0;
+    }
+
+    u32 thread_count = std::min(profiler->thread_count.load(), (u32)PROFILE_MAX_THREADS);
+    for (u32 index = 0; index < thread_count; ++index)
+    {
+        ProfileThread *thread = profiler->threads[index].load(std::memory_order_acquire);
+        if (!thread) continue;
+
+        u32 read = thread->read.load(std::memory_order_relaxed);
+        u32 write = thread->write.load(std::memory_order_acquire);
+
+        for (; read != write; ++read)
+        {
+            const ProfileEvent &event = thread->events[read % PROFILE_RING_SIZE];
+            add_event(event.name, event.begin, event.end, thread->index, false);
+        }
+
+        thread->read.store(read, std::memory_order_release);
+    }
+
+    if (profiler->gpu_ready)
+    {
+        collect_gpu_frames();
+    }
+
+    for (ProfileStage &stage : profiler->stages)
+    {
+        if (stage.frame_calls == 0) continue;
+
+        stage.history[stage.history_next] = (float)stage.frame_ms;
+        stage.history_next = (stage.history_next + 1) % PROFILE_HISTORY;
+        if (stage.history_count < PROFILE_HISTORY) ++stage.history_count;
+    }
+
+    if (profiler->capture_frames_left > 0 && --profiler->capture_frames_left == 0)
+    {
+        write_trace();
+        profiler->captured.clear();
+    }
+}
+
+void capture_trace(u32 frame_count, const char *filename)
+{
+    if (!profiler) return;
+
+    if (profiler->capture_frames_left > 0) return;
+
+    profiler->capture_frames_left = frame_count;
+    profiler->capture_filename = filename;
+    profiler->captured.clear();
+}
+
+void print_profile_summary(FILE *file)
+{
+    if (!profiler) return;
+
+    fprintf(file, "%-28s %8s %8s %8s %8s\n", "stage (ms per frame)", "min", "avg", "p99", "frames");
+
+    std::vector<float> samples;
+    for (const ProfileStage &stage : profiler->stages)
+    {
+        if (stage.history_count == 0) continue;
+
+        samples.assign(stage.history, stage.history + stage.history_count);
+        std::sort(samples.begin(), samples.end());
+
+        double sum = 0.0;
+        for (float sample : samples) sum += sample;
+
+        u32 p99 = (u32)((samples.size() - 1) * 0.99f + 0.5f);
+
+        char name[64];
+        snprintf(name, sizeof(name), "%s%s", stage.gpu ? "gpu " : "", stage.name.c_str());
+        fprintf(file, "%-28s %8.3f %8.3f %8.3f %8u\n",
+                name, samples.front(), sum / samples.size(), samples[p99], stage.history_count);
+    }
+
+    u32 dropped = 0;
+    u32 thread_count = std::min(profiler->thread_count.load(), (u32)PROFILE_MAX_THREADS);
+    for (u32 index = 0; index < thread_count; ++index)
+    {
+        ProfileThread *thread = profiler->threads[index].load(std::memory_order_acquire);
+        if (thread) dropped += thread->dropped.load();
+    }
+
+    if (dropped || profiler->gpu_dropped_frames)
+    {
+        fprintf(file, "dropped: %u cpu events, %u gpu frames\n", dropped, profiler->gpu_dropped_frames);
+    }
+}
+
+void end_profiler()
+{
+    if (!profiler) return;
+
+    if (profiler->capture_frames_left > 0)
+    {
+        write_trace();
+    }
+
+    if (profiler->gpu_ready)
+    {
+        for (u32 i = 0; i < PROFILE_GPU_LATENCY; ++i)
+        {
+            glDeleteQueries(PROFILE_GPU_MAX_SCOPES * 2, profiler->gpu_frames[i].timestamps);
+            glDeleteQueries(1, &profiler->gpu_frames[i].elapsed_query);
+        }
+        profiler->gpu_ready = false;
+    }
+
+    // thread rings stay alive, detached threads may still record into them
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "types.h"
+
+// Frame profiler. Everything is a no-op until init_profiler().
+//
+// CPU: PROFILE_SCOPE("cull") records the scope on destruction into a ring
+// owned by the calling thread. Only that thread writes the ring and only
+// profile_frame() (main thread) reads it, so recording takes no lock: the
+// write index is published with a release store after the event is filled.
+//
+// GPU: PROFILE_GPU_SCOPE("draw") brackets GL commands with GL_TIMESTAMP
+// queries, which unlike GL_TIME_ELAPSED can nest; the whole frame is
+// measured with GL_TIME_ELAPSED. Results are read PROFILE_GPU_LATENCY
+// frames later and only when available, the CPU never waits on them.
+//
+// Every stage keeps a rolling window of per-frame totals for min/avg/p99
+// and a number of frames can be captured to a Chrome trace (chrome://tracing
+// or ui.perfetto.dev).
+
+#define PROFILE_RING_SIZE 16384
+#define PROFILE_MAX_THREADS 64
+#define PROFILE_HISTORY 240
+#define PROFILE_GPU_LATENCY 4
+#define PROFILE_GPU_MAX_SCOPES 64
+
+void init_profiler();
+
+// needs a current GL context, GPU scopes are ignored before this
+void init_gpu_profiler();
+
+void end_profiler();
+
+// label of the calling thread in the trace
+void set_profile_thread_name(const char *name);
+
+u64 profile_now_ns();
+
+void profile_begin_gpu(const char *name);
+void profile_end_gpu();
+
+// brackets GPU work of one frame, call on the GL thread
+void profile_begin_gpu_frame();
+void profile_end_gpu_frame();
+
+// end of frame on the main thread: drains the thread rings, reads finished
+// GPU queries, updates the rolling stats and the trace capture
+void profile_frame();
+
+// records the next frame_count frames and writes them to filename
+void capture_trace(u32 frame_count, const char *filename);
+
+// min/avg/p99 in ms of every stage over the last PROFILE_HISTORY frames
+void print_profile_summary(FILE *file);
+
+struct ProfileScope
+{
+    const char *name;
+    u64 begin;
+
+    ProfileScope(const char *scope_name);
+    ~ProfileScope();
+};
+
+struct ProfileGpuScope
+{
+    ProfileGpuScope(const char *name) { profile_begin_gpu(name); }
+    ~ProfileGpuScope() { profile_end_gpu(); }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) ProfileGpuScope PROFILE_CONCAT(profile_gpu_scope_, __LINE__)(name)
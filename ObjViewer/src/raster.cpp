@@ -0,0 +1,622 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+#include <chrono>
+
+#include "raster.h"
+#include "image.h"
+#include "jobs.h"
+#include "log.h"
+#include "profile.h"
+
+// triangles set up per job, and the count below which threading is not
+// worth the wake up
+#define RASTER_SETUP_BATCH 4096
+
+struct ClipVertex
+{
+    glm::vec4 position;
+    glm::vec2 tex_coord;
+};
+
+local double
+now_ms()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+s32 init(RasterTexture *texture, const char *filename)
+{
+    Image image;
+    if (load_image(&image, filename, 4) != 0)
+    {
+        LOG_E("Cannot load texture '%s'", filename);
+        return -1;
+    }
+
+    texture->pixels = image.pixels;
+    texture->width = image.width;
+    texture->height = image.height;
+
+    return 0;
+}
+
+void destroy(RasterTexture *texture)
+{
+    free(texture->pixels);
+    texture->pixels = nullptr;
+}
+
+void init(RasterTarget *target, u32 width, u32 height)
+{
+    target->width = width;
+    target->height = height;
+    target->tiles_x = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    target->tiles_y = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    target->stride = target->tiles_x * RASTER_TILE_SIZE;
+
+    u32 padded_height = target->tiles_y * RASTER_TILE_SIZE;
+    u32 tile_count = target->tiles_x * target->tiles_y;
+    u32 block_count = tile_count * RASTER_BLOCKS_PER_TILE * RASTER_BLOCKS_PER_TILE;
+
+    target->color = (u32 *)_mm_malloc(target->stride * padded_height * sizeof(u32), 16);
+    target->depth = (float *)_mm_malloc(target->stride * padded_height * sizeof(float), 16);
+    target->block_max_depth = (float *)_mm_malloc(block_count * sizeof(float), 16);
+    target->tile_max_depth = (float *)_mm_malloc(tile_count * sizeof(float), 16);
+
+    target->triangles.clear();
+    target->bins.assign(tile_count, std::vector<u32>());
+    target->texture_container = nullptr;
+    target->texture_awesomeface = nullptr;
+    target->depth_only = false;
+
+    clear(target, glm::vec4(0.0f));
+}
+
+void destroy(RasterTarget *target)
+{
+    _mm_free(target->color);
+    _mm_free(target->depth);
+    _mm_free(target->block_max_depth);
+    _mm_free(target->tile_max_depth);
+
+    target->color = nullptr;
+    target->depth = nullptr;
+    target->block_max_depth = nullptr;
+    target->tile_max_depth = nullptr;
+
+    target->triangles.clear();
+    target->bins.clear();
+    target->setup_batches.clear();
+}
+
+local inline u32
+pack_color(const glm::vec4 &color)
+{
+    glm::vec4 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+    return (u32)c.r | ((u32)c.g << 8) | ((u32)c.b << 16) | ((u32)c.a << 24);
+}
+
+void clear(RasterTarget *target, const glm::vec4 &color)
+{
+    u32 pixel_count = target->stride * target->tiles_y * RASTER_TILE_SIZE;
+    u32 tile_count = target->tiles_x * target->tiles_y;
+    u32 block_count = tile_count * RASTER_BLOCKS_PER_TILE * RASTER_BLOCKS_PER_TILE;
+
+    if (!target->depth_only)
+    {
+        u32 packed = pack_color(color);
+        for (u32 i = 0; i < pixel_count; ++i) target->color[i] = packed;
+    }
+    for (u32 i = 0; i < pixel_count; ++i) target->depth[i] = 1.0f;
+    for (u32 i = 0; i < block_count; ++i) target->block_max_depth[i] = 1.0f;
+    for (u32 i = 0; i < tile_count; ++i) target->tile_max_depth[i] = 1.0f;
+
+    target->triangles.clear();
+    for (std::vector<u32> &bin : target->bins) bin.clear();
+
+    target->stats = {};
+}
+
+void set_textures(RasterTarget *target, const RasterTexture *container, const RasterTexture *awesomeface)
+{
+    target->texture_container = container;
+    target->texture_awesomeface = awesomeface;
+}
+
+local inline ClipVertex
+lerp(const ClipVertex &a, const ClipVertex &b, float t)
+{
+    ClipVertex result;
+    result.position = a.position + (b.position - a.position) * t;
+    result.tex_coord = a.tex_coord + (b.tex_coord - a.tex_coord) * t;
+    return result;
+}
+
+// clip space vertices to screen space edge functions, false when the
+// triangle covers no pixel
+local bool
+setup_triangle(const RasterTarget *target, const ClipVertex *v0, const ClipVertex *v1, const ClipVertex *v2,
+               RasterTriangle *triangle)
+{
+    const ClipVertex *corners[3] = { v0, v1, v2 };
+
+    float x[3], y[3];
+    for (u32 i = 0; i < 3; ++i)
+    {
+        const glm::vec4 &position = corners[i]->position;
+        float inv_w = 1.0f / position.w;
+
+        x[i] = (position.x * inv_w * 0.5f + 0.5f) * target->width;
+        y[i] = (position.y * inv_w * 0.5f + 0.5f) * target->height;
+
+        triangle->z[i] = position.z * inv_w * 0.5f + 0.5f;
+        triangle->inv_w[i] = inv_w;
+        triangle->uv_over_w[i] = corners[i]->tex_coord * inv_w;
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (area == 0.0f || !isfinite(area)) return false;
+
+    // no face culling in the GL path, flip clockwise triangles instead
+    if (area < 0.0f)
+    {
+        glm::vec2 uv = triangle->uv_over_w[1];
+        triangle->uv_over_w[1] = triangle->uv_over_w[2];
+        triangle->uv_over_w[2] = uv;
+
+        float swap;
+        swap = x[1]; x[1] = x[2]; x[2] = swap;
+        swap = y[1]; y[1] = y[2]; y[2] = swap;
+        swap = triangle->z[1]; triangle->z[1] = triangle->z[2]; triangle->z[2] = swap;
+        swap = triangle->inv_w[1]; triangle->inv_w[1] = triangle->inv_w[2]; triangle->inv_w[2] = swap;
+
+        area = -area;
+    }
+
+    // edge i is opposite to vertex i, its value at a pixel is the barycentric
+    // weight of vertex i
+    for (u32 i = 0; i < 3; ++i)
+    {
+        u32 a = (i + 1) % 3;
+        u32 b = (i + 2) % 3;
+
+        float edge_a = (y[a] - y[b]) / area;
+        float edge_b = (x[b] - x[a]) / area;
+
+        triangle->edge_a[i] = edge_a;
+        triangle->edge_b[i] = edge_b;
+        triangle->edge_c[i] = -(edge_a * x[a] + edge_b * y[a]);
+    }
+
+    float min_x = glm::min(x[0], glm::min(x[1], x[2]));
+    float min_y = glm::min(y[0], glm::min(y[1], y[2]));
+    float max_x = glm::max(x[0], glm::max(x[1], x[2]));
+    float max_y = glm::max(y[0], glm::max(y[1], y[2]));
+
+    // pixel centers are at + 0.5
+    triangle->min_x = glm::max(0, (s32)floorf(min_x - 0.5f));
+    triangle->min_y = glm::max(0, (s32)floorf(min_y - 0.5f));
+    triangle->max_x = glm::min((s32)target->width - 1, (s32)ceilf(max_x - 0.5f));
+    triangle->max_y = glm::min((s32)target->height - 1, (s32)ceilf(max_y - 0.5f));
+
+    if (triangle->min_x > triangle->max_x || triangle->min_y > triangle->max_y) return false;
+
+    triangle->min_z = glm::min(triangle->z[0], glm::min(triangle->z[1], triangle->z[2]));
+    if (triangle->min_z >= 1.0f) return false;
+
+    return true;
+}
+
+// transforms, clips against the near plane and sets up a range of
+// triangles; returns how many were dropped or split by clipping
+local u32
+setup_triangles(const RasterTarget *target, const Vertex *vertices, const u32 *indices,
+                u32 first_triangle, u32 end_triangle, const glm::mat4 &model_view_projection,
+                std::vector<RasterTriangle> *triangles)
+{
+    u32 clipped = 0;
+
+    for (u32 t = first_triangle; t < end_triangle; ++t)
+    {
+        ClipVertex corners[3];
+        u32 outside_near = 0;
+        u32 outcode = 0x3F;
+
+        for (u32 i = 0; i < 3; ++i)
+        {
+            const Vertex &vertex = vertices[indices[t * 3 + i]];
+            glm::vec4 p = model_view_projection * glm::vec4(vertex.position, 1.0f);
+
+            corners[i].position = p;
+            corners[i].tex_coord = vertex.tex_coord;
+
+            u32 code = 0;
+            if (p.x < -p.w) code |= 0x01;
+            if (p.x >  p.w) code |= 0x02;
+            if (p.y < -p.w) code |= 0x04;
+            if (p.y >  p.w) code |= 0x08;
+            if (p.z < -p.w) code |= 0x10;
+            if (p.z >  p.w) code |= 0x20;
+            outcode &= code;
+
+            if (code & 0x10) ++outside_near;
+        }
+
+        // every corner outside the same plane
+        if (outcode) continue;
+
+        RasterTriangle triangle;
+
+        if (outside_near == 0)
+        {
+            if (setup_triangle(target, &corners[0], &corners[1], &corners[2], &triangle))
+            {
+                triangles->push_back(triangle);
+            }
+            continue;
+        }
+
+        // Sutherland-Hodgman against z = -w, the only plane that matters:
+        // the rest is handled by the bounds clamp and the depth test
+        ClipVertex polygon[4];
+        u32 polygon_count = 0;
+
+        for (u32 i = 0; i < 3; ++i)
+        {
+            const ClipVertex &a = corners[i];
+            const ClipVertex &b = corners[(i + 1) % 3];
+
+            float da = a.position.z + a.position.w;
+            float db = b.position.z + b.position.w;
+
+            if (da >= 0.0f) polygon[polygon_count++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f)) polygon[polygon_count++] = lerp(a, b, da / (da - db));
+        }
+
+        ++clipped;
+
+        for (u32 i = 2; i < polygon_count; ++i)
+        {
+            if (setup_triangle(target, &polygon[0], &polygon[i - 1], &polygon[i], &triangle))
+            {
+                triangles->push_back(triangle);
+            }
+        }
+    }
+
+    return clipped;
+}
+
+local void
+bin_triangle(RasterTarget *target, const RasterTriangle &triangle)
+{
+    u32 index = (u32)target->triangles.size();
+    target->triangles.push_back(triangle);
+
+    u32 tile_x0 = triangle.min_x / RASTER_TILE_SIZE;
+    u32 tile_y0 = triangle.min_y / RASTER_TILE_SIZE;
+    u32 tile_x1 = triangle.max_x / RASTER_TILE_SIZE;
+    u32 tile_y1 = triangle.max_y / RASTER_TILE_SIZE;
+
+    for (u32 tile_y = tile_y0; tile_y <= tile_y1; ++tile_y)
+    {
+        for (u32 tile_x = tile_x0; tile_x <= tile_x1; ++tile_x)
+        {
+            target->bins[tile_y * target->tiles_x + tile_x].push_back(index);
+        }
+    }
+}
+
+void draw(RasterTarget *target, const Vertex *vertices, const u32 *indices, u32 index_count,
+          const glm::mat4 &model_view_projection)
+{
+    PROFILE_SCOPE("raster setup");
+    double start = now_ms();
+
+    u32 triangle_count = index_count / 3;
+    u32 batch_count = (triangle_count + RASTER_SETUP_BATCH - 1) / RASTER_SETUP_BATCH;
+
+    // batches are set up in parallel and binned in order, so the result does
+    // not depend on the thread count
+    if (target->setup_batches.size() < batch_count)
+    {
+        target->setup_batches.resize(batch_count);
+    }
+
+    std::vector<u32> clipped(batch_count, 0);
+
+    parallel_for(batch_count, 1, [&](u32 begin, u32 end, u32) {
+        for (u32 batch = begin; batch < end; ++batch)
+        {
+            u32 first = batch * RASTER_SETUP_BATCH;
+            u32 last = glm::min(first + RASTER_SETUP_BATCH, triangle_count);
+
+            target->setup_batches[batch].clear();
+            clipped[batch] = setup_triangles(target, vertices, indices, first, last, model_view_projection,
+                                             &target->setup_batches[batch]);
+        }
+    });
+
+    u32 binned = 0;
+    for (u32 batch = 0; batch < batch_count; ++batch)
+    {
+        for (const RasterTriangle &triangle : target->setup_batches[batch])
+        {
+            bin_triangle(target, triangle);
+        }
+
+        binned += (u32)target->setup_batches[batch].size();
+        target->stats.triangles_clipped += clipped[batch];
+    }
+
+    target->stats.draws += 1;
+    target->stats.triangles_submitted += triangle_count;
+    target->stats.triangles_binned += binned;
+    target->stats.setup_ms += now_ms() - start;
+}
+
+local inline glm::vec4
+sample(const RasterTexture *texture, float u, float v)
+{
+    if (!texture || !texture->pixels) return glm::vec4(1.0f);
+
+    // GL_LINEAR with GL_REPEAT
+    float x = u * texture->width - 0.5f;
+    float y = v * texture->height - 0.5f;
+    float fx = floorf(x);
+    float fy = floorf(y);
+    float tx = x - fx;
+    float ty = y - fy;
+
+    s32 x0 = (s32)fx % texture->width;
+    s32 y0 = (s32)fy % texture->height;
+    if (x0 < 0) x0 += texture->width;
+    if (y0 < 0) y0 += texture->height;
+    s32 x1 = x0 + 1 == texture->width ? 0 : x0 + 1;
+    s32 y1 = y0 + 1 == texture->height ? 0 : y0 + 1;
+
+    auto texel = [texture](s32 tx_, s32 ty_) {
+        const u8 *p = texture->pixels + ((size_t)ty_ * texture->width + tx_) * 4;
+        return glm::vec4(p[0], p[1], p[2], p[3]) * (1.0f / 255.0f);
+    };
+
+    glm::vec4 bottom = glm::mix(texel(x0, y0), texel(x1, y0), tx);
+    glm::vec4 top = glm::mix(texel(x0, y1), texel(x1, y1), tx);
+    return glm::mix(bottom, top, ty);
+}
+
+// fragment_shader.frag
+local inline u32
+shade(const RasterTarget *target, float u, float v)
+{
+    glm::vec4 color = glm::mix(sample(target->texture_container, u, v),
+                               sample(target->texture_awesomeface, u, v),
+                               0.2f);
+    color.a = 1.0f;
+    return pack_color(color);
+}
+
+// rasterizes the rows [y0, y1] of the block at x0, returns true when any
+// pixel passed the depth test
+local bool
+raster_block(RasterTarget *target, const RasterTriangle &triangle, s32 x0, s32 y0, s32 y1)
+{
+    __m128 a0 = _mm_set1_ps(triangle.edge_a[0]);
+    __m128 a1 = _mm_set1_ps(triangle.edge_a[1]);
+    __m128 a2 = _mm_set1_ps(triangle.edge_a[2]);
+    __m128 z0 = _mm_set1_ps(triangle.z[0]);
+    __m128 z1 = _mm_set1_ps(triangle.z[1]);
+    __m128 z2 = _mm_set1_ps(triangle.z[2]);
+    __m128 zero = _mm_setzero_ps();
+    __m128 lane_offset = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+    bool written = false;
+
+    for (s32 y = y0; y <= y1; ++y)
+    {
+        float py = y + 0.5f;
+        __m128 row0 = _mm_set1_ps(triangle.edge_b[0] * py + triangle.edge_c[0]);
+        __m128 row1 = _mm_set1_ps(triangle.edge_b[1] * py + triangle.edge_c[1]);
+        __m128 row2 = _mm_set1_ps(triangle.edge_b[2] * py + triangle.edge_c[2]);
+
+        for (s32 x = x0; x < x0 + RASTER_BLOCK_SIZE; x += 4)
+        {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lane_offset);
+
+            __m128 w0 = _mm_add_ps(_mm_mul_ps(a0, px), row0);
+            __m128 w1 = _mm_add_ps(_mm_mul_ps(a1, px), row1);
+            __m128 w2 = _mm_add_ps(_mm_mul_ps(a2, px), row2);
+
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)),
+                                       _mm_cmpge_ps(w2, zero));
+            if (!_mm_movemask_ps(inside)) continue;
+
+            float *depth = target->depth + (size_t)y * target->stride + x;
+            __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, z0), _mm_mul_ps(w1, z1)), _mm_mul_ps(w2, z2));
+            __m128 old_depth = _mm_load_ps(depth);
+
+            __m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(z, old_depth));
+            s32 mask = _mm_movemask_ps(pass);
+            if (!mask) continue;
+
+            _mm_store_ps(depth, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, old_depth)));
+            written = true;
+
+            if (target->depth_only) continue;
+
+            // perspective correct texture coordinates
+            __m128 inv_w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, _mm_set1_ps(triangle.inv_w[0])),
+                                                 _mm_mul_ps(w1, _mm_set1_ps(triangle.inv_w[1]))),
+                                      _mm_mul_ps(w2, _mm_set1_ps(triangle.inv_w[2])));
+            __m128 u = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, _mm_set1_ps(triangle.uv_over_w[0].x)),
+                                             _mm_mul_ps(w1, _mm_set1_ps(triangle.uv_over_w[1].x))),
+                                  _mm_mul_ps(w2, _mm_set1_ps(triangle.uv_over_w[2].x)));
+            __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, _mm_set1_ps(triangle.uv_over_w[0].y)),
+                                             _mm_mul_ps(w1, _mm_set1_ps(triangle.uv_over_w[1].y))),
+                                  _mm_mul_ps(w2, _mm_set1_ps(triangle.uv_over_w[2].y)));
+            u = _mm_div_ps(u, inv_w);
+            v = _mm_div_ps(v, inv_w);
+
+            alignas(16) float us[4];
+            alignas(16) float vs[4];
+            _mm_store_ps(us, u);
+            _mm_store_ps(vs, v);
+
+            u32 *color = target->color + (size_t)y * target->stride + x;
+            for (u32 lane = 0; lane < 4; ++lane)
+            {
+                if (mask & (1 << lane)) color[lane] = shade(target, us[lane], vs[lane]);
+            }
+        }
+    }
+
+    return written;
+}
+
+local float
+block_max_depth(const RasterTarget *target, s32 x0, s32 y0)
+{
+    __m128 max_depth = _mm_setzero_ps();
+    for (s32 y = y0; y < y0 + RASTER_BLOCK_SIZE; ++y)
+    {
+        const float *depth = target->depth + (size_t)y * target->stride + x0;
+        for (s32 x = 0; x < RASTER_BLOCK_SIZE; x += 4)
+        {
+            max_depth = _mm_max_ps(max_depth, _mm_load_ps(depth + x));
+        }
+    }
+
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, max_depth);
+    return glm::max(glm::max(lanes[0], lanes[1]), glm::max(lanes[2], lanes[3]));
+}
+
+local float
+tile_max_depth(const RasterTarget *target, u32 tile)
+{
+    u32 blocks_x = target->tiles_x * RASTER_BLOCKS_PER_TILE;
+    u32 first_block_x = (tile % target->tiles_x) * RASTER_BLOCKS_PER_TILE;
+    u32 first_block_y = (tile / target->tiles_x) * RASTER_BLOCKS_PER_TILE;
+
+    float max_depth = 0.0f;
+    for (u32 block_y = 0; block_y < RASTER_BLOCKS_PER_TILE; ++block_y)
+    {
+        const float *row = target->block_max_depth + (first_block_y + block_y) * blocks_x + first_block_x;
+
+        for (u32 block_x = 0; block_x < RASTER_BLOCKS_PER_TILE; ++block_x)
+        {
+            max_depth = glm::max(max_depth, row[block_x]);
+        }
+    }
+
+    return max_depth;
+}
+
+local void
+raster_tile(RasterTarget *target, u32 tile, RasterStats *stats)
+{
+    s32 tile_x0 = (tile % target->tiles_x) * RASTER_TILE_SIZE;
+    s32 tile_y0 = (tile / target->tiles_x) * RASTER_TILE_SIZE;
+    u32 blocks_x = target->tiles_x * RASTER_BLOCKS_PER_TILE;
+
+    for (u32 index : target->bins[tile])
+    {
+        const RasterTriangle &triangle = target->triangles[index];
+        ++stats->tile_triangles;
+
+        if (triangle.min_z >= target->tile_max_depth[tile])
+        {
+            continue;
+        }
+
+        s32 x0 = glm::max(triangle.min_x, tile_x0);
+        s32 y0 = glm::max(triangle.min_y, tile_y0);
+        s32 x1 = glm::min(triangle.max_x, tile_x0 + RASTER_TILE_SIZE - 1);
+        s32 y1 = glm::min(triangle.max_y, tile_y0 + RASTER_TILE_SIZE - 1);
+
+        bool tile_written = false;
+
+        for (s32 block_y = y0 / RASTER_BLOCK_SIZE; block_y <= y1 / RASTER_BLOCK_SIZE; ++block_y)
+        {
+            for (s32 block_x = x0 / RASTER_BLOCK_SIZE; block_x <= x1 / RASTER_BLOCK_SIZE; ++block_x)
+            {
+                u32 block = block_y * blocks_x + block_x;
+                ++stats->blocks_tested;
+
+                if (triangle.min_z >= target->block_max_depth[block])
+                {
+                    ++stats->blocks_rejected;
+                    continue;
+                }
+
+                s32 bx = block_x * RASTER_BLOCK_SIZE;
+                s32 by = block_y * RASTER_BLOCK_SIZE;
+
+                if (raster_block(target, triangle, bx,
+                                 glm::max(y0, by), glm::min(y1, by + RASTER_BLOCK_SIZE - 1)))
+                {
+                    target->block_max_depth[block] = block_max_depth(target, bx, by);
+                    tile_written = true;
+                }
+            }
+        }
+
+        if (tile_written)
+        {
+            target->tile_max_depth[tile] = tile_max_depth(target, tile);
+        }
+    }
+}
+
+void resolve(RasterTarget *target)
+{
+    double start = now_ms();
+
+    u32 tile_count = target->tiles_x * target->tiles_y;
+    std::vector<RasterStats> worker_stats(worker_count(), RasterStats{});
+
+    // one tile per job, tiles own their pixels so workers never share any
+    parallel_for(tile_count, 1, [&](u32 begin, u32 end, u32 worker) {
+        PROFILE_SCOPE("raster tiles");
+        for (u32 tile = begin; tile < end; ++tile)
+        {
+            raster_tile(target, tile, &worker_stats[worker]);
+        }
+    });
+
+    for (const RasterStats &stats : worker_stats)
+    {
+        target->stats.tile_triangles += stats.tile_triangles;
+        target->stats.blocks_tested += stats.blocks_tested;
+        target->stats.blocks_rejected += stats.blocks_rejected;
+    }
+
+    target->stats.raster_ms += now_ms() - start;
+}
+
+void refresh_depth_hierarchy(RasterTarget *target)
+{
+    u32 tile_count = target->tiles_x * target->tiles_y;
+    u32 blocks_x = target->tiles_x * RASTER_BLOCKS_PER_TILE;
+    u32 blocks_y = target->tiles_y * RASTER_BLOCKS_PER_TILE;
+
+    for (u32 block_y = 0; block_y < blocks_y; ++block_y)
+    {
+        for (u32 block_x = 0; block_x < blocks_x; ++block_x)
+        {
+            target->block_max_depth[block_y * blocks_x + block_x] =
+                block_max_depth(target, block_x * RASTER_BLOCK_SIZE, block_y * RASTER_BLOCK_SIZE);
+        }
+    }
+
+    for (u32 tile = 0; tile < tile_count; ++tile)
+    {
+        target->tile_max_depth[tile] = tile_max_depth(target, tile);
+    }
+}
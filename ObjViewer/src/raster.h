@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "types.h"
+#include "mesh.h"
+
+// CPU rasterizer that renders what the GL path renders: indexed triangles,
+// GL clip space conventions (y up, depth in [-1, 1] mapped to [0, 1], depth
+// test LESS, no face culling) and the container/awesomeface mix of
+// fragment_shader.frag.
+//
+// draw() transforms, clips against the near plane and bins triangles into
+// RASTER_TILE_SIZE tiles; resolve() rasterizes the tiles in parallel, one
+// worker per tile so no locking is needed. Inside a tile the coverage is
+// tested with half-space edge functions, 4 pixels per SSE op, and each
+// RASTER_BLOCK_SIZE block keeps its farthest depth so occluded triangles
+// are rejected a block (or a whole tile) at a time.
+
+#define RASTER_TILE_SIZE 64
+#define RASTER_BLOCK_SIZE 8
+#define RASTER_BLOCKS_PER_TILE (RASTER_TILE_SIZE / RASTER_BLOCK_SIZE)
+
+struct RasterTexture
+{
+    s32 width;
+    s32 height;
+    u8 *pixels; // rgba8, first row is v = 0 like the flipped GL upload
+};
+
+struct RasterTriangle
+{
+    // edge functions w_i = a_i * x + b_i * y + c_i, normalized by the area so
+    // they are the barycentric coordinates directly
+    float edge_a[3];
+    float edge_b[3];
+    float edge_c[3];
+
+    float z[3];        // window space depth
+    float inv_w[3];
+    glm::vec2 uv_over_w[3];
+
+    float min_z;
+    s32 min_x, min_y, max_x, max_y; // inclusive pixel bounds, clamped to the target
+};
+
+struct RasterStats
+{
+    u32 draws;
+    u32 triangles_submitted;
+    u32 triangles_binned;
+    u32 triangles_clipped;
+    u64 tile_triangles;
+    u64 blocks_tested;
+    u64 blocks_rejected;
+    double setup_ms;
+    double raster_ms;
+};
+
+struct RasterTarget
+{
+    u32 width;
+    u32 height;
+    u32 tiles_x;
+    u32 tiles_y;
+
+    u32 stride; // pixels per row, rows and columns are padded to whole tiles
+    u32 *color; // rgba8, first row is the bottom of the image
+    float *depth;
+
+    // farthest depth of every block and of every tile, a triangle that is
+    // nowhere nearer than that fails the depth test on all of their pixels
+    float *block_max_depth;
+    float *tile_max_depth;
+
+    std::vector<RasterTriangle> triangles;
+    std::vector<std::vector<u32>> bins; // triangle indices per tile, in submission order
+    std::vector<std::vector<RasterTriangle>> setup_batches; // per job batch scratch
+
+    const RasterTexture *texture_container;
+    const RasterTexture *texture_awesomeface;
+
+    bool depth_only; // skips shading and the color buffer, for occlusion
+
+    RasterStats stats;
+};
+
+s32 init(RasterTexture *texture, const char *filename);
+void destroy(RasterTexture *texture);
+
+void init(RasterTarget *target, u32 width, u32 height);
+void destroy(RasterTarget *target);
+
+// starts a frame: clears color and depth, drops the binned triangles and stats
+void clear(RasterTarget *target, const glm::vec4 &color);
+
+void set_textures(RasterTarget *target, const RasterTexture *container, const RasterTexture *awesomeface);
+
+// indices index into vertices like glDrawElements, draws can be ranges of one mesh
+void draw(RasterTarget *target, const Vertex *vertices, const u32 *indices, u32 index_count,
+          const glm::mat4 &model_view_projection);
+
+// rasterizes everything drawn since clear()
+void resolve(RasterTarget *target);
+
+// recomputes the block and tile depth bounds after the depth buffer was
+// written directly
+void refresh_depth_hierarchy(RasterTarget *target);
@@ -0,0 +1,268 @@
+#include <float.h>
+
+#include <algorithm>
+#include <functional>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "scene.h"
+#include "log.h"
+#include "profile.h"
+
+void init(SceneGraph *scene)
+{
+    *scene = {};
+}
+
+void transform_bounds(const glm::mat4 &m, const glm::vec3 &bounds_min, const glm::vec3 &bounds_max,
+                      glm::vec3 *out_min, glm::vec3 *out_max)
+{
+    if (bounds_min.x > bounds_max.x)
+    {
+        *out_min = glm::vec3(FLT_MAX);
+        *out_max = glm::vec3(-FLT_MAX);
+        return;
+    }
+
+    // center/extent form: the new extent is |M| * extent
+    glm::vec3 center = (bounds_min + bounds_max) * 0.5f;
+    glm::vec3 extent = (bounds_max - bounds_min) * 0.5f;
+
+    glm::vec3 new_center = glm::vec3(m * glm::vec4(center, 1.0f));
+    glm::vec3 new_extent = glm::abs(glm::vec3(m[0])) * extent.x +
+                           glm::abs(glm::vec3(m[1])) * extent.y +
+                           glm::abs(glm::vec3(m[2])) * extent.z;
+
+    *out_min = new_center - new_extent;
+    *out_max = new_center + new_extent;
+}
+
+u32 add_node(SceneGraph *scene, u32 parent, const glm::mat4 &transform, s32 mesh,
+             const glm::vec3 &bounds_min, const glm::vec3 &bounds_max)
+{
+    u32 node = scene->count;
+
+    while (!scene->open_path.empty() && scene->open_path.back() != parent)
+    {
+        scene->open_path.pop_back();
+    }
+
+    if (parent != SCENE_NO_PARENT && scene->open_path.empty())
+    {
+        LOG_E("Scene node %u added out of depth first order (parent %u)", node, parent);
+        parent = SCENE_NO_PARENT;
+    }
+
+    scene->open_path.push_back(node);
+    scene->structure_changed = true;
+
+    ++scene->count;
+
+    scene->parent.push_back(parent);
+    scene->subtree_end.push_back(node + 1);
+    scene->local_transform.push_back(transform);
+    scene->world.push_back(transform);
+    scene->local_bounds_min.push_back(bounds_min);
+    scene->local_bounds_max.push_back(bounds_max);
+    scene->bounds_min.push_back(glm::vec3(FLT_MAX));
+    scene->bounds_max.push_back(glm::vec3(-FLT_MAX));
+    scene->mesh.push_back(mesh);
+    scene->dirty.push_back(1);
+    scene->dirty_nodes.push_back(node);
+
+    return node;
+}
+
+u32 add_mesh_nodes(SceneGraph *scene, u32 parent, const glm::mat4 &transform, const Mesh *mesh)
+{
+    glm::vec3 empty_min(FLT_MAX);
+    glm::vec3 empty_max(-FLT_MAX);
+
+    if (scene->count == 0) scene->origin = mesh->origin;
+    glm::vec3 offset = glm::vec3(mesh->origin - scene->origin);
+
+    u32 model = add_node(scene, parent, glm::translate(glm::mat4(1.0f), offset) * transform,
+                         SCENE_NO_MESH, empty_min, empty_max);
+    u32 object = SCENE_NO_PARENT;
+
+    for (u32 i = 0; i < (u32)mesh->groups.size(); ++i)
+    {
+        const MeshGroup &group = mesh->groups[i];
+
+        if (object == SCENE_NO_PARENT || group.object_name != mesh->groups[i - 1].object_name)
+        {
+            object = add_node(scene, model, glm::mat4(1.0f), SCENE_NO_MESH, empty_min, empty_max);
+        }
+
+        add_node(scene, object, glm::mat4(1.0f), (s32)i, group.bounds_min, group.bounds_max);
+    }
+
+    return model;
+}
+
+void set_local(SceneGraph *scene, u32 node, const glm::mat4 &transform)
+{
+    scene->local_transform[node] = transform;
+
+    if (!scene->dirty[node])
+    {
+        scene->dirty[node] = 1;
+        scene->dirty_nodes.push_back(node);
+    }
+}
+
+local inline void
+merge_bounds(glm::vec3 *bounds_min, glm::vec3 *bounds_max, const glm::vec3 &other_min, const glm::vec3 &other_max)
+{
+    *bounds_min = glm::min(*bounds_min, other_min);
+    *bounds_max = glm::max(*bounds_max, other_max);
+}
+
+// exact bounds of a node from its own geometry and its direct children,
+// children are found by hopping from one subtree to the next
+local void
+refit_node(SceneGraph *scene, u32 node)
+{
+    glm::vec3 bounds_min, bounds_max;
+    transform_bounds(scene->world[node], scene->local_bounds_min[node], scene->local_bounds_max[node],
+                     &bounds_min, &bounds_max);
+
+    for (u32 child = node + 1; child < scene->subtree_end[node]; child = scene->subtree_end[child])
+    {
+        merge_bounds(&bounds_min, &bounds_max, scene->bounds_min[child], scene->bounds_max[child]);
+    }
+
+    scene->bounds_min[node] = bounds_min;
+    scene->bounds_max[node] = bounds_max;
+}
+
+void update_scene(SceneGraph *scene)
+{
+    PROFILE_SCOPE("update scene");
+
+    if (scene->structure_changed)
+    {
+        // a subtree ends where the last subtree of its children ends
+        for (u32 node = 0; node < scene->count; ++node) scene->subtree_end[node] = node + 1;
+        for (u32 node = scene->count; node-- > 0;)
+        {
+            u32 parent = scene->parent[node];
+            if (parent != SCENE_NO_PARENT && scene->subtree_end[node] > scene->subtree_end[parent])
+            {
+                scene->subtree_end[parent] = scene->subtree_end[node];
+            }
+        }
+
+        scene->structure_changed = false;
+    }
+
+    if (scene->dirty_nodes.empty()) return;
+
+    // ascending order so a dirty node inside an already updated subtree is skipped
+    std::sort(scene->dirty_nodes.begin(), scene->dirty_nodes.end());
+
+    u32 updated_end = 0;
+    for (u32 root : scene->dirty_nodes)
+    {
+        if (root < updated_end) continue;
+
+        u32 end = scene->subtree_end[root];
+
+        // parents come first, one forward pass is enough
+        for (u32 node = root; node < end; ++node)
+        {
+            u32 parent = scene->parent[node];
+            scene->world[node] = parent == SCENE_NO_PARENT ?
+                scene->local_transform[node] :
+                scene->world[parent] * scene->local_transform[node];
+
+            transform_bounds(scene->world[node], scene->local_bounds_min[node], scene->local_bounds_max[node],
+                             &scene->bounds_min[node], &scene->bounds_max[node]);
+
+            scene->dirty[node] = 0;
+        }
+
+        // children come last, a backward pass folds them into their parents
+        for (u32 node = end - 1; node > root; --node)
+        {
+            u32 parent = scene->parent[node];
+            merge_bounds(&scene->bounds_min[parent], &scene->bounds_max[parent],
+                         scene->bounds_min[node], scene->bounds_max[node]);
+        }
+
+        // the bounds of the ancestors may have grown or shrunk; they are
+        // collected once, a chain stops where an earlier root's chain is
+        for (u32 ancestor = scene->parent[root]; ancestor != SCENE_NO_PARENT; ancestor = scene->parent[ancestor])
+        {
+            if (scene->dirty[ancestor] == SCENE_REFIT) break;
+            scene->dirty[ancestor] = SCENE_REFIT;
+            scene->refit_nodes.push_back(ancestor);
+        }
+
+        updated_end = end;
+    }
+
+    // descending, so an ancestor sees the refitted bounds of the ones below it
+    std::sort(scene->refit_nodes.begin(), scene->refit_nodes.end(), std::greater<u32>());
+    for (u32 node : scene->refit_nodes)
+    {
+        refit_node(scene, node);
+        scene->dirty[node] = 0;
+    }
+
+    scene->refit_nodes.clear();
+    scene->dirty_nodes.clear();
+}
+
+u64 scene_memory(const SceneGraph *scene)
+{
+    return scene->parent.capacity() * sizeof(u32) +
+           scene->subtree_end.capacity() * sizeof(u32) +
+           (scene->local_transform.capacity() + scene->world.capacity()) * sizeof(glm::mat4) +
+           (scene->local_bounds_min.capacity() + scene->local_bounds_max.capacity() +
+            scene->bounds_min.capacity() + scene->bounds_max.capacity()) * sizeof(glm::vec3) +
+           scene->mesh.capacity() * sizeof(s32) +
+           scene->dirty.capacity() * sizeof(u8) +
+           (scene->dirty_nodes.capacity() + scene->refit_nodes.capacity()) * sizeof(u32);
+}
+
+bool get_scene_bounds(const SceneGraph *scene, glm::vec3 *bounds_min, glm::vec3 *bounds_max)
+{
+    glm::vec3 result_min(FLT_MAX);
+    glm::vec3 result_max(-FLT_MAX);
+
+    // roots follow each other, every subtree skipped as a whole
+    for (u32 node = 0; node < scene->count; node = scene->subtree_end[node])
+    {
+        result_min = glm::min(result_min, scene->bounds_min[node]);
+        result_max = glm::max(result_max, scene->bounds_max[node]);
+    }
+
+    if (result_min.x > result_max.x) return false;
+
+    *bounds_min = result_min;
+    *bounds_max = result_max;
+    return true;
+}
+
+void cull_scene(const SceneGraph *scene, const Frustum *frustum, std::vector<u32> *visible)
+{
+    PROFILE_SCOPE("frustum cull");
+
+    u32 node = 0;
+    while (node < scene->count)
+    {
+        if (!intersects(frustum, scene->bounds_min[node], scene->bounds_max[node]))
+        {
+            node = scene->subtree_end[node];
+            continue;
+        }
+
+        if (scene->mesh[node] != SCENE_NO_MESH)
+        {
+            visible->push_back(node);
+        }
+
+        ++node;
+    }
+}
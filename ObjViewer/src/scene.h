@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "types.h"
+#include "frustum.h"
+#include "mesh.h"
+
+// Scene hierarchy stored as flat arrays in depth first order: a node is
+// always followed by its whole subtree, [node, subtree_end[node]), so
+// transforms propagate with a linear walk and culling can skip a subtree
+// by jumping to its end, no child pointers involved.
+//
+// Nodes must be added depth first: the parent of a new node has to be the
+// last added node or one of its ancestors.
+
+#define SCENE_NO_PARENT 0xFFFFFFFF
+#define SCENE_NO_MESH -1
+#define SCENE_REFIT 2
+
+struct SceneGraph
+{
+    u32 count;
+
+    // world position the world space below is relative to, taken from the
+    // first mesh added so its coordinates stay small
+    glm::dvec3 origin;
+
+    std::vector<u32> parent;
+    std::vector<u32> subtree_end; // up to date after update_scene
+
+    std::vector<glm::mat4> local_transform;
+    std::vector<glm::mat4> world;
+
+    // object space bounds of the node's own geometry, empty when min > max
+    std::vector<glm::vec3> local_bounds_min;
+    std::vector<glm::vec3> local_bounds_max;
+
+    // world space bounds of the node and all its descendants
+    std::vector<glm::vec3> bounds_min;
+    std::vector<glm::vec3> bounds_max;
+
+    std::vector<s32> mesh; // caller defined draw index, SCENE_NO_MESH for pure transform nodes
+
+    std::vector<u8> dirty; // SCENE_REFIT while update_scene collects ancestors
+    std::vector<u32> dirty_nodes;
+    std::vector<u32> refit_nodes;
+
+    // ancestors of the last added node, to enforce the depth first order
+    std::vector<u32> open_path;
+    bool structure_changed;
+};
+
+void init(SceneGraph *scene);
+
+u32 add_node(SceneGraph *scene, u32 parent, const glm::mat4 &transform, s32 mesh,
+             const glm::vec3 &bounds_min, const glm::vec3 &bounds_max);
+
+// a node for the model, one child per obj object and one grandchild per
+// group, whose mesh is the index of the MeshGroup; returns the model node.
+// The offset between the mesh origin and the scene origin is worked out in
+// double and placed before transform.
+u32 add_mesh_nodes(SceneGraph *scene, u32 parent, const glm::mat4 &transform, const Mesh *mesh);
+
+void set_local(SceneGraph *scene, u32 node, const glm::mat4 &transform);
+
+// recomputes world transforms and bounds of the dirty subtrees only
+void update_scene(SceneGraph *scene);
+
+// bytes held by the node arrays
+u64 scene_memory(const SceneGraph *scene);
+
+// union of the bounds of every root, false for an empty scene; needs
+// update_scene first
+bool get_scene_bounds(const SceneGraph *scene, glm::vec3 *bounds_min, glm::vec3 *bounds_max);
+
+// appends the nodes with a mesh whose bounds touch the frustum
+void cull_scene(const SceneGraph *scene, const Frustum *frustum, std::vector<u32> *visible);
+
+void transform_bounds(const glm::mat4 &m, const glm::vec3 &bounds_min, const glm::vec3 &bounds_max,
+                      glm::vec3 *out_min, glm::vec3 *out_max);
@@ -0,0 +1,295 @@
+#include <math.h>
+#include <float.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "scenegen.h"
+#include "png.h"
+#include "log.h"
+#include "profile.h"
+
+#define TERRAIN_SIZE 1000.0f
+#define TERRAIN_HEIGHT 40.0f
+#define TERRAIN_WAVES 6
+#define PART_SIZE 2.0f
+
+SceneGeneratorOptions default_scene_generator_options()
+{
+    SceneGeneratorOptions options;
+    options.seed = 1;
+    options.terrain_triangles = 500000;
+    options.tiles_per_side = 16;
+    options.materials = 64;
+    options.texture_size = 256;
+    options.instances = 20000;
+    options.hierarchy_depth = 8;
+    return options;
+}
+
+// the generator has to give the same numbers everywhere, so no rand()
+local u32
+next_random(u32 *state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state;
+}
+
+local float
+random_float(u32 *state, float min, float max)
+{
+    return min + (max - min) * (float)(next_random(state) >> 8) / (float)(1 << 24);
+}
+
+struct TerrainWave
+{
+    glm::vec2 direction;
+    float frequency;
+    float amplitude;
+    float phase;
+};
+
+local float
+terrain_height(const TerrainWave *waves, float x, float z)
+{
+    float height = 0.0f;
+    for (u32 i = 0; i < TERRAIN_WAVES; ++i)
+    {
+        const TerrainWave &wave = waves[i];
+        height += wave.amplitude * sinf((wave.direction.x * x + wave.direction.y * z) * wave.frequency + wave.phase);
+    }
+    return height;
+}
+
+local void
+add_part(Mesh *mesh)
+{
+    u32 first_vertex = (u32)mesh->vertices.size();
+
+    // a box with its own corners per face so the uvs stay square
+    const glm::vec3 normals[6] = {
+        glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+        glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1),
+    };
+
+    for (u32 face = 0; face < 6; ++face)
+    {
+        glm::vec3 n = normals[face];
+        glm::vec3 u = glm::abs(n.y) > 0.5f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+        glm::vec3 v = glm::cross(n, u);
+
+        for (u32 corner = 0; corner < 4; ++corner)
+        {
+            float s = (corner & 1) ? 1.0f : 0.0f;
+            float t = (corner & 2) ? 1.0f : 0.0f;
+
+            Vertex vertex = {};
+            vertex.position = (n + u * (s * 2.0f - 1.0f) + v * (t * 2.0f - 1.0f)) * (PART_SIZE * 0.5f);
+            vertex.tex_coord = glm::vec2(s, t);
+            mesh->vertices.push_back(vertex);
+        }
+
+        u32 base = first_vertex + face * 4;
+        u32 quad[6] = { base, base + 1, base + 3, base, base + 3, base + 2 };
+        mesh->indices.insert(mesh->indices.end(), quad, quad + 6);
+    }
+}
+
+void generate_mesh(Mesh *mesh, const SceneGeneratorOptions &options)
+{
+    PROFILE_SCOPE("generate mesh");
+
+    *mesh = {};
+    u32 random = options.seed;
+
+    TerrainWave waves[TERRAIN_WAVES];
+    for (u32 i = 0; i < TERRAIN_WAVES; ++i)
+    {
+        float angle = random_float(&random, 0.0f, 6.2831853f);
+        waves[i].direction = glm::vec2(cosf(angle), sinf(angle));
+        waves[i].frequency = random_float(&random, 0.005f, 0.05f) * (float)(i + 1);
+        waves[i].amplitude = TERRAIN_HEIGHT / (float)(i + 1);
+        waves[i].phase = random_float(&random, 0.0f, 6.2831853f);
+    }
+
+    u32 cells = glm::max((u32)sqrtf(options.terrain_triangles * 0.5f), 1u);
+    u32 tiles = glm::clamp(options.tiles_per_side, 1u, cells);
+    u32 side = cells + 1;
+    float cell_size = TERRAIN_SIZE / cells;
+
+    mesh->vertices.reserve((size_t)side * side + 24);
+    for (u32 z = 0; z < side; ++z)
+    {
+        for (u32 x = 0; x < side; ++x)
+        {
+            float world_x = x * cell_size - TERRAIN_SIZE * 0.5f;
+            float world_z = z * cell_size - TERRAIN_SIZE * 0.5f;
+
+            Vertex vertex = {};
+            vertex.position = glm::vec3(world_x, terrain_height(waves, world_x, world_z), world_z);
+            vertex.tex_coord = glm::vec2((float)x * tiles / cells, (float)z * tiles / cells);
+            mesh->vertices.push_back(vertex);
+        }
+    }
+
+    u32 materials = glm::max(options.materials, 1u);
+    for (u32 i = 0; i < materials; ++i)
+    {
+        char name[64];
+        char texture[64];
+        snprintf(name, sizeof(name), "generated_%u", i);
+        snprintf(texture, sizeof(texture), "generated_%u_%u.png", options.seed, i);
+        mesh->materials.push_back(Material{name, texture});
+    }
+
+    // the tile boundaries fall on cells, every cell belongs to one tile
+    mesh->indices.reserve((size_t)cells * cells * 6 + 36);
+    for (u32 tile_z = 0; tile_z < tiles; ++tile_z)
+    {
+        for (u32 tile_x = 0; tile_x < tiles; ++tile_x)
+        {
+            MeshGroup group = {};
+            group.object_name = "terrain";
+            group.group_name = "tile_" + std::to_string(tile_x) + "_" + std::to_string(tile_z);
+            group.material = next_random(&random) % materials;
+            group.first_index = (u32)mesh->indices.size();
+
+            for (u32 z = tile_z * cells / tiles; z < (tile_z + 1) * cells / tiles; ++z)
+            {
+                for (u32 x = tile_x * cells / tiles; x < (tile_x + 1) * cells / tiles; ++x)
+                {
+                    u32 a = z * side + x;
+                    u32 b = a + 1;
+                    u32 c = a + side;
+                    u32 d = c + 1;
+                    u32 quad[6] = { a, c, b, b, c, d };
+                    mesh->indices.insert(mesh->indices.end(), quad, quad + 6);
+                }
+            }
+
+            group.index_count = (u32)mesh->indices.size() - group.first_index;
+            mesh->groups.push_back(group);
+        }
+    }
+
+    MeshGroup part = {};
+    part.object_name = "part";
+    part.material = next_random(&random) % materials;
+    part.first_index = (u32)mesh->indices.size();
+    add_part(mesh);
+    part.index_count = (u32)mesh->indices.size() - part.first_index;
+    mesh->groups.push_back(part);
+
+    mesh->has_normals = false;
+    compute_bounds(mesh);
+}
+
+s32 save_generated_textures(const Mesh *mesh, const SceneGeneratorOptions &options)
+{
+    PROFILE_SCOPE("generate textures");
+
+    u32 size = glm::max(options.texture_size, 4u);
+    std::vector<u32> pixels((size_t)size * size);
+
+    for (u32 i = 0; i < (u32)mesh->materials.size(); ++i)
+    {
+        // a checker of two seeded colors with some noise, every file differs
+        // so the texture cache cannot share them
+        u32 random = options.seed * 7919u + i;
+        u32 color_a = next_random(&random) | 0xFF000000u;
+        u32 color_b = next_random(&random) | 0xFF000000u;
+        u32 checker = 1u << (2 + next_random(&random) % 4);
+
+        for (u32 y = 0; y < size; ++y)
+        {
+            for (u32 x = 0; x < size; ++x)
+            {
+                u32 color = ((x / checker + y / checker) & 1) ? color_a : color_b;
+                pixels[(size_t)y * size + x] = color ^ (next_random(&random) >> 28);
+            }
+        }
+
+        const char *filename = mesh->materials[i].diffuse_texture.c_str();
+        if (write_png(filename, size, size, size, pixels.data(), false) != 0)
+        {
+            LOG_W("Cannot write generated texture '%s'", filename);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+struct InstanceTreeBuilder
+{
+    SceneGraph *scene;
+    const MeshGroup *part;
+    s32 part_group;
+    u32 branching;
+    u32 depth;
+    u32 remaining;
+    u32 random;
+};
+
+local void
+add_instance_level(InstanceTreeBuilder *builder, u32 parent, u32 level, float spread)
+{
+    glm::vec3 empty_min(FLT_MAX);
+    glm::vec3 empty_max(-FLT_MAX);
+
+    for (u32 child = 0; child < builder->branching && builder->remaining > 0; ++child)
+    {
+        glm::vec3 offset(random_float(&builder->random, -spread, spread),
+                         random_float(&builder->random, 0.0f, spread * 0.25f),
+                         random_float(&builder->random, -spread, spread));
+        float angle = random_float(&builder->random, -0.5f, 0.5f);
+        glm::mat4 transform = glm::rotate(glm::translate(glm::mat4(1.0f), offset), angle, glm::vec3(0.0f, 1.0f, 0.0f));
+
+        if (level + 1 == builder->depth)
+        {
+            add_node(builder->scene, parent, transform, builder->part_group,
+                     builder->part->bounds_min, builder->part->bounds_max);
+            --builder->remaining;
+        }
+        else
+        {
+            u32 node = add_node(builder->scene, parent, transform, SCENE_NO_MESH, empty_min, empty_max);
+            add_instance_level(builder, node, level + 1, spread * 0.5f);
+        }
+    }
+}
+
+u32 generate_scene(SceneGraph *scene, const Mesh *mesh, const SceneGeneratorOptions &options)
+{
+    PROFILE_SCOPE("generate scene");
+
+    glm::vec3 empty_min(FLT_MAX);
+    glm::vec3 empty_max(-FLT_MAX);
+
+    // every group but the part is terrain
+    u32 terrain = add_node(scene, SCENE_NO_PARENT, glm::mat4(1.0f), SCENE_NO_MESH, empty_min, empty_max);
+    for (u32 i = 0; i + 1 < (u32)mesh->groups.size(); ++i)
+    {
+        add_node(scene, terrain, glm::mat4(1.0f), (s32)i, mesh->groups[i].bounds_min, mesh->groups[i].bounds_max);
+    }
+
+    InstanceTreeBuilder builder;
+    builder.scene = scene;
+    builder.part_group = (s32)mesh->groups.size() - 1;
+    builder.part = &mesh->groups.back();
+    builder.depth = glm::max(options.hierarchy_depth, 1u);
+    builder.remaining = options.instances;
+    builder.random = options.seed ^ 0x9E3779B9u;
+
+    // just enough children per level for the instances to fit
+    builder.branching = 2;
+    while (powf((float)builder.branching, (float)builder.depth) < (float)options.instances) ++builder.branching;
+
+    glm::mat4 above_terrain = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, TERRAIN_HEIGHT * 2.0f, 0.0f));
+    u32 assembly = add_node(scene, SCENE_NO_PARENT, above_terrain, SCENE_NO_MESH, empty_min, empty_max);
+    add_instance_level(&builder, assembly, 0, TERRAIN_SIZE * 0.25f);
+
+    return options.instances - builder.remaining;
+}
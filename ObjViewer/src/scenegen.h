@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "types.h"
+#include "mesh.h"
+#include "scene.h"
+
+// Synthetic scenes for benchmarks, the same seed always gives the same
+// bytes.
+//
+// The mesh is a rolling terrain split into tiles, one group and material
+// each with the materials cycling through a set of generated textures, and
+// a small part that the scene instances many times. The scene puts the
+// terrain tiles under one node and the instances at the leaves of a
+// transform tree hierarchy_depth levels deep, so update and culling walk a
+// deep hierarchy.
+
+struct SceneGeneratorOptions
+{
+    u32 seed;
+    u32 terrain_triangles; // about, the grid is square
+    u32 tiles_per_side;
+    u32 materials;         // textures, cycled over the tiles
+    u32 texture_size;
+    u32 instances;         // copies of the part
+    u32 hierarchy_depth;   // transform levels above every instance
+};
+
+SceneGeneratorOptions default_scene_generator_options();
+
+// terrain tile groups first, the part is the last group
+void generate_mesh(Mesh *mesh, const SceneGeneratorOptions &options);
+
+// writes the material textures as png, under the names generate_mesh gives
+// them, relative to the working directory
+s32 save_generated_textures(const Mesh *mesh, const SceneGeneratorOptions &options);
+
+// terrain and the instance hierarchy, returns the number of instances
+u32 generate_scene(SceneGraph *scene, const Mesh *mesh, const SceneGeneratorOptions &options);
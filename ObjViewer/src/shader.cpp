@@ -4,132 +4,130 @@
 #include <glad\glad.h>
 
 #include "shader.h"
+#include "file.h"
 #include "log.h"
+#include "stats.h"
 
-struct FileContent
+local u32
+compile_shader(GLenum type, const char *filename, const char *label)
 {
-    void *data;
-    u64 size;
-};
-
-local FileContent 
-read_entire_file_in_memory_and_zero_terminate(const char* filename, bool zero_terminate)
-{
-    FileContent fc = {0};
-
-    FILE *file = fopen(filename, "rb");
-
-    if (file)
+    FileContent file_content = read_entire_file_in_memory_and_zero_terminate(filename, true);
+    if (!file_content.data)
     {
-        fseek(file, 0, SEEK_END);
-        fc.size = ftell(file);
-        rewind(file);
+        return 0;
+    }
 
-        if (zero_terminate)
-        {
-            ++fc.size;
-        }
+    const char *source = (const char *)file_content.data;
 
-        fc.data = calloc(1, fc.size);
+    u32 shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
 
-        fread(fc.data, 1, fc.size, file);
+    delete_file_content(&file_content);
 
-        fclose(file);
-    }
-    else
+    s32 success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (success == GL_FALSE)
     {
-        LOG_E("Cannot open '%s' for reading", filename);
+        char buffer[1024] = {};
+        glGetShaderInfoLog(shader, sizeof(buffer), NULL, buffer);
+
+        LOG_W("[%s] %s: %s", label, filename, buffer);
+        glDeleteShader(shader);
+        return 0;
     }
 
-    return fc;
+    return shader;
 }
 
-local void
-delete_file_content(FileContent *fc)
+// returns 0 when any stage fails, the errors are logged as warnings so a
+// reload can decide whether they are fatal
+local u32
+build_program(const char *vertex_shader_filename, const char *fragment_shader_filename)
 {
-    if (fc &&
-        fc->data)
+    u32 vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_shader_filename, "Vertex Shader");
+    if (!vertex_shader)
     {
-        free(fc->data);
-        fc->data = nullptr;
-
-        fc->size = 0;
+        return 0;
     }
-}
 
-s32 init(Shader *shader, const char *vertex_shader_filename, const char *fragment_shader_filename)
-{
-    FileContent vertex_shader_file_content = 
-        read_entire_file_in_memory_and_zero_terminate(vertex_shader_filename, true);
+    u32 fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_shader_filename, "Fragment Shader");
+    if (!fragment_shader)
+    {
+        glDeleteShader(vertex_shader);
+        return 0;
+    }
 
-    const char *vertex_shader_source = (const char *)vertex_shader_file_content.data;
+    u32 shader_program = glCreateProgram();
+    glAttachShader(shader_program, vertex_shader);
+    glAttachShader(shader_program, fragment_shader);
+    glLinkProgram(shader_program);
 
-    u32 vertex_shader;
-    vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &vertex_shader_source, NULL);
-    glCompileShader(vertex_shader);
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
 
     s32 success;
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
+    glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
     if (success == GL_FALSE)
     {
         char buffer[1024] = {};
-        glGetShaderInfoLog(vertex_shader, sizeof(buffer), NULL, buffer);
+        glGetProgramInfoLog(shader_program, sizeof(buffer), NULL, buffer);
 
-        LOG_E("[Vertex Shader] %s", buffer);
-        return -1;
+        LOG_W("[Shader Program] %s", buffer);
+        glDeleteProgram(shader_program);
+        return 0;
     }
-    
-    FileContent fragment_shader_file_content = 
-        read_entire_file_in_memory_and_zero_terminate(fragment_shader_filename, true);
 
-    const char *fragment_shader_source = (const char *)fragment_shader_file_content.data;
-    u32 fragment_shader;
-    fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &fragment_shader_source, NULL);
-    glCompileShader(fragment_shader);
+    return shader_program;
+}
 
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
-    if (success == GL_FALSE)
-    {
-        char buffer[1024] = {};
-        glGetShaderInfoLog(fragment_shader, sizeof(buffer), NULL, buffer);
+s32 init(Shader *shader, const char *vertex_shader_filename, const char *fragment_shader_filename)
+{
+    shader->vertex_shader_filename = vertex_shader_filename;
+    shader->fragment_shader_filename = fragment_shader_filename;
 
-        LOG_E("[Fragment Shader] %s", buffer);
+    shader->ID = build_program(vertex_shader_filename, fragment_shader_filename);
+    if (!shader->ID)
+    {
+        LOG_E("Cannot build shader program '%s' + '%s'", vertex_shader_filename, fragment_shader_filename);
         return -1;
     }
 
-    s32 shader_program;
-    shader_program = glCreateProgram();
-    glAttachShader(shader_program, vertex_shader);
-    glAttachShader(shader_program, fragment_shader);
-    glLinkProgram(shader_program);
+    return 0;
+}
 
-    glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
-    if (success == GL_FALSE)
+s32 reload(Shader *shader)
+{
+    u32 shader_program = build_program(shader->vertex_shader_filename.c_str(),
+                                       shader->fragment_shader_filename.c_str());
+    if (!shader_program)
     {
-        char buffer[1024] = {};
-        glGetProgramInfoLog(shader_program, sizeof(buffer), NULL, buffer);
-
-        LOG_E("[Shader Program] %s", buffer);
+        LOG_W("Shader reload failed, keeping the previous program");
         return -1;
     }
 
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
-
-    delete_file_content(&vertex_shader_file_content);
-    delete_file_content(&fragment_shader_file_content);
-
+    // the swap happens between two frames on the GL thread, no draw ever
+    // sees a half built program
+    glDeleteProgram(shader->ID);
     shader->ID = shader_program;
 
+    LOG_I("Reloaded shader '%s' + '%s'",
+          shader->vertex_shader_filename.c_str(), shader->fragment_shader_filename.c_str());
+
     return 0;
 }
 
+void destroy(Shader *shader)
+{
+    glDeleteProgram(shader->ID);
+    shader->ID = 0;
+}
+
 
 void use(Shader *shader)
 {
     glUseProgram(shader->ID);
+    count_program_change();
 }
 
 void set_bool(Shader *shader, const char *name, bool value)
@@ -147,8 +145,18 @@ void set_float(Shader *shader, const char *name, float value)
     glUniform1f(glGetUniformLocation(shader->ID, name), value);
 }
 
+void set_vec2(Shader *shader, const char *name, const glm::vec2 &value)
+{
+    glUniform2f(glGetUniformLocation(shader->ID, name), value.x, value.y);
+}
+
+void set_vec4(Shader *shader, const char *name, const glm::vec4 &value)
+{
+    glUniform4f(glGetUniformLocation(shader->ID, name), value.x, value.y, value.z, value.w);
+}
+
 void set_mat4(Shader *shader, const char *name, const glm::mat4 &value)
 {
     u32 location = glGetUniformLocation(shader->ID, name);
     glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
-}
\ No newline at end of file
+}
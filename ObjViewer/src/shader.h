@@ -4,19 +4,32 @@
 #include <glm\gtc\matrix_transform.hpp>
 #include <glm\gtc\type_ptr.hpp>
 
+#include <string>
+
 #include "types.h"
 
 struct Shader
 {
     u32 ID;
+
+    std::string vertex_shader_filename;
+    std::string fragment_shader_filename;
 };
 
 s32 init(Shader *shader, const char *vertex_shader_filename, const char *fragment_shader_filename);
 
+// rebuilds the program from the same files, on a compile or link error the
+// previous program stays in use; uniforms have to be set again on success
+s32 reload(Shader *shader);
+
+void destroy(Shader *shader);
+
 void use(Shader *shader);
 
 void set_bool(Shader *shader, const char *name, bool value);
 void set_int(Shader *shader, const char *name, int value);
 void set_float(Shader *shader, const char *name, float value);
+void set_vec2(Shader *shader, const char *name, const glm::vec2 &value);
+void set_vec4(Shader *shader, const char *name, const glm::vec4 &value);
 void set_mat4(Shader *shader, const char *name, const glm::mat4 &value);
 
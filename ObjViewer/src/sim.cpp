@@ -0,0 +1,323 @@
+#include <chrono>
+
+#include "sim.h"
+#include "profile.h"
+
+#define TRIPLE_BUFFER_INDEX 0x3u
+#define TRIPLE_BUFFER_FRESH 0x4u
+
+// weight of the newest sample in the latency moving average
+#define LATENCY_AVERAGE_WEIGHT 0.1
+
+SimulationOptions default_simulation_options()
+{
+    SimulationOptions options;
+    options.tick_rate = 120;
+    return options;
+}
+
+local u64
+now_ns()
+{
+    using namespace std::chrono;
+    return (u64)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+local u64
+tick_period_ns(const Simulation *sim)
+{
+    return 1000000000ull / (sim->options.tick_rate > 0 ? sim->options.tick_rate : 1);
+}
+
+local void
+publish(Simulation *sim, const Camera &previous, const Camera &current, u64 input_ns)
+{
+    CameraTripleBuffer *buffer = &sim->buffer;
+
+    CameraTick *tick = &buffer->ticks[buffer->write];
+    tick->previous = previous;
+    tick->current = current;
+    tick->tick_ns = now_ns();
+    tick->input_ns = input_ns;
+
+    buffer->write = buffer->middle.exchange(buffer->write | TRIPLE_BUFFER_FRESH, std::memory_order_acq_rel) & TRIPLE_BUFFER_INDEX;
+
+    if (sim->wake_render) sim->wake_render();
+}
+
+local bool
+same_view(const Camera &a, const Camera &b)
+{
+    return a.position == b.position && a.yaw == b.yaw && a.pitch == b.pitch &&
+           a.fov == b.fov && a.flying == b.flying &&
+           a.orbiting == b.orbiting && a.orbit_distance == b.orbit_distance;
+}
+
+// held keys or input not applied yet; called with the mutex held
+local bool
+has_input(const Simulation *sim)
+{
+    return sim->keys != 0 || sim->yaw != 0.0f || sim->pitch != 0.0f || sim->scroll != 0.0f ||
+           sim->has_teleport || sim->has_orbit || sim->input_ns != 0;
+}
+
+local void
+simulation_thread_proc(Simulation *sim)
+{
+    set_profile_thread_name("simulation");
+
+    using namespace std::chrono;
+    nanoseconds period(tick_period_ns(sim));
+    float dt = 1.0f / (sim->options.tick_rate > 0 ? sim->options.tick_rate : 1);
+
+    Camera camera = sim->buffer.ticks[sim->buffer.write].current;
+    u64 input_ns = 0;
+    bool settled = true;
+    steady_clock::time_point next_tick = steady_clock::now();
+
+    for (;;)
+    {
+        u32 keys;
+        float yaw, pitch, scroll;
+        bool flying;
+        bool has_teleport;
+        Camera teleport;
+        bool has_orbit;
+        bool orbiting;
+        glm::vec3 orbit_target;
+        u64 batch_input_ns;
+        {
+            std::unique_lock<std::mutex> lock(sim->mutex);
+
+            // the camera has stopped and nothing is held: sleep until input
+            // arrives instead of ticking, and start the tick clock over
+            if (settled && !has_input(sim))
+            {
+                sim->wake.wait(lock, [sim] { return sim->quit || has_input(sim); });
+                next_tick = steady_clock::now();
+            }
+            else
+            {
+                sim->wake.wait_until(lock, next_tick, [sim] { return sim->quit; });
+            }
+            if (sim->quit) return;
+
+            keys = sim->keys;
+            yaw = sim->yaw;
+            pitch = sim->pitch;
+            scroll = sim->scroll;
+            flying = sim->flying;
+            has_teleport = sim->has_teleport;
+            teleport = sim->teleport;
+            has_orbit = sim->has_orbit;
+            orbiting = sim->orbiting;
+            orbit_target = sim->orbit_target;
+            batch_input_ns = sim->input_ns;
+
+            sim->yaw = 0.0f;
+            sim->pitch = 0.0f;
+            sim->scroll = 0.0f;
+            sim->has_teleport = false;
+            sim->has_orbit = false;
+            sim->input_ns = 0;
+        }
+
+        next_tick += period;
+
+        PROFILE_SCOPE("simulation tick");
+
+        Camera previous = camera;
+        if (has_teleport)
+        {
+            camera = teleport;
+            previous = teleport;
+        }
+
+        camera.flying = flying;
+        if (has_orbit) set_orbit(&camera, orbiting, orbit_target);
+        if (yaw != 0.0f || pitch != 0.0f) rotate(&camera, yaw, pitch);
+        if (scroll != 0.0f) zoom(&camera, scroll);
+
+        if (keys & SIMULATION_KEY_FORWARD) move(&camera, glm::vec3(0.0f, 0.0f, 1.0f), dt);
+        if (keys & SIMULATION_KEY_BACK)    move(&camera, glm::vec3(0.0f, 0.0f, -1.0f), dt);
+        if (keys & SIMULATION_KEY_LEFT)    move(&camera, glm::vec3(-1.0f, 0.0f, 0.0f), dt);
+        if (keys & SIMULATION_KEY_RIGHT)   move(&camera, glm::vec3(1.0f, 0.0f, 0.0f), dt);
+
+        step(&camera, dt);
+
+        if (batch_input_ns) input_ns = batch_input_ns;
+
+        // the first still tick is published too, so the render side stops
+        // blending towards the last moving one
+        bool moved = has_teleport || !same_view(previous, camera);
+        if (moved || !settled || batch_input_ns)
+        {
+            publish(sim, previous, camera, input_ns);
+        }
+        settled = !moved;
+    }
+}
+
+void init(Simulation *sim, const Camera &camera, const SimulationOptions &options, void (*wake_render)())
+{
+    sim->options = options;
+    sim->wake_render = wake_render;
+
+    sim->keys = 0;
+    sim->yaw = 0.0f;
+    sim->pitch = 0.0f;
+    sim->scroll = 0.0f;
+    sim->flying = camera.flying;
+    sim->has_teleport = false;
+    sim->has_orbit = false;
+    sim->orbiting = camera.orbiting;
+    sim->orbit_target = camera.orbit_target;
+    sim->input_ns = 0;
+    sim->quit = false;
+
+    for (u32 i = 0; i < 3; ++i)
+    {
+        sim->buffer.ticks[i].previous = camera;
+        sim->buffer.ticks[i].current = camera;
+        sim->buffer.ticks[i].tick_ns = 0;
+        sim->buffer.ticks[i].input_ns = 0;
+    }
+    sim->buffer.write = 0;
+    sim->buffer.middle = 1;
+    sim->buffer.read = 2;
+
+    sim->shown_input_ns = 0;
+    sim->shown_settled = false;
+    sim->presented_input_ns = 0;
+    sim->latency = {};
+
+    sim->thread = std::thread(simulation_thread_proc, sim);
+}
+
+void destroy(Simulation *sim)
+{
+    {
+        std::lock_guard<std::mutex> lock(sim->mutex);
+        sim->quit = true;
+    }
+    sim->wake.notify_one();
+
+    if (sim->thread.joinable()) sim->thread.join();
+}
+
+// stamps the batch with the arrival of its first event; called with the
+// mutex held
+local void
+note_input(Simulation *sim)
+{
+    if (sim->input_ns == 0) sim->input_ns = now_ns();
+}
+
+void set_key(Simulation *sim, SimulationKey key, bool pressed)
+{
+    {
+        std::lock_guard<std::mutex> lock(sim->mutex);
+        if (pressed) sim->keys |= key;
+        else sim->keys &= ~(u32)key;
+        note_input(sim);
+    }
+    sim->wake.notify_one();
+}
+
+void add_rotation(Simulation *sim, float yaw, float pitch)
+{
+    {
+        std::lock_guard<std::mutex> lock(sim->mutex);
+        sim->yaw += yaw;
+        sim->pitch += pitch;
+        note_input(sim);
+    }
+    sim->wake.notify_one();
+}
+
+void add_zoom(Simulation *sim, float zoom)
+{
+    {
+        std::lock_guard<std::mutex> lock(sim->mutex);
+        sim->scroll += zoom;
+        note_input(sim);
+    }
+    sim->wake.notify_one();
+}
+
+void set_flying(Simulation *sim, bool flying)
+{
+    {
+        std::lock_guard<std::mutex> lock(sim->mutex);
+        sim->flying = flying;
+        note_input(sim);
+    }
+    sim->wake.notify_one();
+}
+
+void set_orbit(Simulation *sim, bool orbiting, const glm::vec3 &target)
+{
+    {
+        std::lock_guard<std::mutex> lock(sim->mutex);
+        sim->orbiting = orbiting;
+        sim->orbit_target = target;
+        sim->has_orbit = true;
+        note_input(sim);
+    }
+    sim->wake.notify_one();
+}
+
+void set_camera(Simulation *sim, const Camera &camera)
+{
+    {
+        std::lock_guard<std::mutex> lock(sim->mutex);
+        sim->teleport = camera;
+        sim->has_teleport = true;
+        sim->flying = camera.flying;
+    }
+    sim->wake.notify_one();
+}
+
+bool sample_camera(Simulation *sim, Camera *camera)
+{
+    CameraTripleBuffer *buffer = &sim->buffer;
+
+    bool fresh = false;
+    if (buffer->middle.load(std::memory_order_acquire) & TRIPLE_BUFFER_FRESH)
+    {
+        buffer->read = buffer->middle.exchange(buffer->read, std::memory_order_acq_rel) & TRIPLE_BUFFER_INDEX;
+        fresh = true;
+    }
+
+    // the camera left from the last call is still right, and keeps the
+    // matrices it cached
+    if (!fresh && sim->shown_settled) return false;
+
+    const CameraTick &tick = buffer->ticks[buffer->read];
+
+    // the tick took the camera from previous to current over one period,
+    // replay that period starting at the tick
+    u64 now = now_ns();
+    float t = now > tick.tick_ns ? (float)((double)(now - tick.tick_ns) / tick_period_ns(sim)) : 0.0f;
+    if (t > 1.0f) t = 1.0f;
+
+    *camera = interpolate(tick.previous, tick.current, t);
+    sim->shown_input_ns = tick.input_ns;
+    sim->shown_settled = t >= 1.0f;
+
+    return fresh || (t < 1.0f && !same_view(tick.previous, tick.current));
+}
+
+void mark_presented(Simulation *sim)
+{
+    if (sim->shown_input_ns == 0 || sim->shown_input_ns == sim->presented_input_ns) return;
+
+    InputLatencyStats *latency = &sim->latency;
+    latency->last_ms = (now_ns() - sim->shown_input_ns) / 1.0e6;
+    latency->average_ms = latency->samples == 0 ? latency->last_ms :
+        latency->average_ms + (latency->last_ms - latency->average_ms) * LATENCY_AVERAGE_WEIGHT;
+    if (latency->last_ms > latency->max_ms) latency->max_ms = latency->last_ms;
+    ++latency->samples;
+
+    sim->presented_input_ns = sim->shown_input_ns;
+}
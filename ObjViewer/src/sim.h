@@ -0,0 +1,120 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "types.h"
+#include "camera.h"
+
+// Camera motion on its own thread at a fixed tick rate, so a slow frame
+// no longer slows down navigation.
+//
+// GLFW only delivers events on the main thread: its callbacks hand key
+// state, mouse and scroll deltas to the simulation, which applies them
+// every tick with a fixed time step. Each tick publishes the camera before
+// and after it through a triple buffer, the render thread takes the newest
+// without waiting and blends the two by how far it is into the next tick.
+// The shown camera is therefore one tick behind, in exchange for smooth
+// motion at any frame rate.
+//
+// Input events are stamped when they arrive and carried with the tick that
+// applies them, the render thread turns that into an input to present
+// latency once the frame showing them is swapped.
+
+enum SimulationKey
+{
+    SIMULATION_KEY_FORWARD = 1 << 0,
+    SIMULATION_KEY_BACK    = 1 << 1,
+    SIMULATION_KEY_LEFT    = 1 << 2,
+    SIMULATION_KEY_RIGHT   = 1 << 3,
+};
+
+struct SimulationOptions
+{
+    u32 tick_rate; // ticks per second
+};
+
+SimulationOptions default_simulation_options();
+
+// the result of one tick
+struct CameraTick
+{
+    Camera previous;
+    Camera current;
+    u64 tick_ns;  // when current was simulated
+    u64 input_ns; // arrival of the newest input applied so far, 0 for none
+};
+
+// One slot is written, one is read and one holds the newest finished
+// state. Writer and reader each swap their slot with the middle one, so
+// neither ever waits and the reader always gets the latest tick.
+struct CameraTripleBuffer
+{
+    CameraTick ticks[3];
+    std::atomic<u32> middle; // slot index, TRIPLE_BUFFER_FRESH when not read yet
+    u32 write;               // simulation thread only
+    u32 read;                // render thread only
+};
+
+struct InputLatencyStats
+{
+    double last_ms;
+    double average_ms; // moving average
+    double max_ms;
+    u32 samples;
+};
+
+struct Simulation
+{
+    SimulationOptions options;
+    std::thread thread;
+    void (*wake_render)(); // called from the simulation thread after a publish
+
+    // input since the last tick, from the event thread
+    std::mutex mutex;
+    std::condition_variable wake;
+    u32 keys;
+    float yaw;
+    float pitch;
+    float scroll;
+    bool flying;
+    bool has_teleport;
+    Camera teleport;
+    bool has_orbit;
+    bool orbiting;
+    glm::vec3 orbit_target;
+    u64 input_ns;
+    bool quit;
+
+    CameraTripleBuffer buffer;
+
+    // render thread only
+    u64 shown_input_ns;
+    bool shown_settled; // the last sampled camera was a finished tick
+    u64 presented_input_ns;
+    InputLatencyStats latency;
+};
+
+// starts the tick thread from camera; wake_render may be nullptr
+void init(Simulation *sim, const Camera &camera, const SimulationOptions &options, void (*wake_render)());
+
+void destroy(Simulation *sim);
+
+// from the event thread
+void set_key(Simulation *sim, SimulationKey key, bool pressed);
+void add_rotation(Simulation *sim, float yaw, float pitch);
+void add_zoom(Simulation *sim, float zoom);
+void set_flying(Simulation *sim, bool flying);
+void set_orbit(Simulation *sim, bool orbiting, const glm::vec3 &target);
+
+// replaces the camera at the next tick, without blending towards it
+void set_camera(Simulation *sim, const Camera &camera);
+
+// the camera to draw now; true while it still moves, the caller keeps
+// drawing until it returns false
+bool sample_camera(Simulation *sim, Camera *camera);
+
+// after the swap of the frame drawn with the last sampled camera
+void mark_presented(Simulation *sim);
@@ -0,0 +1,324 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <new>
+#include <atomic>
+
+#include <malloc.h>
+
+#ifdef _WIN32
+#define heap_block_size(pointer) _msize(pointer)
+#else
+#define heap_block_size(pointer) malloc_usable_size(pointer)
+#endif
+
+#include "stats.h"
+#include "log.h"
+
+// GL counters are only touched by the GL thread, the heap by every thread
+local FrameStats current_frame;
+local FrameStats last_frame;
+
+local std::atomic<u64> heap_bytes(0);
+local std::atomic<u64> heap_peak_bytes(0);
+local std::atomic<u64> heap_allocations(0);
+
+local void *
+counted_alloc(size_t size)
+{
+    void *pointer = malloc(size ? size : 1);
+    if (!pointer) return nullptr;
+
+    u64 bytes = heap_bytes.fetch_add(heap_block_size(pointer), std::memory_order_relaxed) + heap_block_size(pointer);
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+
+    // the peak only needs to be close, a lost race is a few bytes off
+    if (bytes > heap_peak_bytes.load(std::memory_order_relaxed))
+    {
+        heap_peak_bytes.store(bytes, std::memory_order_relaxed);
+    }
+
+    return pointer;
+}
+
+local void
+counted_free(void *pointer)
+{
+    if (!pointer) return;
+
+    heap_bytes.fetch_sub(heap_block_size(pointer), std::memory_order_relaxed);
+    free(pointer);
+}
+
+void *operator new(size_t size)
+{
+    void *pointer = counted_alloc(size);
+    if (!pointer) throw std::bad_alloc();
+    return pointer;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return counted_alloc(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    counted_free(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept
+{
+    counted_free(pointer);
+}
+
+// the block size is asked from the heap, the one passed in is not needed
+void operator delete(void *pointer, size_t) noexcept
+{
+    counted_free(pointer);
+}
+
+const char *memory_category_name(MemoryCategory category)
+{
+    switch (category)
+    {
+        case MEMORY_MESH_CPU:        return "mesh_cpu";
+        case MEMORY_MESH_GPU:        return "mesh_gpu";
+        case MEMORY_TEXTURES:        return "textures";
+        case MEMORY_MATERIAL_ATLAS:  return "material_atlas";
+        case MEMORY_VIRTUAL_TEXTURE: return "virtual_texture";
+        case MEMORY_CHUNKS_RAM:      return "chunks_ram";
+        case MEMORY_CHUNKS_VRAM:     return "chunks_vram";
+        case MEMORY_UPLOAD_BUFFERS:  return "upload_buffers";
+        case MEMORY_RENDER_TARGETS:  return "render_targets";
+        case MEMORY_DRAW_LISTS:      return "draw_lists";
+        default:                     return "unknown";
+    }
+}
+
+FrameStats *frame_stats()
+{
+    return &current_frame;
+}
+
+void count_draw(u32 index_count)
+{
+    ++current_frame.draw_calls;
+    current_frame.triangles_submitted += index_count / 3;
+}
+
+void count_program_change()
+{
+    ++current_frame.program_changes;
+}
+
+void count_texture_changes(u32 units)
+{
+    current_frame.texture_changes += units;
+}
+
+void end_frame_stats(double frame_ms)
+{
+    current_frame.frame_ms = frame_ms;
+    current_frame.heap_bytes = heap_bytes.load(std::memory_order_relaxed);
+    current_frame.heap_peak_bytes = heap_peak_bytes.load(std::memory_order_relaxed);
+    current_frame.heap_allocations = heap_allocations.exchange(0, std::memory_order_relaxed);
+
+    last_frame = current_frame;
+
+    current_frame = {};
+    current_frame.frame = last_frame.frame + 1;
+}
+
+const FrameStats *last_frame_stats()
+{
+    return &last_frame;
+}
+
+enum StatsCounterType
+{
+    STATS_U32,
+    STATS_U64,
+    STATS_DOUBLE,
+};
+
+struct StatsCounter
+{
+    const char *name;
+    StatsCounterType type;
+    size_t offset;
+};
+
+#define STATS_COUNTER(type, field) { #field, type, offsetof(FrameStats, field) }
+
+// the scalar fields of FrameStats, in the order the JSON dump writes them
+local const StatsCounter stats_counters[] = {
+    STATS_COUNTER(STATS_U64, frame),
+    STATS_COUNTER(STATS_DOUBLE, frame_ms),
+    STATS_COUNTER(STATS_U32, draw_calls),
+    STATS_COUNTER(STATS_U64, triangles_submitted),
+    STATS_COUNTER(STATS_U64, triangles_culled),
+    STATS_COUNTER(STATS_U32, program_changes),
+    STATS_COUNTER(STATS_U32, texture_changes),
+    STATS_COUNTER(STATS_U32, nodes_drawn),
+    STATS_COUNTER(STATS_U32, nodes_frustum_culled),
+    STATS_COUNTER(STATS_U32, nodes_occlusion_culled),
+    STATS_COUNTER(STATS_U64, heap_bytes),
+    STATS_COUNTER(STATS_U64, heap_peak_bytes),
+    STATS_COUNTER(STATS_U64, heap_allocations),
+    STATS_COUNTER(STATS_U64, upload_bytes),
+    STATS_COUNTER(STATS_U32, upload_queue),
+    STATS_COUNTER(STATS_U32, chunk_queue),
+    STATS_COUNTER(STATS_U32, page_queue),
+    STATS_COUNTER(STATS_U32, model_queue),
+};
+
+local double
+counter_value(const FrameStats *stats, const StatsCounter *counter)
+{
+    const u8 *field = (const u8 *)stats + counter->offset;
+    switch (counter->type)
+    {
+        case STATS_U32:    return (double)*(const u32 *)field;
+        case STATS_U64:    return (double)*(const u64 *)field;
+        case STATS_DOUBLE: return *(const double *)field;
+    }
+    return 0.0;
+}
+
+u64 total_memory(const FrameStats *stats)
+{
+    u64 total = 0;
+    for (u32 i = 0; i < MEMORY_CATEGORY_COUNT; ++i) total += stats->memory[i];
+    return total;
+}
+
+// appends to buffer, keeping track of how much is used
+local void
+append(char *buffer, u32 buffer_size, u32 *used, const char *format, ...)
+{
+    if (*used >= buffer_size) return;
+
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer + *used, buffer_size - *used, format, args);
+    va_end(args);
+
+    if (written < 0) return;
+    *used += (u32)written;
+    if (*used >= buffer_size) *used = buffer_size - 1;
+}
+
+#define MB(bytes) ((bytes) / (1024.0 * 1024.0))
+
+u32 format_stats(const FrameStats *stats, char *buffer, u32 buffer_size)
+{
+    u32 used = 0;
+    if (buffer_size) buffer[0] = 0;
+
+    append(buffer, buffer_size, &used, "frame %llu  %.2f ms\n", (unsigned long long)stats->frame, stats->frame_ms);
+    append(buffer, buffer_size, &used, "draws %u  triangles %llu  culled %llu\n",
+           stats->draw_calls, (unsigned long long)stats->triangles_submitted,
+           (unsigned long long)stats->triangles_culled);
+    append(buffer, buffer_size, &used, "nodes %u drawn  %u frustum  %u occluded\n",
+           stats->nodes_drawn, stats->nodes_frustum_culled, stats->nodes_occlusion_culled);
+    append(buffer, buffer_size, &used, "state changes %u programs  %u textures\n",
+           stats->program_changes, stats->texture_changes);
+
+    append(buffer, buffer_size, &used, "memory %.1f MB\n", MB(total_memory(stats)));
+    for (u32 i = 0; i < MEMORY_CATEGORY_COUNT; ++i)
+    {
+        if (stats->memory[i] == 0) continue;
+        append(buffer, buffer_size, &used, "  %-16s %8.1f MB\n", memory_category_name((MemoryCategory)i), MB(stats->memory[i]));
+    }
+
+    append(buffer, buffer_size, &used, "heap %.1f MB  peak %.1f MB  %llu allocations\n",
+           MB(stats->heap_bytes), MB(stats->heap_peak_bytes), (unsigned long long)stats->heap_allocations);
+    append(buffer, buffer_size, &used, "uploads %.1f KB\n", stats->upload_bytes / 1024.0);
+    append(buffer, buffer_size, &used, "queues %u textures  %u chunks  %u pages  %u models\n",
+           stats->upload_queue, stats->chunk_queue, stats->page_queue, stats->model_queue);
+
+    return used;
+}
+
+void write_stats_json(FILE *file, const FrameStats *stats)
+{
+    fprintf(file, "{\n");
+    for (const StatsCounter &counter : stats_counters)
+    {
+        const u8 *field = (const u8 *)stats + counter.offset;
+        switch (counter.type)
+        {
+            case STATS_U32:    fprintf(file, "  \"%s\": %u,\n", counter.name, *(const u32 *)field); break;
+            case STATS_U64:    fprintf(file, "  \"%s\": %llu,\n", counter.name, *(const unsigned long long *)field); break;
+            case STATS_DOUBLE: fprintf(file, "  \"%s\": %.4f,\n", counter.name, *(const double *)field); break;
+        }
+    }
+
+    fprintf(file, "  \"memory\": {\n");
+    for (u32 i = 0; i < MEMORY_CATEGORY_COUNT; ++i)
+    {
+        fprintf(file, "    \"%s\": %llu,\n", memory_category_name((MemoryCategory)i), (unsigned long long)stats->memory[i]);
+    }
+    fprintf(file, "    \"total\": %llu\n", (unsigned long long)total_memory(stats));
+    fprintf(file, "  }\n");
+    fprintf(file, "}\n");
+}
+
+s32 save_stats_json(const char *filename, const FrameStats *stats)
+{
+    FILE *file = fopen(filename, "wb");
+    if (!file)
+    {
+        LOG_W("Cannot open '%s' for writing", filename);
+        return -1;
+    }
+
+    write_stats_json(file, stats);
+    fclose(file);
+
+    return 0;
+}
+
+u32 stats_counter_count(void)
+{
+    return (u32)ArrayCount(stats_counters);
+}
+
+const char *stats_counter_name(u32 index)
+{
+    return index < ArrayCount(stats_counters) ? stats_counters[index].name : nullptr;
+}
+
+s32 stats_query(const char *name, double *value)
+{
+    for (const StatsCounter &counter : stats_counters)
+    {
+        if (strcmp(counter.name, name) == 0)
+        {
+            *value = counter_value(&last_frame, &counter);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+s32 stats_query_memory(const char *category, u64 *bytes)
+{
+    if (strcmp(category, "total") == 0)
+    {
+        *bytes = total_memory(&last_frame);
+        return 0;
+    }
+
+    for (u32 i = 0; i < MEMORY_CATEGORY_COUNT; ++i)
+    {
+        if (strcmp(memory_category_name((MemoryCategory)i), category) == 0)
+        {
+            *bytes = last_frame.memory[i];
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "types.h"
+
+// Per frame counters and memory accounting.
+//
+// Draw calls, triangles and GL state changes are counted where they are
+// issued (mesh draws, program and texture binds) into the frame in
+// progress. Heap use comes from the global operator new and delete, which
+// stats.cpp replaces. Culling, uploads, memory by category and queue depths
+// are filled by the caller from the stats of each system before
+// end_frame_stats().
+//
+// The finished frame stays readable until the next one ends: the overlay
+// draws it, write_stats_json() dumps it for headless runs and the
+// functions at the end query it with C linkage.
+
+enum MemoryCategory
+{
+    MEMORY_MESH_CPU,        // vertices, indices and scene arrays
+    MEMORY_MESH_GPU,        // vertex and index buffers
+    MEMORY_TEXTURES,        // resident textures of the cache
+    MEMORY_MATERIAL_ATLAS,
+    MEMORY_VIRTUAL_TEXTURE, // page atlas and indirection
+    MEMORY_CHUNKS_RAM,
+    MEMORY_CHUNKS_VRAM,
+    MEMORY_UPLOAD_BUFFERS,
+    MEMORY_RENDER_TARGETS,  // scene target and accumulation
+    MEMORY_DRAW_LISTS,
+    MEMORY_CATEGORY_COUNT,
+};
+
+struct FrameStats
+{
+    u64 frame;
+    double frame_ms;
+
+    // GL submission, counted as it happens
+    u32 draw_calls;
+    u64 triangles_submitted;
+    u32 program_changes;
+    u32 texture_changes;
+
+    // culling, from the draw recorder or the software renderer
+    u32 nodes_drawn;
+    u32 nodes_frustum_culled;
+    u32 nodes_occlusion_culled;
+    u64 triangles_culled;
+
+    u64 memory[MEMORY_CATEGORY_COUNT];
+
+    // the heap as a whole, through operator new
+    u64 heap_bytes;
+    u64 heap_peak_bytes;
+    u64 heap_allocations; // this frame
+
+    u64 upload_bytes; // this frame
+    u32 upload_queue; // textures waiting for or being uploaded
+    u32 chunk_queue;  // chunk reads not done yet
+    u32 page_queue;   // virtual texture page reads not done yet
+    u32 model_queue;  // 1 while a model loads, plus one waiting behind it
+};
+
+const char *memory_category_name(MemoryCategory category);
+
+// counters of the frame in progress, for the caller to fill in
+FrameStats *frame_stats();
+
+void count_draw(u32 index_count);
+void count_program_change();
+void count_texture_changes(u32 units);
+
+// closes the frame in progress and starts the next one
+void end_frame_stats(double frame_ms);
+
+// the last finished frame, zeros before the first
+const FrameStats *last_frame_stats();
+
+u64 total_memory(const FrameStats *stats);
+
+// one line per group of counters, for the overlay
+u32 format_stats(const FrameStats *stats, char *buffer, u32 buffer_size);
+
+void write_stats_json(FILE *file, const FrameStats *stats);
+s32 save_stats_json(const char *filename, const FrameStats *stats);
+
+// C linkage queries of the last finished frame, only plain types so
+// scripts and tools that load the viewer do not depend on C++. Counters are
+// named as in the JSON dump, memory by category name or "total".
+extern "C"
+{
+u32 stats_counter_count(void);
+
+// nullptr past the end
+const char *stats_counter_name(u32 index);
+
+// 0, or -1 when there is no counter with that name
+s32 stats_query(const char *name, double *value);
+s32 stats_query_memory(const char *category, u64 *bytes);
+}
@@ -1,2 +1,14 @@
+// stb_image picks its SIMD IDCT, color conversion and upsampling from the
+// target: SSE2 is always there on x64 and has to be asked for on 32 bit
+// x86 (/arch:SSE2, -msse2), NEON only when defined. Without them JPEG
+// decoding is several times slower, so a build that loses them fails here.
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define STBI_NEON
+#endif
+
 #define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
\ No newline at end of file
+#include "stb_image.h"
+
+#if !defined(STBI_SSE2) && !defined(STBI_NEON)
+#error "stb_image is built without its SSE2 or NEON paths"
+#endif
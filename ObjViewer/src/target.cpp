@@ -0,0 +1,112 @@
+#include <glad\glad.h>
+#include <GLFW\glfw3.h>
+
+#include "target.h"
+#include "log.h"
+
+// glad is generated for 3.3 core, clip control is GL 4.5 or the extension
+#ifndef GL_ZERO_TO_ONE
+#define GL_ZERO_TO_ONE 0x935F
+#endif
+
+typedef void (APIENTRYP PFNGLCLIPCONTROLPROC)(GLenum origin, GLenum depth);
+
+bool init_reverse_z()
+{
+    if (!glfwExtensionSupported("GL_ARB_clip_control")) return false;
+
+    PFNGLCLIPCONTROLPROC clip_control = (PFNGLCLIPCONTROLPROC)glfwGetProcAddress("glClipControl");
+    if (!clip_control) return false;
+
+    clip_control(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+    glDepthFunc(GL_GREATER);
+    glClearDepth(0.0);
+
+    return true;
+}
+
+local void
+destroy_attachments(RenderTarget *target)
+{
+    if (target->fbo) glDeleteFramebuffers(1, &target->fbo);
+    if (target->color) glDeleteTextures(1, &target->color);
+    if (target->depth) glDeleteRenderbuffers(1, &target->depth);
+
+    target->fbo = 0;
+    target->color = 0;
+    target->depth = 0;
+    target->width = 0;
+    target->height = 0;
+}
+
+local s32
+init_attachments(RenderTarget *target, u32 width, u32 height)
+{
+    destroy_attachments(target);
+
+    target->width = width > 0 ? width : 1;
+    target->height = height > 0 ? height : 1;
+
+    glGenTextures(1, &target->color);
+    glBindTexture(GL_TEXTURE_2D, target->color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, target->width, target->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenRenderbuffers(1, &target->depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, target->depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, target->reverse_z ? GL_DEPTH_COMPONENT32F : GL_DEPTH_COMPONENT24,
+                          target->width, target->height);
+
+    glGenFramebuffers(1, &target->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target->depth);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        LOG_W("Scene render target is incomplete (0x%x)", status);
+        destroy_attachments(target);
+        return -1;
+    }
+
+    return 0;
+}
+
+s32 init(RenderTarget *target, u32 width, u32 height, bool reverse_z)
+{
+    *target = {};
+    target->reverse_z = reverse_z;
+    return init_attachments(target, width, height);
+}
+
+void destroy(RenderTarget *target)
+{
+    destroy_attachments(target);
+}
+
+void bind(RenderTarget *target, u32 width, u32 height)
+{
+    if (target->width != width || target->height != height || !target->fbo)
+    {
+        init_attachments(target, width, height);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+    glViewport(0, 0, target->width, target->height);
+}
+
+void present(const RenderTarget *target)
+{
+    if (!target->fbo) return;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target->fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, target->width, target->height, 0, 0, target->width, target->height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "types.h"
+
+// The offscreen target the scene is drawn into, copied to the window at the
+// end of the frame or averaged in by the accumulation buffer.
+//
+// With reverse Z the depth buffer is 32 bit float and clip control maps
+// clip space z to [0, 1], so the 1/z falloff of the projection and the
+// exponent of the float cancel out and precision stays even from the near
+// plane to infinity. The default framebuffer only offers fixed point depth,
+// which is why the scene no longer draws there. Without clip control the
+// target keeps a 24 bit depth buffer and the usual depth direction.
+
+struct RenderTarget
+{
+    u32 fbo;
+    u32 color;
+    u32 depth;
+    u32 width;
+    u32 height;
+    bool reverse_z;
+};
+
+// turns on clip control and the reversed depth test and clear value when
+// the driver has GL_ARB_clip_control, false otherwise
+bool init_reverse_z();
+
+s32 init(RenderTarget *target, u32 width, u32 height, bool reverse_z);
+
+void destroy(RenderTarget *target);
+
+// resizes to the window if needed, binds the target and sets the viewport
+void bind(RenderTarget *target, u32 width, u32 height);
+
+// copies the color to the default framebuffer and binds that
+void present(const RenderTarget *target);
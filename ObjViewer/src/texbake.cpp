@@ -0,0 +1,980 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+#include <glm/glm.hpp>
+
+#include "texbake.h"
+#include "image.h"
+#include "jobs.h"
+#include "profile.h"
+#include "file.h"
+#include "log.h"
+
+// entries of the linear -> sRGB table, enough to round trip every 8 bit value
+#define SRGB_ENCODE_TABLE_SIZE 4096
+
+TextureBakeOptions default_texture_bake_options()
+{
+    TextureBakeOptions options;
+    options.format = TEXTURE_FORMAT_BC7;
+    options.srgb = true;
+    return options;
+}
+
+local const char *format_names[TEXTURE_FORMAT_COUNT] = { "rgba8", "bc1", "bc3", "bc5", "bc7" };
+
+const char *texture_format_name(TextureFormat format)
+{
+    return format < TEXTURE_FORMAT_COUNT ? format_names[format] : "unknown";
+}
+
+bool parse_texture_format(const char *name, TextureFormat *format)
+{
+    for (u32 i = 0; i < TEXTURE_FORMAT_COUNT; ++i)
+    {
+        if (strcmp(name, format_names[i]) == 0)
+        {
+            *format = (TextureFormat)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+u32 texture_block_size(TextureFormat format)
+{
+    switch (format)
+    {
+        case TEXTURE_FORMAT_BC1: return 8;
+        case TEXTURE_FORMAT_BC3: return 16;
+        case TEXTURE_FORMAT_BC5: return 16;
+        case TEXTURE_FORMAT_BC7: return 16;
+        default: return 0;
+    }
+}
+
+u64 texture_level_size(TextureFormat format, u32 width, u32 height)
+{
+    u32 block_size = texture_block_size(format);
+    if (block_size == 0) return (u64)width * height * 4;
+
+    return (u64)((width + 3) / 4) * ((height + 3) / 4) * block_size;
+}
+
+
+// --- MIPS ---
+
+local float srgb_decode_table[256];
+local u8 srgb_encode_table[SRGB_ENCODE_TABLE_SIZE];
+local bool srgb_tables_ready = false;
+
+local void
+init_srgb_tables()
+{
+    if (srgb_tables_ready) return;
+
+    for (u32 i = 0; i < 256; ++i)
+    {
+        float c = i / 255.0f;
+        srgb_decode_table[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    for (u32 i = 0; i < SRGB_ENCODE_TABLE_SIZE; ++i)
+    {
+        float c = i / (float)(SRGB_ENCODE_TABLE_SIZE - 1);
+        float s = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+        srgb_encode_table[i] = (u8)glm::clamp(s * 255.0f + 0.5f, 0.0f, 255.0f);
+    }
+
+    srgb_tables_ready = true;
+}
+
+// the chain is built in float rgba so every level is filtered from the
+// unrounded one above it
+local void
+decode_level(const u8 *rgba, u32 count, bool srgb, float *linear)
+{
+    for (u32 i = 0; i < count; ++i)
+    {
+        for (u32 c = 0; c < 3; ++c)
+        {
+            u8 value = rgba[i * 4 + c];
+            linear[i * 4 + c] = srgb ? srgb_decode_table[value] : value / 255.0f;
+        }
+        linear[i * 4 + 3] = rgba[i * 4 + 3] / 255.0f;
+    }
+}
+
+local void
+encode_level(const float *linear, u32 count, bool srgb, u8 *rgba)
+{
+    for (u32 i = 0; i < count; ++i)
+    {
+        for (u32 c = 0; c < 3; ++c)
+        {
+            float value = glm::clamp(linear[i * 4 + c], 0.0f, 1.0f);
+            rgba[i * 4 + c] = srgb ? srgb_encode_table[(u32)(value * (SRGB_ENCODE_TABLE_SIZE - 1) + 0.5f)]
+                                   : (u8)(value * 255.0f + 0.5f);
+        }
+        rgba[i * 4 + 3] = (u8)(glm::clamp(linear[i * 4 + 3], 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+}
+
+// 2x2 box, one texel is one sse register; odd sizes repeat the last row/column
+local void
+downsample_level(const float *source, u32 source_width, u32 source_height,
+                 float *destination, u32 width, u32 height)
+{
+    __m128 quarter = _mm_set1_ps(0.25f);
+
+    for (u32 y = 0; y < height; ++y)
+    {
+        const float *row0 = source + (u64)glm::min(y * 2, source_height - 1) * source_width * 4;
+        const float *row1 = source + (u64)glm::min(y * 2 + 1, source_height - 1) * source_width * 4;
+        float *out = destination + (u64)y * width * 4;
+
+        for (u32 x = 0; x < width; ++x)
+        {
+            u32 x0 = glm::min(x * 2, source_width - 1) * 4;
+            u32 x1 = glm::min(x * 2 + 1, source_width - 1) * 4;
+
+            __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1)),
+                                    _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+            _mm_storeu_ps(out + x * 4, _mm_mul_ps(sum, quarter));
+        }
+    }
+}
+
+void build_mip_chain(const u8 *rgba, u32 width, u32 height, bool srgb, std::vector<TextureLevel> *levels)
+{
+    PROFILE_SCOPE("build mip chain");
+
+    init_srgb_tables();
+
+    levels->clear();
+    levels->push_back(TextureLevel{width, height, std::vector<u8>(rgba, rgba + (u64)width * height * 4)});
+
+    std::vector<float> current((u64)width * height * 4);
+    std::vector<float> next;
+    decode_level(rgba, width * height, srgb, current.data());
+
+    while (width > 1 || height > 1)
+    {
+        u32 next_width = glm::max(width / 2, 1u);
+        u32 next_height = glm::max(height / 2, 1u);
+
+        next.resize((u64)next_width * next_height * 4);
+        downsample_level(current.data(), width, height, next.data(), next_width, next_height);
+
+        TextureLevel level;
+        level.width = next_width;
+        level.height = next_height;
+        level.pixels.resize((u64)next_width * next_height * 4);
+        encode_level(next.data(), next_width * next_height, srgb, level.pixels.data());
+        levels->push_back(std::move(level));
+
+        current.swap(next);
+        width = next_width;
+        height = next_height;
+    }
+}
+
+
+// --- BLOCK COMPRESSION ---
+
+// mean and main direction of the first channels of 16 rgba texels, the
+// direction the endpoints of every format here are searched along
+local void
+principal_axis(const u8 *texels, u32 channels, float *mean, float *axis)
+{
+    for (u32 c = 0; c < channels; ++c)
+    {
+        mean[c] = 0.0f;
+        for (u32 i = 0; i < 16; ++i) mean[c] += texels[i * 4 + c];
+        mean[c] /= 16.0f;
+    }
+
+    float covariance[4][4] = {};
+    for (u32 i = 0; i < 16; ++i)
+    {
+        for (u32 a = 0; a < channels; ++a)
+        {
+            for (u32 b = a; b < channels; ++b)
+            {
+                covariance[a][b] += (texels[i * 4 + a] - mean[a]) * (texels[i * 4 + b] - mean[b]);
+            }
+        }
+    }
+
+    for (u32 a = 0; a < channels; ++a)
+    {
+        for (u32 b = 0; b < a; ++b) covariance[a][b] = covariance[b][a];
+    }
+
+    // power iteration, a handful of steps is plenty for a 16 texel block
+    for (u32 c = 0; c < channels; ++c) axis[c] = 1.0f;
+
+    for (u32 iteration = 0; iteration < 8; ++iteration)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+        for (u32 a = 0; a < channels; ++a)
+        {
+            for (u32 b = 0; b < channels; ++b) next[a] += covariance[a][b] * axis[b];
+            length = glm::max(length, fabsf(next[a]));
+        }
+
+        // flat block, any direction will do
+        if (length < 1e-6f) break;
+
+        for (u32 c = 0; c < channels; ++c) axis[c] = next[c] / length;
+    }
+
+    float length = 0.0f;
+    for (u32 c = 0; c < channels; ++c) length += axis[c] * axis[c];
+    length = sqrtf(length);
+    for (u32 c = 0; c < channels; ++c) axis[c] /= length;
+}
+
+// end points of the texels projected on the axis, pulled in by inset of
+// their distance since the extremes rarely need to be hit exactly
+local void
+fit_endpoints(const u8 *texels, u32 channels, float inset, float *end0, float *end1)
+{
+    float mean[4], axis[4];
+    principal_axis(texels, channels, mean, axis);
+
+    float min_t = FLT_MAX;
+    float max_t = -FLT_MAX;
+    for (u32 i = 0; i < 16; ++i)
+    {
+        float t = 0.0f;
+        for (u32 c = 0; c < channels; ++c) t += (texels[i * 4 + c] - mean[c]) * axis[c];
+        min_t = glm::min(min_t, t);
+        max_t = glm::max(max_t, t);
+    }
+
+    float shrink = (max_t - min_t) * inset;
+    for (u32 c = 0; c < channels; ++c)
+    {
+        end0[c] = glm::clamp(mean[c] + axis[c] * (min_t + shrink), 0.0f, 255.0f);
+        end1[c] = glm::clamp(mean[c] + axis[c] * (max_t - shrink), 0.0f, 255.0f);
+    }
+}
+
+// least squares end points for fixed indices, weight is how much of end1
+// each texel takes; false when the texels do not pin both down
+local bool
+refit_endpoints(const u8 *texels, u32 channels, const float *weights, float *end0, float *end1)
+{
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+
+    for (u32 i = 0; i < 16; ++i)
+    {
+        float b = weights[i];
+        float a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (u32 c = 0; c < channels; ++c)
+        {
+            ax[c] += a * texels[i * 4 + c];
+            bx[c] += b * texels[i * 4 + c];
+        }
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (fabsf(determinant) < 1e-6f) return false;
+
+    for (u32 c = 0; c < channels; ++c)
+    {
+        end0[c] = glm::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+        end1[c] = glm::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+    }
+
+    return true;
+}
+
+local inline u32
+squared_distance(const u8 *texel, const s32 *color, u32 channels)
+{
+    u32 distance = 0;
+    for (u32 c = 0; c < channels; ++c)
+    {
+        s32 d = texel[c] - color[c];
+        distance += d * d;
+    }
+    return distance;
+}
+
+local inline u16
+pack_565(const float *color)
+{
+    u32 r = (u32)(color[0] * 31.0f / 255.0f + 0.5f);
+    u32 g = (u32)(color[1] * 63.0f / 255.0f + 0.5f);
+    u32 b = (u32)(color[2] * 31.0f / 255.0f + 0.5f);
+    return (u16)((r << 11) | (g << 5) | b);
+}
+
+local inline void
+unpack_565(u16 packed, s32 *color)
+{
+    s32 r = (packed >> 11) & 31;
+    s32 g = (packed >> 5) & 63;
+    s32 b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// four color mode only (color0 > color1), the three color one spends an
+// index on transparent black
+local void
+bc1_palette(u16 color0, u16 color1, s32 palette[4][3])
+{
+    unpack_565(color0, palette[0]);
+    unpack_565(color1, palette[1]);
+    for (u32 c = 0; c < 3; ++c)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+}
+
+struct Bc1Block
+{
+    u16 color0;
+    u16 color1;
+    u32 indices;
+    u32 error;
+};
+
+local Bc1Block
+bc1_choose_indices(const u8 *texels, const float *end0, const float *end1)
+{
+    Bc1Block block;
+    block.color0 = pack_565(end1);
+    block.color1 = pack_565(end0);
+    block.indices = 0;
+    block.error = 0;
+
+    if (block.color0 < block.color1)
+    {
+        u16 swap = block.color0;
+        block.color0 = block.color1;
+        block.color1 = swap;
+    }
+
+    s32 palette[4][3];
+    bc1_palette(block.color0, block.color1, palette);
+
+    // equal colors select the three color mode, index 0 is still color0
+    u32 palette_size = block.color0 == block.color1 ? 1 : 4;
+
+    for (u32 i = 0; i < 16; ++i)
+    {
+        u32 best = 0;
+        u32 best_distance = squared_distance(texels + i * 4, palette[0], 3);
+        for (u32 entry = 1; entry < palette_size; ++entry)
+        {
+            u32 distance = squared_distance(texels + i * 4, palette[entry], 3);
+            if (distance < best_distance)
+            {
+                best = entry;
+                best_distance = distance;
+            }
+        }
+
+        block.indices |= best << (i * 2);
+        block.error += best_distance;
+    }
+
+    return block;
+}
+
+local void
+encode_bc1(const u8 *texels, u8 *out)
+{
+    float end0[3], end1[3];
+    fit_endpoints(texels, 3, 1.0f / 16.0f, end0, end1);
+
+    Bc1Block block = bc1_choose_indices(texels, end0, end1);
+
+    // how much of color1 each index takes
+    local const float index_weight[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    // color0 is the larger packed color, fit the end points in that order
+    float weights[16];
+    for (u32 i = 0; i < 16; ++i) weights[i] = 1.0f - index_weight[(block.indices >> (i * 2)) & 3];
+
+    if (block.error > 0 && refit_endpoints(texels, 3, weights, end0, end1))
+    {
+        Bc1Block refit = bc1_choose_indices(texels, end0, end1);
+        if (refit.error < block.error) block = refit;
+    }
+
+    memcpy(out + 0, &block.color0, 2);
+    memcpy(out + 2, &block.color1, 2);
+    memcpy(out + 4, &block.indices, 4);
+}
+
+// one channel, 8 interpolated values between the block minimum and maximum
+local void
+encode_bc4(const u8 *texels, u32 channel, u8 *out)
+{
+    u8 min_value = 255;
+    u8 max_value = 0;
+    for (u32 i = 0; i < 16; ++i)
+    {
+        min_value = glm::min(min_value, texels[i * 4 + channel]);
+        max_value = glm::max(max_value, texels[i * 4 + channel]);
+    }
+
+    out[0] = max_value;
+    out[1] = min_value;
+
+    u64 indices = 0;
+    if (max_value > min_value)
+    {
+        float scale = 7.0f / (max_value - min_value);
+        for (u32 i = 0; i < 16; ++i)
+        {
+            // step 7 is value0 (the maximum), 0 is value1, 1..6 are indices 7..2
+            u32 step = (u32)((texels[i * 4 + channel] - min_value) * scale + 0.5f);
+            u64 index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+            indices |= index << (i * 3);
+        }
+    }
+
+    for (u32 i = 0; i < 6; ++i) out[2 + i] = (u8)(indices >> (i * 8));
+}
+
+local const u32 bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct BitWriter
+{
+    u64 bits[2];
+    u32 position;
+};
+
+local inline void
+put_bits(BitWriter *writer, u64 value, u32 count)
+{
+    u32 position = writer->position;
+    if (position < 64)
+    {
+        writer->bits[0] |= value << position;
+        if (position + count > 64) writer->bits[1] |= value >> (64 - position);
+    }
+    else
+    {
+        writer->bits[1] |= value << (position - 64);
+    }
+    writer->position += count;
+}
+
+struct Bc7Block
+{
+    u32 endpoint[2][4]; // 7 bits
+    u32 pbit[2];
+    u8 indices[16];
+    u32 error;
+};
+
+// 7 bits per channel plus a p bit shared by the channels of an end point
+local void
+quantize_bc7_endpoint(const float *end, u32 *quantized, u32 *pbit)
+{
+    float best_error = FLT_MAX;
+    for (u32 p = 0; p < 2; ++p)
+    {
+        u32 candidate[4];
+        float error = 0.0f;
+        for (u32 c = 0; c < 4; ++c)
+        {
+            candidate[c] = (u32)glm::clamp((end[c] - p) / 2.0f + 0.5f, 0.0f, 127.0f);
+            float d = (float)((candidate[c] << 1) | p) - end[c];
+            error += d * d;
+        }
+
+        if (error < best_error)
+        {
+            best_error = error;
+            memcpy(quantized, candidate, sizeof(candidate));
+            *pbit = p;
+        }
+    }
+}
+
+local Bc7Block
+bc7_choose_indices(const u8 *texels, const float *end0, const float *end1)
+{
+    Bc7Block block;
+    quantize_bc7_endpoint(end0, block.endpoint[0], &block.pbit[0]);
+    quantize_bc7_endpoint(end1, block.endpoint[1], &block.pbit[1]);
+
+    s32 palette[16][4];
+    for (u32 c = 0; c < 4; ++c)
+    {
+        s32 e0 = (block.endpoint[0][c] << 1) | block.pbit[0];
+        s32 e1 = (block.endpoint[1][c] << 1) | block.pbit[1];
+        for (u32 entry = 0; entry < 16; ++entry)
+        {
+            palette[entry][c] = ((64 - bc7_weights[entry]) * e0 + bc7_weights[entry] * e1 + 32) >> 6;
+        }
+    }
+
+    block.error = 0;
+    for (u32 i = 0; i < 16; ++i)
+    {
+        u32 best = 0;
+        u32 best_distance = squared_distance(texels + i * 4, palette[0], 4);
+        for (u32 entry = 1; entry < 16; ++entry)
+        {
+            u32 distance = squared_distance(texels + i * 4, palette[entry], 4);
+            if (distance < best_distance)
+            {
+                best = entry;
+                best_distance = distance;
+            }
+        }
+
+        block.indices[i] = (u8)best;
+        block.error += best_distance;
+    }
+
+    return block;
+}
+
+// mode 6: one subset, rgba end points, 4 bit indices; the best single mode
+// for smooth color and alpha, the partitioned modes are left out
+local void
+encode_bc7(const u8 *texels, u8 *out)
+{
+    float end0[4], end1[4];
+    fit_endpoints(texels, 4, 0.0f, end0, end1);
+
+    Bc7Block block = bc7_choose_indices(texels, end0, end1);
+
+    float weights[16];
+    for (u32 i = 0; i < 16; ++i) weights[i] = bc7_weights[block.indices[i]] / 64.0f;
+
+    if (block.error > 0 && refit_endpoints(texels, 4, weights, end0, end1))
+    {
+        Bc7Block refit = bc7_choose_indices(texels, end0, end1);
+        if (refit.error < block.error) block = refit;
+    }
+
+    // the top bit of the first index is implied 0, flip the block if needed
+    if (block.indices[0] & 8)
+    {
+        for (u32 c = 0; c < 4; ++c)
+        {
+            u32 swap = block.endpoint[0][c];
+            block.endpoint[0][c] = block.endpoint[1][c];
+            block.endpoint[1][c] = swap;
+        }
+        u32 swap = block.pbit[0];
+        block.pbit[0] = block.pbit[1];
+        block.pbit[1] = swap;
+
+        for (u32 i = 0; i < 16; ++i) block.indices[i] = 15 - block.indices[i];
+    }
+
+    BitWriter writer = {};
+    put_bits(&writer, 1 << 6, 7);
+    for (u32 c = 0; c < 4; ++c)
+    {
+        put_bits(&writer, block.endpoint[0][c], 7);
+        put_bits(&writer, block.endpoint[1][c], 7);
+    }
+    put_bits(&writer, block.pbit[0], 1);
+    put_bits(&writer, block.pbit[1], 1);
+    put_bits(&writer, block.indices[0], 3);
+    for (u32 i = 1; i < 16; ++i) put_bits(&writer, block.indices[i], 4);
+
+    memcpy(out, writer.bits, 16);
+}
+
+local void
+encode_block(TextureFormat format, const u8 *texels, u8 *out)
+{
+    switch (format)
+    {
+        case TEXTURE_FORMAT_BC1:
+            encode_bc1(texels, out);
+            break;
+        case TEXTURE_FORMAT_BC3:
+            encode_bc4(texels, 3, out);
+            encode_bc1(texels, out + 8);
+            break;
+        case TEXTURE_FORMAT_BC5:
+            encode_bc4(texels, 0, out);
+            encode_bc4(texels, 1, out + 8);
+            break;
+        case TEXTURE_FORMAT_BC7:
+            encode_bc7(texels, out);
+            break;
+        default:
+            break;
+    }
+}
+
+local void
+compress_rows(TextureFormat format, const u8 *rgba, u32 width, u32 height, u8 *blocks, u32 first_row, u32 last_row)
+{
+    u32 block_size = texture_block_size(format);
+    u32 blocks_x = (width + 3) / 4;
+
+    u8 texels[16 * 4];
+    for (u32 block_y = first_row; block_y < last_row; ++block_y)
+    {
+        for (u32 block_x = 0; block_x < blocks_x; ++block_x)
+        {
+            for (u32 y = 0; y < 4; ++y)
+            {
+                u32 source_y = glm::min(block_y * 4 + y, height - 1);
+                for (u32 x = 0; x < 4; ++x)
+                {
+                    u32 source_x = glm::min(block_x * 4 + x, width - 1);
+                    memcpy(texels + (y * 4 + x) * 4, rgba + ((u64)source_y * width + source_x) * 4, 4);
+                }
+            }
+
+            encode_block(format, texels, blocks + ((u64)block_y * blocks_x + block_x) * block_size);
+        }
+    }
+}
+
+void compress_image(TextureFormat format, const u8 *rgba, u32 width, u32 height, u8 *blocks, bool threaded)
+{
+    PROFILE_SCOPE("compress texture");
+
+    if (format == TEXTURE_FORMAT_RGBA8)
+    {
+        memcpy(blocks, rgba, (u64)width * height * 4);
+        return;
+    }
+
+    u32 blocks_y = (height + 3) / 4;
+
+    if (threaded)
+    {
+        parallel_for(blocks_y, 4, [&](u32 begin, u32 end, u32) {
+            compress_rows(format, rgba, width, height, blocks, begin, end);
+        });
+    }
+    else
+    {
+        compress_rows(format, rgba, width, height, blocks, 0, blocks_y);
+    }
+}
+
+
+// --- DECOMPRESSION ---
+
+local void
+decode_bc1(const u8 *block, u8 *texels)
+{
+    u16 color0, color1;
+    u32 indices;
+    memcpy(&color0, block + 0, 2);
+    memcpy(&color1, block + 2, 2);
+    memcpy(&indices, block + 4, 4);
+
+    s32 palette[4][3];
+    bc1_palette(color0, color1, palette);
+    if (color0 <= color1)
+    {
+        for (u32 c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+
+    for (u32 i = 0; i < 16; ++i)
+    {
+        u32 index = (indices >> (i * 2)) & 3;
+        for (u32 c = 0; c < 3; ++c) texels[i * 4 + c] = (u8)palette[index][c];
+        texels[i * 4 + 3] = 255;
+    }
+}
+
+local void
+decode_bc4(const u8 *block, u32 channel, u8 *texels)
+{
+    u32 values[8];
+    values[0] = block[0];
+    values[1] = block[1];
+    if (values[0] > values[1])
+    {
+        for (u32 i = 1; i < 7; ++i) values[i + 1] = ((7 - i) * values[0] + i * values[1]) / 7;
+    }
+    else
+    {
+        for (u32 i = 1; i < 5; ++i) values[i + 1] = ((5 - i) * values[0] + i * values[1]) / 5;
+        values[6] = 0;
+        values[7] = 255;
+    }
+
+    u64 indices = 0;
+    for (u32 i = 0; i < 6; ++i) indices |= (u64)block[2 + i] << (i * 8);
+
+    for (u32 i = 0; i < 16; ++i)
+    {
+        texels[i * 4 + channel] = (u8)values[(indices >> (i * 3)) & 7];
+    }
+}
+
+local inline u32
+get_bits(const u64 *bits, u32 *position, u32 count)
+{
+    u32 value = 0;
+    for (u32 i = 0; i < count; ++i, ++*position)
+    {
+        value |= (u32)((bits[*position / 64] >> (*position % 64)) & 1) << i;
+    }
+    return value;
+}
+
+// mode 6 only, other modes decode to magenta
+local void
+decode_bc7(const u8 *block, u8 *texels)
+{
+    u64 bits[2];
+    memcpy(bits, block, 16);
+
+    u32 position = 0;
+    if (get_bits(bits, &position, 7) != (1 << 6))
+    {
+        for (u32 i = 0; i < 16; ++i)
+        {
+            texels[i * 4 + 0] = 255;
+            texels[i * 4 + 1] = 0;
+            texels[i * 4 + 2] = 255;
+            texels[i * 4 + 3] = 255;
+        }
+        return;
+    }
+
+    u32 endpoint[2][4];
+    for (u32 c = 0; c < 4; ++c)
+    {
+        endpoint[0][c] = get_bits(bits, &position, 7);
+        endpoint[1][c] = get_bits(bits, &position, 7);
+    }
+    u32 pbit0 = get_bits(bits, &position, 1);
+    u32 pbit1 = get_bits(bits, &position, 1);
+
+    for (u32 i = 0; i < 16; ++i)
+    {
+        u32 weight = bc7_weights[get_bits(bits, &position, i == 0 ? 3 : 4)];
+        for (u32 c = 0; c < 4; ++c)
+        {
+            u32 e0 = (endpoint[0][c] << 1) | pbit0;
+            u32 e1 = (endpoint[1][c] << 1) | pbit1;
+            texels[i * 4 + c] = (u8)(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+        }
+    }
+}
+
+void decompress_image(TextureFormat format, const u8 *blocks, u32 width, u32 height, u8 *rgba)
+{
+    if (format == TEXTURE_FORMAT_RGBA8)
+    {
+        memcpy(rgba, blocks, (u64)width * height * 4);
+        return;
+    }
+
+    u32 block_size = texture_block_size(format);
+    u32 blocks_x = (width + 3) / 4;
+    u32 blocks_y = (height + 3) / 4;
+
+    u8 texels[16 * 4];
+    for (u32 block_y = 0; block_y < blocks_y; ++block_y)
+    {
+        for (u32 block_x = 0; block_x < blocks_x; ++block_x)
+        {
+            const u8 *block = blocks + ((u64)block_y * blocks_x + block_x) * block_size;
+
+            switch (format)
+            {
+                case TEXTURE_FORMAT_BC1:
+                    decode_bc1(block, texels);
+                    break;
+                case TEXTURE_FORMAT_BC3:
+                    decode_bc1(block + 8, texels);
+                    decode_bc4(block, 3, texels);
+                    break;
+                case TEXTURE_FORMAT_BC5:
+                    decode_bc4(block, 0, texels);
+                    decode_bc4(block + 8, 1, texels);
+                    for (u32 i = 0; i < 16; ++i)
+                    {
+                        texels[i * 4 + 2] = 0;
+                        texels[i * 4 + 3] = 255;
+                    }
+                    break;
+                case TEXTURE_FORMAT_BC7:
+                    decode_bc7(block, texels);
+                    break;
+                default:
+                    break;
+            }
+
+            for (u32 y = 0; y < 4 && block_y * 4 + y < height; ++y)
+            {
+                for (u32 x = 0; x < 4 && block_x * 4 + x < width; ++x)
+                {
+                    memcpy(rgba + ((u64)(block_y * 4 + y) * width + block_x * 4 + x) * 4, texels + (y * 4 + x) * 4, 4);
+                }
+            }
+        }
+    }
+}
+
+
+// --- FILE ---
+
+s32 bake_texture(const char *image_filename, const char *filename, const TextureBakeOptions &options)
+{
+    PROFILE_SCOPE("bake texture");
+
+    Image image;
+    if (load_image(&image, image_filename, 4) != 0)
+    {
+        LOG_E("Cannot load '%s': %s", image_filename, image_failure_reason());
+        return -1;
+    }
+
+    u32 width = image.width;
+    u32 height = image.height;
+
+    std::vector<TextureLevel> levels;
+    build_mip_chain(image.pixels, width, height, options.srgb, &levels);
+    destroy(&image);
+
+    FILE *file = fopen(filename, "wb");
+    if (!file)
+    {
+        LOG_E("Cannot open '%s' for writing", filename);
+        return -1;
+    }
+
+    TextureFileHeader header = {};
+    header.magic = TEXTURE_FILE_MAGIC;
+    header.version = TEXTURE_FILE_VERSION;
+    header.format = options.format;
+    header.width = width;
+    header.height = height;
+    header.level_count = (u32)levels.size();
+
+    std::vector<TextureFileLevel> table(levels.size());
+    u64 offset = sizeof(TextureFileHeader) + sizeof(TextureFileLevel) * table.size();
+    u64 raw_size = 0;
+    for (u32 i = 0; i < (u32)levels.size(); ++i)
+    {
+        table[i].width = levels[i].width;
+        table[i].height = levels[i].height;
+        table[i].offset = offset;
+        table[i].size = texture_level_size(options.format, levels[i].width, levels[i].height);
+        offset += table[i].size;
+        raw_size += texture_level_size(TEXTURE_FORMAT_RGBA8, levels[i].width, levels[i].height);
+    }
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(table.data(), sizeof(TextureFileLevel), table.size(), file);
+
+    std::vector<u8> blocks;
+    for (u32 i = 0; i < (u32)levels.size(); ++i)
+    {
+        blocks.resize(table[i].size);
+        compress_image(options.format, levels[i].pixels.data(), levels[i].width, levels[i].height, blocks.data(), true);
+        fwrite(blocks.data(), 1, blocks.size(), file);
+    }
+
+    bool write_error = ferror(file) != 0;
+    fclose(file);
+
+    if (write_error)
+    {
+        LOG_E("Error writing '%s'", filename);
+        return -1;
+    }
+
+    LOG_I("Baked '%s': %ux%u %s, %u levels, %.2f MB in VRAM (%.2f MB as rgba8)", filename, width, height,
+          texture_format_name(options.format), header.level_count,
+          (offset - table[0].offset) / (1024.0 * 1024.0), raw_size / (1024.0 * 1024.0));
+
+    return 0;
+}
+
+s32 load_texture_file(TextureFile *file, const char *filename)
+{
+    file->data = nullptr;
+    file->size = 0;
+    file->levels.clear();
+
+    FILE *handle = fopen(filename, "rb");
+    if (!handle) return -1;
+
+    fseek(handle, 0, SEEK_END);
+    file->size = tell_file(handle);
+    seek_file(handle, 0);
+
+    file->data = (u8 *)malloc(file->size);
+    bool read_ok = file->data && fread(file->data, 1, file->size, handle) == file->size;
+    fclose(handle);
+
+    if (!read_ok || file->size < sizeof(TextureFileHeader))
+    {
+        destroy(file);
+        return -1;
+    }
+
+    memcpy(&file->header, file->data, sizeof(TextureFileHeader));
+    const TextureFileHeader &header = file->header;
+
+    u64 table_end = sizeof(TextureFileHeader) + (u64)header.level_count * sizeof(TextureFileLevel);
+    if (header.magic != TEXTURE_FILE_MAGIC ||
+        header.version != TEXTURE_FILE_VERSION ||
+        header.format >= TEXTURE_FORMAT_COUNT ||
+        header.level_count == 0 ||
+        table_end > file->size)
+    {
+        destroy(file);
+        return -1;
+    }
+
+    file->levels.resize(header.level_count);
+    memcpy(file->levels.data(), file->data + sizeof(TextureFileHeader), header.level_count * sizeof(TextureFileLevel));
+
+    for (const TextureFileLevel &level : file->levels)
+    {
+        if (level.offset + level.size > file->size ||
+            level.size != texture_level_size((TextureFormat)header.format, level.width, level.height))
+        {
+            destroy(file);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void destroy(TextureFile *file)
+{
+    free(file->data);
+    file->data = nullptr;
+    file->size = 0;
+    file->levels.clear();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+
+#include "types.h"
+
+// Baked texture file: the whole mip chain generated offline and optionally
+// block compressed, so loading it is a read and a copy to the GPU.
+//
+// Color textures are filtered in linear light (sRGB decoded, averaged,
+// encoded again), otherwise dark texels win every average and the smaller
+// levels come out too dark. Data textures like normal maps are filtered as is.
+//
+// [TextureFileHeader][TextureFileLevel x level_count][level 0][level 1]...
+
+#define TEXTURE_FILE_MAGIC 0x5854564F // 'OVTX'
+#define TEXTURE_FILE_VERSION 1
+
+enum TextureFormat
+{
+    TEXTURE_FORMAT_RGBA8,
+    TEXTURE_FORMAT_BC1, // rgb, 4 bits per texel
+    TEXTURE_FORMAT_BC3, // rgba, 8 bits per texel
+    TEXTURE_FORMAT_BC5, // rg, 8 bits per texel, for normal maps
+    TEXTURE_FORMAT_BC7, // rgba, 8 bits per texel, mode 6 blocks only
+
+    TEXTURE_FORMAT_COUNT
+};
+
+struct TextureFileHeader
+{
+    u32 magic;
+    u32 version;
+    u32 format;
+    u32 width;
+    u32 height;
+    u32 level_count;
+};
+
+struct TextureFileLevel
+{
+    u32 width;
+    u32 height;
+    u64 offset; // from the start of the file
+    u64 size;
+};
+
+struct TextureBakeOptions
+{
+    TextureFormat format;
+    bool srgb; // filter the mips in linear light
+};
+
+TextureBakeOptions default_texture_bake_options();
+
+const char *texture_format_name(TextureFormat format);
+bool parse_texture_format(const char *name, TextureFormat *format);
+
+// bytes per 4x4 block, 0 for RGBA8
+u32 texture_block_size(TextureFormat format);
+
+u64 texture_level_size(TextureFormat format, u32 width, u32 height);
+
+struct TextureLevel
+{
+    u32 width;
+    u32 height;
+    std::vector<u8> pixels; // rgba8
+};
+
+// level 0 is a copy of the image, every next level is half the size down to 1x1
+void build_mip_chain(const u8 *rgba, u32 width, u32 height, bool srgb, std::vector<TextureLevel> *levels);
+
+// 4x4 blocks row by row, blocks over the edge repeat the last row/column;
+// threaded splits the block rows over the job workers
+void compress_image(TextureFormat format, const u8 *rgba, u32 width, u32 height, u8 *blocks, bool threaded);
+
+void decompress_image(TextureFormat format, const u8 *blocks, u32 width, u32 height, u8 *rgba);
+
+s32 bake_texture(const char *image_filename, const char *filename, const TextureBakeOptions &options);
+
+struct TextureFile
+{
+    TextureFileHeader header;
+    std::vector<TextureFileLevel> levels;
+
+    // the whole file, level offsets point into it
+    u8 *data;
+    u64 size;
+};
+
+// fails quietly, the caller decides how loud to be
+s32 load_texture_file(TextureFile *file, const char *filename);
+
+void destroy(TextureFile *file);
@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "texcache.h"
+#include "file.h"
+#include "log.h"
+
+#define TEXTURE_HASH_BLOCK_SIZE (64 * 1024)
+
+// multiply-xor over 8 byte words, only the last block may have a tail
+local u64
+hash_block(u64 hash, const u8 *data, u64 size)
+{
+    u64 i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        u64 word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 32;
+    }
+
+    for (; i < size; ++i)
+    {
+        hash = (hash ^ data[i]) * 0xC4CEB9FE1A85EC53ull;
+    }
+
+    return hash;
+}
+
+// read in blocks, big images are not held in memory twice
+local bool
+hash_file(const char *filename, u64 *hash)
+{
+    FILE *file = fopen(filename, "rb");
+    if (!file) return false;
+
+    std::vector<u8> block(TEXTURE_HASH_BLOCK_SIZE);
+    u64 size = 0;
+    u64 result = 0x9E3779B97F4A7C15ull;
+
+    for (;;)
+    {
+        size_t read = fread(block.data(), 1, block.size(), file);
+        result = hash_block(result, block.data(), read);
+        size += read;
+        if (read < block.size()) break;
+    }
+
+    fclose(file);
+
+    result ^= size * 0x9E3779B97F4A7C15ull;
+    result ^= result >> 33;
+    *hash = result;
+
+    return true;
+}
+
+// a hash match is only trusted after the bytes agree
+local bool
+same_content(const char *a, const char *b)
+{
+    FILE *file_a = fopen(a, "rb");
+    FILE *file_b = fopen(b, "rb");
+    bool same = file_a && file_b;
+
+    std::vector<u8> block_a(same ? TEXTURE_HASH_BLOCK_SIZE : 0);
+    std::vector<u8> block_b(same ? TEXTURE_HASH_BLOCK_SIZE : 0);
+
+    while (same)
+    {
+        size_t read_a = fread(block_a.data(), 1, block_a.size(), file_a);
+        size_t read_b = fread(block_b.data(), 1, block_b.size(), file_b);
+        same = read_a == read_b && memcmp(block_a.data(), block_b.data(), read_a) == 0;
+        if (read_a < block_a.size()) break;
+    }
+
+    if (file_a) fclose(file_a);
+    if (file_b) fclose(file_b);
+
+    return same;
+}
+
+// an entry of another path whose file has the same bytes as path
+local u32
+find_content(const TextureCache *cache, const std::string &path, u64 hash)
+{
+    auto range = cache->by_content.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (same_content(path.c_str(), cache->entries[it->second]->path.c_str())) return it->second;
+    }
+    return TEXTURE_NO_HANDLE;
+}
+
+local void
+forget_content(TextureCache *cache, u64 hash, u32 entry)
+{
+    auto range = cache->by_content.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == entry)
+        {
+            cache->by_content.erase(it);
+            return;
+        }
+    }
+}
+
+local void
+make_resident(TextureCache *cache, TextureCacheEntry *entry)
+{
+    init(&entry->texture, entry->path.c_str(), cache->uploader);
+    entry->resident = true;
+}
+
+local u32
+add_entry(TextureCache *cache, const std::string &path, u64 hash)
+{
+    TextureCacheEntry *entry = new TextureCacheEntry();
+    entry->path = path;
+    entry->content_hash = hash;
+    entry->ref_count = 0;
+    entry->resident = false;
+    entry->last_used_frame = cache->frame;
+    make_resident(cache, entry);
+
+    u32 index = (u32)cache->entries.size();
+    cache->entries.push_back(entry);
+    cache->by_content.emplace(hash, index);
+
+    return index;
+}
+
+local void
+evict(TextureCache *cache, TextureCacheEntry *entry)
+{
+    cancel_uploads(cache->uploader, &entry->texture);
+    destroy(&entry->texture);
+    entry->texture.size = 0;
+    entry->resident = false;
+
+    cache->stats.evictions += 1;
+}
+
+void init(TextureCache *cache, TextureUploader *uploader, u64 vram_budget)
+{
+    cache->uploader = uploader;
+    cache->vram_budget = vram_budget;
+    cache->frame = 0;
+    cache->paths.clear();
+    cache->entries.clear();
+    cache->by_path.clear();
+    cache->by_content.clear();
+    cache->stats = {};
+}
+
+void destroy(TextureCache *cache)
+{
+    for (TextureCacheEntry *entry : cache->entries)
+    {
+        if (entry->resident)
+        {
+            cancel_uploads(cache->uploader, &entry->texture);
+            destroy(&entry->texture);
+        }
+        delete entry;
+    }
+
+    cache->paths.clear();
+    cache->entries.clear();
+    cache->by_path.clear();
+    cache->by_content.clear();
+}
+
+u32 acquire_texture(TextureCache *cache, const char *filename)
+{
+    std::string path = canonical_path(filename);
+
+    auto known_path = cache->by_path.find(path);
+    if (known_path != cache->by_path.end())
+    {
+        TextureCachePath *known = &cache->paths[known_path->second];
+        known->ref_count += 1;
+        cache->entries[known->entry]->ref_count += 1;
+        return known_path->second;
+    }
+
+    u64 hash;
+    if (!hash_file(path.c_str(), &hash))
+    {
+        LOG_W("Cannot open texture '%s'", filename);
+        return TEXTURE_NO_HANDLE;
+    }
+
+    u32 entry = find_content(cache, path, hash);
+    if (entry != TEXTURE_NO_HANDLE)
+    {
+        cache->stats.deduplicated += 1;
+        LOG_I("Texture '%s' is the same image as '%s'", path.c_str(), cache->entries[entry]->path.c_str());
+    }
+    else
+    {
+        entry = add_entry(cache, path, hash);
+    }
+    cache->entries[entry]->ref_count += 1;
+
+    u32 handle = (u32)cache->paths.size();
+    cache->paths.push_back(TextureCachePath{path, hash, 1, entry});
+    cache->by_path[path] = handle;
+
+    return handle;
+}
+
+const char *texture_path(const TextureCache *cache, u32 handle)
+{
+    return cache->paths[handle].path.c_str();
+}
+
+void release_texture(TextureCache *cache, u32 handle)
+{
+    if (handle == TEXTURE_NO_HANDLE) return;
+
+    TextureCachePath *path = &cache->paths[handle];
+    if (path->ref_count == 0)
+    {
+        LOG_E("Texture '%s' released more often than acquired", path->path.c_str());
+        return;
+    }
+
+    path->ref_count -= 1;
+    cache->entries[path->entry]->ref_count -= 1;
+}
+
+Texture *use_texture(TextureCache *cache, u32 handle)
+{
+    TextureCacheEntry *entry = cache->entries[cache->paths[handle].entry];
+    entry->last_used_frame = cache->frame;
+
+    if (!entry->resident)
+    {
+        make_resident(cache, entry);
+        cache->stats.reloads += 1;
+    }
+
+    return &entry->texture;
+}
+
+void reload_texture(TextureCache *cache, u32 handle)
+{
+    TextureCachePath *path = &cache->paths[handle];
+
+    u64 hash;
+    if (!hash_file(path->path.c_str(), &hash)) return;
+    path->content_hash = hash;
+
+    u32 index = path->entry;
+    TextureCacheEntry *entry = cache->entries[index];
+
+    // another path on the entry, the one to load from if this path was it
+    u32 other = TEXTURE_NO_HANDLE;
+    for (u32 i = 0; i < (u32)cache->paths.size(); ++i)
+    {
+        if (i != handle && cache->paths[i].entry == index) other = i;
+    }
+
+    if (other == TEXTURE_NO_HANDLE)
+    {
+        // the new content may now equal another entry, both stay as they are
+        forget_content(cache, entry->content_hash, index);
+        entry->content_hash = hash;
+        cache->by_content.emplace(hash, index);
+
+        if (entry->resident)
+        {
+            reload(&entry->texture, cache->uploader);
+        }
+        return;
+    }
+
+    // the other paths still have the old content, only this one moves
+    entry->ref_count -= path->ref_count;
+    if (entry->path == path->path)
+    {
+        // the texture stays as loaded, later loads come from a file that has it
+        entry->path = cache->paths[other].path;
+    }
+
+    u32 split = add_entry(cache, path->path, hash);
+    cache->entries[split]->ref_count = path->ref_count;
+    path->entry = split;
+
+    LOG_I("Texture '%s' changed, no longer the same image as '%s'", path->path.c_str(), entry->path.c_str());
+}
+
+void update(TextureCache *cache)
+{
+    u64 vram_used = 0;
+    for (TextureCacheEntry *entry : cache->entries)
+    {
+        if (entry->resident) vram_used += entry->texture.size;
+    }
+
+    if (vram_used > cache->vram_budget)
+    {
+        std::vector<u32> candidates;
+        for (u32 handle = 0; handle < (u32)cache->entries.size(); ++handle)
+        {
+            const TextureCacheEntry *entry = cache->entries[handle];
+            if (entry->resident && entry->last_used_frame != cache->frame) candidates.push_back(handle);
+        }
+
+        // unreferenced first, then least recently used
+        std::sort(candidates.begin(), candidates.end(), [cache](u32 a, u32 b) {
+            const TextureCacheEntry *entry_a = cache->entries[a];
+            const TextureCacheEntry *entry_b = cache->entries[b];
+            if ((entry_a->ref_count > 0) != (entry_b->ref_count > 0)) return entry_a->ref_count == 0;
+            return entry_a->last_used_frame < entry_b->last_used_frame;
+        });
+
+        for (u32 handle : candidates)
+        {
+            if (vram_used <= cache->vram_budget) break;
+
+            TextureCacheEntry *entry = cache->entries[handle];
+            vram_used -= entry->texture.size;
+            evict(cache, entry);
+        }
+    }
+
+    cache->stats.entries = (u32)cache->entries.size();
+    cache->stats.resident = 0;
+    for (const TextureCacheEntry *entry : cache->entries)
+    {
+        if (entry->resident) cache->stats.resident += 1;
+    }
+    cache->stats.vram_used = vram_used;
+
+    cache->frame += 1;
+}
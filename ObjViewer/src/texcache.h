@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "types.h"
+#include "texture.h"
+#include "upload.h"
+
+// Shared textures for materials.
+//
+// Handles are per canonical path, so one image reached through different
+// relative paths is one handle. Paths whose files have the same content,
+// checked by hash and then byte for byte, share one entry and are loaded
+// once; when a file changes on disk only its own path moves to a new entry.
+// Handles are ref counted; an entry nobody references stays cached until
+// evicted.
+//
+// Every texture's GPU size is tracked, and when the total goes over the
+// budget update() evicts the least recently used ones, unreferenced entries
+// first and never one used this frame. An evicted entry keeps its handle and
+// is loaded again the next time it is used.
+
+#define TEXTURE_NO_HANDLE 0xFFFFFFFF
+
+struct TextureCachePath
+{
+    std::string path; // canonical
+    u64 content_hash;
+    u32 ref_count;
+    u32 entry;
+};
+
+struct TextureCacheEntry
+{
+    std::string path; // loaded from, one of the paths sharing the entry
+    u64 content_hash;
+    u32 ref_count;    // over all its paths
+
+    Texture texture;
+    bool resident; // texture object exists, its image may still be on the way
+    u64 last_used_frame;
+};
+
+struct TextureCacheStats
+{
+    u32 entries;
+    u32 resident;
+    u32 deduplicated; // paths sharing the entry of another path with the same content
+    u32 evictions;
+    u32 reloads;      // evicted entries used again
+    u64 vram_used;
+};
+
+struct TextureCache
+{
+    TextureUploader *uploader;
+    u64 vram_budget;
+    u64 frame;
+
+    std::vector<TextureCachePath> paths; // handles index these
+
+    // heap allocated, the uploader holds on to the Texture inside
+    std::vector<TextureCacheEntry *> entries;
+    std::unordered_map<std::string, u32> by_path; // canonical path to handle
+    std::unordered_multimap<u64, u32> by_content; // content hash to entry, hashes can collide
+
+    TextureCacheStats stats;
+};
+
+void init(TextureCache *cache, TextureUploader *uploader, u64 vram_budget);
+void destroy(TextureCache *cache);
+
+// handle of the texture in filename, loading it unless an entry with the
+// same path or content exists; TEXTURE_NO_HANDLE when the file is missing
+u32 acquire_texture(TextureCache *cache, const char *filename);
+
+// the canonical path the handle stands for, the one to watch for changes
+const char *texture_path(const TextureCache *cache, u32 handle);
+
+void release_texture(TextureCache *cache, u32 handle);
+
+// marks the entry used this frame, loads it again when it was evicted
+Texture *use_texture(TextureCache *cache, u32 handle);
+
+// the file of the handle changed on disk; when other paths share its entry
+// the handle gets an entry of its own
+void reload_texture(TextureCache *cache, u32 handle);
+
+// accounts VRAM and evicts down to the budget, once per frame after drawing
+void update(TextureCache *cache);
@@ -0,0 +1,188 @@
+#include <glad\glad.h>
+
+#include "texture.h"
+#include "image.h"
+#include "file.h"
+#include "log.h"
+#include "stats.h"
+
+// block compressed formats the GL 3.3 core headers do not name
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+u32 gl_texture_format(TextureFormat format)
+{
+    switch (format)
+    {
+        case TEXTURE_FORMAT_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case TEXTURE_FORMAT_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case TEXTURE_FORMAT_BC5: return GL_COMPRESSED_RG_RGTC2;
+        case TEXTURE_FORMAT_BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+        default: return GL_RGBA;
+    }
+}
+
+u32 gl_image_format(s32 channels)
+{
+    GLenum formats[] = { GL_RED, GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    return formats[channels];
+}
+
+void set_image_swizzle(s32 channels)
+{
+    GLint gray[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+    GLint gray_alpha[] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+    GLint stored[] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+
+    const GLint *swizzle = channels == 1 ? gray : channels == 2 ? gray_alpha : stored;
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+}
+
+// the levels go up as baked, nothing is generated
+local s32
+upload_baked(Texture *texture)
+{
+    TextureFile file;
+    if (load_texture_file(&file, texture->filename.c_str()) != 0)
+    {
+        LOG_W("Cannot load baked texture '%s'", texture->filename.c_str());
+        return -1;
+    }
+
+    TextureFormat format = (TextureFormat)file.header.format;
+    GLenum gl_format = gl_texture_format(format);
+
+    // as stored, the image before a reload may have been gray
+    glBindTexture(GL_TEXTURE_2D, texture->ID);
+    set_image_swizzle(4);
+
+    for (u32 level = 0; level < file.header.level_count; ++level)
+    {
+        const TextureFileLevel &info = file.levels[level];
+        if (format == TEXTURE_FORMAT_RGBA8)
+        {
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, info.width, info.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                         file.data + info.offset);
+        }
+        else
+        {
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, gl_format, info.width, info.height, 0, (GLsizei)info.size,
+                                   file.data + info.offset);
+        }
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, file.header.level_count - 1);
+
+    texture->width = file.header.width;
+    texture->height = file.header.height;
+    texture->size = 0;
+    for (const TextureFileLevel &level : file.levels) texture->size += level.size;
+
+    destroy(&file);
+
+    return 0;
+}
+
+local s32
+upload_image(Texture *texture)
+{
+    if (has_extension(texture->filename.c_str(), ".tex"))
+    {
+        return upload_baked(texture);
+    }
+
+    Image image;
+    if (load_image(&image, texture->filename.c_str(), 0) != 0)
+    {
+        LOG_W("Cannot load texture '%s': %s", texture->filename.c_str(), image_failure_reason());
+        return -1;
+    }
+
+    u32 width = image.width;
+    u32 height = image.height;
+    u32 n_channels = image.channels;
+
+    GLenum format = gl_image_format(n_channels);
+
+    glBindTexture(GL_TEXTURE_2D, texture->ID);
+    set_image_swizzle(n_channels);
+
+    // rgb rows are not 4 byte aligned for odd widths
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    destroy(&image);
+
+    texture->width = width;
+    texture->height = height;
+    // the generated levels add a third
+    texture->size = (u64)width * height * n_channels * 4 / 3;
+
+    return 0;
+}
+
+void init_empty(Texture *texture, const char *filename)
+{
+    texture->filename = filename;
+    texture->width = 0;
+    texture->height = 0;
+    texture->size = 0;
+
+    glGenTextures(1, &texture->ID);
+    glBindTexture(GL_TEXTURE_2D, texture->ID);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+s32 init(Texture *texture, const char *filename)
+{
+    init_empty(texture, filename);
+
+    if (upload_image(texture) != 0)
+    {
+        LOG_E("Cannot load texture '%s'", filename);
+        return -1;
+    }
+
+    return 0;
+}
+
+s32 reload(Texture *texture)
+{
+    if (upload_image(texture) != 0)
+    {
+        LOG_W("Texture reload failed, keeping the previous image");
+        return -1;
+    }
+
+    LOG_I("Reloaded texture '%s' (%dx%d)", texture->filename.c_str(), texture->width, texture->height);
+    return 0;
+}
+
+void bind(Texture *texture, u32 unit)
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, texture->ID);
+    count_texture_changes(1);
+}
+
+void destroy(Texture *texture)
+{
+    glDeleteTextures(1, &texture->ID);
+    texture->ID = 0;
+}
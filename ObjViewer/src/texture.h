@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+#include "types.h"
+#include "texbake.h"
+
+struct Texture
+{
+    u32 ID;
+    s32 width;
+    s32 height;
+    u64 size; // bytes of all the levels on the GPU, 0 until an image arrived
+
+    std::string filename;
+};
+
+// creates a repeating, mipmapped 2D texture from an image file, or from a
+// baked .tex file with all its levels as they are
+s32 init(Texture *texture, const char *filename);
+
+// only the texture object and its sampling state, no image yet
+void init_empty(Texture *texture, const char *filename);
+
+// decodes the file again into the same texture object, so nothing that
+// refers to it has to change; on failure the old image stays
+s32 reload(Texture *texture);
+
+void bind(Texture *texture, u32 unit);
+
+// GL internal format of a baked texture format
+u32 gl_texture_format(TextureFormat format);
+
+// GL format of decoded 8 bit pixels with 1 to 4 channels
+u32 gl_image_format(s32 channels);
+
+// gray (1 channel) samples as (r, r, r, 1) and gray alpha (2) as (r, r, r, g),
+// more channels as stored; sets the GL_TEXTURE_2D that is bound
+void set_image_swizzle(s32 channels);
+
+void destroy(Texture *texture);
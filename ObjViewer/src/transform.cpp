@@ -0,0 +1,290 @@
+#include <string.h>
+
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "transform.h"
+#include "jobs.h"
+#include "profile.h"
+
+// batches handed to a worker at a time, and the size below which threading
+// is not worth the wake up
+#define TRANSFORM_JOB_BATCHES 512
+#define TRANSFORM_PARALLEL_THRESHOLD (16 * 1024)
+
+local float *
+allocate_floats(u32 count, float value)
+{
+    float *array = (float *)_mm_malloc(count * sizeof(float), 32);
+    for (u32 i = 0; i < count; ++i) array[i] = value;
+    return array;
+}
+
+local void
+grow_floats(float **array, u32 old_capacity, u32 new_capacity, float value)
+{
+    float *new_array = allocate_floats(new_capacity, value);
+    if (*array)
+    {
+        memcpy(new_array, *array, old_capacity * sizeof(float));
+        _mm_free(*array);
+    }
+    *array = new_array;
+}
+
+local void
+grow(TransformSystem *system, u32 new_capacity)
+{
+    new_capacity = (new_capacity + TRANSFORM_BATCH_SIZE - 1) / TRANSFORM_BATCH_SIZE * TRANSFORM_BATCH_SIZE;
+    u32 old_capacity = system->capacity;
+
+    // padding entries are identity transforms, computing them is harmless
+    grow_floats(&system->position_x, old_capacity, new_capacity, 0.0f);
+    grow_floats(&system->position_y, old_capacity, new_capacity, 0.0f);
+    grow_floats(&system->position_z, old_capacity, new_capacity, 0.0f);
+    grow_floats(&system->rotation_x, old_capacity, new_capacity, 0.0f);
+    grow_floats(&system->rotation_y, old_capacity, new_capacity, 0.0f);
+    grow_floats(&system->rotation_z, old_capacity, new_capacity, 0.0f);
+    grow_floats(&system->rotation_w, old_capacity, new_capacity, 1.0f);
+    grow_floats(&system->scale_x, old_capacity, new_capacity, 1.0f);
+    grow_floats(&system->scale_y, old_capacity, new_capacity, 1.0f);
+    grow_floats(&system->scale_z, old_capacity, new_capacity, 1.0f);
+
+    u8 *dirty = (u8 *)_mm_malloc(new_capacity, 32);
+    memset(dirty, 0, new_capacity);
+
+    glm::mat4 *world = (glm::mat4 *)_mm_malloc(new_capacity * sizeof(glm::mat4), 32);
+    for (u32 i = 0; i < new_capacity; ++i) world[i] = glm::mat4(1.0f);
+
+    if (system->dirty)
+    {
+        memcpy(dirty, system->dirty, old_capacity);
+        memcpy(world, system->world, old_capacity * sizeof(glm::mat4));
+        _mm_free(system->dirty);
+        _mm_free(system->world);
+    }
+
+    system->dirty = dirty;
+    system->world = world;
+    system->capacity = new_capacity;
+}
+
+void init(TransformSystem *system, u32 capacity)
+{
+    *system = {};
+    grow(system, capacity ? capacity : TRANSFORM_BATCH_SIZE);
+}
+
+void destroy(TransformSystem *system)
+{
+    float **arrays[] = {
+        &system->position_x, &system->position_y, &system->position_z,
+        &system->rotation_x, &system->rotation_y, &system->rotation_z, &system->rotation_w,
+        &system->scale_x, &system->scale_y, &system->scale_z,
+    };
+
+    for (u32 i = 0; i < ArrayCount(arrays); ++i)
+    {
+        _mm_free(*arrays[i]);
+    }
+
+    _mm_free(system->dirty);
+    _mm_free(system->world);
+
+    *system = {};
+}
+
+u32 add_transform(TransformSystem *system, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    if (system->count == system->capacity)
+    {
+        grow(system, system->capacity * 2);
+    }
+
+    u32 id = system->count++;
+    set_position(system, id, position);
+    set_rotation(system, id, rotation);
+    set_scale(system, id, scale);
+
+    return id;
+}
+
+void set_position(TransformSystem *system, u32 id, const glm::vec3 &position)
+{
+    system->position_x[id] = position.x;
+    system->position_y[id] = position.y;
+    system->position_z[id] = position.z;
+    system->dirty[id] = 1;
+}
+
+void set_rotation(TransformSystem *system, u32 id, const glm::quat &rotation)
+{
+    system->rotation_x[id] = rotation.x;
+    system->rotation_y[id] = rotation.y;
+    system->rotation_z[id] = rotation.z;
+    system->rotation_w[id] = rotation.w;
+    system->dirty[id] = 1;
+}
+
+void set_scale(TransformSystem *system, u32 id, const glm::vec3 &scale)
+{
+    system->scale_x[id] = scale.x;
+    system->scale_y[id] = scale.y;
+    system->scale_z[id] = scale.z;
+    system->dirty[id] = 1;
+}
+
+// a, b, c, d hold one matrix row each for 4 entries, transposed they become
+// one column per entry
+local inline void
+store_column(glm::mat4 *world, u32 column, __m128 a, __m128 b, __m128 c, __m128 d)
+{
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    _mm_store_ps(glm::value_ptr(world[0]) + column * 4, a);
+    _mm_store_ps(glm::value_ptr(world[1]) + column * 4, b);
+    _mm_store_ps(glm::value_ptr(world[2]) + column * 4, c);
+    _mm_store_ps(glm::value_ptr(world[3]) + column * 4, d);
+}
+
+#if defined(__AVX__)
+
+local inline void
+store_column(glm::mat4 *world, u32 column, __m256 a, __m256 b, __m256 c, __m256 d)
+{
+    store_column(world, column,
+                 _mm256_castps256_ps128(a), _mm256_castps256_ps128(b),
+                 _mm256_castps256_ps128(c), _mm256_castps256_ps128(d));
+    store_column(world + 4, column,
+                 _mm256_extractf128_ps(a, 1), _mm256_extractf128_ps(b, 1),
+                 _mm256_extractf128_ps(c, 1), _mm256_extractf128_ps(d, 1));
+}
+
+#define wide __m256
+#define wide_load _mm256_load_ps
+#define wide_set1 _mm256_set1_ps
+#define wide_zero _mm256_setzero_ps
+#define wide_add _mm256_add_ps
+#define wide_sub _mm256_sub_ps
+#define wide_mul _mm256_mul_ps
+#define WIDE_LANES 8
+
+#else
+
+#define wide __m128
+#define wide_load _mm_load_ps
+#define wide_set1 _mm_set1_ps
+#define wide_zero _mm_setzero_ps
+#define wide_add _mm_add_ps
+#define wide_sub _mm_sub_ps
+#define wide_mul _mm_mul_ps
+#define WIDE_LANES 4
+
+#endif
+
+// world = translate(p) * rotate(q) * scale(s) for WIDE_LANES entries
+local inline void
+build_matrices(TransformSystem *system, u32 first)
+{
+    wide x = wide_load(system->rotation_x + first);
+    wide y = wide_load(system->rotation_y + first);
+    wide z = wide_load(system->rotation_z + first);
+    wide w = wide_load(system->rotation_w + first);
+
+    wide one = wide_set1(1.0f);
+    wide two = wide_set1(2.0f);
+
+    wide xx = wide_mul(x, x), yy = wide_mul(y, y), zz = wide_mul(z, z);
+    wide xy = wide_mul(x, y), xz = wide_mul(x, z), yz = wide_mul(y, z);
+    wide wx = wide_mul(w, x), wy = wide_mul(w, y), wz = wide_mul(w, z);
+
+    wide sx = wide_load(system->scale_x + first);
+    wide sy = wide_load(system->scale_y + first);
+    wide sz = wide_load(system->scale_z + first);
+
+    // rotation matrix, rRC is row R column C
+    wide r00 = wide_mul(wide_sub(one, wide_mul(two, wide_add(yy, zz))), sx);
+    wide r10 = wide_mul(wide_mul(two, wide_add(xy, wz)), sx);
+    wide r20 = wide_mul(wide_mul(two, wide_sub(xz, wy)), sx);
+
+    wide r01 = wide_mul(wide_mul(two, wide_sub(xy, wz)), sy);
+    wide r11 = wide_mul(wide_sub(one, wide_mul(two, wide_add(xx, zz))), sy);
+    wide r21 = wide_mul(wide_mul(two, wide_add(yz, wx)), sy);
+
+    wide r02 = wide_mul(wide_mul(two, wide_add(xz, wy)), sz);
+    wide r12 = wide_mul(wide_mul(two, wide_sub(yz, wx)), sz);
+    wide r22 = wide_mul(wide_sub(one, wide_mul(two, wide_add(xx, yy))), sz);
+
+    wide zero = wide_zero();
+
+    glm::mat4 *world = system->world + first;
+    store_column(world, 0, r00, r10, r20, zero);
+    store_column(world, 1, r01, r11, r21, zero);
+    store_column(world, 2, r02, r12, r22, zero);
+    store_column(world, 3,
+                 wide_load(system->position_x + first),
+                 wide_load(system->position_y + first),
+                 wide_load(system->position_z + first),
+                 one);
+}
+
+local void
+update_range(TransformSystem *system, u32 first, u32 last)
+{
+    for (u32 batch = first; batch < last; batch += WIDE_LANES)
+    {
+        // clean batches are skipped with a single load of their flags
+        u8 *dirty = system->dirty + batch;
+#if WIDE_LANES == 8
+        u64 flags;
+#else
+        u32 flags;
+#endif
+        memcpy(&flags, dirty, sizeof(flags));
+        if (!flags) continue;
+
+        build_matrices(system, batch);
+        memset(dirty, 0, sizeof(flags));
+    }
+}
+
+void update_transforms(TransformSystem *system, bool threaded)
+{
+    PROFILE_SCOPE("update transforms");
+
+    u32 padded_count = (system->count + TRANSFORM_BATCH_SIZE - 1) / TRANSFORM_BATCH_SIZE * TRANSFORM_BATCH_SIZE;
+
+    if (!threaded || padded_count < TRANSFORM_PARALLEL_THRESHOLD)
+    {
+        update_range(system, 0, padded_count);
+        return;
+    }
+
+    u32 batch_count = padded_count / TRANSFORM_BATCH_SIZE;
+    parallel_for(batch_count, TRANSFORM_JOB_BATCHES, [system](u32 begin, u32 end, u32) {
+        update_range(system, begin * TRANSFORM_BATCH_SIZE, end * TRANSFORM_BATCH_SIZE);
+    });
+}
+
+void update_transforms_scalar(TransformSystem *system)
+{
+    for (u32 i = 0; i < system->count; ++i)
+    {
+        if (!system->dirty[i]) continue;
+
+        glm::quat rotation(system->rotation_w[i], system->rotation_x[i], system->rotation_y[i], system->rotation_z[i]);
+
+        glm::mat4 world = glm::translate(glm::mat4(1.0f),
+                                         glm::vec3(system->position_x[i], system->position_y[i], system->position_z[i]));
+        world = world * glm::mat4_cast(rotation);
+        world = glm::scale(world, glm::vec3(system->scale_x[i], system->scale_y[i], system->scale_z[i]));
+
+        system->world[i] = world;
+        system->dirty[i] = 0;
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "types.h"
+
+// Position/rotation/scale of many objects stored as structure of arrays so
+// the world matrices can be built 4 (SSE) or 8 (AVX) at a time.
+// Only entries flagged dirty are recomputed, static objects cost nothing
+// besides skipping their dirty flags.
+//
+// Arrays are padded to a multiple of TRANSFORM_BATCH_SIZE so a batch never
+// reads past the end.
+
+#define TRANSFORM_BATCH_SIZE 8
+
+struct TransformSystem
+{
+    u32 count;
+    u32 capacity;
+
+    float *position_x;
+    float *position_y;
+    float *position_z;
+
+    // unit quaternion
+    float *rotation_x;
+    float *rotation_y;
+    float *rotation_z;
+    float *rotation_w;
+
+    float *scale_x;
+    float *scale_y;
+    float *scale_z;
+
+    u8 *dirty;
+
+    glm::mat4 *world;
+};
+
+void init(TransformSystem *system, u32 capacity);
+
+void destroy(TransformSystem *system);
+
+u32 add_transform(TransformSystem *system, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale);
+
+void set_position(TransformSystem *system, u32 id, const glm::vec3 &position);
+void set_rotation(TransformSystem *system, u32 id, const glm::quat &rotation);
+void set_scale(TransformSystem *system, u32 id, const glm::vec3 &scale);
+
+// recomputes the world matrix of every dirty entry, when threaded big
+// systems are split across the job pool
+void update_transforms(TransformSystem *system, bool threaded);
+
+// same result, one entry at a time, kept as reference for the benchmark
+void update_transforms_scalar(TransformSystem *system);
@@ -11,4 +11,6 @@ typedef signed int s32;
 typedef signed long long int s64;
 
 #define local static
-#define global
\ No newline at end of file
+#define global
+
+#define ArrayCount(a) (sizeof(a) / sizeof(a[0]))
@@ -0,0 +1,638 @@
+#include <glad\glad.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "upload.h"
+#include "image.h"
+#include "profile.h"
+#include "file.h"
+#include "log.h"
+
+// keeps every piece 16 byte aligned inside its PBO
+#define UPLOAD_PIECE_ALIGNMENT 16
+
+UploadOptions default_upload_options()
+{
+    UploadOptions options;
+    options.pbo_count = 8;
+    options.pbo_size = 4 * 1024 * 1024;
+    options.bytes_per_frame = 8 * 1024 * 1024;
+    options.decode_threads = 2;
+    return options;
+}
+
+local inline u64
+row_size(const UploadImage *image, u32 level)
+{
+    if (image->block_size) return (u64)((image->level_width[level] + 3) / 4) * image->block_size;
+    return (u64)image->level_width[level] * image->channels;
+}
+
+local inline s32
+row_count(const UploadImage *image, u32 level)
+{
+    if (image->block_size) return (image->level_height[level] + 3) / 4;
+    return image->level_height[level];
+}
+
+// 2x2 box filter, the last row/column is repeated for odd sizes
+local void
+downsample(const u8 *source, s32 source_width, s32 source_height,
+           u8 *destination, s32 width, s32 height, s32 channels)
+{
+    for (s32 y = 0; y < height; ++y)
+    {
+        const u8 *row0 = source + (u64)glm::min(y * 2, source_height - 1) * source_width * channels;
+        const u8 *row1 = source + (u64)glm::min(y * 2 + 1, source_height - 1) * source_width * channels;
+
+        for (s32 x = 0; x < width; ++x)
+        {
+            s32 x0 = glm::min(x * 2, source_width - 1) * channels;
+            s32 x1 = glm::min(x * 2 + 1, source_width - 1) * channels;
+
+            for (s32 c = 0; c < channels; ++c)
+            {
+                u32 sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                destination[((u64)y * width + x) * channels + c] = (u8)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+local void
+read_baked_image(TextureUploader *uploader, UploadImage *image)
+{
+    TextureFile file;
+    if (load_texture_file(&file, image->filename.c_str()) != 0)
+    {
+        image->error = "not a valid baked texture";
+        return;
+    }
+
+    TextureFormat format = (TextureFormat)file.header.format;
+    image->width = file.header.width;
+    image->height = file.header.height;
+    image->channels = 4;
+    image->gl_format = gl_texture_format(format);
+    image->block_size = texture_block_size(format);
+
+    for (const TextureFileLevel &level : file.levels)
+    {
+        image->level_offset.push_back(level.offset);
+        image->level_width.push_back(level.width);
+        image->level_height.push_back(level.height);
+    }
+
+    if (row_size(image, 0) > uploader->options.pbo_size)
+    {
+        image->error = "rows are larger than a PBO";
+        destroy(&file);
+        return;
+    }
+
+    // the level offsets point into the file, keep it whole
+    image->pixels = file.data;
+    file.data = nullptr;
+    destroy(&file);
+
+    image->next_level = (u32)image->level_offset.size() - 1;
+    image->next_row = 0;
+}
+
+local void
+decode_image(TextureUploader *uploader, UploadImage *image)
+{
+    PROFILE_SCOPE("decode texture");
+
+    if (has_extension(image->filename.c_str(), ".tex"))
+    {
+        read_baked_image(uploader, image);
+        return;
+    }
+
+    Image decoded;
+    if (load_image(&decoded, image->filename.c_str(), 0) != 0)
+    {
+        image->error = image_failure_reason();
+        return;
+    }
+
+    s32 width = decoded.width;
+    s32 height = decoded.height;
+    s32 channels = decoded.channels;
+
+    if ((u64)width * channels > uploader->options.pbo_size)
+    {
+        image->error = "rows are larger than a PBO";
+        destroy(&decoded);
+        return;
+    }
+
+    image->width = width;
+    image->height = height;
+    image->channels = channels;
+    image->gl_format = gl_image_format(channels);
+    image->block_size = 0;
+
+    u64 size = 0;
+    s32 level_width = width;
+    s32 level_height = height;
+    for (;;)
+    {
+        image->level_offset.push_back(size);
+        image->level_width.push_back(level_width);
+        image->level_height.push_back(level_height);
+        size += (u64)level_width * level_height * channels;
+
+        if (level_width == 1 && level_height == 1) break;
+        level_width = glm::max(level_width / 2, 1);
+        level_height = glm::max(level_height / 2, 1);
+    }
+
+    image->pixels = (u8 *)malloc(size);
+    if (!image->pixels)
+    {
+        image->error = "out of memory";
+        destroy(&decoded);
+        return;
+    }
+
+    memcpy(image->pixels, decoded.pixels, (u64)width * height * channels);
+    destroy(&decoded);
+
+    for (u32 level = 1; level < image->level_offset.size(); ++level)
+    {
+        downsample(image->pixels + image->level_offset[level - 1],
+                   image->level_width[level - 1], image->level_height[level - 1],
+                   image->pixels + image->level_offset[level],
+                   image->level_width[level], image->level_height[level], channels);
+    }
+
+    image->next_level = (u32)image->level_offset.size() - 1;
+    image->next_row = 0;
+}
+
+local void
+copy_pieces(UploadPbo *pbo)
+{
+    PROFILE_SCOPE("fill pbo");
+
+    for (const UploadPiece &piece : pbo->pieces)
+    {
+        const UploadImage *image = piece.image;
+        u64 row_bytes = row_size(image, piece.level);
+
+        memcpy(pbo->mapped + piece.offset,
+               image->pixels + image->level_offset[piece.level] + piece.first_row * row_bytes,
+               piece.row_count * row_bytes);
+    }
+}
+
+local void
+upload_thread_proc(TextureUploader *uploader, u32 index)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "texture upload %u", index);
+    set_profile_thread_name(name);
+
+    std::unique_lock<std::mutex> lock(uploader->mutex);
+
+    for (;;)
+    {
+        uploader->wake.wait(lock, [uploader] { return uploader->quit || !uploader->tasks.empty(); });
+
+        if (uploader->quit) break;
+
+        UploadTask task = uploader->tasks.front();
+        uploader->tasks.pop_front();
+
+        lock.unlock();
+
+        if (task.type == UPLOAD_TASK_DECODE)
+        {
+            decode_image(uploader, task.image);
+
+            lock.lock();
+            task.image->state = task.image->pixels ? UPLOAD_READY : UPLOAD_FAILED;
+        }
+        else
+        {
+            copy_pieces(&uploader->pbos[task.pbo]);
+
+            lock.lock();
+            uploader->pbos[task.pbo].state = PBO_FILLED;
+        }
+    }
+}
+
+void init(TextureUploader *uploader, const UploadOptions &options)
+{
+    uploader->options = options;
+    uploader->quit = false;
+    uploader->stats = {};
+
+    uploader->pbos.resize(options.pbo_count);
+    for (UploadPbo &pbo : uploader->pbos)
+    {
+        glGenBuffers(1, &pbo.ID);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo.ID);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, options.pbo_size, nullptr, GL_STREAM_DRAW);
+
+        pbo.state = PBO_FREE;
+        pbo.mapped = nullptr;
+        pbo.fence = nullptr;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    for (u32 i = 0; i < options.decode_threads; ++i)
+    {
+        uploader->threads.push_back(std::thread(upload_thread_proc, uploader, i));
+    }
+}
+
+void destroy(TextureUploader *uploader)
+{
+    {
+        std::lock_guard<std::mutex> lock(uploader->mutex);
+        uploader->quit = true;
+    }
+    uploader->wake.notify_all();
+
+    for (std::thread &thread : uploader->threads)
+    {
+        thread.join();
+    }
+    uploader->threads.clear();
+    uploader->tasks.clear();
+
+    for (UploadPbo &pbo : uploader->pbos)
+    {
+        if (pbo.mapped)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo.ID);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        if (pbo.fence)
+        {
+            glDeleteSync((GLsync)pbo.fence);
+        }
+        glDeleteBuffers(1, &pbo.ID);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    uploader->pbos.clear();
+    uploader->pbo_order.clear();
+
+    for (UploadImage *image : uploader->images)
+    {
+        free(image->pixels);
+        delete image;
+    }
+    uploader->images.clear();
+}
+
+local void
+queue_image(TextureUploader *uploader, Texture *texture)
+{
+    cancel_uploads(uploader, texture);
+
+    UploadImage *image = new UploadImage();
+    image->texture = texture;
+    image->texture_id = texture->ID;
+    image->filename = texture->filename;
+    image->state = UPLOAD_DECODING;
+    image->cancelled = false;
+    image->error = nullptr;
+    image->pixels = nullptr;
+    image->storage_allocated = false;
+    image->pieces_in_flight = 0;
+
+    uploader->images.push_back(image);
+
+    {
+        std::lock_guard<std::mutex> lock(uploader->mutex);
+        uploader->tasks.push_back(UploadTask{UPLOAD_TASK_DECODE, image, 0});
+    }
+    uploader->wake.notify_one();
+}
+
+void init(Texture *texture, const char *filename, TextureUploader *uploader)
+{
+    init_empty(texture, filename);
+    queue_image(uploader, texture);
+}
+
+void reload(Texture *texture, TextureUploader *uploader)
+{
+    queue_image(uploader, texture);
+}
+
+void cancel_uploads(TextureUploader *uploader, const Texture *texture)
+{
+    for (UploadImage *image : uploader->images)
+    {
+        if (image->texture == texture) image->cancelled = true;
+    }
+}
+
+// all levels at once when the coarsest one is about to arrive, so a reload
+// keeps showing the old image until then
+local void
+allocate_storage(UploadImage *image)
+{
+    u32 level_count = (u32)image->level_offset.size();
+
+    // a bound unpack buffer would turn the null pointers into offsets
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, image->texture_id);
+
+    for (u32 level = 0; level < level_count; ++level)
+    {
+        if (image->block_size)
+        {
+            u64 size = (u64)row_count(image, level) * row_size(image, level);
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, image->gl_format, image->level_width[level],
+                                   image->level_height[level], 0, (GLsizei)size, nullptr);
+        }
+        else
+        {
+            glTexImage2D(GL_TEXTURE_2D, level, image->gl_format, image->level_width[level], image->level_height[level],
+                         0, image->gl_format, GL_UNSIGNED_BYTE, nullptr);
+        }
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level_count - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level_count - 1);
+    set_image_swizzle(image->channels);
+
+    image->texture->width = image->width;
+    image->texture->height = image->height;
+    image->texture->size = 0;
+    for (u32 level = 0; level < level_count; ++level)
+    {
+        image->texture->size += (u64)row_count(image, level) * row_size(image, level);
+    }
+    image->storage_allocated = true;
+}
+
+local PboState
+pbo_state(TextureUploader *uploader, const UploadPbo *pbo)
+{
+    std::lock_guard<std::mutex> lock(uploader->mutex);
+    return pbo->state;
+}
+
+local void
+finish_pbo(TextureUploader *uploader, UploadPbo *pbo)
+{
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo->ID);
+    if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_FALSE)
+    {
+        LOG_W("PBO contents were lost, some texture rows may be wrong");
+    }
+    pbo->mapped = nullptr;
+
+    for (const UploadPiece &piece : pbo->pieces)
+    {
+        UploadImage *image = piece.image;
+        image->pieces_in_flight -= 1;
+
+        if (image->cancelled) continue;
+
+        if (!image->storage_allocated)
+        {
+            allocate_storage(image);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo->ID);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, image->texture_id);
+        const void *offset = (const void *)(uintptr_t)piece.offset;
+        if (image->block_size)
+        {
+            // the last block row may be cut by the bottom of the level
+            s32 y = piece.first_row * 4;
+            s32 height = glm::min(piece.row_count * 4, image->level_height[piece.level] - y);
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, piece.level, 0, y, image->level_width[piece.level], height,
+                                      image->gl_format, (GLsizei)(piece.row_count * row_size(image, piece.level)),
+                                      offset);
+        }
+        else
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, piece.level, 0, piece.first_row,
+                            image->level_width[piece.level], piece.row_count,
+                            image->gl_format, GL_UNSIGNED_BYTE, offset);
+        }
+
+        // pieces are issued in order, the level is complete in the command stream
+        if (piece.first_row + piece.row_count == row_count(image, piece.level))
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, piece.level);
+        }
+
+        uploader->stats.bytes_uploaded += piece.row_count * row_size(image, piece.level);
+    }
+
+    pbo->pieces.clear();
+    pbo->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    std::lock_guard<std::mutex> lock(uploader->mutex);
+    pbo->state = PBO_IN_FLIGHT;
+}
+
+// the ready image with the coarsest pending level, so every texture gets
+// its small levels before any gets its big ones
+local UploadImage *
+next_image(TextureUploader *uploader)
+{
+    UploadImage *best = nullptr;
+
+    std::lock_guard<std::mutex> lock(uploader->mutex);
+    for (UploadImage *image : uploader->images)
+    {
+        if (image->cancelled || image->state != UPLOAD_READY) continue;
+        if (!best || image->next_level > best->next_level) best = image;
+    }
+
+    return best;
+}
+
+// takes rows from the ready images until the PBO or the budget is full,
+// returns the bytes used
+local u32
+plan_pieces(TextureUploader *uploader, UploadPbo *pbo, u64 budget)
+{
+    u32 used = 0;
+    u64 planned = 0;
+
+    while (planned < budget)
+    {
+        UploadImage *image = next_image(uploader);
+        if (!image) break;
+
+        u64 row_bytes = row_size(image, image->next_level);
+        u32 offset = (used + UPLOAD_PIECE_ALIGNMENT - 1) & ~(UPLOAD_PIECE_ALIGNMENT - 1);
+        if (offset >= uploader->options.pbo_size) break;
+
+        // may go over the budget by less than a row, so a row is never split
+        s64 rows_left = row_count(image, image->next_level) - image->next_row;
+        s64 rows_fit = (uploader->options.pbo_size - offset) / row_bytes;
+        s64 rows_budget = (budget - planned + row_bytes - 1) / row_bytes;
+        s32 rows = (s32)glm::min(rows_left, glm::min(rows_fit, rows_budget));
+        if (rows == 0) break;
+
+        pbo->pieces.push_back(UploadPiece{image, image->next_level, image->next_row, rows, offset});
+        image->pieces_in_flight += 1;
+
+        used = offset + (u32)(rows * row_bytes);
+        planned += rows * row_bytes;
+
+        image->next_row += rows;
+        if (image->next_row == row_count(image, image->next_level))
+        {
+            image->next_row = 0;
+            if (image->next_level == 0)
+            {
+                image->state = UPLOAD_SCHEDULED;
+            }
+            else
+            {
+                image->next_level -= 1;
+            }
+        }
+    }
+
+    return used;
+}
+
+local bool
+retire_image(UploadImage *image)
+{
+    if (image->pieces_in_flight > 0) return false;
+
+    if (image->state == UPLOAD_FAILED)
+    {
+        if (!image->cancelled)
+        {
+            LOG_W("Cannot load texture '%s': %s", image->filename.c_str(), image->error);
+        }
+        return true;
+    }
+
+    if (image->cancelled) return image->state != UPLOAD_DECODING;
+
+    if (image->state == UPLOAD_SCHEDULED)
+    {
+        LOG_I("Streamed texture '%s' (%dx%d, %u levels)", image->filename.c_str(),
+              image->width, image->height, (u32)image->level_offset.size());
+        return true;
+    }
+
+    return false;
+}
+
+void update(TextureUploader *uploader)
+{
+    PROFILE_SCOPE("texture uploads");
+
+    uploader->stats.bytes_started = 0;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // in the order they were started, a later PBO may hold finer levels
+    while (!uploader->pbo_order.empty())
+    {
+        UploadPbo *pbo = &uploader->pbos[uploader->pbo_order.front()];
+        if (pbo_state(uploader, pbo) != PBO_FILLED) break;
+
+        uploader->pbo_order.pop_front();
+        finish_pbo(uploader, pbo);
+    }
+
+    for (UploadPbo &pbo : uploader->pbos)
+    {
+        if (pbo_state(uploader, &pbo) != PBO_IN_FLIGHT) continue;
+
+        GLenum result = glClientWaitSync((GLsync)pbo.fence, 0, 0);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+        {
+            glDeleteSync((GLsync)pbo.fence);
+            pbo.fence = nullptr;
+
+            std::lock_guard<std::mutex> lock(uploader->mutex);
+            pbo.state = PBO_FREE;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(uploader->mutex);
+
+        u32 kept = 0;
+        for (UploadImage *image : uploader->images)
+        {
+            if (retire_image(image))
+            {
+                free(image->pixels);
+                delete image;
+            }
+            else
+            {
+                uploader->images[kept++] = image;
+            }
+        }
+        uploader->images.resize(kept);
+    }
+
+    for (u32 index = 0; index < uploader->pbos.size(); ++index)
+    {
+        u64 budget = uploader->options.bytes_per_frame;
+        if (uploader->stats.bytes_started >= budget || !next_image(uploader)) break;
+
+        UploadPbo *pbo = &uploader->pbos[index];
+        if (pbo_state(uploader, pbo) != PBO_FREE) continue;
+
+        // the fence guarantees the GPU is done with it, no need to sync
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo->ID);
+        pbo->mapped = (u8 *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, uploader->options.pbo_size,
+                                             GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT |
+                                             GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!pbo->mapped)
+        {
+            LOG_W("Cannot map a texture upload PBO");
+            break;
+        }
+
+        u32 used = plan_pieces(uploader, pbo, budget - uploader->stats.bytes_started);
+        uploader->stats.bytes_started += used;
+
+        {
+            std::lock_guard<std::mutex> lock(uploader->mutex);
+            pbo->state = PBO_FILLING;
+            // copies first, they hold up PBOs and the decodes can wait
+            uploader->tasks.push_front(UploadTask{UPLOAD_TASK_COPY, nullptr, index});
+        }
+        uploader->wake.notify_one();
+
+        uploader->pbo_order.push_back(index);
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    uploader->stats.pending_textures = (u32)uploader->images.size();
+    uploader->stats.pbos_in_use = 0;
+    for (const UploadPbo &pbo : uploader->pbos)
+    {
+        if (pbo_state(uploader, &pbo) != PBO_FREE) uploader->stats.pbos_in_use += 1;
+    }
+}
+
+bool uploads_pending(const TextureUploader *uploader)
+{
+    return !uploader->images.empty();
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "types.h"
+#include "texture.h"
+
+// Asynchronous texture uploads through a pool of pixel buffer objects.
+//
+// init()/reload() with an uploader return right away: a decode thread loads
+// the image and builds its mip chain, or reads a baked .tex file as is.
+// Once per frame update() on the GL thread maps free PBOs and hands them to
+// the decode threads to fill; the frame after, the filled ones are unmapped
+// and glTexSubImage2D reads from them. At most bytes_per_frame are started
+// per frame.
+//
+// Levels go coarsest first and GL_TEXTURE_BASE_LEVEL follows the finest
+// level that arrived, so a texture is usable after one frame and sharpens
+// over the next ones. On reload the old image stays until the coarsest level
+// of the new one is there, a file that fails to decode leaves it untouched.
+//
+// A PBO is reused once the fence behind its copies signaled, so the driver
+// never has to wait for, or copy aside, a buffer the GPU still reads.
+
+struct UploadOptions
+{
+    u32 pbo_count;
+    u32 pbo_size;
+    u64 bytes_per_frame;
+    u32 decode_threads;
+};
+
+UploadOptions default_upload_options();
+
+enum UploadState
+{
+    UPLOAD_DECODING,
+    UPLOAD_READY,     // mip chain built, levels being uploaded
+    UPLOAD_SCHEDULED, // every row is in a PBO, waiting for the last ones
+    UPLOAD_FAILED,
+};
+
+// one image on its way into a texture
+struct UploadImage
+{
+    Texture *texture;
+    u32 texture_id;
+    std::string filename;
+    UploadState state;
+    bool cancelled; // superseded by a newer reload of the same texture
+    const char *error;
+
+    // all levels, finest first, rows bottom up as GL wants them; for block
+    // compressed files a row is a row of 4x4 blocks
+    u8 *pixels;
+    s32 width;
+    s32 height;
+    s32 channels;
+    u32 gl_format;
+    u32 block_size; // 0 when not compressed
+    std::vector<u64> level_offset;
+    std::vector<s32> level_width;
+    std::vector<s32> level_height;
+
+    // next rows to put in a PBO, the level counts down to 0
+    u32 next_level;
+    s32 next_row;
+
+    bool storage_allocated;
+    u32 pieces_in_flight;
+};
+
+// rows [first_row, first_row + row_count) of a level at offset in a PBO
+struct UploadPiece
+{
+    UploadImage *image;
+    u32 level;
+    s32 first_row;
+    s32 row_count;
+    u32 offset;
+};
+
+enum PboState
+{
+    PBO_FREE,
+    PBO_FILLING, // mapped, a decode thread copies the pieces in
+    PBO_FILLED,  // copies done, waiting for the GL thread to unmap
+    PBO_IN_FLIGHT,
+};
+
+struct UploadPbo
+{
+    u32 ID;
+    PboState state;
+    u8 *mapped;
+    void *fence; // GLsync
+    std::vector<UploadPiece> pieces;
+};
+
+enum UploadTaskType
+{
+    UPLOAD_TASK_DECODE,
+    UPLOAD_TASK_COPY,
+};
+
+struct UploadTask
+{
+    UploadTaskType type;
+    UploadImage *image;
+    u32 pbo;
+};
+
+struct UploadStats
+{
+    u32 pending_textures;
+    u32 pbos_in_use;
+    u64 bytes_started;  // this frame
+    u64 bytes_uploaded; // since init
+};
+
+struct TextureUploader
+{
+    UploadOptions options;
+
+    std::vector<UploadPbo> pbos;
+    std::deque<u32> pbo_order; // PBOs being filled, in the order they were started
+
+    // in queue order, owned by the uploader
+    std::vector<UploadImage *> images;
+
+    // shared with the decode threads: tasks, UploadImage::state and
+    // UploadPbo::state of PBOs being filled
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<UploadTask> tasks;
+    bool quit;
+
+    UploadStats stats;
+};
+
+// needs a current GL context
+void init(TextureUploader *uploader, const UploadOptions &options);
+
+// waits for the decode threads, pending uploads are dropped
+void destroy(TextureUploader *uploader);
+
+// creates the texture object and queues the file, the texture samples black
+// until its first level arrived; it has to outlive the uploader
+void init(Texture *texture, const char *filename, TextureUploader *uploader);
+
+// queues the file again, replaces any upload of this texture still going on
+void reload(Texture *texture, TextureUploader *uploader);
+
+// drops what is still on its way into texture, call before destroying it
+void cancel_uploads(TextureUploader *uploader, const Texture *texture);
+
+// finishes filled PBOs, recycles the ones the GPU is done with and starts
+// new copies within the budget, once per frame on the GL thread
+void update(TextureUploader *uploader);
+
+bool uploads_pending(const TextureUploader *uploader);
@@ -0,0 +1,617 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "vtex.h"
+#include "image.h"
+#include "texbake.h"
+#include "profile.h"
+#include "log.h"
+
+VirtualTextureBakeOptions default_virtual_texture_bake_options()
+{
+    VirtualTextureBakeOptions options;
+    options.srgb = true;
+    return options;
+}
+
+VirtualTextureOptions default_virtual_texture_options()
+{
+    VirtualTextureOptions options;
+    options.slots_x = 16;
+    options.slots_y = 16;
+    options.max_uploads_per_frame = 8;
+    options.max_requests = 64;
+    return options;
+}
+
+local inline u32
+pages_for(u32 texels)
+{
+    return (texels + VT_PAGE_SIZE - 1) / VT_PAGE_SIZE;
+}
+
+local inline u32
+next_power_of_two(u32 value)
+{
+    u32 result = 1;
+    while (result < value) result <<= 1;
+    return result;
+}
+
+// sizes follow build_mip_chain, halving down to the first level in one page
+local void
+compute_levels(u32 width, u32 height, std::vector<VirtualTextureLevel> *levels)
+{
+    levels->clear();
+
+    u32 indirection_width = next_power_of_two(pages_for(width));
+    u32 indirection_height = next_power_of_two(pages_for(height));
+    u32 first_page = 0;
+
+    for (;;)
+    {
+        VirtualTextureLevel level;
+        level.width = width;
+        level.height = height;
+        level.pages_x = pages_for(width);
+        level.pages_y = pages_for(height);
+        level.first_page = first_page;
+        level.indirection_width = indirection_width;
+        level.indirection_height = indirection_height;
+        levels->push_back(level);
+
+        if (level.pages_x == 1 && level.pages_y == 1) break;
+
+        first_page += level.pages_x * level.pages_y;
+        width = glm::max(width / 2, 1u);
+        height = glm::max(height / 2, 1u);
+        indirection_width = glm::max(indirection_width / 2, 1u);
+        indirection_height = glm::max(indirection_height / 2, 1u);
+    }
+}
+
+// the page with its border, texels past the edge of the level repeat the edge
+local void
+copy_page(const TextureLevel *level, u32 page_x, u32 page_y, u8 *page)
+{
+    s32 origin_x = (s32)(page_x * VT_PAGE_SIZE) - VT_PAGE_BORDER;
+    s32 origin_y = (s32)(page_y * VT_PAGE_SIZE) - VT_PAGE_BORDER;
+
+    for (s32 y = 0; y < VT_PAGE_STRIDE; ++y)
+    {
+        s32 source_y = glm::clamp(origin_y + y, 0, (s32)level->height - 1);
+        const u8 *row = level->pixels.data() + (u64)source_y * level->width * 4;
+        u8 *out = page + (u64)y * VT_PAGE_STRIDE * 4;
+
+        for (s32 x = 0; x < VT_PAGE_STRIDE; ++x)
+        {
+            s32 source_x = glm::clamp(origin_x + x, 0, (s32)level->width - 1);
+            memcpy(out + x * 4, row + source_x * 4, 4);
+        }
+    }
+}
+
+s32 bake_virtual_texture(const char *image_filename, const char *filename, const VirtualTextureBakeOptions &options)
+{
+    Image image;
+    if (load_image(&image, image_filename, 4) != 0)
+    {
+        LOG_E("Cannot load '%s': %s", image_filename, image_failure_reason());
+        return -1;
+    }
+
+    s32 result = bake_virtual_texture(image.pixels, image.width, image.height, filename, options);
+    destroy(&image);
+
+    return result;
+}
+
+s32 bake_virtual_texture(const u8 *rgba, u32 width, u32 height, const char *filename, const VirtualTextureBakeOptions &options)
+{
+    PROFILE_SCOPE("bake virtual texture");
+
+    if (pages_for(width) > VT_MAX_PAGES_PER_SIDE || pages_for(height) > VT_MAX_PAGES_PER_SIDE)
+    {
+        LOG_E("Image is %ux%u, virtual textures go up to %u texels per side",
+              width, height, VT_MAX_PAGES_PER_SIDE * VT_PAGE_SIZE);
+        return -1;
+    }
+
+    std::vector<TextureLevel> mips;
+    build_mip_chain(rgba, width, height, options.srgb, &mips);
+
+    std::vector<VirtualTextureLevel> levels;
+    compute_levels(width, height, &levels);
+
+    FILE *file = fopen(filename, "wb");
+    if (!file)
+    {
+        LOG_E("Cannot open '%s' for writing", filename);
+        return -1;
+    }
+
+    const VirtualTextureLevel &last = levels.back();
+
+    VirtualTextureFileHeader header = {};
+    header.magic = VT_FILE_MAGIC;
+    header.version = VT_FILE_VERSION;
+    header.width = width;
+    header.height = height;
+    header.level_count = (u32)levels.size();
+    header.page_count = last.first_page + last.pages_x * last.pages_y;
+    header.page_data_offset = sizeof(VirtualTextureFileHeader);
+
+    fwrite(&header, sizeof(header), 1, file);
+
+    std::vector<u8> page(VT_PAGE_BYTES);
+    for (u32 i = 0; i < (u32)levels.size(); ++i)
+    {
+        for (u32 y = 0; y < levels[i].pages_y; ++y)
+        {
+            for (u32 x = 0; x < levels[i].pages_x; ++x)
+            {
+                copy_page(&mips[i], x, y, page.data());
+                fwrite(page.data(), 1, page.size(), file);
+            }
+        }
+    }
+
+    bool write_error = ferror(file) != 0;
+    fclose(file);
+
+    if (write_error)
+    {
+        LOG_E("Error writing '%s'", filename);
+        return -1;
+    }
+
+    LOG_I("Baked '%s': %ux%u, %u levels, %u pages, %.2f MB", filename, width, height,
+          header.level_count, header.page_count,
+          (header.page_data_offset + (u64)header.page_count * VT_PAGE_BYTES) / (1024.0 * 1024.0));
+
+    return 0;
+}
+
+local void
+io_thread_proc(VirtualTexture *vt)
+{
+    set_profile_thread_name("vt io");
+
+    std::unique_lock<std::mutex> lock(vt->mutex);
+
+    for (;;)
+    {
+        vt->wake.wait(lock, [vt] { return vt->quit || !vt->requests.empty(); });
+
+        if (vt->quit) break;
+
+        u32 page = vt->requests.back();
+        vt->requests.pop_back();
+
+        lock.unlock();
+
+        // the copy is where the mapped pages are read from disk, so the
+        // GL thread never waits on a page fault
+        u8 *pixels = (u8 *)malloc(VT_PAGE_BYTES);
+        if (pixels)
+        {
+            memcpy(pixels, vt->file.data + vt->header.page_data_offset + (u64)page * VT_PAGE_BYTES, VT_PAGE_BYTES);
+        }
+
+        lock.lock();
+        vt->completed.push_back(VirtualPageLoad{page, pixels});
+        if (pixels) vt->bytes_read += VT_PAGE_BYTES;
+    }
+}
+
+local inline u32
+parent_page(const VirtualTexture *vt, u32 level, u32 x, u32 y)
+{
+    const VirtualTextureLevel &parent = vt->levels[level + 1];
+    return page_index(vt, level + 1, glm::min(x / 2, parent.pages_x - 1), glm::min(y / 2, parent.pages_y - 1));
+}
+
+local void
+place_page(VirtualTexture *vt, u32 page, u32 slot, u8 *pixels)
+{
+    vt->pages[page].slot = slot;
+    vt->slot_page[slot] = page;
+    vt->uploads.push_back(VirtualPageUpload{slot, pixels});
+    vt->indirection_dirty = true;
+}
+
+// coarse to fine, a page without a slot inherits its parent's entry
+local void
+build_indirection(VirtualTexture *vt)
+{
+    PROFILE_SCOPE("vt indirection");
+
+    u32 last = (u32)vt->levels.size() - 1;
+    for (u32 level = last + 1; level-- > 0;)
+    {
+        const VirtualTextureLevel &info = vt->levels[level];
+        std::vector<u8> &entries = vt->indirection[level];
+
+        for (u32 y = 0; y < info.pages_y; ++y)
+        {
+            for (u32 x = 0; x < info.pages_x; ++x)
+            {
+                u8 *entry = entries.data() + ((u64)y * info.indirection_width + x) * 4;
+                u32 slot = vt->pages[page_index(vt, level, x, y)].slot;
+
+                if (slot != VT_NO_SLOT)
+                {
+                    entry[0] = (u8)(slot % vt->options.slots_x);
+                    entry[1] = (u8)(slot / vt->options.slots_x);
+                    entry[2] = (u8)level;
+                    entry[3] = 255;
+                }
+                else
+                {
+                    const VirtualTextureLevel &parent = vt->levels[level + 1];
+                    u32 parent_x = glm::min(x / 2, parent.pages_x - 1);
+                    u32 parent_y = glm::min(y / 2, parent.pages_y - 1);
+                    memcpy(entry, vt->indirection[level + 1].data() + ((u64)parent_y * parent.indirection_width + parent_x) * 4, 4);
+                }
+            }
+        }
+    }
+
+    vt->indirection_dirty = true;
+}
+
+s32 init(VirtualTexture *vt, const char *filename, const VirtualTextureOptions &options)
+{
+    if (map_file(&vt->file, filename) != 0)
+    {
+        LOG_E("Cannot open '%s' for reading", filename);
+        return -1;
+    }
+
+    VirtualTextureFileHeader *header = &vt->header;
+    if (vt->file.size >= sizeof(VirtualTextureFileHeader))
+    {
+        memcpy(header, vt->file.data, sizeof(VirtualTextureFileHeader));
+    }
+
+    bool valid = vt->file.size >= sizeof(VirtualTextureFileHeader) &&
+        header->magic == VT_FILE_MAGIC &&
+        header->version == VT_FILE_VERSION &&
+        header->width > 0 && header->height > 0 &&
+        pages_for(header->width) <= VT_MAX_PAGES_PER_SIDE &&
+        pages_for(header->height) <= VT_MAX_PAGES_PER_SIDE;
+
+    if (valid)
+    {
+        compute_levels(header->width, header->height, &vt->levels);
+        const VirtualTextureLevel &last = vt->levels.back();
+
+        valid = header->level_count == (u32)vt->levels.size() &&
+            header->level_count <= VT_MAX_LEVELS &&
+            header->page_count == last.first_page + last.pages_x * last.pages_y &&
+            header->page_data_offset + (u64)header->page_count * VT_PAGE_BYTES <= vt->file.size;
+    }
+
+    // the coarsest level stays in the atlas, nothing else is guaranteed to fit
+    u32 slot_count = options.slots_x * options.slots_y;
+    if (valid && (options.slots_x > 256 || options.slots_y > 256 || slot_count < 2))
+    {
+        LOG_E("Virtual texture atlas of %ux%u slots is not supported", options.slots_x, options.slots_y);
+        unmap_file(&vt->file);
+        return -1;
+    }
+
+    if (!valid)
+    {
+        LOG_E("'%s' is not a valid virtual texture file", filename);
+        unmap_file(&vt->file);
+        return -1;
+    }
+
+    vt->options = options;
+    vt->pages.assign(header->page_count, VirtualPage{VT_NO_SLOT, 0, 0, false});
+    vt->slot_page.assign(slot_count, VT_NO_SLOT);
+    vt->slot_pinned.assign(slot_count, false);
+    vt->requests.clear();
+    vt->completed.clear();
+    vt->arrived.clear();
+    vt->seen.clear();
+    vt->uploads.clear();
+    vt->bytes_read = 0;
+    vt->quit = false;
+    vt->frame = 0;
+    vt->stats = {};
+
+    vt->indirection.resize(vt->levels.size());
+    for (u32 level = 0; level < (u32)vt->levels.size(); ++level)
+    {
+        const VirtualTextureLevel &info = vt->levels[level];
+        vt->indirection[level].assign((u64)info.indirection_width * info.indirection_height * 4, 0);
+    }
+
+    u32 root = page_index(vt, header->level_count - 1, 0, 0);
+    u8 *pixels = (u8 *)malloc(VT_PAGE_BYTES);
+    memcpy(pixels, vt->file.data + header->page_data_offset + (u64)root * VT_PAGE_BYTES, VT_PAGE_BYTES);
+    place_page(vt, root, 0, pixels);
+    vt->slot_pinned[0] = true;
+
+    build_indirection(vt);
+
+    vt->io_thread = std::thread(io_thread_proc, vt);
+
+    return 0;
+}
+
+void destroy(VirtualTexture *vt)
+{
+    {
+        std::lock_guard<std::mutex> lock(vt->mutex);
+        vt->quit = true;
+    }
+    vt->wake.notify_one();
+
+    if (vt->io_thread.joinable())
+    {
+        vt->io_thread.join();
+    }
+
+    for (const VirtualPageLoad &load : vt->completed) free(load.pixels);
+    for (const VirtualPageLoad &load : vt->arrived) free(load.pixels);
+    vt->completed.clear();
+    vt->arrived.clear();
+    vt->requests.clear();
+    finish_uploads(vt);
+
+    unmap_file(&vt->file);
+
+    vt->pages.clear();
+    vt->slot_page.clear();
+    vt->slot_pinned.clear();
+    vt->indirection.clear();
+    vt->levels.clear();
+}
+
+u32 page_index(const VirtualTexture *vt, u32 level, u32 x, u32 y)
+{
+    const VirtualTextureLevel &info = vt->levels[level];
+    return info.first_page + y * info.pages_x + x;
+}
+
+local inline u32
+page_level(const VirtualTexture *vt, u32 page)
+{
+    u32 level = 0;
+    while (level + 1 < (u32)vt->levels.size() && page >= vt->levels[level + 1].first_page) ++level;
+    return level;
+}
+
+local inline void
+see_page(VirtualTexture *vt, u32 page)
+{
+    VirtualPage *info = &vt->pages[page];
+    if (info->last_seen_frame != vt->frame)
+    {
+        info->last_seen_frame = vt->frame;
+        info->feedback_count = 0;
+        vt->seen.push_back(page);
+    }
+}
+
+void process_feedback(VirtualTexture *vt, const u32 *pixels, u32 pixel_count)
+{
+    PROFILE_SCOPE("vt feedback");
+
+    vt->frame += 1;
+    vt->seen.clear();
+
+    u32 level_count = (u32)vt->levels.size();
+    u32 previous = 0;
+    u32 previous_page = 0;
+
+    for (u32 i = 0; i < pixel_count; ++i)
+    {
+        u32 texel = pixels[i];
+        if ((texel >> 24) == 0) continue;
+
+        // neighbouring pixels mostly ask for the same page
+        if (texel == previous)
+        {
+            vt->pages[previous_page].feedback_count += 1;
+            continue;
+        }
+
+        u32 x = texel & 0xFF;
+        u32 y = (texel >> 8) & 0xFF;
+        u32 level = (texel >> 16) & 0xFF;
+        if (level >= level_count) continue;
+
+        const VirtualTextureLevel &info = vt->levels[level];
+        if (x >= info.pages_x || y >= info.pages_y) continue;
+
+        u32 page = page_index(vt, level, x, y);
+        see_page(vt, page);
+        vt->pages[page].feedback_count += 1;
+
+        previous = texel;
+        previous_page = page;
+    }
+
+    u32 directly_seen = (u32)vt->seen.size();
+
+    // ancestors are what a page falls back to while it loads, they are needed
+    // too; appended pages get their own parent when the loop reaches them
+    for (u32 i = 0; i < (u32)vt->seen.size(); ++i)
+    {
+        u32 page = vt->seen[i];
+        u32 level = page_level(vt, page);
+        if (level + 1 >= level_count) continue;
+
+        const VirtualTextureLevel &info = vt->levels[level];
+        u32 local_index = page - info.first_page;
+        see_page(vt, parent_page(vt, level, local_index % info.pages_x, local_index / info.pages_x));
+    }
+
+    std::vector<u32> wanted;
+    for (u32 page : vt->seen)
+    {
+        const VirtualPage &info = vt->pages[page];
+        if (info.slot == VT_NO_SLOT) wanted.push_back(page);
+    }
+
+    // coarse levels first, each one makes every page below it look better
+    std::vector<u32> levels(wanted.size());
+    for (u32 i = 0; i < (u32)wanted.size(); ++i) levels[i] = page_level(vt, wanted[i]);
+
+    std::vector<u32> order(wanted.size());
+    for (u32 i = 0; i < (u32)order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [vt, &wanted, &levels](u32 a, u32 b) {
+        if (levels[a] != levels[b]) return levels[a] > levels[b];
+        return vt->pages[wanted[a]].feedback_count > vt->pages[wanted[b]].feedback_count;
+    });
+
+    vt->stats.pages_seen = directly_seen;
+    vt->stats.pages_missing = (u32)wanted.size();
+
+    // the queue is rebuilt from every feedback, pages that went out of view
+    // are dropped before being read
+    {
+        std::lock_guard<std::mutex> lock(vt->mutex);
+        for (u32 page : vt->requests)
+        {
+            vt->pages[page].loading = false;
+        }
+        vt->requests.clear();
+    }
+
+    std::vector<u32> requests;
+    for (u32 i : order)
+    {
+        if (requests.size() >= vt->options.max_requests) break;
+
+        VirtualPage *info = &vt->pages[wanted[i]];
+        if (info->loading) continue;
+
+        info->loading = true;
+        requests.push_back(wanted[i]);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(vt->mutex);
+        std::reverse(requests.begin(), requests.end());
+        vt->requests.swap(requests);
+    }
+    vt->wake.notify_one();
+}
+
+// a free slot, otherwise the one whose page was seen longest ago; never one
+// seen in the last feedback, those are on screen
+local u32
+find_slot(VirtualTexture *vt)
+{
+    u32 best = VT_NO_SLOT;
+    u64 best_frame = vt->frame;
+
+    for (u32 slot = 0; slot < (u32)vt->slot_page.size(); ++slot)
+    {
+        if (vt->slot_pinned[slot]) continue;
+
+        u32 page = vt->slot_page[slot];
+        if (page == VT_NO_SLOT) return slot;
+
+        u64 last_seen = vt->pages[page].last_seen_frame;
+        if (last_seen < best_frame)
+        {
+            best = slot;
+            best_frame = last_seen;
+        }
+    }
+
+    return best;
+}
+
+void update(VirtualTexture *vt)
+{
+    PROFILE_SCOPE("vt update");
+
+    {
+        std::lock_guard<std::mutex> lock(vt->mutex);
+        vt->arrived.insert(vt->arrived.end(), vt->completed.begin(), vt->completed.end());
+        vt->completed.clear();
+        vt->stats.bytes_read = vt->bytes_read;
+    }
+
+    std::stable_sort(vt->arrived.begin(), vt->arrived.end(), [vt](const VirtualPageLoad &a, const VirtualPageLoad &b) {
+        return page_level(vt, a.page) > page_level(vt, b.page);
+    });
+
+    u32 uploads = 0;
+    u32 taken = 0;
+    for (; taken < (u32)vt->arrived.size(); ++taken)
+    {
+        if (uploads >= vt->options.max_uploads_per_frame) break;
+
+        const VirtualPageLoad &load = vt->arrived[taken];
+        VirtualPage *page = &vt->pages[load.page];
+        page->loading = false;
+
+        if (!load.pixels)
+        {
+            LOG_W("Cannot read virtual texture page %u", load.page);
+            continue;
+        }
+
+        // pages that went out of view while loading are still worth a free
+        // slot, but do not push out anything
+        u32 slot = find_slot(vt);
+        if (slot == VT_NO_SLOT || page->slot != VT_NO_SLOT ||
+            (vt->slot_page[slot] != VT_NO_SLOT && page->last_seen_frame != vt->frame))
+        {
+            free(load.pixels);
+            continue;
+        }
+
+        if (vt->slot_page[slot] != VT_NO_SLOT)
+        {
+            vt->pages[vt->slot_page[slot]].slot = VT_NO_SLOT;
+            vt->stats.evictions += 1;
+        }
+
+        place_page(vt, load.page, slot, load.pixels);
+        ++uploads;
+    }
+    vt->arrived.erase(vt->arrived.begin(), vt->arrived.begin() + taken);
+
+    if (uploads > 0) build_indirection(vt);
+
+    vt->stats.uploads = (u32)vt->uploads.size();
+    vt->stats.pages_resident = 0;
+    for (u32 page : vt->slot_page)
+    {
+        if (page != VT_NO_SLOT) vt->stats.pages_resident += 1;
+    }
+    vt->stats.pending_loads = 0;
+    for (const VirtualPage &page : vt->pages)
+    {
+        if (page.loading) vt->stats.pending_loads += 1;
+    }
+}
+
+void finish_uploads(VirtualTexture *vt)
+{
+    for (const VirtualPageUpload &upload : vt->uploads) free(upload.pixels);
+    vt->uploads.clear();
+}
+
+void lookup_page(const VirtualTexture *vt, u32 level, u32 x, u32 y, u32 *slot_x, u32 *slot_y, u32 *resident_level)
+{
+    const VirtualTextureLevel &info = vt->levels[level];
+    const u8 *entry = vt->indirection[level].data() + ((u64)y * info.indirection_width + x) * 4;
+    *slot_x = entry[0];
+    *slot_y = entry[1];
+    *resident_level = entry[2];
+}
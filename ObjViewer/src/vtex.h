@@ -0,0 +1,181 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "types.h"
+#include "file.h"
+
+// Virtual texturing for scans too big to keep on the GPU.
+//
+// The image is baked offline into fixed size pages for every mip level. At
+// run time a low resolution feedback pass writes, per pixel, the page the
+// fragment would sample. The pages seen there are read from the memory
+// mapped page file on a background thread and copied into slots of one
+// physical atlas texture. An indirection texture, one texel per page and
+// level, maps a page to its slot; a page that is not resident points to
+// the slot of its nearest resident ancestor, so the surface is always drawn,
+// blurry at first and sharper as the pages arrive.
+//
+// Everything in this file runs without GL; vtexgpu.h owns the textures.
+//
+// [VirtualTextureFileHeader][level 0 pages][level 1 pages]...
+// pages of a level row by row, bottom row first like GL textures
+
+#define VT_FILE_MAGIC 0x5456564F // 'OVVT'
+#define VT_FILE_VERSION 1
+
+#define VT_PAGE_SIZE 128
+// texels of the neighbour pages around each page, so bilinear filtering at
+// the edge of a slot does not read from the slot next to it
+#define VT_PAGE_BORDER 4
+#define VT_PAGE_STRIDE (VT_PAGE_SIZE + 2 * VT_PAGE_BORDER)
+#define VT_PAGE_BYTES (VT_PAGE_STRIDE * VT_PAGE_STRIDE * 4)
+
+// feedback texels store page coordinates in 8 bits
+#define VT_MAX_PAGES_PER_SIDE 256
+#define VT_MAX_LEVELS 16
+
+#define VT_NO_SLOT 0xFFFFFFFF
+
+struct VirtualTextureFileHeader
+{
+    u32 magic;
+    u32 version;
+    u32 width;
+    u32 height;
+    u32 level_count; // the last level fits in one page
+    u32 page_count;
+    u64 page_data_offset;
+};
+
+struct VirtualTextureBakeOptions
+{
+    bool srgb; // filter the mips in linear light
+};
+
+VirtualTextureBakeOptions default_virtual_texture_bake_options();
+
+s32 bake_virtual_texture(const char *image_filename, const char *filename, const VirtualTextureBakeOptions &options);
+
+// rgba rows bottom up
+s32 bake_virtual_texture(const u8 *rgba, u32 width, u32 height, const char *filename, const VirtualTextureBakeOptions &options);
+
+struct VirtualTextureOptions
+{
+    u32 slots_x; // physical atlas size in pages
+    u32 slots_y;
+    u32 max_uploads_per_frame;
+    u32 max_requests; // io queue length, the rest waits for the next feedback
+};
+
+VirtualTextureOptions default_virtual_texture_options();
+
+struct VirtualTextureLevel
+{
+    u32 width; // texels
+    u32 height;
+    u32 pages_x;
+    u32 pages_y;
+    u32 first_page; // index of page (0, 0) in the file
+
+    // the indirection texture is a GL mip chain over the page counts
+    // rounded up to powers of two, this level's size in it
+    u32 indirection_width;
+    u32 indirection_height;
+};
+
+struct VirtualPage
+{
+    u32 slot;              // VT_NO_SLOT when not resident
+    u64 last_seen_frame;   // in the feedback, or an ancestor of a page that was
+    u32 feedback_count;    // pixels asking for it in the last feedback
+    bool loading;          // queued or being read by the io thread
+};
+
+struct VirtualPageLoad
+{
+    u32 page;
+    u8 *pixels; // VT_PAGE_BYTES, null when the read failed
+};
+
+// a slot the GPU side has to fill with pixels
+struct VirtualPageUpload
+{
+    u32 slot;
+    u8 *pixels;
+};
+
+struct VirtualTextureStats
+{
+    u32 pages_seen;       // distinct pages in the last feedback
+    u32 pages_missing;    // of those, not resident
+    u32 pages_resident;
+    u32 pending_loads;
+    u32 uploads;          // this frame
+    u32 evictions;        // total
+    u64 bytes_read;       // total, by the io thread
+};
+
+struct VirtualTexture
+{
+    MappedFile file;
+    VirtualTextureFileHeader header;
+    std::vector<VirtualTextureLevel> levels;
+    VirtualTextureOptions options;
+
+    std::vector<VirtualPage> pages;
+    std::vector<u32> slot_page; // page in each slot, VT_NO_SLOT when free
+    std::vector<bool> slot_pinned;
+
+    // page reads the io thread works through, guarded by mutex; bytes_read
+    // is its running total for the stats
+    std::thread io_thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<u32> requests; // sorted by priority, highest last
+    std::vector<VirtualPageLoad> completed;
+    u64 bytes_read;
+    bool quit;
+
+    u64 frame;
+    std::vector<VirtualPageLoad> arrived; // read but not in a slot yet
+    std::vector<u32> seen; // pages in the last feedback and their ancestors
+    std::vector<VirtualPageUpload> uploads;
+
+    // rgba8 per level: slot x, slot y, level of the page in the slot, 255
+    std::vector<std::vector<u8>> indirection;
+    bool indirection_dirty;
+
+    VirtualTextureStats stats;
+};
+
+s32 init(VirtualTexture *vt, const char *filename, const VirtualTextureOptions &options);
+void destroy(VirtualTexture *vt);
+
+u32 page_index(const VirtualTexture *vt, u32 level, u32 x, u32 y);
+
+// texel of the feedback pass for a page, alpha 0 means no virtual texture there
+inline u32 pack_feedback(u32 level, u32 x, u32 y)
+{
+    return x | (y << 8) | (level << 16) | 0xFF000000u;
+}
+
+// pixels are pack_feedback() values as read back from the feedback target;
+// marks the pages seen and their ancestors, and queues the missing ones,
+// coarsest level and most pixels first
+void process_feedback(VirtualTexture *vt, const u32 *pixels, u32 pixel_count);
+
+// takes the pages the io thread finished and assigns them slots, evicting
+// the least recently seen pages; fills vt->uploads and rebuilds the
+// indirection when anything moved. Once per frame after process_feedback
+void update(VirtualTexture *vt);
+
+// frees the pixels of vt->uploads once the GPU side copied them
+void finish_uploads(VirtualTexture *vt);
+
+// slot x, y and level of the page used for (level, x, y) after update(),
+// which is what the shader reads from the indirection texture
+void lookup_page(const VirtualTexture *vt, u32 level, u32 x, u32 y, u32 *slot_x, u32 *slot_y, u32 *resident_level);
@@ -0,0 +1,230 @@
+#include <math.h>
+
+#include <glad\glad.h>
+
+#include "vtexgpu.h"
+#include "profile.h"
+#include "stats.h"
+#include "log.h"
+
+VirtualTextureGpuOptions default_virtual_texture_gpu_options()
+{
+    VirtualTextureGpuOptions options;
+    options.feedback_divisor = 8;
+    return options;
+}
+
+local void
+destroy_feedback_target(VirtualTextureGpu *gpu)
+{
+    if (gpu->feedback_fbo) glDeleteFramebuffers(1, &gpu->feedback_fbo);
+    if (gpu->feedback_color) glDeleteTextures(1, &gpu->feedback_color);
+    if (gpu->feedback_depth) glDeleteRenderbuffers(1, &gpu->feedback_depth);
+    if (gpu->readback_pbo[0]) glDeleteBuffers(2, gpu->readback_pbo);
+
+    gpu->feedback_fbo = 0;
+    gpu->feedback_color = 0;
+    gpu->feedback_depth = 0;
+    gpu->readback_pbo[0] = 0;
+    gpu->readback_pbo[1] = 0;
+    gpu->readback_pending[0] = false;
+    gpu->readback_pending[1] = false;
+    gpu->feedback_width = 0;
+    gpu->feedback_height = 0;
+}
+
+local s32
+init_feedback_target(VirtualTextureGpu *gpu, u32 screen_width, u32 screen_height)
+{
+    destroy_feedback_target(gpu);
+
+    u32 width = screen_width / gpu->options.feedback_divisor;
+    u32 height = screen_height / gpu->options.feedback_divisor;
+    gpu->feedback_width = width > 0 ? width : 1;
+    gpu->feedback_height = height > 0 ? height : 1;
+
+    glGenTextures(1, &gpu->feedback_color);
+    glBindTexture(GL_TEXTURE_2D, gpu->feedback_color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, gpu->feedback_width, gpu->feedback_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenRenderbuffers(1, &gpu->feedback_depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, gpu->feedback_depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, gpu->feedback_width, gpu->feedback_height);
+
+    glGenFramebuffers(1, &gpu->feedback_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, gpu->feedback_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gpu->feedback_color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, gpu->feedback_depth);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        LOG_W("Virtual texture feedback target is incomplete (0x%x)", status);
+        destroy_feedback_target(gpu);
+        return -1;
+    }
+
+    glGenBuffers(2, gpu->readback_pbo);
+    for (u32 i = 0; i < 2; ++i)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, gpu->readback_pbo[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (u64)gpu->feedback_width * gpu->feedback_height * 4, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    return 0;
+}
+
+s32 init(VirtualTextureGpu *gpu, const VirtualTexture *vt, u32 screen_width, u32 screen_height,
+         const VirtualTextureGpuOptions &options)
+{
+    *gpu = {};
+    gpu->options = options;
+
+    gpu->atlas_width = vt->options.slots_x * VT_PAGE_STRIDE;
+    gpu->atlas_height = vt->options.slots_y * VT_PAGE_STRIDE;
+
+    // no mips, every slot holds one level of one page
+    glGenTextures(1, &gpu->atlas);
+    glBindTexture(GL_TEXTURE_2D, gpu->atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, gpu->atlas_width, gpu->atlas_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // read with texelFetch only, the levels are filled from vt->indirection
+    u32 level_count = (u32)vt->levels.size();
+    glGenTextures(1, &gpu->indirection);
+    glBindTexture(GL_TEXTURE_2D, gpu->indirection);
+    for (u32 level = 0; level < level_count; ++level)
+    {
+        const VirtualTextureLevel &info = vt->levels[level];
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, info.indirection_width, info.indirection_height, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level_count - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return init_feedback_target(gpu, screen_width, screen_height);
+}
+
+void destroy(VirtualTextureGpu *gpu)
+{
+    destroy_feedback_target(gpu);
+
+    if (gpu->atlas) glDeleteTextures(1, &gpu->atlas);
+    if (gpu->indirection) glDeleteTextures(1, &gpu->indirection);
+    gpu->atlas = 0;
+    gpu->indirection = 0;
+}
+
+void begin_feedback(VirtualTextureGpu *gpu, u32 screen_width, u32 screen_height)
+{
+    // a resize throws away the read backs in flight, the next ones catch up
+    if (gpu->feedback_width != glm::max(screen_width / gpu->options.feedback_divisor, 1u) ||
+        gpu->feedback_height != glm::max(screen_height / gpu->options.feedback_divisor, 1u))
+    {
+        init_feedback_target(gpu, screen_width, screen_height);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, gpu->feedback_fbo);
+    glViewport(0, 0, gpu->feedback_width, gpu->feedback_height);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void end_feedback(VirtualTextureGpu *gpu, VirtualTexture *vt, u32 screen_width, u32 screen_height)
+{
+    u32 current = gpu->readback_index;
+    u32 previous = current ^ 1;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, gpu->readback_pbo[current]);
+    glReadPixels(0, 0, gpu->feedback_width, gpu->feedback_height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    gpu->readback_pending[current] = true;
+
+    if (gpu->readback_pending[previous])
+    {
+        PROFILE_SCOPE("vt feedback read back");
+
+        u32 pixel_count = gpu->feedback_width * gpu->feedback_height;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, gpu->readback_pbo[previous]);
+        const u32 *pixels = (const u32 *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (u64)pixel_count * 4, GL_MAP_READ_BIT);
+        if (pixels)
+        {
+            process_feedback(vt, pixels, pixel_count);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        gpu->readback_pending[previous] = false;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    gpu->readback_index = previous;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, screen_width, screen_height);
+}
+
+void update(VirtualTextureGpu *gpu, VirtualTexture *vt)
+{
+    update(vt);
+
+    if (vt->uploads.empty() && !vt->indirection_dirty) return;
+
+    PROFILE_SCOPE("vt upload");
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    glBindTexture(GL_TEXTURE_2D, gpu->atlas);
+    for (const VirtualPageUpload &upload : vt->uploads)
+    {
+        u32 slot_x = upload.slot % vt->options.slots_x;
+        u32 slot_y = upload.slot / vt->options.slots_x;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, slot_x * VT_PAGE_STRIDE, slot_y * VT_PAGE_STRIDE,
+                        VT_PAGE_STRIDE, VT_PAGE_STRIDE, GL_RGBA, GL_UNSIGNED_BYTE, upload.pixels);
+    }
+    finish_uploads(vt);
+
+    if (vt->indirection_dirty)
+    {
+        glBindTexture(GL_TEXTURE_2D, gpu->indirection);
+        for (u32 level = 0; level < (u32)vt->levels.size(); ++level)
+        {
+            const VirtualTextureLevel &info = vt->levels[level];
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, info.indirection_width, info.indirection_height,
+                            GL_RGBA, GL_UNSIGNED_BYTE, vt->indirection[level].data());
+        }
+        vt->indirection_dirty = false;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void bind(VirtualTextureGpu *gpu, u32 atlas_unit, u32 indirection_unit)
+{
+    glActiveTexture(GL_TEXTURE0 + atlas_unit);
+    glBindTexture(GL_TEXTURE_2D, gpu->atlas);
+    glActiveTexture(GL_TEXTURE0 + indirection_unit);
+    glBindTexture(GL_TEXTURE_2D, gpu->indirection);
+    count_texture_changes(2);
+}
+
+void set_virtual_texture_uniforms(Shader *shader, const VirtualTextureGpu *gpu, const VirtualTexture *vt, float lod_bias)
+{
+    set_vec2(shader, "vt_size", glm::vec2((float)vt->header.width, (float)vt->header.height));
+    set_vec2(shader, "vt_atlas_size", glm::vec2((float)gpu->atlas_width, (float)gpu->atlas_height));
+    set_float(shader, "vt_max_level", (float)(vt->levels.size() - 1));
+    set_float(shader, "vt_lod_bias", lod_bias);
+}
+
+float feedback_lod_bias(const VirtualTextureGpu *gpu)
+{
+    return -log2f((float)gpu->options.feedback_divisor);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "types.h"
+#include "vtex.h"
+#include "shader.h"
+
+// GL side of a VirtualTexture: the physical page atlas, the indirection
+// texture and the feedback target.
+//
+// The feedback pass draws the scene with shader/vt_feedback.frag into a
+// target 1/feedback_divisor the size of the screen. It is read back through
+// two pixel pack buffers, so a frame's feedback is mapped one frame later
+// when the copy has long finished instead of stalling on it.
+
+struct VirtualTextureGpuOptions
+{
+    u32 feedback_divisor;
+};
+
+VirtualTextureGpuOptions default_virtual_texture_gpu_options();
+
+struct VirtualTextureGpu
+{
+    VirtualTextureGpuOptions options;
+
+    u32 atlas;       // slots_x * VT_PAGE_STRIDE by slots_y * VT_PAGE_STRIDE, rgba8
+    u32 indirection; // one mip level per virtual texture level
+    u32 atlas_width;
+    u32 atlas_height;
+
+    u32 feedback_fbo;
+    u32 feedback_color;
+    u32 feedback_depth;
+    u32 feedback_width;
+    u32 feedback_height;
+
+    u32 readback_pbo[2];
+    bool readback_pending[2];
+    u32 readback_index;
+};
+
+s32 init(VirtualTextureGpu *gpu, const VirtualTexture *vt, u32 screen_width, u32 screen_height,
+         const VirtualTextureGpuOptions &options);
+
+void destroy(VirtualTextureGpu *gpu);
+
+// binds and clears the feedback target, draw the scene with the feedback
+// shader after this
+void begin_feedback(VirtualTextureGpu *gpu, u32 screen_width, u32 screen_height);
+
+// starts the read back of this frame's feedback, hands last frame's to
+// process_feedback and restores the default framebuffer
+void end_feedback(VirtualTextureGpu *gpu, VirtualTexture *vt, u32 screen_width, u32 screen_height);
+
+// update(vt), then copies the new pages into the atlas and the indirection
+// when it changed
+void update(VirtualTextureGpu *gpu, VirtualTexture *vt);
+
+void bind(VirtualTextureGpu *gpu, u32 atlas_unit, u32 indirection_unit);
+
+// the vt_ uniforms both shaders share; lod_bias moves the selected level,
+// the feedback pass uses it to make up for its smaller target
+void set_virtual_texture_uniforms(Shader *shader, const VirtualTextureGpu *gpu, const VirtualTexture *vt, float lod_bias);
+
+// lod bias of the feedback pass
+float feedback_lod_bias(const VirtualTextureGpu *gpu);
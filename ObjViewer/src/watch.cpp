@@ -0,0 +1,216 @@
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+
+#include "watch.h"
+#include "log.h"
+
+// how often the thread checks for changes (polling) or for quit (inotify)
+#define WATCH_INTERVAL_MS 200
+
+local s64
+modified_time(const char *filename)
+{
+    struct stat info;
+    if (stat(filename, &info) != 0) return -1;
+    return (s64)info.st_mtime;
+}
+
+local void
+split_path(const char *filename, std::string *directory, std::string *name)
+{
+    const char *slash = nullptr;
+    for (const char *at = filename; *at; ++at)
+    {
+        if (*at == '/' || *at == '\\') slash = at;
+    }
+
+    if (slash)
+    {
+        directory->assign(filename, slash - filename);
+        name->assign(slash + 1);
+    }
+    else
+    {
+        directory->assign(".");
+        name->assign(filename);
+    }
+}
+
+local void
+mark_changed(FileWatcher *watcher, u32 id)
+{
+    if (std::find(watcher->changed.begin(), watcher->changed.end(), id) == watcher->changed.end())
+    {
+        watcher->changed.push_back(id);
+    }
+}
+
+#if defined(__linux__)
+
+local void
+watch_thread_proc(FileWatcher *watcher)
+{
+    alignas(struct inotify_event) char buffer[4096];
+
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> lock(watcher->mutex);
+            if (watcher->quit) break;
+        }
+
+        pollfd fd = { watcher->inotify_fd, POLLIN, 0 };
+        if (poll(&fd, 1, WATCH_INTERVAL_MS) <= 0) continue;
+
+        ssize_t size = read(watcher->inotify_fd, buffer, sizeof(buffer));
+        if (size <= 0) continue;
+
+        std::lock_guard<std::mutex> lock(watcher->mutex);
+
+        for (char *at = buffer; at < buffer + size;)
+        {
+            const inotify_event *event = (const inotify_event *)at;
+            at += sizeof(inotify_event) + event->len;
+
+            if (event->len == 0) continue;
+
+            for (u32 directory = 0; directory < watcher->directory_watches.size(); ++directory)
+            {
+                if (watcher->directory_watches[directory] != event->wd) continue;
+
+                for (u32 id = 0; id < watcher->files.size(); ++id)
+                {
+                    const WatchedFile &file = watcher->files[id];
+                    if (file.directory == watcher->directories[directory] && file.name == event->name)
+                    {
+                        mark_changed(watcher, id);
+                    }
+                }
+            }
+        }
+    }
+}
+
+#else
+
+local void
+watch_thread_proc(FileWatcher *watcher)
+{
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> lock(watcher->mutex);
+            if (watcher->quit) break;
+
+            for (u32 id = 0; id < watcher->files.size(); ++id)
+            {
+                WatchedFile &file = watcher->files[id];
+
+                // a file being replaced may briefly not exist, wait for it
+                s64 time = modified_time(file.filename.c_str());
+                if (time != -1 && time != file.modified_time)
+                {
+                    file.modified_time = time;
+                    mark_changed(watcher, id);
+                }
+            }
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_INTERVAL_MS));
+    }
+}
+
+#endif
+
+s32 init(FileWatcher *watcher)
+{
+    watcher->quit = false;
+
+#if defined(__linux__)
+    watcher->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher->inotify_fd < 0)
+    {
+        LOG_W("Cannot create the inotify instance, hot reload disabled");
+        return -1;
+    }
+#endif
+
+    watcher->thread = std::thread(watch_thread_proc, watcher);
+
+    return 0;
+}
+
+u32 watch_file(FileWatcher *watcher, const char *filename)
+{
+    WatchedFile file;
+    file.filename = filename;
+    file.modified_time = modified_time(filename);
+    split_path(filename, &file.directory, &file.name);
+
+    std::lock_guard<std::mutex> lock(watcher->mutex);
+
+#if defined(__linux__)
+    if (std::find(watcher->directories.begin(), watcher->directories.end(), file.directory) == watcher->directories.end())
+    {
+        s32 wd = inotify_add_watch(watcher->inotify_fd, file.directory.c_str(),
+                                   IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (wd < 0)
+        {
+            LOG_W("Cannot watch directory '%s'", file.directory.c_str());
+        }
+        else
+        {
+            watcher->directory_watches.push_back(wd);
+            watcher->directories.push_back(file.directory);
+        }
+    }
+#endif
+
+    watcher->files.push_back(file);
+
+    return (u32)watcher->files.size() - 1;
+}
+
+void poll_changes(FileWatcher *watcher, std::vector<u32> *changed)
+{
+    std::lock_guard<std::mutex> lock(watcher->mutex);
+
+    changed->insert(changed->end(), watcher->changed.begin(), watcher->changed.end());
+    watcher->changed.clear();
+}
+
+void destroy(FileWatcher *watcher)
+{
+    {
+        std::lock_guard<std::mutex> lock(watcher->mutex);
+        watcher->quit = true;
+    }
+
+    if (watcher->thread.joinable())
+    {
+        watcher->thread.join();
+    }
+
+#if defined(__linux__)
+    if (watcher->inotify_fd >= 0)
+    {
+        close(watcher->inotify_fd);
+    }
+    watcher->inotify_fd = -1;
+    watcher->directory_watches.clear();
+    watcher->directories.clear();
+#endif
+
+    watcher->files.clear();
+    watcher->changed.clear();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+
+#include "types.h"
+
+// Watches a set of files from a background thread: inotify on linux, a
+// modification time poll everywhere else. The main thread drains the
+// changed files once per frame and reloads only those.
+//
+// Editors often save through a temporary file and a rename, so the
+// directory of a file is watched rather than the file itself.
+
+#define WATCH_NONE 0xFFFFFFFF
+
+struct WatchedFile
+{
+    std::string filename;
+    std::string directory;
+    std::string name;
+    s64 modified_time;
+};
+
+struct FileWatcher
+{
+    // shared with the watch thread
+    std::thread thread;
+    std::mutex mutex;
+    std::vector<WatchedFile> files;
+    std::vector<u32> changed;
+    bool quit;
+
+#if defined(__linux__)
+    s32 inotify_fd;
+    std::vector<s32> directory_watches; // one per watched directory
+    std::vector<std::string> directories;
+#endif
+};
+
+s32 init(FileWatcher *watcher);
+
+// returns the id reported by poll_changes when the file is modified
+u32 watch_file(FileWatcher *watcher, const char *filename);
+
+// ids of the files modified since the last call, each reported once
+void poll_changes(FileWatcher *watcher, std::vector<u32> *changed);
+
+void destroy(FileWatcher *watcher);